@@ -10,10 +10,172 @@
 /*#include "fly_io.h"*/
 #include "mex.h"
 #include "mathLib.h"            /* Trunc function is in there */    
-#include "fly_sa.h"             /* MoveX function is in here */
+#include "fly_sa.h"             /* MoveX and MoveXBatch are in here */
+#include "score.h"              /* for GetScoreStats */
 #include <string.h>
 #include "RootOfAllEvol.h"
 
+/* default for the most memory the score cache may use (see SetScoreCache *
+ * in fly_sa.h and MexOption)                                             */
+#define SCORE_CACHE_BYTES (256 << 20)
+
+static double cache_bytes = SCORE_CACHE_BYTES;  /* 0: no score cache */
+static int solver = 1;          /* for MoveX: 0 Rkck, 1 Direct-Band, 2 Imex, 3 Rk4 */
+
+/* MexOption: RootOfAllEvol('name', value) sets an option for the runs that *
+ * follow, RootOfAllEvol('name') returns what there is to know about it:    *
+ *   'cache': the most memory (in bytes) the score cache may use, 0 turns   *
+ *            it off (default 256MB); without a value, returns the          *
+ *            [hits misses] of the cache since it was last emptied          *
+ *   'bound': stop a model run as soon as its score + penalty are over      *
+ *            the value and score it FORBIDDEN_MOVE (see SetScoreBound in   *
+ *            fly_sa.h), 0 turns this off (the default); without a value,   *
+ *            prints and returns the [runs stopped] model runs so far       *
+ *   'solver': 'rkck', 'band' (the default), 'imex' or 'rk4'; takes effect  *
+ *            with the next call that scores                                *
+ *   'ensemble': K [rkck] scores batches K candidates at a time in lock-    *
+ *            step (see SetEnsembleSize in fly_sa.h), which needs the rk4   *
+ *            solver, or rkck if the second value is 1 (but then the score  *
+ *            of a candidate depends on the others in its ensemble); K = 1  *
+ *            turns this off (the default)                                  */
+static void MexOption(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
+    char *name = mxArrayToString(prhs[0]);
+
+    if (!strcmp(name, "cache")) {
+        if (nrhs > 1) {
+            cache_bytes = mxGetScalar(prhs[1]);
+            if (cache_bytes < 0)
+                cache_bytes = 0;
+            SetScoreCache((size_t) cache_bytes);
+        } else {
+            long hits, misses;
+            GetScoreCacheStats(&hits, &misses);
+            plhs[0] = mxCreateDoubleMatrix(1,2,mxREAL);
+            mxGetPr(plhs[0])[0] = hits;
+            mxGetPr(plhs[0])[1] = misses;
+        }
+    } else if (!strcmp(name, "bound")) {
+        if (nrhs > 1) {
+            SetScoreBound(mxGetScalar(prhs[1]));
+        } else {
+            int scores, aborted;
+            GetScoreStats(&scores, &aborted);
+            printf("stopped %d of %d model runs (%.4f)\n", aborted, scores, scores ? (double) aborted / scores : 0.);
+            plhs[0] = mxCreateDoubleMatrix(1,2,mxREAL);
+            mxGetPr(plhs[0])[0] = scores;
+            mxGetPr(plhs[0])[1] = aborted;
+        }
+    } else if (!strcmp(name, "solver") && nrhs > 1) {
+        char *which = mxArrayToString(prhs[1]);
+        int s = -1;
+
+        if (which != NULL) {
+            if (!strcmp(which, "rkck"))
+                s = 0;
+            else if (!strcmp(which, "band"))
+                s = 1;
+            else if (!strcmp(which, "imex"))
+                s = 2;
+            else if (!strcmp(which, "rk4"))
+                s = 3;
+            mxFree(which);
+        }
+        if (s < 0) {
+            mxFree(name);
+            mexErrMsgTxt("RootOfAllEvol: unknown solver, use: rkck, band, imex, rk4");
+        }
+        solver = s;
+    } else if (!strcmp(name, "ensemble") && nrhs > 1) {
+        int K = (int) mxGetScalar(prhs[1]);
+
+        if (K < 1) {
+            mxFree(name);
+            mexErrMsgTxt("RootOfAllEvol: an ensemble needs at least one member");
+        }
+        SetEnsembleSize(K);
+        SetEnsembleRkck(nrhs > 2 && mxGetScalar(prhs[2]) != 0);
+    } else {
+        mxFree(name);
+        mexErrMsgTxt("RootOfAllEvol: unknown option, use: bound, cache, ensemble, solver");
+    }
+    mxFree(name);
+}
+
+/* MexBatch: the batch version of mexFunction; prhs[0] is a matrix with one 
+ * candidate per row, plhs[0] gets a column of scores (score + penalty) and 
+ * plhs[1] the residuals of the candidates, stacked row by row */
+static void MexBatch(mxArray *plhs[], const mxArray *prhs[], int init) {
+    double *x, *xt, *m, *y, *z;
+    int *mask;
+    int i, j, nvec, nparm, masksize, size;
+    Files files;
+    ScoreOutput *out;
+    char *inputfile;
+
+    nvec = mxGetM(prhs[0]);
+    nparm = mxGetN(prhs[0]);
+    masksize = mxGetN(prhs[1]);
+
+    files.inputfile = ( char * ) calloc( MAX_RECORD, sizeof( char ) );
+    files.statefile = ( char * ) calloc( MAX_RECORD, sizeof( char ) );
+    inputfile = mxArrayToString(prhs[2]);
+    strcpy( files.inputfile, inputfile);
+    sprintf( files.statefile, "%s.state", files.inputfile );
+
+    mask = (int *) calloc( masksize, sizeof(int) );
+    m = mxGetPr(prhs[1]);
+    for (i=0; i<masksize; i++) {
+        mask[i] = (int) m[i];
+    }
+
+    /* matlab stores matrices column by column, MoveXBatch wants rows */
+    x = mxGetPr(prhs[0]);
+    xt = (double *) calloc( nvec * nparm, sizeof(double) );
+    for (i=0; i<nvec; i++) {
+        for (j=0; j<nparm; j++) {
+            xt[i*nparm + j] = Trunc(x[j*nvec + i], 5);  /*see mexFunction*/
+        }
+    }
+
+    out = (ScoreOutput *) calloc( nvec, sizeof(ScoreOutput) );
+    for (i=0; i<nvec; i++) {
+        out[i].score = 1e38;
+    }
+
+    MoveXBatch(xt, nvec, nparm, mask, out, &files, init, 0, solver);
+
+    size = 0;
+    for (i=0; i<nvec; i++) {
+        if (out[i].score < 0) {
+            printf("OUT_OF_BOUND - setting score to 0 and penalty to 1e38\n");
+            out[i].score = 0;
+            out[i].penalty = 1e38;
+        }
+        if (out[i].size_resid_arr > size)
+            size = out[i].size_resid_arr;
+    }
+
+    /* candidates that were out of bounds have no residuals; they get zeros */
+    plhs[0] = mxCreateDoubleMatrix(nvec,1,mxREAL);
+    plhs[1] = mxCreateDoubleMatrix(nvec,size,mxREAL);
+    y = mxGetPr(plhs[0]);
+    z = mxGetPr(plhs[1]);
+    for (i=0; i<nvec; i++) {
+        y[i] = out[i].score + out[i].penalty;
+        for (j=0; j<out[i].size_resid_arr; j++) {
+            z[j*nvec + i] = out[i].residuals[j];
+        }
+        free(out[i].jacobian);
+        free(out[i].residuals);
+    }
+
+    mxFree(inputfile);
+    free(files.inputfile);
+    free(files.statefile);
+    free(out);
+    free(xt);
+    free(mask);
+}
 
 void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
     /*printf("Mex Function Entered Successfully\n");*/
@@ -22,17 +184,49 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
     static int i, size, rowLen, masksize;
     static int nParm = 0;
     static int init = 1;    /* init = 1 means 'initialization loop' */
-    static int jacobian = 0;    /* set this if you need the Jacobian matrix */
+    int jacobian = (nlhs > 2) ? JACOBIAN : 0;  /* [f,R,J] = ...: J is the Jacobian of R */
+    char *what = NULL;
+    int np = 0;
     static Files files;
     static char *inputfile = NULL;
 
     static ScoreOutput out;
+
+    /* RootOfAllEvol('name', ...) sets or queries an option */
+    if (nrhs > 0 && mxIsChar(prhs[0])) {
+        MexOption(nlhs, plhs, nrhs, prhs);
+        return;
+    }
+    if (nrhs < 3)
+        mexErrMsgTxt("RootOfAllEvol: usage: [f,R] = RootOfAllEvol(x,mask,file)");
+
+    /* SSm sends the same (truncated) parameters more than once, so we keep *
+     * the scores of the last ones around                                  */
+    if (init)
+        SetScoreCache((size_t) cache_bytes);
     
+    /* a matrix of candidates (one per row) is scored in one go */
+    if (mxGetM(prhs[0]) > 1 && mxGetN(prhs[0]) > 1) {
+        MexBatch(plhs, prhs, init);
+        init = 0;
+        return;
+    }
+
     out.score = 1e38;       /*start with a very large number*/
     out.penalty = 0;
     out.size_resid_arr = 0;
     out.jacobian = NULL;
+    out.gradient = NULL;
     out.residuals = NULL;
+
+    /* [f,R,g] = RootOfAllEvol(x,mask,file,'gradient'): g is the gradient *
+     * of f, by adjoints                                                  */
+    if (jacobian && (nrhs > 3)) {
+        what = mxArrayToString(prhs[3]);
+        if (what != NULL && !strcmp(what, "gradient"))
+            jacobian = GRADIENT;
+        mxFree(what);
+    }
     
     
     /* allocate memory for static file names */
@@ -58,6 +252,7 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
 
     for (i=0; i<masksize; i++) {
         mask[i] = (int) m[i];        
+        np += mask[i];
     }
     for (i=0; i<nParm; i++) {
         x[i] = Trunc(x[i], 5);      /*this is needed to avoid errors due to lack of precision*/
@@ -74,7 +269,7 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
     /*if( 0 == access( files.statefile, F_OK ) )
         stateflag = 1; //use this for restore when implemented*/
     
-    MoveX(x, mask, &out, &files, init, jacobian, 1); /*0 Rkck, 1 Direct-Band */
+    MoveX(x, mask, &out, &files, init, jacobian, solver);
     /*printf("SCORE = %lf, PENALTY = %lf, RETURNED %lf\n", out.score, out.penalty, out.score + out.penalty);*/
     /*printf("RETURNED %lf\n", out.score + out.penalty);*/
     if (out.score < 0) {    /* maybe eliminate later and deal only with 1e38 */
@@ -92,6 +287,18 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
         z[i] = out.residuals[i];
     }
     y[0] = out.score + out.penalty; /*comment this to test without penalties*/
+
+    /* the Jacobian of the residuals to the np parameters in x, one column *
+     * per parameter, which is how matlab stores matrices anyway           */
+    if (jacobian == GRADIENT) {
+        plhs[2] = mxCreateDoubleMatrix(np,1,mxREAL);
+        if (out.gradient != NULL && out.penalty != 1e38)
+            memcpy(mxGetPr(plhs[2]), out.gradient, np * sizeof(double));
+    } else if (jacobian) {
+        plhs[2] = mxCreateDoubleMatrix(size,np,mxREAL);
+        if (out.jacobian != NULL)
+            memcpy(mxGetPr(plhs[2]), out.jacobian, size * np * sizeof(double));
+    }
     
     plhs[1] = mxCreateDoubleMatrix(1,1,mxREAL);
     init = 0;
@@ -99,6 +306,7 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
     free(files.inputfile);
     free(files.statefile);
     free(out.jacobian);
+    free(out.gradient);
     free(out.residuals);
     free(mask);
     return;
@@ -31,6 +31,7 @@
 //#include <distributions.h>               /* DistP.variables and prototypes */
 //#include <sa.h>                /* *ONLY* for random number funcs and flags */
 #include <fly_io.h>
+#include <fly_sa.h>             /* for SetScoreBound */
 
 #ifdef MPI                      
 #include <mpi.h>                /* this is the official MPI interface */
@@ -203,10 +204,12 @@ GetFinalInfo( void ) {
 
 /** GenerateMove: evaluates the old energy, changes a parameter, then eval- 
  *               uates the new energy; returns the difference between old  
- *               and new energy to the caller                              
+ *               and new energy to the caller, or FORBIDDEN_MOVE if the    
+ *               new energy went over bound (unless bound is 0), in which  
+ *               case the model run is stopped early (see SetScoreBound)   
  */
 double
-GenerateMove( Files * files, DistParms * distp, ScoreOutput * out ) {
+GenerateMove( Files * files, DistParms * distp, ScoreOutput * out, double bound ) {
     double delta_e;             /* energy difference before and after move */
     /* for first call: check for valid parameters */
 
@@ -224,7 +227,9 @@ GenerateMove( Files * files, DistParms * distp, ScoreOutput * out ) {
     acc_tab[idx].hits++;
     //new_energy = Score();
 
+    SetScoreBound( bound );
     MoveSA( NULL, distp, out, NULL, 0, 0 );
+    SetScoreBound( 0. );
 
     new_energy = out->score + out->penalty;
     if( new_energy >= FORBIDDEN_MOVE ) {
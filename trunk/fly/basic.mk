@@ -2,11 +2,11 @@
 # (unless you know *exactly* what you're doing...) 
 
 #all objects
-AOBJ = zygotic.o fly_io.o maternal.o integrate.o translate.o savestate.o fly_sa.o ../util/error.o ../util/ioTools.o solvers.o score.o # ../util/distributions.o ../util/random.o ../util/dSFMT.o ../util/dSFMT_str_state.o
+AOBJ = zygotic.o fly_io.o maternal.o integrate.o translate.o savestate.o fly_sa.o ../util/error.o ../util/ioTools.o ../util/vecLib.o solvers.o score.o # ../util/distributions.o ../util/random.o ../util/dSFMT.o ../util/dSFMT_str_state.o
 
 #fly_sa objects
 FOBJ = zygotic.o fly_io.o maternal.o integrate.o translate.o \
-         ../util/error.o ../util/distributions.o ../util/random.o ../util/ioTools.o solvers.o score.o ../util/dSFMT.o ../util/dSFMT_str_state.o
+         ../util/error.o ../util/distributions.o ../util/random.o ../util/ioTools.o ../util/vecLib.o solvers.o score.o ../util/dSFMT.o ../util/dSFMT_str_state.o
 # serial code
 FSOBJ = fly_sa.o savestate.o # moves.o ../util/lsa.o
 # parallel code
@@ -15,15 +15,19 @@ FSOBJ = fly_sa.o savestate.o # moves.o ../util/lsa.o
 
 #printscore objects
 POBJ = zygotic.o fly_io.o maternal.o integrate.o translate.o \
-       ../util/error.o ../util/distributions.o ../util/random.o ../util/ioTools.o solvers.o score.o printscore.o ../util/dSFMT.o ../util/dSFMT_str_state.o
+       ../util/error.o ../util/distributions.o ../util/random.o ../util/ioTools.o ../util/vecLib.o solvers.o score.o printscore.o ../util/dSFMT.o ../util/dSFMT_str_state.o
 
 #unfold objects
 UOBJ = zygotic.o fly_io.o maternal.o integrate.o translate.o \
-	 ../util/error.o ../util/distributions.o ../util/random.o ../util/ioTools.o solvers.o score.o unfold.o ../util/dSFMT.o ../util/dSFMT_str_state.o
+	 ../util/error.o ../util/distributions.o ../util/random.o ../util/ioTools.o ../util/vecLib.o solvers.o score.o unfold.o ../util/dSFMT.o ../util/dSFMT_str_state.o
 
 #scramble objects
 SOBJ = zygotic.o fly_io.o maternal.o integrate.o translate.o \
-	 ../util/error.o ../util/distributions.o ../util/random.o ../util/ioTools.o solvers.o score.o scramble.o ../util/dSFMT.o ../util/dSFMT_str_state.o
+	 ../util/error.o ../util/distributions.o ../util/random.o ../util/ioTools.o ../util/vecLib.o solvers.o score.o scramble.o ../util/dSFMT.o ../util/dSFMT_str_state.o
+
+#benchmark objects (not in FLYEXECS: 'make benchmark')
+BOBJ = zygotic.o fly_io.o maternal.o integrate.o translate.o \
+	 ../util/error.o ../util/ioTools.o ../util/vecLib.o solvers.o score.o benchmark.o
 
 SOURCES = `ls *.c`
 
@@ -79,6 +83,9 @@ unfold: $(UOBJ)
 scramble: $(SOBJ)
 	$(CC) -o scramble $(CFLAGS) $(LDFLAGS) $(SOBJ) $(LIBS) 
 
+benchmark: $(BOBJ)
+	$(CC) -o benchmark $(CFLAGS) $(LDFLAGS) $(BOBJ) $(LIBS) 
+
 # ... and parallel
 
 #fly_sa.mpi: $(FOBJ) $(FPOBJ)
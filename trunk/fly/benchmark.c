@@ -0,0 +1,493 @@
+/**
+ * @file benchmark.c
+ *
+ * @copyright Copyright (C) 2009-2013 Damjan Cicin-Sain, Anton Crombach and
+ * Yogi Jaeger
+ *
+ * @brief Times the model on a data file, for the options that only change
+ * how fast it runs: the state layout, the threads per derivative, ensembles
+ * and the solvers.
+ *
+ * Each benchmark scores the parameters of the data file a number of times
+ * and prints the best wallclock time of a run, together with whether the
+ * runs it compares came out the same, bit for bit. The numbers in the com-
+ * mit messages and in zygotic.h come from here. Not part of 'make all'; do
+ * 'make benchmark' in fly.
+ */
+
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <unistd.h>             /* for getopt */
+
+#include <error.h>
+#include <integrate.h>
+#include <maternal.h>
+#include <score.h>
+#include <solvers.h>
+#include <zygotic.h>
+
+
+/* *Constants *************************************************************/
+
+const char *OPTS = ":a:b:g:hi:k:r:s:x:";  /* command line option string */
+
+
+/*** Help, usage and version messages **************************************/
+
+static const char usage[] =
+    "Usage: benchmark [-a <accuracy>] [-b <benchmark>] [-g <g(u)>] [-h]\n"
+    "                 [-i <stepsize>] [-k <threads>] [-r <runs>] [-s <solver>]\n"
+    "                 [-x <sect_title>]\n"
+    "                 <datafile>\n";
+
+static const char help[] =
+    "Usage: benchmark [options] <datafile>\n\n"
+    "Arguments:\n"
+    "  <datafile>          data file whose parameters we time the model with\n\n"
+    "Options:\n"
+    "  -a <accuracy>       solver accuracy for adaptive stepsize ODE solvers\n"
+    "  -b <benchmark>      what to time:\n"
+    "                        layout: nucleus- against gene-major state (default)\n"
+    "                        solvers: time, derivatives and error of each solver\n"
+    "                        threads: 1, 2, 4... threads per derivative (see -k)\n"
+    "                        ensemble: K candidates in lockstep against one by one\n"
+    "                        accuracy: error against derivatives for -a 1e-1..1e-5\n"
+    "  -g <g(u)>           chooses g(u): e = exp, h = hvs, s = sqrt, t = tanh\n"
+    "  -h                  prints this help message\n"
+    "  -i <stepsize>       sets ODE solver stepsize (in minutes)\n"
+    "  -k <threads>        most threads per derivative to time (default: cores)\n"
+    "  -r <runs>           best of <runs> runs (default 5)\n"
+    "  -s <solver>         choose ODE solver (as in printscore)\n"
+    "  -x <sect_title>     uses equation paramters from section <sect_title>\n\n"
+    "Please report bugs to <yoginho@usa.net>. Thank you!\n";
+
+
+// GLOBAL CONSTANTS
+
+const int MAX_PRECISION = 16;
+/* the following constant as a score tells the annealer to reject a move,  */
+/* no matter what. It had better not be a number that could actually be a  */
+/* score.                                                                  */
+const double FORBIDDEN_MOVE = DBL_MAX;  /* the biggest possible score, ever */
+
+const int OUT_OF_BOUND = -1;
+
+static int runs = 5;            /* each time is the best of this many runs */
+static int maxthreads = 0;      /* most rhsthreads to time (0: the cores) */
+
+static long nderiv = 0;         /* derivative evaluations so far */
+static void ( *p_counted ) ( double *, double, double *, int, SolverInput *, Input * );
+
+
+/*** Timing ****************************************************************/
+
+/* WallTime: seconds since some time in the past */
+static double
+WallTime( void ) {
+    struct timeval t;
+
+    gettimeofday( &t, NULL );
+    return t.tv_sec + 1e-6 * t.tv_usec;
+}
+
+/* TimeScore: the best time of runs calls of Score() on inp, in seconds; *
+ * the output of the last one is left in out                            */
+static double
+TimeScore( Input * inp, ScoreOutput * out ) {
+    double t, best = DBL_MAX;
+    int r;
+
+    for( r = 0; r < runs; r++ ) {
+        t = WallTime(  );
+        Score( inp, out, 0 );
+        t = WallTime(  ) - t;
+        if( t < best )
+            best = t;
+    }
+    return best;
+}
+
+/* SameOutput: 1 if a and b have the same score, penalty and residuals, *
+ * bit for bit                                                          */
+static int
+SameOutput( ScoreOutput * a, ScoreOutput * b ) {
+    return ( a->score == b->score ) && ( a->penalty == b->penalty ) && ( a->size_resid_arr == b->size_resid_arr )
+        && !memcmp( a->residuals, b->residuals, a->size_resid_arr * sizeof( double ) );
+}
+
+
+/* CountDeriv: p_counted, counted in nderiv */
+static void
+CountDeriv( double *v, double t, double *vdot, int n, SolverInput * si, Input * inp ) {
+    nderiv++;
+    p_counted( v, t, vdot, n, si, inp );
+}
+
+/* MaxDiff: the largest difference between the residuals of a and b */
+static double
+MaxDiff( ScoreOutput * a, ScoreOutput * b ) {
+    double d, max = 0.;
+    int i;
+
+    if( a->size_resid_arr != b->size_resid_arr )
+        return HUGE_VAL;
+    for( i = 0; i < a->size_resid_arr; i++ ) {
+        d = fabs( a->residuals[i] - b->residuals[i] );
+        if( !( d <= max ) )
+            max = d;
+    }
+    return max;
+}
+
+
+/*** The benchmarks ********************************************************/
+
+/* BenchLayout: a whole Score() with the solvers working on nucleus-major *
+ * and on gene-major states (see StateLayout in zygotic.h)                */
+static void
+BenchLayout( Input * inp ) {
+    ScoreOutput out[2];
+    double t[2];
+    int l;
+
+    memset( out, 0, sizeof( out ) );
+    for( l = 0; l < 2; l++ ) {
+        slayout = l ? GeneMajor : NucMajor;
+        t[l] = TimeScore( inp, &( out[l] ) );
+    }
+    slayout = NucMajor;
+    printf( "layout, %d nuclei: nucleus-major %.3f ms, gene-major %.3f ms (%.2f times), chisq %s\n",
+            inp->zyg.defs.nnucs, 1e3 * t[0], 1e3 * t[1], t[1] / t[0], SameOutput( &out[0], &out[1] ) ? "the same" : "differs" );
+    free( out[0].residuals );
+    free( out[1].residuals );
+}
+
+/* ReferenceScore: the output of Rk4 with a stepsize fraction times smal- *
+ * ler than the one given, to measure the error of the other solvers by   */
+static void
+ReferenceScore( Input * inp, ScoreOutput * ref, double fraction ) {
+    void ( *old_ps ) ( double *, double *, double, double, double, double, int, FILE *, SolverInput *, Input * ) = ps;
+    double stepsize = inp->ste.stepsize;
+
+    ps = Rk4;
+    inp->ste.stepsize = stepsize / fraction;
+    Score( inp, ref, 0 );
+    inp->ste.stepsize = stepsize;
+    ps = old_ps;
+}
+
+/* BenchSolvers: a whole Score() with each solver at the accuracy and step- *
+ * size given, next to the derivative evaluations per Score() and the lar- *
+ * gest error in a residual; the error is against Rk4 with a stepsize 16   *
+ * times smaller. Run it on bigger and bigger data files to see where the  *
+ * Krylov solver overtakes Band                                            */
+static void
+BenchSolvers( Input * inp ) {
+    static struct {
+        const char *name;
+        void ( *solver ) ( double *, double *, double, double, double, double, int, FILE *, SolverInput *, Input * );
+    } solvers[] = {
+        {"Rk4", Rk4}, {"Rkck", Rkck}, {"Imex", Imex}, {"Band", Band}, {"Krylov", Krylov}
+    };
+    void ( *old_ps ) ( double *, double *, double, double, double, double, int, FILE *, SolverInput *, Input * ) = ps;
+    ScoreOutput ref, out;
+    double t;
+    long n;
+    int s;
+
+    memset( &ref, 0, sizeof( ref ) );
+    memset( &out, 0, sizeof( out ) );
+    ReferenceScore( inp, &ref, 16. );
+
+    p_counted = p_deriv;
+    p_deriv = CountDeriv;
+    for( s = 0; s < sizeof( solvers ) / sizeof( solvers[0] ); s++ ) {
+        ps = solvers[s].solver;
+        nderiv = 0;
+        Score( inp, &out, 0 );
+        n = nderiv;
+        t = TimeScore( inp, &out );
+        printf( "solvers, %d nuclei: %-6s %9.3f ms, %8ld derivatives, max error %.2e\n", inp->zyg.defs.nnucs, solvers[s].name, 1e3 * t, n,
+                MaxDiff( &ref, &out ) );
+    }
+    p_deriv = p_counted;
+    ps = old_ps;
+    free( ref.residuals );
+    free( out.residuals );
+}
+
+/* BenchThreads: a whole Score() with 1, 2, 4... threads sharing each deri- *
+ * vative (see rhsthreads in zygotic.h), up to maxthreads, for strong sca- *
+ * ling; all the blocks are forced to be used by setting rhsblock to 1     */
+static void
+BenchThreads( Input * inp ) {
+    ScoreOutput ref, out;
+    double t, t1 = 0.;
+    int k, kmax = maxthreads ? maxthreads : ( int ) sysconf( _SC_NPROCESSORS_ONLN );
+
+    memset( &ref, 0, sizeof( ref ) );
+    memset( &out, 0, sizeof( out ) );
+    rhsblock = 1;
+    for( k = 1; k <= kmax; k = ( 2 * k > kmax ) && ( k < kmax ) ? kmax : 2 * k ) {
+        rhsthreads = k;
+        t = TimeScore( inp, k == 1 ? &ref : &out );
+        if( k == 1 )
+            t1 = t;
+        printf( "threads, %d nuclei: %2d threads %9.3f ms (speedup %.2f), chisq %s\n", inp->zyg.defs.nnucs, k, 1e3 * t, t1 / t,
+                ( k == 1 ) || SameOutput( &ref, &out ) ? "the same" : "differs" );
+    }
+    rhsthreads = 0;
+    rhsblock = 0;
+    free( ref.residuals );
+    free( out.residuals );
+}
+
+/* BenchEnsemble: K candidates (the parameters of inp with each R scaled a *
+ * bit differently) scored in lockstep by ScoreEnsemble against scored one *
+ * by one, for K = 1, 2, 4... 16, on one core; needs Rk4 or Rkck (-s)      */
+static void
+BenchEnsemble( Input * inp ) {
+    enum { MAXK = 16 };
+    Input member[MAXK];
+    EqParms parm[MAXK];
+    ScoreOutput one[MAXK], all[MAXK];
+    Ensemble ens;
+    double t, t1, tK;
+    int K, k, i, r, same;
+
+    if( ( ps != Rk4 ) && ( ps != Rkck ) )
+        error( "benchmark: ensembles only work with the Rk4 and Rkck solvers (use -s r4 or -s rck)" );
+    nthreads = 1;               /* as in MoveXBatch */
+    rhsthreads = 1;
+    memset( one, 0, sizeof( one ) );
+    memset( all, 0, sizeof( all ) );
+    Score( inp, &( one[0] ), 0 );       /* sets up Theta() */
+    for( k = 0; k < MAXK; k++ ) {
+        parm[k] = CopyParm( inp->zyg.parm, &( inp->zyg.defs ) );
+        for( i = 0; i < inp->zyg.defs.ngenes; i++ )
+            parm[k].R[i] *= 1. + 0.01 * k;
+        member[k] = *inp;
+        member[k].zyg.parm = AllocParm( &( inp->zyg.defs ) );
+        member[k].wsp = InitWorkspace( &( inp->zyg.defs ) );
+        member[k].ctx = InitModelContext(  );
+        member[k].lparm = AllocParm( &( inp->zyg.defs ) );
+    }
+
+    for( K = 1; K <= MAXK; K *= 2 ) {
+        ens = InitEnsemble( K, &( inp->zyg.defs ) );
+        ens.size = K;
+        t1 = tK = DBL_MAX;
+        for( r = 0; r < runs; r++ ) {
+            /* Score() flips signs in zyg.parm, so each run starts afresh */
+            for( k = 0; k < K; k++ )
+                memcpy( member[k].zyg.parm.array, parm[k].array, parm[k].size * sizeof( double ) );
+            t = WallTime(  );
+            for( k = 0; k < K; k++ )
+                Score( &( member[k] ), &( one[k] ), 0 );
+            t = WallTime(  ) - t;
+            if( t < t1 )
+                t1 = t;
+
+            for( k = 0; k < K; k++ ) {
+                memcpy( member[k].zyg.parm.array, parm[k].array, parm[k].size * sizeof( double ) );
+                ens.member[k] = &( member[k] );
+            }
+            t = WallTime(  );
+            ScoreEnsemble( &ens, all );
+            t = WallTime(  ) - t;
+            if( t < tK )
+                tK = t;
+        }
+        for( k = 0, same = 1; k < K; k++ )
+            same = same && SameOutput( &( one[k] ), &( all[k] ) );
+        printf( "ensemble, %d nuclei: K = %2d, one by one %8.1f evals/s, in lockstep %8.1f evals/s (%.2f times), chisq %s\n",
+                inp->zyg.defs.nnucs, K, K / t1, K / tK, t1 / tK, same ? "the same" : "differs" );
+        FreeEnsemble( &ens );
+    }
+
+    for( k = 0; k < MAXK; k++ ) {
+        FreeMutant( parm[k] );
+        FreeMutant( member[k].zyg.parm );
+        FreeWorkspace( &( member[k].wsp ) );
+        FreeModelContext( &( member[k].ctx ) );
+        FreeMutant( member[k].lparm );
+        free( one[k].residuals );
+        free( all[k].residuals );
+    }
+    nthreads = 0;
+    rhsthreads = 0;
+}
+
+/* BenchAccuracy: the derivative evaluations a whole Score() takes against *
+ * the largest error in a residual, for the adaptive solvers at accuracies *
+ * 1e-1 to 1e-5; the error is against Rk4 with a stepsize 64 times smaller *
+ * than the one given, which needs to be small enough not to be the error  *
+ * we see at 1e-5                                                          */
+static void
+BenchAccuracy( Input * inp ) {
+    static struct {
+        const char *name;
+        void ( *solver ) ( double *, double *, double, double, double, double, int, FILE *, SolverInput *, Input * );
+    } solvers[] = {
+        {"Rkck", Rkck}, {"Imex", Imex}, {"Band", Band}
+    };
+    void ( *old_ps ) ( double *, double *, double, double, double, double, int, FILE *, SolverInput *, Input * ) = ps;
+    double accuracy = inp->ste.accuracy;
+    ScoreOutput ref, out;
+    double a;
+    int s;
+
+    memset( &ref, 0, sizeof( ref ) );
+    memset( &out, 0, sizeof( out ) );
+    ReferenceScore( inp, &ref, 64. );
+
+    p_counted = p_deriv;
+    p_deriv = CountDeriv;
+    for( s = 0; s < sizeof( solvers ) / sizeof( solvers[0] ); s++ ) {
+        ps = solvers[s].solver;
+        for( a = 1e-1; a > 0.5e-5; a /= 10. ) {
+            inp->ste.accuracy = a;
+            nderiv = 0;
+            Score( inp, &out, 0 );
+            printf( "accuracy, %d nuclei: %-4s -a %.0e %8ld derivatives, max error %.2e\n", inp->zyg.defs.nnucs, solvers[s].name, a, nderiv,
+                    MaxDiff( &ref, &out ) );
+        }
+    }
+    p_deriv = p_counted;
+    inp->ste.accuracy = accuracy;
+    ps = old_ps;
+    free( ref.residuals );
+    free( out.residuals );
+}
+
+
+/** benchmark main() function */
+int
+main( int argc, char **argv ) {
+    int c;                      /* used to parse command line options */
+    FILE *fp;                   /* pointer to input data file */
+    char *bench = "layout";     /* which benchmark to run */
+    char *section_title = "eqparms";    /* parameter section name */
+    double stepsize = 1.;       /* stepsize for solver */
+    double accuracy = 0.001;    /* accuracy for solver */
+    Input inp;
+
+    /* external declarations for command line option parsing (unistd.h) */
+
+    extern char *optarg;        /* command line option argument */
+    extern int optind;          /* pointer to current element of argv */
+    extern int optopt;          /* contain option character upon error */
+
+    dd = DvdtDelay;
+    ps = Rkck;
+
+    optarg = NULL;
+    while( ( c = getopt( argc, argv, OPTS ) ) != -1 )
+        switch ( c ) {
+        case 'a':
+            accuracy = atof( optarg );
+            if( accuracy <= 0 )
+                error( "benchmark: accuracy (%g) is too small", accuracy );
+            break;
+        case 'b':              /* -b chooses the benchmark */
+            bench = optarg;
+            break;
+        case 'g':              /* -g choose g(u) function */
+            if( !( strcmp( optarg, "s" ) ) )
+                gofu = Sqrt;
+            else if( !( strcmp( optarg, "t" ) ) )
+                gofu = Tanh;
+            else if( !( strcmp( optarg, "e" ) ) )
+                gofu = Exp;
+            else if( !( strcmp( optarg, "h" ) ) )
+                gofu = Hvs;
+            else if( !( strcmp( optarg, "k" ) ) )
+                gofu = Kolja;
+            else
+                error( "benchmark: %s is an invalid g(u), should be e, h, s or t", optarg );
+            break;
+        case 'h':              /* -h help option */
+            PrintMsg( help, 0 );
+            break;
+        case 'i':              /* -i sets the stepsize */
+            stepsize = atof( optarg );
+            if( stepsize <= 0 )
+                error( "benchmark: going nowhere? (hint: check your -i)" );
+            if( stepsize > MAX_STEPSIZE )
+                error( "benchmark: stepsize %g too large (max. is %g)", stepsize, MAX_STEPSIZE );
+            break;
+        case 'k':              /* -k sets the most threads per derivative */
+            maxthreads = atoi( optarg );
+            if( maxthreads < 1 )
+                error( "benchmark: need at least one thread (hint: check your -k)" );
+            break;
+        case 'r':              /* -r sets the number of runs to take the best of */
+            runs = atoi( optarg );
+            if( runs < 1 )
+                error( "benchmark: need at least one run (hint: check your -r)" );
+            break;
+        case 's':              /* -s sets solver to be used */
+            if( !( strcmp( optarg, "r4" ) ) || !( strcmp( optarg, "r" ) ) )
+                ps = Rk4;
+            else if( !( strcmp( optarg, "rck" ) ) )
+                ps = Rkck;
+            else if( !( strcmp( optarg, "imex" ) ) )
+                ps = Imex;
+            else if( !( strcmp( optarg, "bnd" ) ) )
+                ps = Band;
+            else if( !( strcmp( optarg, "K" ) ) )
+                ps = Krylov;
+            else
+                error( "benchmark: bad solver (%s), use: bnd,K,r4,rck,imex", optarg );
+            break;
+        case 'x':
+            if( ( strcmp( optarg, "input" ) ) && ( strcmp( optarg, "eqparms" ) ) && ( strcmp( optarg, "parameters" ) ) )
+                error( "benchmark: invalid section title (%s)", optarg );
+            section_title = optarg;
+            break;
+        case ':':
+            error( "benchmark: need an argument for option -%c", optopt );
+            break;
+        case '?':
+        default:
+            error( "benchmark: unrecognized option -%c", optopt );
+        }
+
+    if( ( argc - ( optind - 1 ) ) != 2 )
+        PrintMsg( usage, 1 );
+
+    fp = fopen( argv[optind], "r" );
+    if( !fp )
+        file_error( "benchmark" );
+
+    /* the same initialization as in printscore */
+    inp.zyg = InitZygote( fp, DvdtOrig, JacobnOrig, &inp, section_title );
+    inp.sco = InitScoring( fp, 0, &inp );
+    inp.his = InitHistory( fp, &inp );
+    inp.ext = InitExternalInputs( fp, &inp );
+    InitSchedules( &inp );
+    inp.ste = InitStepsize( stepsize, accuracy, NULL, argv[optind] );
+    inp.twe = InitTweak( fp, NULL, inp.zyg.defs );
+    inp.tra = Translate( &inp );
+    inp.lparm = CopyParm( inp.zyg.parm, &( inp.zyg.defs ) );
+    fclose( fp );
+
+    if( !strcmp( bench, "layout" ) )
+        BenchLayout( &inp );
+    else if( !strcmp( bench, "solvers" ) )
+        BenchSolvers( &inp );
+    else if( !strcmp( bench, "threads" ) )
+        BenchThreads( &inp );
+    else if( !strcmp( bench, "ensemble" ) )
+        BenchEnsemble( &inp );
+    else if( !strcmp( bench, "accuracy" ) )
+        BenchAccuracy( &inp );
+    else
+        error( "benchmark: unknown benchmark %s, use: accuracy, ensemble, layout, solvers, threads", bench );
+
+    return 0;
+}
@@ -16,6 +16,7 @@
 #include <mathLib.h>
 
 #include "fly_io.h"
+#include "zygotic.h"            /* for AllocParm */
 
 //
 // INPUT
@@ -214,18 +215,7 @@ ReadParameters( FILE * fp, TheProblem defs, char *section_title ) {
     }
 
     // initialize the EqParm struct
-    l_parm.R = ( double * ) calloc( defs.ngenes, sizeof( double ) );
-    l_parm.T = ( double * ) calloc( defs.ngenes * defs.ngenes, sizeof( double ) );
-    l_parm.E = ( double * ) calloc( defs.ngenes * defs.egenes, sizeof( double ) );
-    l_parm.m = ( double * ) calloc( defs.ngenes, sizeof( double ) );
-    l_parm.h = ( double * ) calloc( defs.ngenes, sizeof( double ) );
-    if( ( defs.diff_schedule == 'A' ) || ( defs.diff_schedule == 'C' ) ) {
-        l_parm.d = ( double * ) malloc( sizeof( double ) );
-    } else {
-        l_parm.d = ( double * ) calloc( defs.ngenes, sizeof( double ) );
-    }
-    l_parm.lambda = ( double * ) calloc( defs.ngenes, sizeof( double ) );
-    l_parm.tau = ( double * ) calloc( defs.ngenes, sizeof( double ) );
+    l_parm = AllocParm( &defs );
 
     fp = FindSection( fp, section_title );      // find input section
     if( !fp )
@@ -370,49 +360,39 @@ ReadParametersX( double *x, int *mask, EqParms *iparm, TheProblem defs ) {
     int i, j, k;                   // local loop counter
     //int len_x;                // length of the input (parameter) array
 
-    // initialize the EqParm struct
-    l_parm.R = ( double * ) calloc( defs.ngenes, sizeof( double ) );
-    l_parm.T = ( double * ) calloc( defs.ngenes * defs.ngenes, sizeof( double ) );
-    l_parm.E = ( double * ) calloc( defs.ngenes * defs.egenes, sizeof( double ) );
-    l_parm.m = ( double * ) calloc( defs.ngenes, sizeof( double ) );
-    l_parm.h = ( double * ) calloc( defs.ngenes, sizeof( double ) );
-    if( ( defs.diff_schedule == 'A' ) || ( defs.diff_schedule == 'C' ) ) {
-        l_parm.d = ( double * ) calloc( defs.ngenes, sizeof( double ) );
-    } else {
-        l_parm.d = ( double * ) calloc( defs.ngenes, sizeof( double ) );
-    }
-    l_parm.lambda = ( double * ) calloc( defs.ngenes, sizeof( double ) );
-    l_parm.tau = ( double * ) calloc( defs.ngenes, sizeof( double ) );
+    // initialize the EqParm struct; d has a single entry for schedules A 
+    // and C, the mask always has ngenes of them
+    l_parm = AllocParm( &defs );
 
     // len_x = sizeof( x ) / sizeof( double );
     j = 0;
     k = 0;
     for( i = 0; i < defs.ngenes; i++ ) { // R 
-        l_parm.R[i] = mask[j + i]*x[k] + (1 - mask[j + i])*iparm->R[i];
+        l_parm.R[i] = mask[j + i] ? x[k] : iparm->R[i];
         k+=mask[j + i];
     }
     j += defs.ngenes;
 
     for( i = 0; i < defs.ngenes * defs.ngenes; i++ ) { // T 
-        l_parm.T[i] = mask[j + i]*x[k] + (1 - mask[j + i])*iparm->T[i];
+        l_parm.T[i] = mask[j + i] ? x[k] : iparm->T[i];
         k+=mask[j + i];
     }
     j += defs.ngenes * defs.ngenes;
 
     for( i = 0; i < defs.egenes * defs.egenes; i++ ) { // E 
-        l_parm.E[i] = mask[j + i]*x[k] + (1 - mask[j + i])*iparm->E[i];
+        l_parm.E[i] = mask[j + i] ? x[k] : iparm->E[i];
         k+=mask[j + i];
     }
     j += defs.egenes * defs.egenes;
         
     for( i = 0; i < defs.ngenes; i++ ) { // m 
-        l_parm.m[i] = mask[j + i]*x[k] + (1 - mask[j + i])*iparm->m[i];
+        l_parm.m[i] = mask[j + i] ? x[k] : iparm->m[i];
         k+=mask[j + i];
     }
     j += defs.ngenes;
  
     for( i = 0; i < defs.ngenes; i++ ) { // h 
-        l_parm.h[i] = mask[j + i]*x[k] + (1 - mask[j + i])*iparm->h[i];
+        l_parm.h[i] = mask[j + i] ? x[k] : iparm->h[i];
         k+=mask[j + i];
     }
     j += defs.ngenes;
@@ -420,32 +400,138 @@ ReadParametersX( double *x, int *mask, EqParms *iparm, TheProblem defs ) {
     // usually read ngenes parameters, but for diff. schedule A or C only read
     // one d parameter
     if( ( defs.diff_schedule == 'A' ) || ( defs.diff_schedule == 'C' ) ) { // d          
-        l_parm.d[0] = mask[j]*x[k] + (1 - mask[j])*iparm->d[0];
+        l_parm.d[0] = mask[j] ? x[k] : iparm->d[0];
         k+=mask[j];
     } else {
         
         for( i = 0; i < defs.ngenes; i++ ) {
-            l_parm.d[i] = mask[j + i]*x[k] + (1 - mask[j + i])*iparm->d[i];
+            l_parm.d[i] = mask[j + i] ? x[k] : iparm->d[i];
             k+=mask[j + i];
         }
     }
     j += defs.ngenes;
 
     for( i = 0; i < defs.ngenes; i++ ) { // lambda 
-        l_parm.lambda[i] = mask[j + i]*x[k] + (1 - mask[j + i])*iparm->lambda[i];
+        l_parm.lambda[i] = mask[j + i] ? x[k] : iparm->lambda[i];
         l_parm.lambda[i] = log( 2. ) / l_parm.lambda[i];
         k+=mask[j + i];        
     }
     j += defs.ngenes;
 
     for( i = 0; i < defs.ngenes; i++ ) { // tau 
-        l_parm.tau[i] = mask[j + i]*x[k] + (1 - mask[j + i])*iparm->tau[i];
+        l_parm.tau[i] = mask[j + i] ? x[k] : iparm->tau[i];
         k+=mask[j + i];
     }
 
     return l_parm;
 }
 
+/** ReadSensParmsX: returns the parameters of x (for which mask == 1) in the
+    same order as ReadParametersX reads them, for the forward sensitivities;
+    their number goes to np
+    NOTE: lambda is the half life in x, which is not taken into account here
+ */
+SensParm *
+ReadSensParmsX( int *mask, TheProblem defs, int *np ) {
+    SensParm *sp;
+    int i, j, k;
+
+    sp = ( SensParm * ) calloc( defs.ngenes * defs.ngenes + defs.egenes * defs.egenes + 6 * defs.ngenes, sizeof( SensParm ) );
+    j = 0;
+    k = 0;
+    for( i = 0; i < defs.ngenes; i++ ) // R 
+        if( mask[j + i] )
+            sp[k++] = ( SensParm ) { ParmR, i, 0 };
+    j += defs.ngenes;
+
+    for( i = 0; i < defs.ngenes * defs.ngenes; i++ ) // T 
+        if( mask[j + i] )
+            sp[k++] = ( SensParm ) { ParmT, i / defs.ngenes, i % defs.ngenes };
+    j += defs.ngenes * defs.ngenes;
+
+    for( i = 0; i < defs.egenes * defs.egenes; i++ ) // E, as in ReadParametersX 
+        if( mask[j + i] )
+            sp[k++] = ( SensParm ) { ParmE, i / defs.egenes, i % defs.egenes };
+    j += defs.egenes * defs.egenes;
+
+    for( i = 0; i < defs.ngenes; i++ ) // m 
+        if( mask[j + i] )
+            sp[k++] = ( SensParm ) { Parmm, i, 0 };
+    j += defs.ngenes;
+
+    for( i = 0; i < defs.ngenes; i++ ) // h 
+        if( mask[j + i] )
+            sp[k++] = ( SensParm ) { Parmh, i, 0 };
+    j += defs.ngenes;
+
+    if( ( defs.diff_schedule == 'A' ) || ( defs.diff_schedule == 'C' ) ) { // d          
+        if( mask[j] )
+            sp[k++] = ( SensParm ) { Parmd, 0, 0 };
+    } else {
+        for( i = 0; i < defs.ngenes; i++ )
+            if( mask[j + i] )
+                sp[k++] = ( SensParm ) { Parmd, i, 0 };
+    }
+    j += defs.ngenes;
+
+    for( i = 0; i < defs.ngenes; i++ ) // lambda 
+        if( mask[j + i] )
+            sp[k++] = ( SensParm ) { Parmlambda, i, 0 };
+    j += defs.ngenes;
+
+    for( i = 0; i < defs.ngenes; i++ ) // tau 
+        if( mask[j + i] )
+            sp[k++] = ( SensParm ) { Parmtau, i, 0 };
+
+    *np = k;
+    return sp;
+}
+
+/** TweakSensParms: returns the parameters that are tweaked in twe, in the
+    same order as ReadSensParmsX, for the adjoint gradient of printscore;
+    their number goes to np
+ */
+SensParm *
+TweakSensParms( Tweak * twe, TheProblem defs, int *np ) {
+    SensParm *sp;
+    int i, k;
+
+    sp = ( SensParm * ) calloc( defs.ngenes * defs.ngenes + defs.ngenes * defs.egenes + 6 * defs.ngenes, sizeof( SensParm ) );
+    k = 0;
+    for( i = 0; i < defs.ngenes; i++ ) // R 
+        if( twe->Rtweak[i] )
+            sp[k++] = ( SensParm ) { ParmR, i, 0 };
+    for( i = 0; i < defs.ngenes * defs.ngenes; i++ ) // T 
+        if( twe->Ttweak[i] )
+            sp[k++] = ( SensParm ) { ParmT, i / defs.ngenes, i % defs.ngenes };
+    for( i = 0; i < defs.ngenes * defs.egenes; i++ ) // E 
+        if( twe->Etweak[i] )
+            sp[k++] = ( SensParm ) { ParmE, i / defs.egenes, i % defs.egenes };
+    for( i = 0; i < defs.ngenes; i++ ) // m 
+        if( twe->mtweak[i] )
+            sp[k++] = ( SensParm ) { Parmm, i, 0 };
+    for( i = 0; i < defs.ngenes; i++ ) // h 
+        if( twe->htweak[i] )
+            sp[k++] = ( SensParm ) { Parmh, i, 0 };
+    if( ( defs.diff_schedule == 'A' ) || ( defs.diff_schedule == 'C' ) ) { // d          
+        if( twe->dtweak[0] )
+            sp[k++] = ( SensParm ) { Parmd, 0, 0 };
+    } else {
+        for( i = 0; i < defs.ngenes; i++ )
+            if( twe->dtweak[i] )
+                sp[k++] = ( SensParm ) { Parmd, i, 0 };
+    }
+    for( i = 0; i < defs.ngenes; i++ ) // lambda 
+        if( twe->lambdatweak[i] )
+            sp[k++] = ( SensParm ) { Parmlambda, i, 0 };
+    for( i = 0; i < defs.ngenes; i++ ) // tau 
+        if( twe->tautweak[i] )
+            sp[k++] = ( SensParm ) { Parmtau, i, 0 };
+
+    *np = k;
+    return sp;
+}
+
 
 /** @brief A function that writes parameters into the data file */
 /** WriteParameters: writes the out_parm struct into a new section in the 
@@ -1453,6 +1539,31 @@ ReadCompoundRanges( FILE * fp, char *record, Range **r, int n, int e ) {
     return r;
 }
 
+/** FlattenLimits: copies the ranges of the search space into the flat 
+ *                 lower and upper arrays, laid out like the parameters 
+ *                 in EqParms.array (see AllocParm), so that they can be 
+ *                 checked in one pass                                   
+ */
+static void
+FlattenLimits( SearchSpace * limits, TheProblem defs ) {
+    int i, k, n;
+    int nd = ( ( defs.diff_schedule == 'A' ) || ( defs.diff_schedule == 'C' ) ) ? 1 : defs.ngenes;
+    Range **lim[8] = { limits->Rlim, limits->Tlim, limits->Elim, limits->mlim,
+        limits->hlim, limits->dlim, limits->lambdalim, limits->taulim
+    };
+    int len[8] = { defs.ngenes, defs.ngenes * defs.ngenes, defs.ngenes * defs.egenes, defs.ngenes,
+        defs.ngenes, nd, defs.ngenes, defs.ngenes
+    };
+
+    limits->lower = ( double * ) malloc( ( defs.ngenes * ( 5 + defs.ngenes + defs.egenes ) + nd ) * sizeof( double ) );
+    limits->upper = ( double * ) malloc( ( defs.ngenes * ( 5 + defs.ngenes + defs.egenes ) + nd ) * sizeof( double ) );
+    for( k = 0, n = 0; k < 8; k++ )
+        for( i = 0; i < len[k]; i++, n++ ) {
+            limits->lower[n] = lim[k][i]->lower;
+            limits->upper[n] = lim[k][i]->upper;
+        }
+}
+
 /**
  * ReadLimits: reads the limits section of a data file and returns the  
  *             approriate SearchSpace struct to the calling function     
@@ -1551,6 +1662,8 @@ ReadLimits( FILE * fp, TheProblem defs ) {
     }        
     /* read Transcriptional/translational delay parameter ranges */
     l_limits->taulim = ReadSingleRanges( fp, record, l_limits->taulim, ncols );
+
+    FlattenLimits( l_limits, defs );
     
     free( record );
     return l_limits;
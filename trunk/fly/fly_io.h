@@ -78,6 +78,14 @@ EqParms ReadParameters( FILE * fp, TheProblem defs, char *section_title );
 /** ReadParametersX for the input passed by the mex file - needed for the scatter algorithm test */
 EqParms ReadParametersX(  double *x, int *mask, EqParms *iparm, TheProblem defs );
 
+/** ReadSensParmsX: the parameters in x for the forward sensitivities, in the
+    order of ReadParametersX; np gets their number */
+SensParm *ReadSensParmsX( int *mask, TheProblem defs, int *np );
+
+/** TweakSensParms: the parameters tweaked in twe for the adjoint gradient, in
+    the same order; np gets their number */
+SensParm *TweakSensParms( Tweak * twe, TheProblem defs, int *np );
+
 /** @brief ReadDivTimes: reead divison times from file */
 /** 
      * MITOSIS SCHEDULE: hard-wired cell division tables ***********************                                                                         
@@ -25,10 +25,12 @@
 
 #include <float.h>
 #include <limits.h>
+#include <math.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>             /* for command line option stuff */
+#include <pthread.h>            /* for the MoveXBatch thread pool */
 
 #include "error.h"              /* error handling funcs */
 //#include "distributions.h"      /* DistP.variables and prototypes */
@@ -67,7 +69,7 @@ const int OUT_OF_BOUND = -1;
 
 /* #define  OPTS       ":a:b:Bc:C:d:De:Ef:g:hi:lLnopQr:s:StTvw:W:y:" */
 
-const char *OPTS = ":a:b:Bc:C:De:Ef:g:hi:lLm:nNopQr:s:StTvw:W:y:";
+const char *OPTS = ":a:b:Bc:C:De:Ef:g:hi:j:Jk:K:lLm:nNopQr:s:StTuvw:W:y:";
 /* command line option string */
 /* D will be debug, like scramble, score */
 /* must start with :, option with argument must have a : following */
@@ -81,14 +83,16 @@ const char *OPTS = ":a:b:Bc:C:De:Ef:g:hi:lLm:nNopQr:s:StTvw:W:y:";
 static const char usage[] =
     "Usage: fly_sa.mpi [-b <bkup_freq>] [-B] [-C <covar_ind>] \n"
     "                  [-D] [-e <freeze_crit>][-E] [-f <param_prec>] [-g <g(u)>]\n"
-    "                  [-h] [-i <stepsize>] [-l] [-L] [-n] [-N] [-p] [-s <solver>]\n"
-    "                  [-S] [-t] [-T] [-v] [-w <out_file>]\n" "                  [-W <tune_stat>] [-y <log_freq>]\n" "                  <datafile>\n";
+    "                  [-h] [-i <stepsize>] [-j <threads>] [-J] [-k <threads>]\n"
+    "                  [-K <nuclei>] [-l] [-L] [-n] [-N] [-p] [-s <solver>] [-S] [-t]\n"
+    "                  [-T] [-u] [-v] [-w <out_file>]\n" "                  [-W <tune_stat>] [-y <log_freq>]\n" "                  <datafile>\n";
 #else
 static const char usage[] =
     "Usage: fly_sa [-a <accuracy>] [-b <bkup_freq>] [-B] [-e <freeze_crit>] [-E]\n"
-    "              [-f <param_prec>] [-g <g(u)>] [-h] [-i <stepsize>] [-l] [-L] \n"
-    "              [-m <score_method>] [-n] [-N] [-p] [-Q] [-s <solver>] [-t] [-v]\n"
-    "              [-w <out_file>] [-y <log_freq>]\n" "              <datafile>\n";
+    "              [-f <param_prec>] [-g <g(u)>] [-h] [-i <stepsize>] [-j <threads>]\n"
+    "              [-J] [-k <threads>] [-K <nuclei>] [-l] [-L] [-m <score_method>]\n"
+    "              [-n] [-N] [-p] [-Q] [-s <solver>]\n"
+    "              [-t] [-u] [-v] [-w <out_file>] [-y <log_freq>]\n" "              <datafile>\n";
 #endif
 
 static const char help[] =
@@ -111,7 +115,12 @@ static const char help[] =
     "  -f <param_prec>     float precision of parameters is <param_prec>\n"
     "  -g <g(u)>           chooses g(u): e = exp, h = hvs, s = sqrt, t = tanh\n"
     "  -h                  prints this help message\n"
-    "  -i <stepsize>       sets ODE solver stepsize (in minutes)\n" "  -l                  echo log to the terminal\n"
+    "  -i <stepsize>       sets ODE solver stepsize (in minutes)\n"
+    "  -j <threads>        score up to <threads> genotypes in parallel\n"
+    "  -J                  use the analytic Jacobian with the Band solver\n"
+    "  -k <threads>        share each derivative out over <threads> threads\n"
+    "  -K <nuclei>         with at least <nuclei> nuclei each (default 256)\n"
+    "  -l                  echo log to the terminal\n"
 #ifdef MPI
     "  -L                  write local logs (llog files)\n"
 #endif
@@ -130,6 +139,7 @@ static const char help[] =
 #ifdef MPI
     "  -T                  run in tuning mode\n"
 #endif
+    "  -u                  solve in gene-major state layout (explicit solvers)\n"
     "  -v                  print version and compilation date\n" "  -w <out_file>       write output to <out_file> instead of <datafile>\n"
 #ifdef MPI
     "  -W <tune_stat>      tuning stats written <tune_stat> times per interval\n"
@@ -165,6 +175,12 @@ static EqParms iparm;
 /* NOTE: ps (solver) is declared as global in integrate.h                  */
 
 static Input inp;               //The whole input - this is static in order to not to read data from file at every loop
+static int ensemble_size = 1;   /* candidates per MoveXBatch thread run in lockstep */
+static int ensemble_rkck = 0;   /* whether Rkck may run in ensembles, too */
+static int ninput = 0;          /* times SetupMoveX read the input file */
+static double score_bound = 0.; /* see SetScoreBound (0: none) */
+
+static void FlushScoreCache( void );
 
 void ( *pd ) ( double *, double, double *, int, SolverInput *, Input * );
 void ( *pj ) ( double, double *, double *, double **, int, SolverInput *, Input * );
@@ -321,6 +337,24 @@ ParseCommandLine( int argc, char **argv ) {
             if( stepsize > MAX_STEPSIZE )
                 error( "fly_sa: stepsize %g too large (max. is %g)", stepsize, MAX_STEPSIZE );
             break;
+        case 'J':              /* -J gives the Band solver the analytic Jacobian */
+            bandjac = 1;
+            break;
+        case 'j':              /* -j sets the number of scoring threads */
+            nthreads = atoi( optarg );
+            if( nthreads < 1 )
+                error( "fly_sa: need at least one thread (hint: check your -j)" );
+            break;
+        case 'k':              /* -k sets the threads per derivative (big embryos) */
+            rhsthreads = atoi( optarg );
+            if( rhsthreads < 1 )
+                error( "fly_sa: need at least one thread (hint: check your -k)" );
+            break;
+        case 'K':              /* -K sets the smallest block of nuclei per thread */
+            rhsblock = atoi( optarg );
+            if( rhsblock < 1 )
+                error( "fly_sa: need at least one nucleus per block (hint: check your -K)" );
+            break;
         case 'l':              /* -l displays the log to the screen */
             log_flag = 1;
             break;
@@ -380,14 +414,18 @@ ParseCommandLine( int argc, char **argv ) {
                 ps = Rkck;
             else if( !( strcmp( optarg, "rf" ) ) )
                 ps = Rkf;
+            else if( !( strcmp( optarg, "imex" ) ) )
+                ps = Imex;
             else if( !( strcmp( optarg, "sd" ) ) )
                 ps = SoDe;
             else if( !( strcmp( optarg, "kr" ) ) )
                 ps = Band; //this is to avoid bugs in case we forgot top change 'kr' to 'bnd' somewhere
             else if( !( strcmp(optarg, "bnd" ) ) )
                 ps = Band; 
+            else if( !( strcmp( optarg, "K" ) ) )
+                ps = Krylov;
             else
-                error( "fly_sa: invalid solver (%s), use: a,bs,e,h,bnd,mi,me,r{2,4,ck,f}", optarg );
+                error( "fly_sa: invalid solver (%s), use: a,bs,e,h,bnd,K,mi,me,r{2,4,ck,f},imex", optarg );
             break;
         case 'S':              /* -S unsets the auto_stop_tune flag */
 #ifdef MPI
@@ -406,6 +444,9 @@ ParseCommandLine( int argc, char **argv ) {
             error( "fly_sa: can't use -T in serial, tuning only in parallel" );
 #endif
             break;
+        case 'u':              /* -u propagates the state in gene-major layout */
+            slayout = GeneMajor;
+            break;
         case 'v':              /* -v prints version message */
             fprintf( stderr, "%s\n", version );
             //fprintf(stderr, verstring, USR, MACHINE, COMPILER, FLAGS, __DATE__, __TIME__);
@@ -464,18 +505,13 @@ ParseCommandLine( int argc, char **argv ) {
     return optind;
 }
 
-/** MoveX: This function actually does almost everything.
- * First it creates a static Input structure 'inp', where it puts all the 
- * information from the input file. This part is executed only once (when init == 1).
- * Then it creates a ScoreOutput structure 'out' where the score, penalty 
- * and residual vectors will be stored.
- * At the end it runs the score function, where all the calculation is done.
- * This function is called from the mex file and it is used to connect with the matlab
- * ssm code. Once that the code is translated to c, we plan to call MoveSA instead of 
- * MoveX (and name it differently of course). 
+/** SetupMoveX: installs the derivative functions and the solver for MoveX 
+ *               and MoveXBatch; if init == 1, it also reads the input    
+ *               file into the static 'inp' and keeps a copy of the       
+ *               initial parameters in 'iparm'                            
  */
-void
-MoveX( double *x, int *mask, ScoreOutput * out, Files * files, int init, int jacobian, int solver ) {
+static void
+SetupMoveX( Files * files, int init, int solver ) {
     //printf("MoveSA Function Entered Successfully\n");
     //char *p;
     
@@ -497,6 +533,12 @@ MoveX( double *x, int *mask, ScoreOutput * out, Files * files, int init, int jac
         case 1:
             ps = Band;
             break;
+        case 2:
+            ps = Imex;
+            break;
+        case 3:
+            ps = Rk4;
+            break;
     }
 
     FILE *slogfile; 
@@ -508,6 +550,10 @@ MoveX( double *x, int *mask, ScoreOutput * out, Files * files, int init, int jac
 
         if (solver == 0)
             printf("Using RKCK solver\n");
+        else if (solver == 2)
+            printf("Using IMEX solver\n");
+        else if (solver == 3)
+            printf("Using RK4 solver\n");
         else 
             printf("Using BAND DIRECT solver\n");        
         
@@ -529,12 +575,17 @@ MoveX( double *x, int *mask, ScoreOutput * out, Files * files, int init, int jac
         }
         inp.zyg = InitZygote( infile, pd, pj, &inp, "input" );
         inp.sco = InitScoring( infile, method, &inp );
+        inp.sco.bound = score_bound;
         inp.his = InitHistory( infile, &inp );  //It fills the polations vector
         inp.ext = InitExternalInputs( infile, &inp );
+        InitSchedules( &inp );  /* what Blastoderm does when, per genotype */
         inp.ste = InitStepsize( stepsize, accuracy, slogfile, inname );
         // read the list of parameters to be tweaked
         inp.twe = InitTweak( infile, NULL, inp.zyg.defs );
         inp.tra = Translate( &inp );
+        /* scores of the old input are no good anymore */
+        ninput++;
+        FlushScoreCache(  );
         //in_tune = ReadSATune( infile ); /* read tune_parameter section */
         //i_temp = InitMoves( infile, &inp );     /* set initial temperature and initialize */
         // initialize distribution stuff
@@ -545,19 +596,691 @@ MoveX( double *x, int *mask, ScoreOutput * out, Files * files, int init, int jac
         iparm = CopyParm( inp.zyg.parm, &( inp.zyg.defs ) );
 
     }
+}
+
+/** ToHalfLives: x has the half lives of the proteins rather than the decay
+ *                rates lambda = ln 2 / x (see ReadParametersX), so the
+ *                columns of the Jacobian (or the elements of the gradient)
+ *                that are for lambda need to be multiplied by dlambda/dx =
+ *                -lambda^2 / ln 2
+ */
+static void
+ToHalfLives( ScoreOutput * out, int jacobian, SensParm * sp, int np, EqParms * parm ) {
+    int p, r, nrows;
+    double dl;
+    double *deriv = ( jacobian == GRADIENT ) ? out->gradient : out->jacobian;
+
+    if( ( deriv == NULL ) || ( out->score == FORBIDDEN_MOVE ) || ( out->penalty == FORBIDDEN_MOVE ) )
+        return;
+    nrows = ( jacobian == GRADIENT ) ? 1 : out->size_resid_arr;
+    for( p = 0; p < np; p++ ) {
+        if( sp[p].type != Parmlambda )
+            continue;
+        dl = -parm->lambda[sp[p].k] * parm->lambda[sp[p].k] / log( 2. );
+        for( r = 0; r < nrows; r++ )
+            deriv[p * nrows + r] *= dl;
+    }
+}
+
+/** SetDerivParms: tells the solvers which parameters MoveX wants the
+ *                  Jacobian (or the gradient) for; np = 0 for none
+ */
+static void
+SetDerivParms( Input * in, int jacobian, SensParm * sp, int np ) {
+    if( jacobian == GRADIENT ) {
+        in->ctx.adj.parm = sp;
+        in->ctx.adj.np = np;
+    } else {
+        in->ctx.sens.parm = sp;
+        in->ctx.sens.np = np;
+    }
+}
+
+/** CheckJacobian: debugging aid for MoveX; compares the Jacobian in out
+ *                  with central differences of the residuals to each of
+ *                  the np parameters in x and prints the largest differ-
+ *                  ence for each (relative to the largest element of its
+ *                  column)
+ */
+static void
+CheckJacobian( double *x, int *mask, ScoreOutput * out, int np ) {
+    EqParms parm = inp.zyg.parm;
+    double *xp = ( double * ) calloc( np, sizeof( double ) );
+    double *rp = ( double * ) calloc( out->size_resid_arr, sizeof( double ) );
+    double h, colmax, err, maxerr;
+    int p, r, sign, rmax, inside;
+    ScoreOutput o;
+
+    memcpy( xp, x, np * sizeof( double ) );
+    for( p = 0; p < np; p++ ) {
+        h = 1e-6 * fmax( fabs( x[p] ), 1. );
+        inside = 1;
+        for( sign = 1; sign >= -1; sign -= 2 ) {
+            xp[p] = x[p] + sign * h;
+            memset( &o, 0, sizeof( ScoreOutput ) );
+            inp.zyg.parm = ReadParametersX( xp, mask, &iparm, inp.zyg.defs );
+            Score( &inp, &o, 0 );
+            FreeMutant( inp.zyg.parm );
+            if( o.size_resid_arr != out->size_resid_arr )
+                inside = 0;     /* out of the search space */
+            else
+                for( r = 0; r < out->size_resid_arr; r++ )
+                    rp[r] = ( sign > 0 ) ? o.residuals[r] : ( rp[r] - o.residuals[r] ) / ( 2 * h );
+            free( o.residuals );
+        }
+        xp[p] = x[p];
+        if( !inside ) {
+            printf( "CheckJacobian: parameter %d is on a limit, not checked\n", p );
+            continue;
+        }
+        colmax = 0.;
+        for( r = 0; r < out->size_resid_arr; r++ )
+            colmax = fmax( colmax, fabs( rp[r] ) );
+        maxerr = 0.;
+        rmax = 0;
+        for( r = 0; r < out->size_resid_arr; r++ ) {
+            err = fabs( out->jacobian[p * out->size_resid_arr + r] - rp[r] ) / fmax( colmax, 1. );
+            if( err > maxerr ) {
+                maxerr = err;
+                rmax = r;
+            }
+        }
+        printf( "CheckJacobian: parameter %d, max. difference %g in residual %d\n", p, maxerr, rmax );
+    }
+    inp.zyg.parm = parm;
+    free( rp );
+    free( xp );
+}
+
+/** CheckGradient: debugging aid for MoveX; compares the gradient in out
+ *                  with central differences of score + penalty to each of
+ *                  the np parameters in x and prints the relative differ-
+ *                  ence for each
+ */
+static void
+CheckGradient( double *x, int *mask, ScoreOutput * out, int np ) {
+    EqParms parm = inp.zyg.parm;
+    double *xp = ( double * ) calloc( np, sizeof( double ) );
+    double h, fd = 0.;
+    int p, sign, inside;
+    ScoreOutput o;
+
+    memcpy( xp, x, np * sizeof( double ) );
+    for( p = 0; p < np; p++ ) {
+        h = 1e-6 * fmax( fabs( x[p] ), 1. );
+        inside = 1;
+        for( sign = 1; sign >= -1; sign -= 2 ) {
+            xp[p] = x[p] + sign * h;
+            memset( &o, 0, sizeof( ScoreOutput ) );
+            inp.zyg.parm = ReadParametersX( xp, mask, &iparm, inp.zyg.defs );
+            Score( &inp, &o, 0 );
+            FreeMutant( inp.zyg.parm );
+            if( ( o.score == FORBIDDEN_MOVE ) || ( o.penalty == FORBIDDEN_MOVE ) )
+                inside = 0;     /* out of the search space */
+            else
+                fd = ( sign > 0 ) ? o.score + o.penalty : ( fd - o.score - o.penalty ) / ( 2 * h );
+            free( o.residuals );
+        }
+        xp[p] = x[p];
+        if( !inside ) {
+            printf( "CheckGradient: parameter %d is on a limit, not checked\n", p );
+            continue;
+        }
+        printf( "CheckGradient: parameter %d, %g by adjoints, %g by differences (%g)\n", p, out->gradient[p], fd,
+                fabs( out->gradient[p] - fd ) / fmax( fabs( fd ), 1. ) );
+    }
+    inp.zyg.parm = parm;
+    free( xp );
+}
+
+/*** SCORE CACHE ***********************************************************/
+
+/* SSm tends to send the same (truncated) parameters more than once, so     *
+ * MoveX and MoveXBatch keep the scores and residuals of the last runs in   *
+ * a least recently used cache; the key is the whole parameter set (masked *
+ * parameters from x, the others from iparm) plus the solver settings, and *
+ * entries are found by hash, then compared bit by bit                     */
+
+#define CACHE_BUCKETS 4096      /* number of hash buckets (a power of 2) */
+
+typedef struct CacheEntry {
+    unsigned long long hash;    /* hash of the key */
+    double *key;                /* parameters and solver settings */
+    int nkey;                   /* length of key */
+    double score, penalty;      /* what Score() made of it */
+    int size_resid_arr;
+    double *residuals;
+    size_t bytes;               /* memory held by the entry */
+    struct CacheEntry *chain;   /* next entry in the same bucket */
+    struct CacheEntry *newer, *older;   /* neighbours in the LRU list */
+} CacheEntry;
+
+static struct {
+    CacheEntry *bucket[CACHE_BUCKETS];
+    CacheEntry *newest, *oldest;        /* ends of the LRU list */
+    size_t bytes;               /* memory held by all entries */
+    size_t cap;                 /* most memory to hold (0: no cache) */
+    long hits, misses;
+    pthread_mutex_t lock;       /* MoveXBatch threads share the cache */
+} cache = {.lock = PTHREAD_MUTEX_INITIALIZER };
+
+/** CacheKey: returns the parameters in parm followed by the solver set- 
+ *             tings and the input data they were scored on, which to-   
+ *             gether decide the score, and the size of the ensembles it 
+ *             was scored in (1: none); nkey is its length               
+ */
+static double *
+CacheKey( EqParms * parm, Input * in, int nens, int *nkey ) {
+    double *key, *k;
+
+    *nkey = parm->size + 12;
+    key = ( double * ) malloc( *nkey * sizeof( double ) );
+    memcpy( key, parm->array, parm->size * sizeof( double ) );
+    k = key + parm->size;
+    k[0] = ( double ) ( size_t ) ps;    /* the solver and the equations */
+    k[1] = ( double ) ( size_t ) p_deriv;
+    k[2] = gofu;
+    k[3] = slayout;
+    k[4] = in->ste.stepsize;
+    k[5] = in->ste.accuracy;
+    k[6] = in->sco.method;
+    k[7] = nens;
+    k[8] = bandjac;
+    k[9] = rhsthreads;
+    k[10] = rhsblock;
+    k[11] = ninput;             /* which reading of the input file */
+    return key;
+}
+
+/** CacheHash: FNV-1a hash of the bytes of key */
+static unsigned long long
+CacheHash( double *key, int nkey ) {
+    unsigned char *b = ( unsigned char * ) key;
+    unsigned long long h = 14695981039346656037ULL;
+    size_t i;
+
+    for( i = 0; i < nkey * sizeof( double ); i++ )
+        h = ( h ^ b[i] ) * 1099511628211ULL;
+    return h;
+}
+
+/** CacheUnlink: takes e out of the LRU list (not out of its bucket) */
+static void
+CacheUnlink( CacheEntry * e ) {
+    if( e->newer )
+        e->newer->older = e->older;
+    else
+        cache.newest = e->older;
+    if( e->older )
+        e->older->newer = e->newer;
+    else
+        cache.oldest = e->newer;
+}
+
+/** CacheEvict: frees the least recently used entry */
+static void
+CacheEvict( void ) {
+    CacheEntry *e = cache.oldest;
+    CacheEntry **p = &( cache.bucket[e->hash & ( CACHE_BUCKETS - 1 )] );
+
+    while( *p != e )
+        p = &( ( *p )->chain );
+    *p = e->chain;
+    CacheUnlink( e );
+    cache.bytes -= e->bytes;
+    free( e->key );
+    free( e->residuals );
+    free( e );
+}
+
+/** CacheGet: if key is in the cache, copies its score, penalty and resi- 
+ *             duals to out (realloc'ing out->residuals) and returns 1    
+ */
+static int
+CacheGet( double *key, int nkey, unsigned long long hash, ScoreOutput * out ) {
+    CacheEntry *e;
+
+    pthread_mutex_lock( &( cache.lock ) );
+    for( e = cache.bucket[hash & ( CACHE_BUCKETS - 1 )]; e; e = e->chain )
+        if( ( e->hash == hash ) && ( e->nkey == nkey ) && !memcmp( e->key, key, nkey * sizeof( double ) ) )
+            break;
+    if( e ) {
+        /* it's the most recently used one now */
+        CacheUnlink( e );
+        e->older = cache.newest;
+        e->newer = NULL;
+        if( cache.newest )
+            cache.newest->newer = e;
+        cache.newest = e;
+        if( !cache.oldest )
+            cache.oldest = e;
+        out->score = e->score;
+        out->penalty = e->penalty;
+        out->size_resid_arr = e->size_resid_arr;
+        out->residuals = ( double * ) realloc( out->residuals, e->size_resid_arr * sizeof( double ) );
+        memcpy( out->residuals, e->residuals, e->size_resid_arr * sizeof( double ) );
+        cache.hits++;
+    } else
+        cache.misses++;
+    pthread_mutex_unlock( &( cache.lock ) );
+    return e != NULL;
+}
+
+/** CachePut: adds the score in out under key (which the cache takes over) 
+ *             and drops the least recently used entries to stay under    
+ *             the memory cap                                              
+ */
+static void
+CachePut( double *key, int nkey, unsigned long long hash, ScoreOutput * out ) {
+    CacheEntry *e = ( CacheEntry * ) malloc( sizeof( CacheEntry ) );
+    CacheEntry **b;
+
+    e->hash = hash;
+    e->key = key;
+    e->nkey = nkey;
+    e->score = out->score;
+    e->penalty = out->penalty;
+    e->size_resid_arr = out->size_resid_arr;
+    e->residuals = ( double * ) malloc( out->size_resid_arr * sizeof( double ) );
+    memcpy( e->residuals, out->residuals, out->size_resid_arr * sizeof( double ) );
+    e->bytes = sizeof( CacheEntry ) + ( nkey + out->size_resid_arr ) * sizeof( double );
+
+    pthread_mutex_lock( &( cache.lock ) );
+    /* two threads may have scored the same parameters at the same time */
+    for( b = &( cache.bucket[hash & ( CACHE_BUCKETS - 1 )] ); *b; b = &( ( *b )->chain ) )
+        if( ( ( *b )->hash == hash ) && ( ( *b )->nkey == nkey ) && !memcmp( ( *b )->key, key, nkey * sizeof( double ) ) )
+            break;
+    if( ( *b != NULL ) || ( e->bytes > cache.cap ) ) {
+        pthread_mutex_unlock( &( cache.lock ) );
+        free( e->key );
+        free( e->residuals );
+        free( e );
+        return;
+    }
+    while( cache.bytes + e->bytes > cache.cap )
+        CacheEvict(  );
+    b = &( cache.bucket[hash & ( CACHE_BUCKETS - 1 )] );
+    e->chain = *b;
+    *b = e;
+    e->older = cache.newest;
+    e->newer = NULL;
+    if( cache.newest )
+        cache.newest->newer = e;
+    cache.newest = e;
+    if( !cache.oldest )
+        cache.oldest = e;
+    cache.bytes += e->bytes;
+    pthread_mutex_unlock( &( cache.lock ) );
+}
+
+/** ScoreCached: Score() without derivatives, unless the cache has the 
+ *                parameters of in->zyg.parm already; runs that are for-   
+ *                bidden or stopped early (see SetScoreBound) aren't kept  
+ */
+static void
+ScoreCached( Input * in, ScoreOutput * out ) {
+    double *key;
+    int nkey;
+    unsigned long long hash;
+
+    if( cache.cap == 0 ) {
+        Score( in, out, 0 );
+        return;
+    }
+    /* Score() flips signs in zyg.parm, so we make the key first */
+    key = CacheKey( &( in->zyg.parm ), in, 1, &nkey );
+    hash = CacheHash( key, nkey );
+    if( CacheGet( key, nkey, hash, out ) ) {
+        free( key );
+        return;
+    }
+    Score( in, out, 0 );
+    if( ( out->score != FORBIDDEN_MOVE ) && ( out->penalty != FORBIDDEN_MOVE ) )
+        CachePut( key, nkey, hash, out );
+    else
+        free( key );
+}
+
+/** SetScoreCache: keeps the scores and residuals of MoveX and MoveXBatch 
+ *                  in a cache of at most bytes bytes of memory, dropping  
+ *                  the least recently used ones first; 0 turns the cache  
+ *                  off; either way, the cache and its counters are emptied
+ */
+void
+SetScoreCache( size_t bytes ) {
+    pthread_mutex_lock( &( cache.lock ) );
+    cache.cap = 0;
+    while( cache.oldest )
+        CacheEvict(  );
+    cache.cap = bytes;
+    cache.hits = cache.misses = 0;
+    pthread_mutex_unlock( &( cache.lock ) );
+}
+
+/** FlushScoreCache: empties the cache, keeping its size */
+static void
+FlushScoreCache( void ) {
+    SetScoreCache( cache.cap );
+}
+
+/** GetScoreCacheStats: returns the number of scores that were found in 
+ *                       the cache (hits) and that were not (misses) since 
+ *                       the last SetScoreCache                            
+ */
+void
+GetScoreCacheStats( long *hits, long *misses ) {
+    pthread_mutex_lock( &( cache.lock ) );
+    *hits = cache.hits;
+    *misses = cache.misses;
+    pthread_mutex_unlock( &( cache.lock ) );
+}
+
+/** MoveX: This function actually does almost everything.
+ * First it creates a static Input structure 'inp', where it puts all the 
+ * information from the input file. This part is executed only once (when init == 1).
+ * Then it creates a ScoreOutput structure 'out' where the score, penalty 
+ * and residual vectors will be stored.
+ * At the end it runs the score function, where all the calculation is done.
+ * This function is called from the mex file and it is used to connect with the matlab
+ * ssm code. Once that the code is translated to c, we plan to call MoveSA instead of 
+ * MoveX (and name it differently of course). 
+ */
+void
+MoveX( double *x, int *mask, ScoreOutput * out, Files * files, int init, int jacobian, int solver ) {
+    SensParm *sp = NULL;        /* the parameters of the Jacobian */
+    int np = 0;
+
+    SetupMoveX( files, init, solver );
+
     //FILE *tempfile = fopen("/users/jjaeger/dcicin/Desktop/scatter_method/SSm_R2008A_ML7.5/input/output.out", "a" );
+    /* Blastoderm mutates these into inp.lparm, which we keep */
     inp.zyg.parm = ReadParametersX(x, mask, &iparm, inp.zyg.defs);
-    inp.lparm = CopyParm( inp.zyg.parm, &( inp.zyg.defs ) );
     //fprintf(tempfile, "parameters: %lg, %lg, %lg, %lg, %lg, %lg, %lg, %lg, %lg, %lg, %lg, %lg, %lg, %lg, %lg, %lg, %lg, %lg, %lg, %lg, %lg, %lg, %lg, %lg, %lg, %lg, %lg, %lg, %lg, %lg, %lg, %lg, %lg, %lg, %lg, %lg, %lg, %lg, %lg, %lg, %lg, %lg, %lg, %lg, %lg, %lg, %lg, %lg, %lg, %lg, %lg, %lg, %lg, %lg, %lg, %lg\n", inp.lparm.R[0],inp.lparm.R[1],inp.lparm.R[2],inp.lparm.R[3],inp.lparm.T[0],inp.lparm.T[1],inp.lparm.T[2],inp.lparm.T[3],inp.lparm.T[4],inp.lparm.T[5],inp.lparm.T[6],inp.lparm.T[7],inp.lparm.T[8],inp.lparm.T[9],inp.lparm.T[10],inp.lparm.T[11],inp.lparm.T[12],inp.lparm.T[13],inp.lparm.T[14],inp.lparm.T[15],inp.lparm.E[0],inp.lparm.E[1],inp.lparm.E[2],inp.lparm.E[3],inp.lparm.E[4],inp.lparm.E[5],inp.lparm.E[6],inp.lparm.E[7],inp.lparm.E[8],inp.lparm.E[9],inp.lparm.E[10],inp.lparm.E[11],inp.lparm.E[12],inp.lparm.E[13],inp.lparm.E[14],inp.lparm.E[15],inp.lparm.m[0],inp.lparm.m[1],inp.lparm.m[2],inp.lparm.m[3],inp.lparm.h[0],inp.lparm.h[1],inp.lparm.h[2],inp.lparm.h[3],inp.lparm.d[0],inp.lparm.d[1],inp.lparm.d[2],inp.lparm.d[3],inp.lparm.lambda[0],inp.lparm.lambda[1],inp.lparm.lambda[2],inp.lparm.lambda[3],inp.lparm.tau[0],inp.lparm.tau[1],inp.lparm.tau[2],inp.lparm.tau[3]);
+    /* the Jacobian (by forward sensitivities) or the gradient (by adjoints) *
+     * is to the parameters in x                                            */
+    if( jacobian ) {
+        sp = ReadSensParmsX( mask, inp.zyg.defs, &np );
+        SetDerivParms( &inp, jacobian, sp, np );
+    }
     //In this function all the calculations are made
-    Score( &inp, out, jacobian );
+    if( jacobian )
+        Score( &inp, out, jacobian );
+    else
+        ScoreCached( &inp, out );
+    if( jacobian ) {
+        SetDerivParms( &inp, jacobian, NULL, 0 );
+        ToHalfLives( out, jacobian, sp, np, &( inp.zyg.parm ) );
+        if( debug && ( jacobian == JACOBIAN ) && ( out->jacobian != NULL ) )
+            CheckJacobian( x, mask, out, np );
+        if( debug && ( jacobian == GRADIENT ) && ( out->gradient != NULL ) && ( out->score != FORBIDDEN_MOVE )
+            && ( out->penalty != FORBIDDEN_MOVE ) )
+            CheckGradient( x, mask, out, np );
+        free( sp );
+    }
     
     //fprintf( tempfile, "score=%lg, penalty=%lg\n", out->score, out->penalty);
     //fclose(tempfile);
-    FreeMutant( inp.lparm );
 
 }
 
+/** BatchWorker: the private part of the Input of one MoveXBatch thread, 
+ *                plus what it needs to know about the batch              
+ */
+typedef struct BatchWorker {
+    Input inp;                  /* copy of 'inp' with its own parms, wsp and ctx */
+    double *x;                  /* candidates, one per row */
+    int nvec;                   /* number of candidates */
+    int nparm;                  /* length of a row of x */
+    int *mask;                  /* which parameters are in x */
+    int *next;                  /* index of the next candidate to score */
+    ScoreOutput *out;           /* one ScoreOutput per candidate */
+    int jacobian;               /* JACOBIAN, GRADIENT or 0 */
+    SensParm *sp;               /* the parameters of the derivatives */
+    int np;
+    Input *member;              /* more copies of 'inp', one per ensemble member */
+    Ensemble ens;               /* the ensemble they run in (capacity 0: none) */
+} BatchWorker;
+
+/** ScoreBatchEnsemble: ScoreBatch for a worker with an ensemble: takes as 
+ *                       many candidates off the batch as the ensemble has  
+ *                       room for and scores those the cache doesn't know   
+ *                       yet together (see ScoreEnsemble); Rkck ensembles   
+ *                       don't use the cache, since their scores depend on  
+ *                       which candidates end up in the same ensemble       
+ */
+static void
+ScoreBatchEnsemble( BatchWorker * w ) {
+    int K = w->ens.capacity;
+    int cached = ( cache.cap > 0 ) && ( ps == Rk4 );
+    int first, last, v, k, n;
+    int *which = ( int * ) malloc( K * sizeof( int ) );        /* candidate of each member */
+    ScoreOutput *out = ( ScoreOutput * ) malloc( K * sizeof( ScoreOutput ) );
+    double **key = ( double ** ) malloc( K * sizeof( double * ) );
+    int *nkey = ( int * ) malloc( K * sizeof( int ) );
+    unsigned long long *hash = ( unsigned long long * ) malloc( K * sizeof( unsigned long long ) );
+    Input *in;
+
+    while( ( first = __sync_fetch_and_add( w->next, K ) ) < w->nvec ) {
+        last = ( first + K < w->nvec ) ? first + K : w->nvec;
+        for( v = first, n = 0; v < last; v++ ) {
+            in = &( w->member[n] );
+            in->zyg.parm = ReadParametersX( w->x + v * w->nparm, w->mask, &iparm, in->zyg.defs );
+            /* Score() flips signs in zyg.parm, so we make the key first */
+            if( cached ) {
+                key[n] = CacheKey( &( in->zyg.parm ), in, K, &( nkey[n] ) );
+                hash[n] = CacheHash( key[n], nkey[n] );
+                if( CacheGet( key[n], nkey[n], hash[n], &( w->out[v] ) ) ) {
+                    free( key[n] );
+                    FreeMutant( in->zyg.parm );
+                    continue;
+                }
+            }
+            which[n] = v;
+            out[n] = w->out[v];
+            w->ens.member[n++] = in;
+        }
+        if( n == 0 )
+            continue;
+        w->ens.size = n;
+        ScoreEnsemble( &( w->ens ), out );
+        for( k = 0; k < n; k++ ) {
+            w->out[which[k]] = out[k];
+            if( cached ) {
+                if( ( out[k].score != FORBIDDEN_MOVE ) && ( out[k].penalty != FORBIDDEN_MOVE ) )
+                    CachePut( key[k], nkey[k], hash[k], &( out[k] ) );
+                else
+                    free( key[k] );
+            }
+            FreeMutant( w->member[k].zyg.parm );
+        }
+    }
+    free( which );
+    free( out );
+    free( key );
+    free( nkey );
+    free( hash );
+}
+
+/** ScoreBatch: thread start routine for MoveXBatch; keeps taking the next 
+ *               unscored candidate off the batch until there are none left 
+ */
+static void *
+ScoreBatch( void *arg ) {
+    BatchWorker *w = ( BatchWorker * ) arg;
+    int v;
+
+    if( w->ens.capacity > 0 ) {
+        ScoreBatchEnsemble( w );
+        return NULL;
+    }
+    while( ( v = __sync_fetch_and_add( w->next, 1 ) ) < w->nvec ) {
+        /* Score() flips signs in zyg.parm, so each candidate needs its own */
+        w->inp.zyg.parm = ReadParametersX( w->x + v * w->nparm, w->mask, &iparm, w->inp.zyg.defs );
+        if( w->jacobian )
+            Score( &( w->inp ), &( w->out[v] ), w->jacobian );
+        else
+            ScoreCached( &( w->inp ), &( w->out[v] ) );
+        if( w->jacobian )
+            ToHalfLives( &( w->out[v] ), w->jacobian, w->sp, w->np, &( w->inp.zyg.parm ) );
+        FreeMutant( w->inp.zyg.parm );
+    }
+    return NULL;
+}
+
+/** MoveXBatch: same as MoveX, but scores nvec parameter vectors in one go; 
+ *               x holds them row by row (nvec rows of nparm values) and  
+ *               out must have room for nvec ScoreOutputs; the candidates 
+ *               are shared out over a pool of nthreads threads (or one   
+ *               per CPU if nthreads is not set), each of which has its   
+ *               own copy of the parameters, workspace and solver context 
+ */
+void
+MoveXBatch( double *x, int nvec, int nparm, int *mask, ScoreOutput * out, Files * files, int init, int jacobian, int solver ) {
+    int i, k, nworkers;
+    int nens = 0;               /* members per ensemble (0: no ensembles) */
+    int next = 0;
+    int nthreads_save = nthreads;
+    int rhsthreads_save = rhsthreads;
+    int np = 0;
+    SensParm *sp = NULL;        /* the parameters of the Jacobians */
+    BatchWorker *workers;
+    pthread_t *threads;
+    void ( *p_nucmajor ) ( double *, double, double *, int, SolverInput *, Input * );
+
+    SetupMoveX( files, init, solver );
+    if( jacobian )
+        sp = ReadSensParmsX( mask, inp.zyg.defs, &np );
+
+    nworkers = ( nthreads > 0 ) ? nthreads : ( int ) sysconf( _SC_NPROCESSORS_ONLN );
+    if( debug || ( nworkers < 1 ) )
+        nworkers = 1;           /* debugging output is not thread-safe */
+    if( nworkers > nvec )
+        nworkers = nvec;
+    /* the ensemble solvers only do the plain equations with Rk4, or Rkck *
+     * if the scores don't need to be reproducible (see SetEnsembleRkck)   */
+    if( ( ensemble_size > 1 ) && !jacobian && !debug && ( ( ps == Rk4 ) || ( ( ps == Rkck ) && ensemble_rkck ) )
+        && ( p_deriv == DvdtOrig ) && ( slayout != GeneMajor ) )
+        nens = ensemble_size;
+
+    /* we are running candidates in parallel, so each Score() runs its     *
+     * genotypes one after the other, and each derivative in one piece     */
+    nthreads = 1;
+    rhsthreads = 1;
+
+    /* Theta() sets up its tables on the first call, and Blastoderm() would *
+     * swap in the gene-major derivative; do both before we start          */
+    Theta( 0.0, &( inp.zyg ) );
+    p_nucmajor = p_deriv;
+    if( slayout == GeneMajor )
+        p_deriv = DvdtGeneMajor;
+
+    workers = ( BatchWorker * ) calloc( nworkers, sizeof( BatchWorker ) );
+    threads = ( pthread_t * ) calloc( nworkers, sizeof( pthread_t ) );
+    for( i = 0; i < nworkers; i++ ) {
+        workers[i].inp = inp;
+        workers[i].inp.wsp = InitWorkspace( &( inp.zyg.defs ) );
+        workers[i].inp.ctx = InitModelContext(  );
+        workers[i].inp.lparm = AllocParm( &( inp.zyg.defs ) );
+        if( jacobian )
+            SetDerivParms( &( workers[i].inp ), jacobian, sp, np );
+        workers[i].x = x;
+        workers[i].nvec = nvec;
+        workers[i].nparm = nparm;
+        workers[i].mask = mask;
+        workers[i].next = &next;
+        workers[i].out = out;
+        workers[i].jacobian = jacobian;
+        workers[i].sp = sp;
+        workers[i].np = np;
+        if( nens > 0 ) {
+            workers[i].member = ( Input * ) calloc( nens, sizeof( Input ) );
+            for( k = 0; k < nens; k++ ) {
+                workers[i].member[k] = inp;
+                workers[i].member[k].wsp = InitWorkspace( &( inp.zyg.defs ) );
+                workers[i].member[k].ctx = InitModelContext(  );
+                workers[i].member[k].lparm = AllocParm( &( inp.zyg.defs ) );
+            }
+            workers[i].ens = InitEnsemble( nens, &( inp.zyg.defs ) );
+        }
+    }
+
+    if( nworkers == 1 )
+        ScoreBatch( &( workers[0] ) );
+    else {
+        for( i = 0; i < nworkers; i++ )
+            if( pthread_create( &( threads[i] ), NULL, ScoreBatch, &( workers[i] ) ) )
+                error( "MoveXBatch: could not start scoring thread %d", i );
+        for( i = 0; i < nworkers; i++ )
+            pthread_join( threads[i], NULL );
+    }
+
+    for( i = 0; i < nworkers; i++ ) {
+        FreeWorkspace( &( workers[i].inp.wsp ) );
+        FreeModelContext( &( workers[i].inp.ctx ) );
+        FreeMutant( workers[i].inp.lparm );
+        if( nens > 0 ) {
+            for( k = 0; k < nens; k++ ) {
+                FreeWorkspace( &( workers[i].member[k].wsp ) );
+                FreeModelContext( &( workers[i].member[k].ctx ) );
+                FreeMutant( workers[i].member[k].lparm );
+            }
+            free( workers[i].member );
+            FreeEnsemble( &( workers[i].ens ) );
+        }
+    }
+    free( threads );
+    free( workers );
+    free( sp );
+
+    p_deriv = p_nucmajor;
+    nthreads = nthreads_save;
+    rhsthreads = rhsthreads_save;
+}
+
+/** SetScoreBound: from now on, MoveX and MoveXBatch stop a model run as 
+ *                  soon as score + penalty are over bound and return a    
+ *                  score of FORBIDDEN_MOVE for it, as an annealer would   
+ *                  reject such a move anyway; 0 turns this off again; the 
+ *                  bound stays when the input is read again               
+ */
+void
+SetScoreBound( double bound ) {
+    score_bound = bound;
+    inp.sco.bound = bound;
+}
+
+/** AbortedFraction: the fraction of the model runs so far that were 
+ *                    stopped early by the bound (see SetScoreBound)     
+ */
+double
+AbortedFraction( void ) {
+    int scores, aborted;
+
+    GetScoreStats( &scores, &aborted );
+    return scores ? ( double ) aborted / scores : 0.;
+}
+
+/** SetEnsembleSize: from now on, each MoveXBatch thread runs up to size 
+ *                    candidates in lockstep as an ensemble (see Score-    
+ *                    Ensemble); 1 turns this off again                    
+ */
+void
+SetEnsembleSize( int size ) {
+    if( size < 1 )
+        error( "SetEnsembleSize: ensemble size must be at least 1, not %d", size );
+    ensemble_size = size;
+}
+
+/** SetEnsembleRkck: 1 lets MoveXBatch run Rkck in ensembles as well (see 
+ *                    SetEnsembleSize), even though the score of a candi-  
+ *                    date then depends on the others in its ensemble; 0   
+ *                    (the default) keeps ensembles to Rk4                 
+ */
+void
+SetEnsembleRkck( int nonrepro ) {
+    ensemble_rkck = nonrepro;
+}
+
 
 /** WriteTimes: writes the timing information to wherever it needs to be 
  *               written to at the end of a run                            
@@ -566,6 +1289,7 @@ void
 WriteTimes( double *times ) {
     char *timefile;             /* name of the .times file */
     FILE *timeptr;              /* file pointer for .times file */
+    long hits, misses;          /* of the score cache */
 
     /* create time file name by appending .times to input file name */
     timefile = ( char * ) calloc( MAX_RECORD, sizeof( char ) );
@@ -577,6 +1301,12 @@ WriteTimes( double *times ) {
         file_error( "main" );
 
     PrintTimes( timeptr, times );       /* write times to .times file */
+    PrintScoreStats( timeptr );         /* and how long a Score() took */
+    GetScoreCacheStats( &hits, &misses );
+    if( hits + misses > 0 ) {
+        fprintf( timeptr, "cache hits:   %ld\n", hits );
+        fprintf( timeptr, "cache misses: %ld\n", misses );
+    }
 
     fclose( timeptr );          /* clean up */
     free( timefile );
@@ -634,10 +1364,14 @@ GetOptions( void ) {
         options->solver = strcpy( options->solver, "Rkck" );
     else if( ps == Rkf )
         options->solver = strcpy( options->solver, "Rkf" );
+    else if( ps == Imex )
+        options->solver = strcpy( options->solver, "Imex" );
     else if( ps == SoDe )
         options->solver = strcpy( options->solver, "SoDe" );    
     else if( ps == Band )
         options->solver = strcpy(options->solver, "Band");     
+    else if( ps == Krylov )     /* "Krylov" in old state files meant Band */
+        options->solver = strcpy( options->solver, "BlockKrylov" );
     else
         error( "GetOptions: unknown solver function" );
 
@@ -688,12 +1422,16 @@ RestoreOptions( Opts * options ) {
         ps = Rkck;
     else if( !strcmp( options->solver, "Rkf" ) )
         ps = Rkf;
+    else if( !strcmp( options->solver, "Imex" ) )
+        ps = Imex;
     else if( !strcmp( options->solver, "SoDe" ) )
         ps = SoDe;
     else if( !strcmp( options->solver, "Krylov" ) )
         ps = Band;
     else if( !strcmp(options->solver, "Band" ) )
         ps = Band;     
+    else if( !strcmp( options->solver, "BlockKrylov" ) )
+        ps = Krylov;
     else
         error( "RestoreOptions: unknown solver %s", options->solver );
 
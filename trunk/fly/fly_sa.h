@@ -6,6 +6,7 @@
  * Created on June 17, 2013, 5:26 PM
  */
 
+#include <stddef.h>             /* for size_t */
 #include "global.h"
 
 #ifndef _FLY_SA_H
@@ -25,10 +26,75 @@ extern "C" {
  * This function is called from the mex file and it is used to connect with the matlab
  * ssm code. Once that the code is translated to c, we plan to call MoveSA instead of 
  * MoveX. 
+ * If jacobian is JACOBIAN (or GRADIENT), it also returns the derivatives of
+ * the residuals (or of score + penalty) to the parameters in x in out.
+ * solver is 0 for Rkck, 1 for Band, 2 for Imex and 3 for Rk4.
  */
 void
 MoveX( double *x, int *mask, ScoreOutput * out, Files * files, int init, int jacobian, int solver );
 
+/** MoveXBatch: same as MoveX, but scores nvec parameter vectors in one go. 
+ * x holds them row by row (nvec rows of nparm values), and out must have room
+ * for nvec ScoreOutputs, set up the same way as for MoveX. The candidates are 
+ * shared out over a pool of nthreads threads (one per CPU if nthreads is not 
+ * set); each thread has its own copy of the parameters, workspace and solver 
+ * context, so the scores are the same as those of nvec calls to MoveX.
+ */
+void
+MoveXBatch( double *x, int nvec, int nparm, int *mask, ScoreOutput * out, Files * files, int init, int jacobian, int solver );
+
+/** SetScoreBound: from now on, MoveX and MoveXBatch stop a model run as 
+ * soon as score + penalty are over bound and return a score of FORBIDDEN_MOVE
+ * for it, which is what the Metropolis criterion of an annealer needs: it
+ * knows the worst score it could still accept before the move is scored.
+ * 0 turns this off again. It can be set before the first MoveX and stays when
+ * the input is read again.
+ */
+void
+SetScoreBound( double bound );
+
+/** SetEnsembleSize: from now on, each MoveXBatch thread takes up to size 
+ * candidates at a time and runs them in lockstep, with their states inter-
+ * leaved so that the derivative and the solver steps work on all of them in
+ * each (vectorizable) loop. This only applies to plain scores (no derivatives
+ * or debugging output) with DvdtOrig and the Rk4 solver (or Rkck, see Set-
+ * EnsembleRkck); otherwise MoveXBatch scores one candidate at a time as
+ * before. Rk4 gives the same scores, bit for bit, either way and whatever
+ * candidates end up in an ensemble together, as the vector exp and tanh give
+ * the same bits wherever an argument is (see vecLib.h); Sqrt, Hvs and Kolja
+ * use no vector functions at all. 1 turns this off again.
+ */
+void
+SetEnsembleSize( int size );
+
+/** SetEnsembleRkck: with nonrepro set, MoveXBatch also runs Rkck in ensem-
+ * bles. Their members share the adaptive steps, which are at most as large
+ * as those of each of them, so a score then depends on which other candi-
+ * dates are in its ensemble and is no longer reproducible on its own; such
+ * scores aren't cached. 0 (the default) keeps ensembles to Rk4.
+ */
+void
+SetEnsembleRkck( int nonrepro );
+
+/** SetScoreCache: from now on, MoveX and MoveXBatch keep the scores and 
+ * residuals they calculate (not the derivatives) in a cache of at most bytes
+ * bytes, keyed by the whole parameter set, the solver and threading settings
+ * and the input data, and return them without running the model if the same
+ * parameters come again; the least recently used scores are dropped first. 0
+ * turns the cache off. Either way, the cache and its counters are emptied, as
+ * they are whenever MoveX or MoveXBatch read the input file again (init = 1).
+ * The cache is thread-safe.
+ */
+void
+SetScoreCache( size_t bytes );
+
+/** GetScoreCacheStats: returns how many scores were found in the cache 
+ * (hits) and how many had to be calculated (misses) since the cache was
+ * last emptied.
+ */
+void
+GetScoreCacheStats( long *hits, long *misses );
+
 
 #ifdef	__cplusplus
 }
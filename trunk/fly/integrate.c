@@ -10,10 +10,10 @@
  * The function Blastoderm runs the fly model and   
  * calls the appropriate solver for propagating the equations.   
  * PrintBlastoderm formats and prints the output of the Blasto-  
- * derm function and FreeSolution frees the solution allocated   
- * by Blastoderm. integrate.h also comes with a few utility      
+ * derm function and FreeSolution frees the solutions copied    
+ * from it. integrate.h also comes with a few utility      
  * functions for TLists which are linked lists used to initia-   
- * lize the time/mode table for Blastoderm.                      
+ * lize the time/mode table (the Schedule) for Blastoderm.       
  *                                                               
  * @note all right-hand-of-ODE-specific stuff is in zygotic.h    
  */
@@ -66,8 +66,8 @@ const int MITOTATE = 16;        /* and MITOTATE carries forward the system by ep
 
 const char Jerry[] = "@(#) In Memoriam Jerome John Garcia, 8/1/42-8/9/95";
 
-// size of jacobian???
-int jacSize;
+// size of jacobian??? (per thread, see Score)
+__thread int jacSize;
 
 /* variables used for timing */
 
@@ -94,134 +94,91 @@ double *delta;
  *               It includes times when bias is added, cell division times 
  *               and times for which we have data and ends with the time   
  *               of gastrulation.                                          
+ *               If inp->ctx.sens.np > 0, it also leaves the forward sen-  
+ *               sitivities for each time of the solution in inp->ctx.sens 
+ *               (see Sensitivity in maternal.h).                          
+ *               The times and what to do at each of them come from the    
+ *               Schedule of the genotype (see InitSchedules).             
+ *               The solution lives in inp->ctx.arena: it is good until    
+ *               the next Blastoderm on the same context and must not be   
+ *               freed (copy it, e.g. with ConvertAnswer, to keep it).     
+ *               If inp->ctx.stream.eval is set, the data are scored as    
+ *               we go (see ScoreStream) and only the last state of the    
+ *               solution is left.                                         
  */
 NArrPtr
 Blastoderm( int genindex, char *genotype, Input * inp, FILE * slog ) {
 
     SolverInput si;
-    const double epsilon = EPSILON;     /* epsilons: very small in- */
-    const double big_epsilon = BIG_EPSILON;     /* creases used for division */
 
     NArrPtr solution;           /* solution will be an array of */
     /* concs for each requested time */
 
-    int *what2do = NULL;        /* what to do at each time step */
-
-    double *divtable = NULL;    /* cell div times in reverse order */
-    double *transitions = NULL; /* this is when cell divs start */
-    double *durations = NULL;   /* durations of cell divisions */
+    Schedule *sched;            /* times and ops of this genotype */
+    Schedule own;               /* or one compiled just for this run */
+    int *what2do;               /* what to do at each time step */
+    int *daughter;              /* DIVIDE: anterior daughter of each conc */
 
-    DArrPtr biastimes;          /* times a which bias is added */
-    //DArrPtr   oldtimes;                  /* statically saves tabtimes */ //we want to keep this in memory to avoid initialization in case
-    //our times are repeated
     DArrPtr bias;               /* bias for given time & genotype */
 
-    //static int       allocate;             /* flag: need to allocate or not? */
     int i, ii, j;               /* loop counters */
-    int k;                      /* index of gene k in current nuc */
-    int ap;                     /* nuc. position on AP axis */
-    int lin;                    /* first lineage number at each ccycle */
 
-    int rule;                   /* MITOSIS or INTERPHASE? */
+    /* derivative to restore after propagating in gene-major layout */
+    void ( *p_nucmajor ) ( double *, double, double *, int, SolverInput *, Input * );
 
+    Sensitivity *sens = &( inp->ctx.sens );     /* forward sensitivities */
+    ScoreStream *stream = &( inp->ctx.stream ); /* scoring as we go */
+    double **s = NULL;          /* ds/dp for each solution time */
+    int p;                      /* parameter of the sensitivities */
+    int size, size1;            /* state size before and after DIVIDE */
 
-    TList *entries = NULL;      /* temp linked list for times and */
-    TList *current;             /* ops for the solver */
     jacSize = 0;
-    /* allocate transitions array (skip if ndivs == 0) */
-    if( inp->zyg.defs.ndivs > 0 )
-        transitions = ( double * ) calloc( inp->zyg.defs.ndivs, sizeof( double ) );
+    /* the gene-major layout breaks the banded Jacobian and the delay history */
+    if( ( slayout == GeneMajor ) && ( ( ps == Band ) || ( ps == Krylov ) || ( ps == BaDe ) || ( ps == SoDe ) ) )
+        error( "Blastoderm: gene-major state layout only works with explicit solvers" );
+    /* the sensitivities come out of CVODES and need the DvdtOrig equations */
+    if( ( sens->np > 0 ) && ( ( ( ps != Band ) && ( ps != Krylov ) ) || ( p_deriv != DvdtOrig ) ) )
+        error( "Blastoderm: sensitivities only work with DvdtOrig and the Band or Krylov solver" );
+    if( ( inp->ctx.adj.np > 0 ) && ( ( ( ps != Band ) && ( ps != Krylov ) ) || ( p_deriv != DvdtOrig ) ) )
+        error( "Blastoderm: the adjoint gradient only works with DvdtOrig and the Band or Krylov solver" );
+    /* both need the whole solution, which we don't keep if we score as we go */
+    if( ( stream->eval != NULL ) && ( ( sens->np > 0 ) || ( inp->ctx.adj.np > 0 ) ) )
+        error( "Blastoderm: can't score as we go with sensitivities or adjoints" );
     /* for each genotype, the 'genotype' variable has to be made static to zy- *
      * gotic.c so that the derivative functions know which genotype they're    *
      * dealing with (i.e. they need to get the appropriate bcd gradient)       */
-    InitDelaySolver(  );
+    InitDelaySolver( &( inp->ctx ) );
+    inp->wsp.num_nucs = 0;      /* D and bcd get set up again by SetCycle */
     si.genindex = genindex;
     si.all_fact_discons = SetFactDiscons( &( inp->his[genindex] ), &( inp->ext[genindex] ) );
 
     /* INITIALIZATION OF THE MODEL STRUCTS AND ARRAYS ************************* */
 
-    solution.array = NULL;
-    solution.size = 0;
-
-    what2do = NULL;
-
-    biastimes.array = NULL;
-    biastimes.size = 0;
-
-
-    /* get bias times and initialize information about cell divisions */
-
-    biastimes = GetBTimes( genotype, &( inp->zyg ) );
-    if( !( biastimes.array ) )
-        error( "Blastoderm: error getting bias times" );
-    if( inp->zyg.defs.ndivs > 0 ) {
-        if( !( divtable = inp->zyg.times.div_times ) )
-            error( "Blastoderm: error getting division table" );
-        if( !( durations = inp->zyg.times.div_duration ) )
-            error( "Blastoderm: error getting division durations" );
-        for( i = 0; i < inp->zyg.defs.ndivs; i++ ) {
-            transitions[i] = divtable[i] - durations[i];
-        }
+    /* the times and ops come from the schedule compiled by InitSchedules */
+    sched = GetSchedule( genindex, genotype, inp, &own );
+    what2do = sched->op;
+
+    /* the solution goes into the arena of the context, cleared to zero; *
+     * if we score as we go, we only need the current and the next state */
+    solution = ArenaSolution( &( inp->ctx.arena ), sched, stream->eval == NULL );
+
+    /* the sensitivities start from zero and go with the solution; *
+     * parameters that this mutant fixes get none                  */
+    if( sens->np > 0 ) {
+        s = ( double ** ) calloc( solution.size, sizeof( double * ) );
+        for( i = 0; i < solution.size; i++ )
+            s[i] = ( double * ) calloc( sens->np * solution.array[i].state.size, sizeof( double ) );
+        sens->live = ( int * ) calloc( sens->np, sizeof( int ) );
+        for( p = 0; p < sens->np; p++ )
+            sens->live[p] = !FixedByMutant( genotype, sens->parm[p] );
     }
-    /* entries is a linked list, which we use to set up the solution struct    *
-     * and the what2do array; each of these needs an entry for:                *
-     * - start and end (gastrulation) time                                     *
-     * - times for mitoses: - beginning of mitosis                             *
-     *                      - cell division time (still belongs to previous    *
-     *                        cleavage cycle)                                  *
-     *                      - time right after cell division (+EPSILON), be-   *
-     *                        longs to new cell cycle with doubled nnucs       *
-     * - times at which we add bias                                            *
-     * - tabulated times for which we have data or which we want to display    */
-
-    /* add start and end (gastrulation) time */
-    entries = InitTList( &( inp->zyg ), inp->zyg.nnucs );
-    /* add all times required for mitoses (skip this for 0 div schedule) */
-    for( i = 0; i < inp->zyg.defs.ndivs; i++ ) {
-
-        entries = InsertTList( &( inp->zyg ), entries, divtable[i], DIVIDE );
-        if( GetNNucs( &( inp->zyg.defs ), inp->zyg.nnucs, divtable[i], &( inp->zyg.times ) ) ==
-            GetNNucs( &( inp->zyg.defs ), inp->zyg.nnucs, ( divtable[i] + epsilon ), &( inp->zyg.times ) ) )
-            error( "Blastoderm: epsilon of %g too small! %g ", epsilon, divtable[i] );
-        entries = InsertTList( &( inp->zyg ), entries, divtable[i] + epsilon, PROPAGATE );
-        entries = InsertTList( &( inp->zyg ), entries, transitions[i], MITOTATE );
-        if( GetNNucs( &( inp->zyg.defs ), inp->zyg.nnucs, transitions[i], &( inp->zyg.times ) ) !=
-            GetNNucs( &( inp->zyg.defs ), inp->zyg.nnucs, ( transitions[i] + epsilon ), &( inp->zyg.times ) ) )
-            error( "Blastoderm: division within epsilon of %g! %g %g ", epsilon, transitions[i], durations[i] );
-        entries = InsertTList( &( inp->zyg ), entries, transitions[i] + epsilon, PROPAGATE );
-    }
-    /* add bias times */
-    
-    for( i = 0; i < biastimes.size; i++ ) {
-        entries = InsertTList( &( inp->zyg ), entries, biastimes.array[i], ADD_BIAS | PROPAGATE );
-    }
-
-    /* tabulated times */
-    for( i = 0; i < inp->sco.facts.tt[genindex].ptr.times.size; i++ ) {
-        entries = InsertTList( &( inp->zyg ), entries, inp->sco.facts.tt[genindex].ptr.times.array[i], PROPAGATE );
-    }
-    /* now we know the number of solutions we have to calculate, so we can     *
-     * allocate and initialize the solution struct and the what2do array       */
-    solution.size = CountEntries( entries );
-    solution.array = ( NucState * ) calloc( solution.size, sizeof( NucState ) );
-    what2do = ( int * ) calloc( solution.size, sizeof( int ) );
-    current = entries;
-    for( i = 0; i < solution.size; i++ ) {
-        solution.array[i].time = current->time;
-        solution.array[i].state.size = current->n;
-        solution.array[i].state.array = ( double * ) calloc( current->n, sizeof( double ) );
-        for( j = 0; j < current->n; j++ )       //check if this zeroing is really needed or it was just for testing purposes
-            solution.array[i].state.array[j] = 0;
-        what2do[i] = current->op;
-        current = current->next;
-    }
-    /* free the linked list and save new tab times in oldtimes array */
-    FreeTList( entries );
 
     /* RUNNING THE MODEL ****************************************************** */
-    /* Before running the model, mutate zygotic params appropriately */
-    FreeMutant( inp->lparm );
-    inp->lparm = Mutate( genotype, inp->zyg.parm, &( inp->zyg.defs ) );
+    /* Before running the model, mutate zygotic params appropriately; *
+     * which ones to zero was worked out with the schedule; the base- *
+     * lines of the regulatory input depend on them (and on bcd)      */
+    ApplyMutant( sched->zero, sched->nzero, inp->zyg.parm, &( inp->lparm ), &( inp->zyg.defs ) );
+    ResetRegBase( &( inp->wsp ) );
     /*if (debug) {
        fprintf(slog, "\n--------------------------------------------------");
        fprintf(slog, "--------------------------------------------------\n");
@@ -235,8 +192,9 @@ Blastoderm( int genindex, char *genotype, Input * inp, FILE * slog ) {
         //printf("%d) %lg %lg %lg %lg\n", i, solution.array[i].state.array[0], solution.array[i].state.array[1], solution.array[i].state.array[2], solution.array[i].state.array[3]);
         /* First we have to set the propagation rule in zygotic.c (either MITOSIS  *
          * or INTERPHASE) to make sure that the correct differential equations are *
-         * propagated (rules are defined in zygotic.h)                             */
-        rule = GetRule( solution.array[i].time, &( inp->zyg ) );
+         * propagated (rules are defined in zygotic.h); it comes with the schedule *
+         * and holds for the whole interval the solver sees                        */
+        si.rule = sched->rule[i];
         si.time = solution.array[i].time;
         //printf("WHAT2DO = %d at step %d\n", what2do[i], i);
         /*if (debug) {
@@ -257,19 +215,25 @@ Blastoderm( int genindex, char *genotype, Input * inp, FILE * slog ) {
          * note that the bias lives in maternal.c and has to be fetched from there */
         if( what2do[i] & ADD_BIAS ) {
             //printf("%d-%d ADD_BIAS\n", i, what2do[i]);  
-            for( j = 0; j < biastimes.size; j++ ) {
-                if( fabs( solution.array[i].time - biastimes.array[j] ) < big_epsilon ) {
-                    bias = GetBias( biastimes.array[j], genindex, &( inp->zyg ) );      //bias is an array with concentrations
-                    //Here we choose if we want to "add" or "set" bias concentrations;
-                    //just uncomment the line you need (and comment the other one)
-                    for( ii = 0; ii < bias.size; ii++ )
-                        //solution.array[i].state.array[ii] += bias.array[ii]; //adding bias concentrations to the system
-                        solution.array[i].state.array[ii] = bias.array[ii];    //setting bias concentrations to the system
-                }
-            }
+            bias = sched->bias[i];      //bias is an array with concentrations
+            //Here we choose if we want to "add" or "set" bias concentrations;
+            //just uncomment the line you need (and comment the other one)
+            for( ii = 0; ii < bias.size; ii++ )
+                //solution.array[i].state.array[ii] += bias.array[ii]; //adding bias concentrations to the system
+                solution.array[i].state.array[ii] = bias.array[ii];    //setting bias concentrations to the system
+            /* concentrations that are set don't depend on the parameters */
+            for( p = 0; p < sens->np; p++ )
+                for( ii = 0; ii < bias.size; ii++ )
+                    s[i][p * solution.array[i].state.size + ii] = 0.;
             if( debug )
                 fprintf( slog, "Blastoderm: added bias at time %f.\n", solution.array[i].time );
         }
+        /* the state is final now: score it if we do that as we go, and stop *
+         * if there are no more data (the next state overwrites this one)   */
+        if( ( stream->eval != NULL ) && EvalState( genindex, solution.array[i].time, solution.array[i].state.array, inp ) ) {
+            solution.size = i + 1;
+            break;
+        }
         /* The ops below can be executed in addition to ADD_BIAS but they cannot   *
          * be combined between themselves; if more than one op is set, the prio-   * 
          * rities are as follows: NO_OP > DIVIDE > PROPAGATE; please make sure     *
@@ -295,25 +259,16 @@ Blastoderm( int genindex, char *genotype, Input * inp, FILE * slog ) {
          * want to loose the most posterior daughter cell if we don't need it any  *
          * more at the later cycle                                                 *
          *                                                                         *
-         * This is implemented as follows below: lin is the lineage number of the  *
-         * most anterior cell of the next cell cycle; if it's odd numbered, we'll  *
-         * push off the most anterior daughter by subtracting the number of genes  * 
-         * from the daughter indices (i.e. we shift the solution array for the     *
-         * next cycle posteriorly by one nucleus); if on the other hand, the most  *
+         * This is implemented in CompileSchedule, which gives us the index ii of  *
+         * the anterior daughter of each concentration j (see there); if the most  *
          * posterior nucleus lies outside our new array, we just forget about it   */
         else if( what2do[i] & DIVIDE ) {
             //printf("%d-%d DIVIDE\n", i, what2do[i]);
-            lin = GetStartLin( solution.array[i + 1].time, inp->zyg.defs, inp->zyg.lin_start, &( inp->zyg.times ) );
+            daughter = sched->daughter[i];
+            size = solution.array[i].state.size;
+            size1 = solution.array[i + 1].state.size;
             for( j = 0; j < solution.array[i].state.size; j++ ) {
-                k = j % inp->zyg.defs.ngenes;   /* k: index of gene k in current nucleus */
-                ap = j / inp->zyg.defs.ngenes;  /* ap: rel. nucleus position on AP axis */
-
-                /* evaluate ii: index of anterior daughter nucleus */
-
-                if( lin % 2 )
-                    ii = 2 * ap * inp->zyg.defs.ngenes + k - inp->zyg.defs.ngenes;
-                else
-                    ii = 2 * ap * inp->zyg.defs.ngenes + k;
+                ii = daughter[j];
 
                 /* skip the first most anterior daughter nucleus in case lin is odd */
                 if( ii >= 0 )
@@ -321,9 +276,17 @@ Blastoderm( int genindex, char *genotype, Input * inp, FILE * slog ) {
                 /* the second daughter only exists if it is still within the region */
                 if( ii + inp->zyg.defs.ngenes < solution.array[i + 1].state.size )
                     solution.array[i + 1].state.array[ii + inp->zyg.defs.ngenes] = solution.array[i].state.array[j];
+
+                /* the daughters inherit the sensitivities as well */
+                for( p = 0; p < sens->np; p++ ) {
+                    if( ii >= 0 )
+                        s[i + 1][p * size1 + ii] = s[i][p * size + j];
+                    if( ii + inp->zyg.defs.ngenes < size1 )
+                        s[i + 1][p * size1 + ii + inp->zyg.defs.ngenes] = s[i][p * size + j];
+                }
             }
             /* Divide the history of the delay solver */
-            DivideHistory( solution.array[i].time, solution.array[i + 1].time, &( inp->zyg ) );
+            DivideHistory( solution.array[i].time, solution.array[i + 1].time, inp );
 
             if( debug )
                 fprintf( slog, "Blastoderm: nuclear division %d -> %d nuclei.\n", solution.array[i].state.size / inp->zyg.defs.ngenes,
@@ -338,6 +301,8 @@ Blastoderm( int genindex, char *genotype, Input * inp, FILE * slog ) {
             //printf("%d-%d MITOTATE\n", i, what2do[i]);
             for( j = 0; j < solution.array[i].state.size; j++ )
                 solution.array[i + 1].state.array[j] = solution.array[i].state.array[j];
+            for( j = 0; j < sens->np * solution.array[i].state.size; j++ )
+                s[i + 1][j] = s[i][j];
         }
         /* In case we have to PROPAGATE the differential equeations, we call the   *
          * solver; you have to make sure that the appropriate rule has been set in *
@@ -356,8 +321,32 @@ Blastoderm( int genindex, char *genotype, Input * inp, FILE * slog ) {
                printf("From %d, %lg %lg %lg %lg\n", i, solution.array[i].state.array[0], solution.array[i].state.array[1], solution.array[i].state.array[2], solution.array[i].state.array[3]);
                }
              */
-            ( *ps ) ( solution.array[i].state.array, solution.array[i + 1].state.array, solution.array[i].time, solution.array[i + 1].time, inp->ste.stepsize,
-                      inp->ste.accuracy, solution.array[i].state.size, slog, &si, inp );
+            if( slayout == GeneMajor ) {
+                /* the solver sees a gene-major copy of the state and the gene-major *
+                 * derivative; we convert back for DIVIDE, bias and scoring (see     *
+                 * StateLayout in zygotic.h), which all work nucleus by nucleus; the *
+                 * two copies are O(n), while the solver makes several derivative    *
+                 * evaluations of O(n * ngenes) in between; a threaded Score() in-   *
+                 * stalls it once for all threads, so we leave p_deriv alone if      *
+                 * that's been done                                                  */
+                ToGeneMajor( solution.array[i].state.array, inp->wsp.soa_in, inp->zyg.defs.ngenes, solution.array[i].state.size );
+                p_nucmajor = p_deriv;
+                if( p_nucmajor != DvdtGeneMajor )
+                    p_deriv = DvdtGeneMajor;
+                ( *ps ) ( inp->wsp.soa_in, inp->wsp.soa_out, solution.array[i].time, solution.array[i + 1].time, inp->ste.stepsize,
+                          inp->ste.accuracy, solution.array[i].state.size, slog, &si, inp );
+                if( p_nucmajor != DvdtGeneMajor )
+                    p_deriv = p_nucmajor;
+                ToNucMajor( inp->wsp.soa_out, solution.array[i + 1].state.array, inp->zyg.defs.ngenes, solution.array[i + 1].state.size );
+            } else {
+                /* the Band and Krylov solvers take the sensitivities along */
+                if( sens->np > 0 ) {
+                    sens->sin = s[i];
+                    sens->sout = s[i + 1];
+                }
+                ( *ps ) ( solution.array[i].state.array, solution.array[i + 1].state.array, solution.array[i].time, solution.array[i + 1].time, inp->ste.stepsize,
+                          inp->ste.accuracy, solution.array[i].state.size, slog, &si, inp );
+            }
             /*
                if (debug) {
                printf("To %d, %lg %lg %lg %lg\n", i+1, solution.array[i+1].state.array[0], solution.array[i+1].state.array[1], solution.array[i+1].state.array[2], solution.array[i+1].state.array[3]);
@@ -374,13 +363,276 @@ Blastoderm( int genindex, char *genotype, Input * inp, FILE * slog ) {
     /* After having calculated the solution, free the mutant parameter structs * 
      * and return the result                                                   */
 
-    FreeDelaySolver(  );
+    FreeDelaySolver( &( inp->ctx ) );
     FreeFactDiscons( si.all_fact_discons.fact_discons );
-    free( what2do );
-    free( transitions );
+    if( sched == &own )
+        FreeSchedule( &own );
+    /* Score picks up the sensitivities and frees them */
+    if( sens->np > 0 ) {
+        sens->s = s;
+        sens->size = solution.size;
+        sens->sin = sens->sout = NULL;
+        free( sens->live );
+        sens->live = NULL;
+    }
     return solution;
 }
 
+/**  BlastodermEnsemble: Blastoderm for all members of an ensemble (see 
+ *                       Ensemble in maternal.h) in lockstep: the ops of  
+ *                       the Schedule are done for each member, and each  
+ *                       PROPAGATE takes all of them through Rk4Ensemble  
+ *                       or RkckEnsemble (for ps Rk4 or Rkck) in one go;  
+ *                       the solution of each member goes into its arena  
+ *                       (and to solution[k], unless that is NULL), and   
+ *                       members that score as they go (see ScoreStream)  
+ *                       drop out of the ensemble as soon as they are     
+ *                       done; only works for DvdtOrig in nucleus-major   
+ *                       layout, without sensitivities or adjoints        
+ */
+void
+BlastodermEnsemble( int genindex, char *genotype, Ensemble * ens, NArrPtr * solution, FILE * slog ) {
+
+    SolverInput si;
+
+    Schedule *sched;            /* times and ops of this genotype */
+    Schedule own;               /* or one compiled just for this run */
+    int *what2do;               /* what to do at each time step */
+    int *daughter;              /* DIVIDE: anterior daughter of each conc */
+
+    DArrPtr bias;               /* bias for given time & genotype */
+
+    /* the ensemble version of the solver */
+    void ( *pe ) ( double *, double *, double, double, double, double, int, FILE *, SolverInput *, Ensemble * );
+
+    int K = ens->size;          /* number of members */
+    Input **member;             /* all members ... */
+    NArrPtr *sol;               /* ... their solutions ... */
+    int *live;                  /* ... and the ones still going */
+    int nlive;
+    Input *inp;                 /* the first member, for what they share */
+    double *state, *next;       /* state of a member now and next */
+    int size, size1;            /* state size now and next */
+    int i, ii, j, k, a;         /* loop counters */
+
+    if( K == 0 )
+        return;
+    inp = ens->member[0];
+
+    if( ps == Rk4 )
+        pe = Rk4Ensemble;
+    else if( ps == Rkck )
+        pe = RkckEnsemble;
+    else
+        error( "BlastodermEnsemble: ensembles only work with the Rk4 and Rkck solvers" );
+    if( ( p_deriv != DvdtOrig ) || ( slayout == GeneMajor ) )
+        error( "BlastodermEnsemble: ensembles only work with DvdtOrig in nucleus-major layout" );
+
+    member = ( Input ** ) malloc( K * sizeof( Input * ) );
+    sol = ( NArrPtr * ) malloc( K * sizeof( NArrPtr ) );
+    live = ( int * ) malloc( K * sizeof( int ) );
+    memcpy( member, ens->member, K * sizeof( Input * ) );
+
+    si.genindex = genindex;
+    si.all_fact_discons = SetFactDiscons( &( inp->his[genindex] ), &( inp->ext[genindex] ) );
+
+    /* the members share the schedule, but each of them has its own solution *
+     * and mutant (and baselines of u, which depend on it)                   */
+    sched = GetSchedule( genindex, genotype, inp, &own );
+    what2do = sched->op;
+    for( k = 0; k < K; k++ ) {
+        if( ( member[k]->ctx.sens.np > 0 ) || ( member[k]->ctx.adj.np > 0 ) )
+            error( "BlastodermEnsemble: no sensitivities or adjoints in an ensemble" );
+        member[k]->wsp.num_nucs = 0;
+        sol[k] = ArenaSolution( &( member[k]->ctx.arena ), sched, member[k]->ctx.stream.eval == NULL );
+        ApplyMutant( sched->zero, sched->nzero, member[k]->zyg.parm, &( member[k]->lparm ), &( member[k]->zyg.defs ) );
+        ResetRegBase( &( member[k]->wsp ) );
+        live[k] = k;
+    }
+    nlive = K;
+
+    /* the ops are those of Blastoderm (see there for what they do) */
+    for( i = 0; ( i < sched->size ) && ( nlive > 0 ); i++ ) {
+        si.rule = sched->rule[i];
+        si.time = sched->time[i];
+        size = sched->n[i];
+
+        if( what2do[i] & ADD_BIAS ) {
+            bias = sched->bias[i];
+            for( a = 0; a < nlive; a++ )
+                for( ii = 0; ii < bias.size; ii++ )
+                    sol[live[a]].array[i].state.array[ii] = bias.array[ii];
+        }
+        /* the states are final now: the members we score as we go drop out *
+         * as soon as they have no more data or are over the bound           */
+        for( a = 0, j = 0; a < nlive; a++ ) {
+            k = live[a];
+            if( ( member[k]->ctx.stream.eval != NULL )
+                && EvalState( genindex, sol[k].array[i].time, sol[k].array[i].state.array, member[k] ) )
+                sol[k].size = i + 1;
+            else
+                live[j++] = k;
+        }
+        nlive = j;
+
+        if( what2do[i] & NO_OP ) {
+            ;
+        } else if( what2do[i] & DIVIDE ) {
+            daughter = sched->daughter[i];
+            size1 = sched->n[i + 1];
+            for( a = 0; a < nlive; a++ ) {
+                state = sol[live[a]].array[i].state.array;
+                next = sol[live[a]].array[i + 1].state.array;
+                for( j = 0; j < size; j++ ) {
+                    ii = daughter[j];
+                    if( ii >= 0 )
+                        next[ii] = state[j];
+                    if( ii + inp->zyg.defs.ngenes < size1 )
+                        next[ii + inp->zyg.defs.ngenes] = state[j];
+                }
+            }
+        } else if( what2do[i] & MITOTATE ) {
+            for( a = 0; a < nlive; a++ )
+                memcpy( sol[live[a]].array[i + 1].state.array, sol[live[a]].array[i].state.array, size * sizeof( double ) );
+        } else if( what2do[i] & PROPAGATE ) {
+            /* interleave the states of the members still going, propagate *
+             * them all at once and take them apart again                  */
+            if( nlive == 0 )
+                break;
+            for( a = 0; a < nlive; a++ ) {
+                ens->member[a] = member[live[a]];
+                state = sol[live[a]].array[i].state.array;
+                for( j = 0; j < size; j++ )
+                    ens->vin[j * nlive + a] = state[j];
+            }
+            ens->size = nlive;
+            ( *pe ) ( ens->vin, ens->vout, sched->time[i], sched->time[i + 1], inp->ste.stepsize, inp->ste.accuracy, size, slog, &si, ens );
+            for( a = 0; a < nlive; a++ ) {
+                next = sol[live[a]].array[i + 1].state.array;
+                for( j = 0; j < size; j++ )
+                    next[j] = ens->vout[j * nlive + a];
+            }
+        } else {
+            error( "BlastodermEnsemble: op was %d!?", what2do[i] );
+        }
+    }
+
+    FreeFactDiscons( si.all_fact_discons.fact_discons );
+    if( sched == &own )
+        FreeSchedule( &own );
+    memcpy( ens->member, member, K * sizeof( Input * ) );
+    ens->size = K;
+    if( solution != NULL )
+        memcpy( solution, sol, K * sizeof( NArrPtr ) );
+    free( member );
+    free( sol );
+    free( live );
+}
+
+/**  BlastodermAdjoint: goes back through the solution of Blastoderm for 
+ *                      genotype genindex and adds d score / d parm for  
+ *                      the parameters in inp->ctx.adj to its grad, where
+ *                      dgdv[i] is d score / d state at solution time i  
+ *                      (NULL if the score doesn't depend on it); the    
+ *                      ops are undone in reverse: DIVIDE sums what the  
+ *                      two daughters get, bias that is set takes nothing
+ *                      and PROPAGATE goes through BandAdjoint           
+ */
+void
+BlastodermAdjoint( int genindex, char *genotype, NArrPtr * solution, double **dgdv, Input * inp ) {
+
+    SolverInput si;
+
+    Adjoint *adj = &( inp->ctx.adj );
+    Schedule *sched;            /* what Blastoderm did at each time */
+    Schedule own;               /* (if it had to compile it itself) */
+    int *what2do;
+    int *daughter;              /* DIVIDE: anterior daughter of each conc */
+
+    DArrPtr bias;               /* bias for given time & genotype */
+
+    double *l, *l1, *swap;      /* d score / d state at times i and i+1 */
+    int i, ii, j;               /* as in Blastoderm */
+    int size, size1;            /* state size at times i and i+1 */
+    int maxsize = 0;
+    int p;
+
+    sched = GetSchedule( genindex, genotype, inp, &own );
+    what2do = sched->op;
+    if( sched->size != solution->size )
+        error( "BlastodermAdjoint: solution does not belong to genotype %s", genotype );
+
+    inp->wsp.num_nucs = 0;      /* D and bcd get set up again by SetCycle */
+    si.genindex = genindex;
+    si.all_fact_discons = SetFactDiscons( &( inp->his[genindex] ), &( inp->ext[genindex] ) );
+
+    /* the parameters are the mutated ones of the forward run */
+    ApplyMutant( sched->zero, sched->nzero, inp->zyg.parm, &( inp->lparm ), &( inp->zyg.defs ) );
+    ResetRegBase( &( inp->wsp ) );
+    adj->live = ( int * ) calloc( adj->np, sizeof( int ) );
+    for( p = 0; p < adj->np; p++ )
+        adj->live[p] = !FixedByMutant( genotype, adj->parm[p] );
+
+    for( i = 0; i < solution->size; i++ )
+        if( solution->array[i].state.size > maxsize )
+            maxsize = solution->array[i].state.size;
+    l = ( double * ) calloc( maxsize, sizeof( double ) );
+    l1 = ( double * ) calloc( maxsize, sizeof( double ) );
+
+    /* l1 holds d score / d state at time i + 1, before its bias was set */
+    for( i = solution->size - 1; i >= 0; i-- ) {
+        size = solution->array[i].state.size;
+        si.time = solution->array[i].time;
+        si.rule = sched->rule[i];
+
+        if( what2do[i] & NO_OP ) {
+            for( j = 0; j < size; j++ )
+                l[j] = 0.;
+        } else if( what2do[i] & DIVIDE ) {
+            daughter = sched->daughter[i];
+            size1 = solution->array[i + 1].state.size;
+            for( j = 0; j < size; j++ ) {
+                ii = daughter[j];
+                l[j] = 0.;
+                if( ii >= 0 )
+                    l[j] += l1[ii];
+                if( ii + inp->zyg.defs.ngenes < size1 )
+                    l[j] += l1[ii + inp->zyg.defs.ngenes];
+            }
+        } else if( what2do[i] & MITOTATE ) {
+            for( j = 0; j < size; j++ )
+                l[j] = l1[j];
+        } else if( what2do[i] & PROPAGATE ) {
+            BandAdjoint( solution->array[i].state.array, l1, l, solution->array[i].time, solution->array[i + 1].time,
+                         inp->ste.accuracy, size, &si, inp );
+        } else {
+            error( "BlastodermAdjoint: op was %d!?", what2do[i] );
+        }
+
+        if( dgdv[i] != NULL )
+            for( j = 0; j < size; j++ )
+                l[j] += dgdv[i][j];
+
+        /* concentrations that are set by the bias don't depend on before */
+        if( what2do[i] & ADD_BIAS ) {
+            bias = sched->bias[i];
+            for( ii = 0; ii < bias.size; ii++ )
+                l[ii] = 0.;
+        }
+        swap = l1;
+        l1 = l;
+        l = swap;
+    }
+
+    free( l );
+    free( l1 );
+    free( adj->live );
+    adj->live = NULL;
+    FreeFactDiscons( si.all_fact_discons.fact_discons );
+    if( sched == &own )
+        FreeSchedule( &own );
+}
+
 // don't really understand how or why this works like this
 /*
  double*  BlastodermJac(int genindex, char *genotype, DArrPtr tabtimes,
@@ -750,7 +1002,8 @@ Blastoderm( int genindex, char *genotype, Input * inp, FILE * slog ) {
  */
 
 /**  FreeSolution: frees memory of the solution structure created by 
- *                 Blastoderm() or gut functions                           
+ *                 ConvertAnswer() or gut functions (not the one of Blas-  
+ *                 toderm(), which lives in the SolutionArena)             
  */
 void
 FreeSolution( NArrPtr * solution ) {
@@ -825,6 +1078,254 @@ ConvertAnswer( NArrPtr answer, DArrPtr tabtimes ) {
  *   data, how many nuclei there are and what to do.                       *
  ***************************************************************************/
 
+/*** SCHEDULES *************************************************************/
+
+/**  CompileSchedule: works out what Blastoderm has to do for genotype    
+ *                    genindex, and when; this is everything that does    
+ *                    not depend on the parameters: the solution times    
+ *                    and their ops and sizes, the bias to set, the line- 
+ *                    age map of each division, the mutated parameters    
+ *                    and the rule (MITOSIS or INTERPHASE) of each inter- 
+ *                    val; the times of the mitoses are in the schedule,  
+ *                    so the rule never changes within an interval        
+ */
+Schedule
+CompileSchedule( int genindex, char *genotype, Input * inp ) {
+    const double epsilon = EPSILON;     /* epsilons: very small in- */
+    const double big_epsilon = BIG_EPSILON;     /* creases used for division */
+
+    Schedule sched;
+
+    double *divtable = NULL;    /* cell div times in reverse order */
+    double *durations = NULL;   /* durations of cell divisions */
+    double transition;          /* this is when a cell div starts */
+
+    DArrPtr biastimes;          /* times a which bias is added */
+    DArrPtr tabtimes;           /* times for which we have data */
+
+    TList *entries = NULL;      /* temp linked list for times and */
+    TList *current;             /* ops for the solver */
+
+    int i, j;                   /* loop counters */
+    int k;                      /* index of gene k in current nuc */
+    int ap;                     /* nuc. position on AP axis */
+    int lin;                    /* first lineage number at each ccycle */
+    int ngenes = inp->zyg.defs.ngenes;
+
+    /* get bias times and initialize information about cell divisions */
+
+    biastimes = GetBTimes( genotype, &( inp->zyg ) );
+    if( !( biastimes.array ) )
+        error( "CompileSchedule: error getting bias times" );
+    if( inp->zyg.defs.ndivs > 0 ) {
+        if( !( divtable = inp->zyg.times.div_times ) )
+            error( "CompileSchedule: error getting division table" );
+        if( !( durations = inp->zyg.times.div_duration ) )
+            error( "CompileSchedule: error getting division durations" );
+    }
+    /* entries is a linked list, which we use to set up the schedule; it needs *
+     * an entry for:                                                           *
+     * - start and end (gastrulation) time                                     *
+     * - times for mitoses: - beginning of mitosis                             *
+     *                      - cell division time (still belongs to previous    *
+     *                        cleavage cycle)                                  *
+     *                      - time right after cell division (+EPSILON), be-   *
+     *                        longs to new cell cycle with doubled nnucs       *
+     * - times at which we add bias                                            *
+     * - tabulated times for which we have data or which we want to display    */
+
+    /* add start and end (gastrulation) time */
+    entries = InitTList( &( inp->zyg ), inp->zyg.nnucs );
+    /* add all times required for mitoses (skip this for 0 div schedule) */
+    for( i = 0; i < inp->zyg.defs.ndivs; i++ ) {
+        transition = divtable[i] - durations[i];
+        entries = InsertTList( &( inp->zyg ), entries, divtable[i], DIVIDE );
+        if( GetNNucs( &( inp->zyg.defs ), inp->zyg.nnucs, divtable[i], &( inp->zyg.times ) ) ==
+            GetNNucs( &( inp->zyg.defs ), inp->zyg.nnucs, ( divtable[i] + epsilon ), &( inp->zyg.times ) ) )
+            error( "CompileSchedule: epsilon of %g too small! %g ", epsilon, divtable[i] );
+        entries = InsertTList( &( inp->zyg ), entries, divtable[i] + epsilon, PROPAGATE );
+        entries = InsertTList( &( inp->zyg ), entries, transition, MITOTATE );
+        if( GetNNucs( &( inp->zyg.defs ), inp->zyg.nnucs, transition, &( inp->zyg.times ) ) !=
+            GetNNucs( &( inp->zyg.defs ), inp->zyg.nnucs, ( transition + epsilon ), &( inp->zyg.times ) ) )
+            error( "CompileSchedule: division within epsilon of %g! %g %g ", epsilon, transition, durations[i] );
+        entries = InsertTList( &( inp->zyg ), entries, transition + epsilon, PROPAGATE );
+    }
+    /* add bias times */
+    for( i = 0; i < biastimes.size; i++ ) {
+        entries = InsertTList( &( inp->zyg ), entries, biastimes.array[i], ADD_BIAS | PROPAGATE );
+    }
+    /* tabulated times */
+    tabtimes = inp->sco.facts.tt[genindex].ptr.times;
+    for( i = 0; i < tabtimes.size; i++ ) {
+        entries = InsertTList( &( inp->zyg ), entries, tabtimes.array[i], PROPAGATE );
+    }
+
+    /* now we know the number of solutions we have to calculate */
+    sched.genotype = ( char * ) calloc( MAX_RECORD, sizeof( char ) );
+    sched.genotype = strcpy( sched.genotype, genotype );
+    sched.size = CountEntries( entries );
+    sched.time = ( double * ) calloc( sched.size, sizeof( double ) );
+    sched.op = ( int * ) calloc( sched.size, sizeof( int ) );
+    sched.n = ( int * ) calloc( sched.size, sizeof( int ) );
+    sched.bias = ( DArrPtr * ) calloc( sched.size, sizeof( DArrPtr ) );
+    sched.daughter = ( int ** ) calloc( sched.size, sizeof( int * ) );
+    sched.rule = ( int * ) calloc( sched.size, sizeof( int ) );
+    current = entries;
+    for( i = 0; i < sched.size; i++ ) {
+        sched.time[i] = current->time;
+        sched.n[i] = current->n;
+        sched.op[i] = current->op;
+        current = current->next;
+    }
+    FreeTList( entries );
+
+    /* the parameters the mutant sets to zero */
+    sched.zero = CompileMutant( genotype, &( inp->zyg.defs ), &( sched.nzero ) );
+
+    for( i = 0; i < sched.size; i++ ) {
+        /* the rule at the start holds up to the next time; the derivative *
+         * functions get it from here rather than looking it up each call  */
+        sched.rule[i] = GetRule( sched.time[i], &( inp->zyg ) );
+        if( ( sched.op[i] & PROPAGATE ) && !( sched.op[i] & ( NO_OP | DIVIDE | MITOTATE ) )
+            && ( GetRule( sched.time[i + 1], &( inp->zyg ) ) != sched.rule[i] ) )
+            error( "CompileSchedule: rule changes between %g and %g", sched.time[i], sched.time[i + 1] );
+        /* the bias lives in maternal.c, we just point to it */
+        if( sched.op[i] & ADD_BIAS ) {
+            for( j = 0; j < biastimes.size; j++ )
+                if( fabs( sched.time[i] - biastimes.array[j] ) < big_epsilon )
+                    sched.bias[i] = GetBias( biastimes.array[j], genindex, &( inp->zyg ) );
+        }
+        /* lin is the lineage number of the most anterior cell of the next cell *
+         * cycle; if it's odd numbered, we push off the most anterior daughter  *
+         * by subtracting the number of genes from the daughter indices (i.e.   *
+         * we shift the solution array for the next cycle posteriorly by one    *
+         * nucleus; see the DIVIDE rule in Blastoderm)                          */
+        if( ( sched.op[i] & DIVIDE ) && !( sched.op[i] & NO_OP ) ) {
+            lin = GetStartLin( sched.time[i + 1], inp->zyg.defs, inp->zyg.lin_start, &( inp->zyg.times ) );
+            sched.daughter[i] = ( int * ) calloc( sched.n[i], sizeof( int ) );
+            for( j = 0; j < sched.n[i]; j++ ) {
+                k = j % ngenes; /* k: index of gene k in current nucleus */
+                ap = j / ngenes;        /* ap: rel. nucleus position on AP axis */
+                if( lin % 2 )
+                    sched.daughter[i][j] = 2 * ap * ngenes + k - ngenes;
+                else
+                    sched.daughter[i][j] = 2 * ap * ngenes + k;
+            }
+        }
+    }
+    return sched;
+}
+
+/**  FreeSchedule: frees what CompileSchedule allocated */
+void
+FreeSchedule( Schedule * sched ) {
+    int i;
+
+    for( i = 0; i < sched->size; i++ )
+        free( sched->daughter[i] );
+    free( sched->daughter );
+    free( sched->bias );
+    free( sched->n );
+    free( sched->op );
+    free( sched->time );
+    free( sched->genotype );
+    free( sched->zero );
+    free( sched->rule );
+}
+
+/**  InitSchedules: compiles the schedules of all genotypes in the facts 
+ *                  into inp->sco.sched; call it once the tabulated times 
+ *                  are known (after InitScoring)                         
+ */
+void
+InitSchedules( Input * inp ) {
+    int i;
+
+    inp->sco.sched = ( Schedule * ) calloc( inp->zyg.nalleles, sizeof( Schedule ) );
+    for( i = 0; i < inp->zyg.nalleles; i++ )
+        inp->sco.sched[i] = CompileSchedule( i, inp->sco.facts.facttype[i].genotype, inp );
+}
+
+/**  FreeSchedules: frees the schedules of InitSchedules */
+void
+FreeSchedules( Input * inp ) {
+    int i;
+
+    if( inp->sco.sched == NULL )
+        return;
+    for( i = 0; i < inp->zyg.nalleles; i++ )
+        FreeSchedule( &( inp->sco.sched[i] ) );
+    free( inp->sco.sched );
+    inp->sco.sched = NULL;
+}
+
+/**  GetSchedule: returns the schedule of genotype genindex from InitSched- 
+ *                ules, or, if there is none for this genotype (e.g. unfold 
+ *                with a genotype of its own), compiles one into own, which 
+ *                the caller has to free with FreeSchedule                  
+ */
+Schedule *
+GetSchedule( int genindex, char *genotype, Input * inp, Schedule * own ) {
+    if( ( inp->sco.sched != NULL ) && !strcmp( inp->sco.sched[genindex].genotype, genotype ) )
+        return &( inp->sco.sched[genindex] );
+    *own = CompileSchedule( genindex, genotype, inp );
+    return own;
+}
+
+/**  ArenaSolution: lays out a solution for sched in arena and returns it 
+ *                  with all states set to zero; array and block of the    
+ *                  arena are only reallocated if they are too small; if   
+ *                  all is 0, the states take turns in two arrays, so that 
+ *                  only the last two of them are kept (see ScoreStream)   
+ */
+NArrPtr
+ArenaSolution( SolutionArena * arena, Schedule * sched, int all ) {
+    NArrPtr solution;
+    size_t length = 0;          /* doubles needed for all states */
+    int maxn = 0;               /* size of the biggest state */
+    int i;
+
+    for( i = 0; i < sched->size; i++ ) {
+        length += sched->n[i];
+        if( sched->n[i] > maxn )
+            maxn = sched->n[i];
+    }
+    if( !all )
+        length = 2 * maxn;
+
+    if( sched->size > arena->capacity ) {
+        if( !( arena->array = ( NucState * ) realloc( arena->array, sched->size * sizeof( NucState ) ) ) )
+            error( "ArenaSolution: error allocating solution" );
+        arena->capacity = sched->size;
+        arena->grown++;
+    }
+    if( length > arena->length ) {
+        if( !( arena->block = ( double * ) realloc( arena->block, length * sizeof( double ) ) ) )
+            error( "ArenaSolution: error allocating solution" );
+        arena->length = length;
+        arena->grown++;
+    }
+    memset( arena->block, 0, length * sizeof( double ) );
+
+    solution.size = sched->size;
+    solution.array = arena->array;
+    for( length = 0, i = 0; i < sched->size; i++ ) {
+        solution.array[i].time = sched->time[i];
+        solution.array[i].state.size = sched->n[i];
+        solution.array[i].state.array = arena->block + ( all ? length : ( i % 2 ) * maxn );
+        length += sched->n[i];
+    }
+    return solution;
+}
+
+/**  FreeSolutionArena: frees the memory of an arena and empties it */
+void
+FreeSolutionArena( SolutionArena * arena ) {
+    free( arena->array );
+    free( arena->block );
+    memset( arena, 0, sizeof( SolutionArena ) );
+}
+
 /**  InitTList: initializes TList and adds first (t=0) and last 
  *              (t=gastrulation) element of Tlist.                         
  */
@@ -992,9 +1493,43 @@ Dat2NArrPtr( DataTable * table, int *maxind ) {
     return input;
 }
 
+/** CompileInterp: lays out func and slope of interp_res once for each 
+ *                 lineage index c, in the nucleus layout of c, so that   
+ *                 History and ExternalInputs need no Go_Forward or Go_-  
+ *                 Backward at all; both are linear, so mapping func +    
+ *                 slope * dt is the same as mapping func and slope       
+ */
+static void
+CompileInterp( InterpObject * interp_res, int num_genes, Zygote * zyg ) {
+    int c, k;
+    int maxind;                 /* lineage index of the interpolants */
+    int n;
+
+    maxind = GetStartLinIndex( interp_res->maxtime, &( zyg->defs ), &( zyg->times ) );
+    interp_res->ncycles = zyg->defs.full_ccycles;
+    interp_res->csize = ( int * ) calloc( interp_res->ncycles, sizeof( int ) );
+    interp_res->cfunc = ( double ** ) calloc( interp_res->ncycles, sizeof( double * ) );
+    interp_res->cslope = ( double ** ) calloc( interp_res->ncycles, sizeof( double * ) );
+
+    for( c = 0; c < interp_res->ncycles; c++ ) {
+        n = interp_res->csize[c] = Index2NNuc( c, zyg->full_nnucs ) * num_genes;
+        interp_res->cfunc[c] = ( double * ) calloc( interp_res->func.size * n, sizeof( double ) );
+        interp_res->cslope[c] = ( double * ) calloc( interp_res->slope.size * n, sizeof( double ) );
+        for( k = 0; k < interp_res->func.size; k++ ) {
+            if( c <= maxind ) { /* lower indices are later cycles */
+                Go_Forward( interp_res->cfunc[c] + k * n, interp_res->func.array[k].state.array, c, maxind, zyg, num_genes );
+                Go_Forward( interp_res->cslope[c] + k * n, interp_res->slope.array[k].state.array, c, maxind, zyg, num_genes );
+            } else {
+                Go_Backward( interp_res->cfunc[c] + k * n, interp_res->func.array[k].state.array, c, maxind, zyg, num_genes );
+                Go_Backward( interp_res->cslope[c] + k * n, interp_res->slope.array[k].state.array, c, maxind, zyg, num_genes );
+            }
+        }
+    }
+}
+
 /** DoInterp: Sets up the interpolation functions for the lineage that has most
- * nuclei, these functions will be used later in conjunction with Go_Backward to 
- * return history for particular times 
+ * nuclei, and from them the tables of CompileInterp that History and External-
+ * Inputs use to return history for particular times 
  */
 void
 DoInterp( DataTable * interp_dat, InterpObject * interp_res, int num_genes, Zygote * zyg ) {
@@ -1135,6 +1670,7 @@ DoInterp( DataTable * interp_dat, InterpObject * interp_res, int num_genes, Zygo
         gsl_spline_free( temp_spline );
     }
     FreeSolution( &Nptrfacts );
+    CompileInterp( interp_res, num_genes, zyg );
     return;
 }
 
@@ -1204,97 +1740,83 @@ FreeFactDiscons( double *fact_discons ) {
     free( fact_discons );
 }
 
-void
-History( double t, double t_size, double *yd, int n, InterpObject hist_interp_object, int ngenes, Zygote * zyg ) {
-
-    int j, k;
-    double *blug;
-    double t_interp, t_diff;
-
-    /*  printf("Going from %d to %d, time:%f time for size:%f\n",maxsize,n,t,t_size); */
-
-    blug = ( double * ) calloc( hist_interp_object.maxsize, sizeof( double ) );
-
-    k = -1;
-    do {
-        k++;
-
-    } while( ( k < hist_interp_object.slope.size ) && ( t > hist_interp_object.slope.array[k].time ) );
-    if( k == 0 )
-        t_interp = hist_interp_object.slope.array[k].time;
-    else {
+/** InterpInterval: returns the interval k of io that time t is in (the 
+ *                   last time before t, or 0 if there is none) and puts  
+ *                   t minus its start into t_diff (0 before the first     
+ *                   time, where the interpolant stays at its first value);
+ *                   the search starts from *cursor (the last interval),   
+ *                   so this is O(1) as long as t moves on steadily        
+ */
+int
+InterpInterval( InterpObject * io, double t, int *cursor, double *t_diff ) {
+    int k;
 
+    k = ( ( *cursor > 0 ) && ( *cursor < io->slope.size ) ) ? *cursor : 0;
+    while( ( k > 0 ) && !( t > io->slope.array[k].time ) )
         k--;
-        t_interp = t;
-
-    }
-
-    t_diff = t_interp - hist_interp_object.slope.array[k].time;
-
-    for( j = 0; j < hist_interp_object.maxsize; j++ ) {
-
-        blug[j] = hist_interp_object.func.array[k].state.array[j] + hist_interp_object.slope.array[k].state.array[j] * t_diff;
-
-    }
+    while( ( k + 1 < io->slope.size ) && ( t > io->slope.array[k + 1].time ) )
+        k++;
+    *cursor = k;
 
-    if( n >= hist_interp_object.maxsize ) {
-        Go_Forward( yd, blug, GetStartLinIndex( t_size, &( zyg->defs ), &( zyg->times ) ),
-                    GetStartLinIndex( hist_interp_object.maxtime, &( zyg->defs ), &( zyg->times ) ), zyg, ngenes );
-    } else
-        Go_Backward( yd, blug, GetStartLinIndex( t_size, &( zyg->defs ), &( zyg->times ) ),
-                     GetStartLinIndex( hist_interp_object.maxtime, &( zyg->defs ), &( zyg->times ) ), zyg, ngenes );
-    free( blug );
+    if( t > io->slope.array[k].time )
+        *t_diff = t - io->slope.array[k].time;
+    else
+        *t_diff = 0.;
+    return k;
+}
 
-    return;
+/** Interpolate: writes the interpolant of io at time t into yd, in the 
+ *                nucleus layout of time t_size (see InterpInterval for  
+ *                cursor)                                                
+ */
+static void
+Interpolate( double t, double t_size, double *yd, InterpObject * io, Zygote * zyg, int *cursor ) {
+    int j, k, c, n;
+    double t_diff;
+    double *func, *slope;
+
+    k = InterpInterval( io, t, cursor, &t_diff );
+    c = GetStartLinIndex( t_size, &( zyg->defs ), &( zyg->times ) );
+    n = io->csize[c];
+    func = io->cfunc[c] + k * n;
+    slope = io->cslope[c] + k * n;
+    for( j = 0; j < n; j++ )
+        yd[j] = func[j] + slope[j] * t_diff;
 }
 
+/** History: writes the history of the ngenes genes at time t into yd (n 
+ *            concentrations, in the nucleus layout of time t_size)      
+ */
 void
-ExternalInputs( double t, double t_size, double *yd, int n, InterpObject extinp_interp_object, int egenes, Zygote * zyg ) {
-
-    int j, k;
-    double *blug;
-    double t_interp, t_diff;
-
-    /*  printf("Going from %d to %d, time:%f time for size:%f\n",maxsize,n,t,t_size); */
-
-    blug = ( double * ) calloc( extinp_interp_object.maxsize, sizeof( double ) );
-
-    k = -1;
-
-    do {
-        k++;
-    } while( ( k < extinp_interp_object.slope.size ) && ( t > extinp_interp_object.slope.array[k].time ) );
-
-    if( k == 0 )
-        t_interp = extinp_interp_object.slope.array[k].time;
-    else {
-        k--;
-        t_interp = t;
-    }
-
-    t_diff = t_interp - extinp_interp_object.slope.array[k].time;
-
-    for( j = 0; j < extinp_interp_object.maxsize; j++ ) {
-        blug[j] = extinp_interp_object.func.array[k].state.array[j] + extinp_interp_object.slope.array[k].state.array[j] * t_diff;
-    }
-    if( n >= extinp_interp_object.maxsize ) {
-        Go_Forward( yd, blug, GetStartLinIndex( t_size, &( zyg->defs ), &( zyg->times ) ),
-                    GetStartLinIndex( extinp_interp_object.maxtime, &( zyg->defs ), &( zyg->times ) ), zyg, egenes );
-    } else
-        Go_Backward( yd, blug, GetStartLinIndex( t_size, &( zyg->defs ), &( zyg->times ) ),
-                     GetStartLinIndex( extinp_interp_object.maxtime, &( zyg->defs ), &( zyg->times ) ), zyg, egenes );
-    free( blug );
+History( double t, double t_size, double *yd, int n, InterpObject hist_interp_object, int ngenes, Zygote * zyg, int *cursor ) {
+    Interpolate( t, t_size, yd, &hist_interp_object, zyg, cursor );
+}
 
-    return;
+/** ExternalInputs: writes the egenes external inputs at time t into yd 
+ *                   (n concentrations, in the nucleus layout of time     
+ *                   t_size)                                              
+ */
+void
+ExternalInputs( double t, double t_size, double *yd, int n, InterpObject extinp_interp_object, int egenes, Zygote * zyg, int *cursor ) {
+    Interpolate( t, t_size, yd, &extinp_interp_object, zyg, cursor );
 }
 
 void
 FreeInterpObject( InterpObject * interp_obj ) {
+    int i;
+
     FreeSolution( ( &( interp_obj->func ) ) );
     FreeSolution( ( &( interp_obj->slope ) ) );
 
     if( interp_obj->fact_discons )
         free( interp_obj->fact_discons );
+    for( i = 0; i < interp_obj->ncycles; i++ ) {
+        free( interp_obj->cfunc[i] );
+        free( interp_obj->cslope[i] );
+    }
+    free( interp_obj->cfunc );
+    free( interp_obj->cslope );
+    free( interp_obj->csize );
 }
 
 void
@@ -1362,6 +1884,28 @@ Go_Forward( double *output, double *input, int output_ind, int input_ind, Zygote
     return;
 }
 
+/** ToGeneMajor: nucleus-major in to gene-major out (see integrate.h) */
+void
+ToGeneMajor( double *in, double *out, int ngenes, int n ) {
+    int k, ap;
+    int m = n / ngenes;
+
+    for( ap = 0; ap < m; ap++ )
+        for( k = 0; k < ngenes; k++ )
+            out[k * m + ap] = in[ap * ngenes + k];
+}
+
+/** ToNucMajor: gene-major in to nucleus-major out (see integrate.h) */
+void
+ToNucMajor( double *in, double *out, int ngenes, int n ) {
+    int k, ap;
+    int m = n / ngenes;
+
+    for( ap = 0; ap < m; ap++ )
+        for( k = 0; k < ngenes; k++ )
+            out[ap * ngenes + k] = in[k * m + ap];
+}
+
 void
 Go_Backward( double *output, double *input, int output_ind, int input_ind, Zygote * zyg, int num_genes ) {
 
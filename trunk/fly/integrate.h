@@ -10,10 +10,10 @@
  * The function Blastoderm runs the fly model and   
  * calls the appropriate solver for propagating the equations.   
  * PrintBlastoderm formats and prints the output of the Blasto-  
- * derm function and FreeSolution frees the solution allocated   
- * by Blastoderm. integrate.h also comes with a few utility      
+ * derm function and FreeSolution frees the solutions copied    
+ * from it. integrate.h also comes with a few utility      
  * functions for TLists which are linked lists used to initia-   
- * lize the time/mode table for Blastoderm.                      
+ * lize the time/mode table (the Schedule) for Blastoderm.       
  *                                                               
  * @note all right-hand-of-ODE-specific stuff is in zygotic.h    
  */
@@ -89,9 +89,39 @@ void ( *ps ) ( double *, double *, double, double, double, double, int, FILE *,
  *               It includes times when bias is added, cell division times 
  *               and times for which we have data and ends with the time   
  *               of gastrulation.                                          
+ *               If inp->ctx.sens.np > 0, it also leaves the forward sen-  
+ *               sitivities for each time of the solution in inp->ctx.sens 
+ *               (see Sensitivity in maternal.h).                          
+ *               The times and what to do at each of them come from the    
+ *               Schedule of the genotype (see InitSchedules).             
+ *               The solution lives in inp->ctx.arena: it is good until    
+ *               the next Blastoderm on the same context and must not be   
+ *               freed (copy it, e.g. with ConvertAnswer, to keep it).     
+ *               If inp->ctx.stream.eval is set, the data are scored as    
+ *               we go (see ScoreStream) and only the last state of the    
+ *               solution is left.                                         
  */
 NArrPtr Blastoderm( int genindex, char *genotype, Input * inp, FILE * slog );
 
+/**  BlastodermEnsemble: Blastoderm for all members of an ensemble (see 
+ *                       Ensemble in maternal.h) in lockstep, propagating 
+ *                       them together with Rk4Ensemble or RkckEnsemble;  
+ *                       the solution of each member is left in its arena 
+ *                       (and in solution[k], unless that is NULL); only  
+ *                       works for DvdtOrig in nucleus-major layout with  
+ *                       the Rk4 or Rkck solver, and without sensitivities
+ *                       or adjoints                                      
+ */
+void BlastodermEnsemble( int genindex, char *genotype, Ensemble * ens, NArrPtr * solution, FILE * slog );
+
+/**  BlastodermAdjoint: goes back through the solution of Blastoderm for 
+ *                      genotype genindex and adds d score / d parm for  
+ *                      the parameters in inp->ctx.adj to its grad, where
+ *                      dgdv[i] is d score / d state at solution time i  
+ *                      (NULL if the score doesn't depend on it)         
+ */
+void BlastodermAdjoint( int genindex, char *genotype, NArrPtr * solution, double **dgdv, Input * inp );
+
 //double *BlastodermJac( int genindex, char *genotype, DArrPtr tabtimes, double stephint, double accuracy, FILE * slog );
 
 /**  ConvertAnswer: little function that gets rid of bias times, division 
@@ -105,7 +135,8 @@ NArrPtr Blastoderm( int genindex, char *genotype, Input * inp, FILE * slog );
 NArrPtr ConvertAnswer( NArrPtr answer, DArrPtr tabtimes );
 
 /** FreeSolution: frees memory of the solution structure created by 
- *                 Blastoderm() or gut functions                           
+ *                 ConvertAnswer() or gut functions (not the one of Blas-  
+ *                 toderm(), which lives in the SolutionArena)             
  */
 void FreeSolution( NArrPtr * solution );
 
@@ -115,6 +146,41 @@ void FreeSolution( NArrPtr * solution );
 
 /* TList Utility Functions */
 
+/**  CompileSchedule: works out what Blastoderm has to do for genotype    
+ *                    genindex, and when (everything that does not depend 
+ *                    on the parameters)                                  
+ */
+Schedule CompileSchedule( int genindex, char *genotype, Input * inp );
+
+/**  FreeSchedule: frees what CompileSchedule allocated */
+void FreeSchedule( Schedule * sched );
+
+/**  InitSchedules: compiles the schedules of all genotypes in the facts 
+ *                  into inp->sco.sched; call it once the tabulated times 
+ *                  are known (after InitScoring)                         
+ */
+void InitSchedules( Input * inp );
+
+/**  FreeSchedules: frees the schedules of InitSchedules */
+void FreeSchedules( Input * inp );
+
+/**  GetSchedule: returns the schedule of genotype genindex from InitSched- 
+ *                ules, or, if there is none for this genotype, compiles    
+ *                one into own, which the caller has to free                
+ */
+Schedule *GetSchedule( int genindex, char *genotype, Input * inp, Schedule * own );
+
+/**  ArenaSolution: lays out a solution for sched in arena and returns it 
+ *                  with all states set to zero; array and block of the    
+ *                  arena are only reallocated if they are too small; if   
+ *                  all is 0, the states take turns in two arrays, so that 
+ *                  only the last two of them are kept (see ScoreStream)   
+ */
+NArrPtr ArenaSolution( SolutionArena * arena, Schedule * sched, int all );
+
+/**  FreeSolutionArena: frees the memory of an arena and empties it */
+void FreeSolutionArena( SolutionArena * arena );
+
 /** InitTList: initializes TList and adds first (t=0) and last 
  *              (t=gastrulation) element of Tlist.             
  */
@@ -139,8 +205,8 @@ the number of nuclei is maximum */
 NArrPtr Dat2NArrPtr( DataTable * table, int *maxind );
 
 /** DoInterp: Sets up the interpolation functions for the lineage that has most
-nuclei, these functions will be used later in conjunction with
-Go_Backward to return history for particular times */
+nuclei, and from them the tables in the layout of each lineage that History
+and ExternalInputs use to return history for particular times */
 void DoInterp( DataTable * interp_dat, InterpObject * interp_res, int num_genes, Zygote * zyg );
 
 /** SetFactDiscons: make one object from History and ExternalInputs */
@@ -151,10 +217,34 @@ void FreeFactDiscons( double *fact_discons );
 
 void Go_Forward( double *output, double *input, int output_ind, int input_ind, Zygote * zyg, int num_genes );
 void Go_Backward( double *output, double *input, int output_ind, int input_ind, Zygote * zyg, int num_genes );
-void History( double t, double t_size, double *yd, int n, InterpObject hist_interp_object, int ngenes, Zygote * zyg );
+
+/** ToGeneMajor: copies the state in, stored nucleus-major as everywhere in
+ *                the files (in[ap*ngenes + k], n = nnucs * ngenes), into
+ *                out in gene-major order (out[k*nnucs + ap])
+ */
+void ToGeneMajor( double *in, double *out, int ngenes, int n );
+
+/** ToNucMajor: the reverse of ToGeneMajor */
+void ToNucMajor( double *in, double *out, int ngenes, int n );
+
+/** History: writes the history of the ngenes genes at time t into yd (n 
+ *            concentrations, in the nucleus layout of time t_size); the  
+ *            search for the interval of t starts from *cursor, which it  
+ *            updates (see ModelContext)                                  
+ */
+void History( double t, double t_size, double *yd, int n, InterpObject hist_interp_object, int ngenes, Zygote * zyg, int *cursor );
 double *GetFactDiscons( int *sss, FactDiscons fd );
 void FreeInterpObject( InterpObject * interp_obj );
-void ExternalInputs( double t, double t_size, double *yd, int n, InterpObject extinp_interp_object, int egenes, Zygote * zyg );
+
+/** InterpInterval: returns the interval k of io that time t is in (the 
+ *                   last time before t, or 0 if there is none) and puts  
+ *                   t minus its start into t_diff (0 before the first     
+ *                   time); the search starts from *cursor, which it sets  
+ */
+int InterpInterval( InterpObject * io, double t, int *cursor, double *t_diff );
+
+/** ExternalInputs: same as History, for the egenes external inputs */
+void ExternalInputs( double t, double t_size, double *yd, int n, InterpObject extinp_interp_object, int egenes, Zygote * zyg, int *cursor );
 //void TestInterp( int num_genes, int type );
 void FreeExternalInputTemp( void );
 void FreeHistoryTemp( void );
@@ -88,7 +88,12 @@ typedef struct TheProblem {
     int full_ccycles;
 } TheProblem;
 
-/** @brief Holds the equation parameters */
+/** @brief Holds the equation parameters 
+ *
+ * All parameters live in one block (array, size doubles); R to tau point 
+ * into it in the order declared below, so copying or mutating a set of   
+ * parameters is one memcpy (see AllocParm in zygotic.c)                  
+ */
 typedef struct EqParms {
     double *R;                  /* strength of each promoter--always >= 0. */
     double *T;                  /* the genetic interconnect matrix */
@@ -98,6 +103,8 @@ typedef struct EqParms {
     double *d;                  /* spatial interaction at gastrulation--always >= 0. */
     double *lambda;             /*protein half lives--always >= 0. */
     double *tau;                /* delay times for the proteins */
+    double *array;              /* the block that R to tau point into */
+    int size;                   /* number of doubles in array */
 } EqParms;
 
 /** @brief Tweaking individual parameters or not.
@@ -132,6 +139,8 @@ typedef struct FactDiscons {
 typedef struct SolverInput {    
     double time;                
     int genindex;
+    int rule;                   /* MITOSIS or INTERPHASE: the same for the */
+                                /* whole interval (see Schedule.rule)      */
     FactDiscons all_fact_discons;
 } SolverInput;
 
@@ -293,14 +302,41 @@ typedef struct SearchSpace {
     Range **dlim;               /* limit(s) for diffusion parameter(s) */
     Range **lambdalim;          /* limits for lambda (prot. decay rate) */
     Range **taulim;             /* limits for tau (delays) */
+    double *lower;              /* all lower limits, laid out like EqParms.array */
+    double *upper;              /* all upper limits, laid out like EqParms.array */
 } SearchSpace;
 
+/** @brief What Blastoderm does for one genotype, and when.
+ *
+ * None of this depends on the parameters, so InitSchedules() compiles it
+ * once per genotype from the division, bias and tabulated times and the
+ * genotype string, and each Blastoderm() run then mutates the parameters
+ * and does op[i] at time[i] on n[i] concentrations.
+ */
+typedef struct Schedule {
+    char *genotype;             /* the genotype it is for */
+    int size;                   /* number of solution times */
+    double *time;               /* the solution times */
+    int *op;                    /* what to do at each time (ADD_BIAS etc.) */
+    int *n;                     /* number of concentrations at each time */
+    DArrPtr *bias;              /* bias set at each time (size 0 for none) */
+    int **daughter;             /* DIVIDE: index of the anterior daughter of */
+                                /* each concentration, NULL for other ops  */
+    int *zero;                  /* parameters the genotype sets to zero, as */
+    int nzero;                  /* indices into EqParms.array (see Mutate) */
+    int *rule;                  /* MITOSIS or INTERPHASE from each time to */
+                                /* the next; never changes in between      */
+} Schedule;
+
 /** @brief This is returned by InitScoring function */
 typedef struct Scoring {        
     SearchSpace *searchspace;
     Weights weights;
     Facts facts;
     int method;
+    Schedule *sched;            /* one per genotype, see InitSchedules */
+    double bound;               /* reject a run as soon as score + penalty */
+                                /* are over this (0: never, see Score) */
 } Scoring;
 
 /** @brief Interpolation object */
@@ -311,6 +347,10 @@ typedef struct InterpObject {
     NArrPtr slope;
     int maxsize;
     double maxtime;
+    int ncycles;                /* one table per lineage index c (see  */
+    int *csize;                 /* DoInterp): entries in the layout of c */
+    double **cfunc;             /* func and slope at each time, already in */
+    double **cslope;            /* the layout of c: [c][k * csize[c] + j] */
 } InterpObject;
 
 /** @brief Stepsize, accuracy, solver log file pointer and input file name */
@@ -350,6 +390,198 @@ typedef struct Zygote {
     int ndp;
 } Zygote;
 
+/** @brief Threads that share one derivative by blocks of nuclei (zygotic.c) */
+typedef struct NucTeam NucTeam;
+
+/** @brief Scratch arrays for the derivative and Jacobian functions.
+ *
+ * Sized once for the maximum number of nuclei (see InitWorkspace() in
+ * zygotic.c) and reused by every call to DvdtOrig, DvdtDelay, Dvdt_sqrt,
+ * DvdtGeneMajor and JacobnOrig, so that the inner loop of the model never
+ * allocates. It also caches the quantities that only change with the
+ * cleavage cycle (D and bcd). Together with the ModelContext below this
+ * is all the mutable state of a model run.
+ */
+typedef struct Workspace {
+    double *vinput;             /* u for every gene in every nucleus */
+    double *bot2;               /* intermediate stuff for g(u): 1 + u^2 ... */
+    double *bot;                /* ... and sqrt(1 + u^2) or exp(-2u) */
+    int *l_rule;                /* propagation rule for each gene */
+    double *v_ext;              /* external input concentrations at time t */
+    double **v_extd;            /* delayed external inputs, one row per gene */
+    double *soa_in;             /* gene-major copies of the state, used */
+    double *soa_out;            /* if the layout is GeneMajor (zygotic.h) */
+    double *D;                  /* diffusion coefficients for this cycle */
+    DArrPtr bcd;                /* bicoid gradient for this cycle */
+    int num_nucs;               /* nuclei of the cycle D and bcd are for */
+    int size;                   /* length of vinput, bot2, bot and soa_* */
+    int ext_size;               /* length of v_ext and of each v_extd row */
+    double **regbase;           /* h + m * bcd + E . v_ext at the start of */
+    int *regvalid;              /* each interval of the external inputs, */
+    int nregbase;               /* and its slope (see RegBase in zygotic.c) */
+    NucTeam *team;              /* started when first needed (see rhsthreads) */
+    size_t bytes;               /* total bytes held by the workspace */
+} Workspace;
+
+/** @brief Tables kept between the steps of a Bulirsch-Stoer solver 
+ * (bsstep for BuSt and stifbs for BaDe, see solvers.c) 
+ */
+typedef struct ExtrapTables {
+    double old_accuracy;        /* accuracy the tables were made for */
+    double tnew;                /* start time of the next step */
+    int nold;                   /* size of the system (stifbs only) */
+    double *a;                  /* work coefficients and correction factors */
+    double **alf;               /* (alpha) for Deuflhard's error estimation */
+    int kmax;                   /* used for finding kopt */
+    int kopt;                   /* optimal row number for convergence */
+    int first;                  /* is this the first try for a given step? */
+} ExtrapTables;
+
+/** @brief Block-tridiagonal preconditioner of the Krylov solver 
+ * (see PrecondKrylov in solvers.c); allocated for n equations 
+ */
+typedef struct BlockPrecond {
+    double *jac;                /* Jacobian in band storage ... */
+    double **cols;              /* ... and pointers to its columns */
+    double *blocks;             /* LU factors of the diagonal blocks */
+    int *pivot;                 /* their row pivots */
+    double *coupl;              /* -gamma * D (the off-diagonal blocks) */
+    double *work;               /* scratch for one block */
+    int n;                      /* number of equations */
+} BlockPrecond;
+
+/** @brief Which equation parameter a derivative is taken to */
+typedef enum ParmType {
+    ParmR,
+    ParmT,
+    ParmE,
+    Parmm,
+    Parmh,
+    Parmd,
+    Parmlambda,
+    Parmtau,
+} ParmType;
+
+/** @brief One parameter of the forward sensitivities or of the adjoint
+ * gradient: element [k] of R,
+ * m, h, d, lambda or tau, or element [k * ngenes (or egenes) + j] of T
+ * (or E)
+ */
+typedef struct SensParm {
+    ParmType type;
+    int k;                      /* gene */
+    int j;                      /* regulator (T and E only) */
+} SensParm;
+
+/** @brief Forward sensitivities ds/dp of a model run (see DvdpOrig).
+ *
+ * If np > 0, Blastoderm propagates the sensitivities to the parameters
+ * in parm along with the state (using CVODES in the Band and Krylov
+ * solvers) and leaves them in s, one array per time of the solution,
+ * each holding np arrays of the size of the state, parameter by parameter.
+ */
+typedef struct Sensitivity {
+    int np;                     /* number of parameters (0: none) */
+    SensParm *parm;             /* the parameters (not owned) */
+    int *live;                  /* 0 if the mutant fixes the parameter */
+    double **s;                 /* ds/dp at each time of the solution */
+    int size;                   /* number of arrays in s */
+    double *sin;                /* ds/dp at the start of a PROPAGATE */
+    double *sout;               /* and at its end */
+    struct _generic_N_Vector **yS;      /* CVODES sensitivities (N_Vector *) */
+    int nyS;                    /* number of yS (0: CVODES has none) */
+    double **sp, **sdot;        /* scratch: data of yS and their derivatives */
+    double *dD;                 /* scratch: dD/dd for one d */
+} Sensitivity;
+
+/** @brief Adjoint gradient of the score of a model run (see DvdlOrig).
+ *
+ * If np > 0, BlastodermAdjoint goes back through the solution of Blasto-
+ * derm (undoing the ops of its Schedule), propagating d score / d state
+ * backwards in time (with CVODES, from checkpoints of the forward solu-
+ * tion) and adding d score / d parm to grad.
+ */
+typedef struct Adjoint {
+    int np;                     /* number of parameters (0: none) */
+    SensParm *parm;             /* the parameters (not owned) */
+    int *live;                  /* 0 if the mutant fixes the parameter */
+    double *grad;               /* d score / d parm, summed over genotypes */
+    void *cvode_mem;            /* CVODES memory with the checkpoints */
+    int which;                  /* index of the backward problem in there */
+    struct _generic_N_Vector *y;        /* the state (N_Vector) */
+    struct _generic_N_Vector *yB;       /* d score / d state */
+    struct _generic_N_Vector *qB;       /* d score / d parm of one PROPAGATE */
+    double *dD;                 /* scratch: dD/dd for one d */
+} Adjoint;
+
+/** @brief Memory for the solution of Blastoderm, kept between runs.
+ *
+ * The states at all times of a solution are one block, and array is the
+ * NArrPtr view of it that Blastoderm returns. Both only ever grow, so once
+ * they fit the longest Schedule a model run allocates no solution at all;
+ * the next run on the same context overwrites it (see ArenaSolution).
+ */
+typedef struct SolutionArena {
+    NucState *array;            /* the times of the solution */
+    int capacity;               /* number of NucStates in array */
+    double *block;              /* the states of all times, one after another */
+    size_t length;              /* number of doubles in block */
+    int grown;                  /* how often array or block had to grow */
+} SolutionArena;
+
+/** @brief Scoring of a model run while it goes (see EvalState in score.c).
+ *
+ * If eval is set, Blastoderm hands every state to EvalState as soon as it
+ * is final, which scores the data for its time right away, and only keeps
+ * the current and the next state instead of the whole solution. The run
+ * stops as soon as there are no more data to score, or as soon as known
+ * plus the score so far are over the bound of the Scoring.
+ */
+typedef struct ScoreStream {
+    ScoreEval *eval;            /* where the score goes (NULL: no streaming) */
+    int tindex;                 /* next time of the data to be scored */
+    double known;               /* score + penalty of the other genotypes */
+    int rejected;               /* 1 if that plus eval went over sco.bound */
+} ScoreStream;
+
+/** @brief Solver state of one model run.
+ *
+ * Everything the solvers have to remember between calls: the Bulirsch-
+ * Stoer tables, the delays and grid of past states of the delay solver 
+ * and the CVODE memory of the Band and Krylov solvers (with the forward
+ * sensitivities or the adjoint, if asked for). It is set up by InitModel-
+ * Context() in solvers.c and gets to the solvers (and to the CVODE right
+ * hand side) through the Input, so any number of Inputs with their own 
+ * ModelContext and Workspace can be run at the same time.
+ */
+typedef struct ModelContext {
+    ExtrapTables bust;          /* tables for BuSt */
+    ExtrapTables bade;          /* tables for BaDe */
+    double maxdel, mindel;      /* longest and shortest delay */
+    int numdel;                 /* number of delays (one per gene) */
+    double *delay;              /* the delays, set in SoDe */
+    int gridstart;              /* for the heuristic in DCERk32 */
+    int gridpos;                /* where you are in the grid */
+    double *tdone;              /* the grid */
+    double **vdonne;            /* states at the grid points and the */
+    double **derivv1;           /* intermediate derivatives for the */
+    double **derivv2;           /* Cash-Karp formula */
+    double **derivv3;
+    double **derivv4;
+    void *cvode_mem;            /* memory for CVODE to use */
+    int cvode_lsolver;          /* its linear solver (see CanReuseSolver) */
+    struct _generic_N_Vector *vars;     /* current state for CVODE (N_Vector) */
+    int neq;                    /* number of equations (length of vars) */
+    SolverInput *si;            /* passed on by the CVODE right hand side */
+    BlockPrecond kry;           /* preconditioner for Krylov */
+    Sensitivity sens;           /* forward sensitivities, if any */
+    Adjoint adj;                /* adjoint gradient, if any */
+    SolutionArena arena;        /* the solution of the last Blastoderm */
+    ScoreStream stream;         /* scoring as Blastoderm goes, if any */
+    int hiscursor;              /* last interval of History and of */
+    int extcursor;              /* ExternalInputs, where they look first */
+} ModelContext;
+
 /** @brief The whole input, and nothing but the input.
  *
  * Contains pointers to all other relevant structures with data taken from 
@@ -365,8 +597,37 @@ typedef struct Input {
     PArrPtr tra;
     //DistParms dis;
     EqParms lparm;
+    Workspace wsp;
+    ModelContext ctx;
 } Input;
 
+/** @brief Several parameter sets run in lockstep (see BlastodermEnsemble).
+ *
+ * Each member is a whole Input with its own parameters, Workspace and
+ * ModelContext; the rest of it is shared. The solvers see the states of
+ * all members as one interleaved array, element i of member k at i * size
+ * + k, so that every loop of DvdtEnsemble and of the ensemble solvers runs
+ * over the members innermost and with unit stride, i.e. in SIMD (see
+ * VecEnsembleDot and VecEnsembleRate in vecLib.h). The
+ * scratch arrays are sized once for capacity members and the maximum
+ * number of nuclei, like those of the Workspace.
+ */
+typedef struct Ensemble {
+    int size;                   /* members in the current run ... */
+    int capacity;               /* ... and at most */
+    Input **member;             /* the members of the current run */
+    double *T;                  /* their T, R, lambda and D for this */
+    double *R;                  /* cycle, interleaved like the state; */
+    double *lambda;             /* R comes with the rule and 1/2 of g(u) */
+    double *D;
+    double *u;                  /* interleaved u, ... */
+    double *bot2;               /* ... 1 + u^2 ... */
+    double *bot;                /* ... and g(u) */
+    double *vin;                /* the interleaved states of the solver */
+    double *vout;
+    int length;                 /* doubles in u, bot2, bot, vin and vout */
+} Ensemble;
+
 
 /*** GLOBALS ** ************************************************************/
 
@@ -30,15 +30,16 @@
 
 /* *Constants *************************************************************/
 
-const char *OPTS = ":a:Df:g:Ghi:m:opqr:s:vx:";  /* command line option string */
+const char *OPTS = ":a:dDf:g:Ghi:j:Jk:K:m:opqr:s:vx:";  /* command line option string */
 
 
 /*** Help, usage and version messages **************************************/
 
 static const char usage[] =
-    "Usage: printscore [-a <accuracy>] [-D] [-f <float_prec>] [-g <g(u)>] [-G]\n"
-    "                  [-h] [-i <stepsize>] [-m <score_method>] [-o] [-p] \n"
-    "                  [-s <solver>] [-v] [-x <sect_title>]\n" 
+    "Usage: printscore [-a <accuracy>] [-d] [-D] [-f <float_prec>] [-g <g(u)>] [-G]\n"
+    "                  [-h] [-i <stepsize>] [-j <threads>] [-J] [-k <threads>]\n"
+    "                  [-K <nuclei>] [-m <score_method>] [-o] [-p] [-s <solver>] [-v]\n"
+    "                  [-x <sect_title>]\n" 
     "                  <datafile>\n";
 
 static const char help[] =
@@ -47,6 +48,8 @@ static const char help[] =
     "  <datafile>          data file for which we evaluate score and RMS\n\n"
     "Options:\n"
     "  -a <accuracy>       solver accuracy for adaptive stepsize ODE solvers\n"
+    "  -d                  prints the gradient of the score to the tweaked parameters\n"
+    "                      (by adjoints, needs -g and -s bnd or -s K)\n"
     "  -D                  debugging mode, prints all kinds of debugging info\n"
     "  -f <float_prec>     float precision of output is <float_prec>\n"
     "  -g <g(u)>           chooses g(u): e = exp, h = hvs, s = sqrt, t = tanh\n"
@@ -54,6 +57,10 @@ static const char help[] =
     "  -h                  prints this help message\n"
     "  -m <score_method>   w = wls, o=ols score calculation method\n"
     "  -i <stepsize>       sets ODE solver stepsize (in minutes)\n"
+    "  -j <threads>        score up to <threads> genotypes in parallel\n"
+    "  -J                  use the analytic Jacobian with the Band solver\n"
+    "  -k <threads>        share each derivative out over <threads> threads\n"
+    "  -K <nuclei>         with at least <nuclei> nuclei each (default 256)\n"
     "  -o                  use oldstyle cell division times (3 div only)\n"
     "  -p                  prints penalty in addition to score and RMS\n"
     "  -s <solver>         choose ODE solver\n"
@@ -100,6 +107,7 @@ main( int argc, char **argv ) {
     int penaltyflag = 0;        /* flag for printing penalty */
     int rmsflag = 1;            /* flag for printing root mean square */
     int gutflag = 0;            /* flag for root square diff guts */
+    int gradflag = 0;           /* flag for printing the gradient */
 
     double stepsize = 1.;       /* stepsize for solver */
     double accuracy = 0.001;    /* accuracy for solver */
@@ -126,6 +134,11 @@ main( int argc, char **argv ) {
     int ndp = 0;                /* number of datapoints */
     struct rusage begin, end;   /*        structs for measuring time */
 
+    SensParm *sp;               /* tweaked parameters for the gradient */
+    int np;
+    char regulator[MAX_RECORD]; /* [j] of T and E */
+    static const char *parmname[] = { "R", "T", "E", "m", "h", "d", "lambda", "tau" };
+
     Input inp;
     ScoreOutput out;
 
@@ -133,6 +146,7 @@ main( int argc, char **argv ) {
     out.penalty = 0;
     out.size_resid_arr = 0;
     out.jacobian = NULL;
+    out.gradient = NULL;
     out.residuals = NULL;
 
     /* the following lines define a pointers to:                               */
@@ -171,6 +185,9 @@ main( int argc, char **argv ) {
             if( accuracy <= 0 )
                 error( "fly_sa: accuracy (%g) is too small", accuracy );
             break;
+        case 'd':              /* -d prints the gradient by adjoints */
+            gradflag = 1;
+            break;
         case 'D':              /* -D runs in debugging mode */
             debug = 1;
             break;
@@ -212,6 +229,24 @@ main( int argc, char **argv ) {
             if( stepsize > MAX_STEPSIZE )
                 error( "printscore: stepsize %g too large (max. is %g)", stepsize, MAX_STEPSIZE );
             break;
+        case 'J':              /* -J gives the Band solver the analytic Jacobian */
+            bandjac = 1;
+            break;
+        case 'k':              /* -k sets the threads per derivative (big embryos) */
+            rhsthreads = atoi( optarg );
+            if( rhsthreads < 1 )
+                error( "printscore: need at least one thread (hint: check your -k)" );
+            break;
+        case 'K':              /* -K sets the smallest block of nuclei per thread */
+            rhsblock = atoi( optarg );
+            if( rhsblock < 1 )
+                error( "printscore: need at least one nucleus per block (hint: check your -K)" );
+            break;
+        case 'j':              /* -j sets the number of scoring threads */
+            nthreads = atoi( optarg );
+            if( nthreads < 1 )
+                error( "printscore: need at least one thread (hint: check your -j)" );
+            break;
         case 'm':              /* -m sets the score method: w for wls, o for ols */
             if( !( strcmp( optarg, "w" ) ) )
                 method = 0;
@@ -253,14 +288,18 @@ main( int argc, char **argv ) {
                 ps = Rkck;
             else if( !( strcmp( optarg, "rf" ) ) )
                 ps = Rkf;
+            else if( !( strcmp( optarg, "imex" ) ) )
+                ps = Imex;
             else if( !( strcmp( optarg, "sd" ) ) )
                 ps = SoDe;
             else if( !( strcmp( optarg, "kr" ) ) )
                 ps = Band;
             else if( !( strcmp( optarg, "bnd" ) ) )
                 ps = Band;
+            else if( !( strcmp( optarg, "K" ) ) )
+                ps = Krylov;
             else
-                error( "printscore: bad solver (%s), use: a,bd,bs,e,h,kr,mi,me,r{2,4,ck,f}", optarg );
+                error( "printscore: bad solver (%s), use: a,bd,bs,e,h,kr,K,mi,me,r{2,4,ck,f},imex", optarg );
             break;
         case 'v':              /* -v prints version number */
             //fprintf(stderr, verstring, *argv, VERS, USR, MACHINE, COMPILER, FLAGS, __DATE__, __TIME__);
@@ -331,6 +370,7 @@ main( int argc, char **argv ) {
     inp.his = InitHistory( fp, &inp );  //It fills the polations vector
     //printf("...ok!\nInitExtinp...");
     inp.ext = InitExternalInputs( fp, &inp );
+    InitSchedules( &inp );      /* what Blastoderm does when, per genotype */
     //printf("...ok!\nInitStepsize...");
     inp.ste = InitStepsize( stepsize, accuracy, slog, infile );
     // read the list of parameters to be tweaked
@@ -407,6 +447,25 @@ main( int argc, char **argv ) {
         printf( format, rms );
     }
     printf( "\n" );
+    if( gradflag ) {            /* in case of -d, the gradient of chisq (+ penalty) */
+        sp = TweakSensParms( &( inp.twe ), inp.zyg.defs, &np );
+        inp.ctx.adj.parm = sp;
+        inp.ctx.adj.np = np;
+        Score( &inp, &out, GRADIENT );
+        inp.ctx.adj.np = 0;
+        inp.ctx.adj.parm = NULL;
+        if( ( out.score == FORBIDDEN_MOVE ) || ( out.penalty == FORBIDDEN_MOVE ) )
+            error( "printscore: no gradient, the parameters are out of the search space" );
+        sprintf( format, " d chisq / d %%s[%%d]%%s = %%.%sf\n", precision );
+        for( i = 0; i < np; i++ ) {
+            if( ( sp[i].type == ParmT ) || ( sp[i].type == ParmE ) )
+                sprintf( regulator, "[%d]", sp[i].j );
+            else
+                regulator[0] = '\0';
+            printf( format, parmname[sp[i].type], sp[i].k, regulator, out.gradient[i] );
+        }
+        free( sp );
+    }
     /* clean up before you go home... */
     getrusage( RUSAGE_SELF, &end );     /* get end time */
     printf( "# Printscore ran for %.13f seconds\n", tvsub( end, begin ) );
@@ -453,6 +512,8 @@ main( int argc, char **argv ) {
     free( inp.sco.searchspace->lambdalim );
     free( inp.sco.searchspace->taulim );
     free( inp.sco.searchspace->pen_vec );
+    free( inp.sco.searchspace->lower );
+    free( inp.sco.searchspace->upper );
     free( inp.sco.searchspace );
 
     free( inp.zyg.defs.egene_ids );
@@ -461,14 +522,7 @@ main( int argc, char **argv ) {
     free( inp.zyg.full_nnucs );
     free( inp.zyg.full_lin_start );
     free( inp.zyg.lin_start );
-    free( inp.zyg.parm.E );
-    free( inp.zyg.parm.R );
-    free( inp.zyg.parm.T );
-    free( inp.zyg.parm.d );
-    free( inp.zyg.parm.h );
-    free( inp.zyg.parm.lambda );
-    free( inp.zyg.parm.m );
-    free( inp.zyg.parm.tau );
+    FreeMutant( inp.zyg.parm );
 
     for( i = 0; i < inp.zyg.nalleles; i++ ) {
         free( inp.zyg.bias.bt[i].genotype );
@@ -503,12 +557,16 @@ main( int argc, char **argv ) {
     FreeMutant( inp.lparm );
     FreeHistory( inp.zyg.nalleles, inp.his );
     FreeExternalInputs( inp.zyg.nalleles, inp.ext );
+    FreeSchedules( &inp );
     FreeZygote(  );
+    FreeWorkspace( &( inp.wsp ) );
+    FreeModelContext( &( inp.ctx ) );
 
     free( precision );
     free( format );
     free( section_title );
     free( out.residuals );
+    free( out.gradient );
     if( debug )
         free( slogfile );
 
@@ -19,11 +19,14 @@
 #include <stdio.h>
 #include <ctype.h>
 #include <string.h>
+#include <pthread.h>            /* for scoring genotypes in parallel */
+#include <sys/time.h>           /* for timing Score() */
 
 #include "score.h"              /* obviously */
 #include "integrate.h"          /* for blastoderm and EPSILON and stuff */
 #include "fly_io.h"             /* i/o of parameters and data */
 #include "solvers.h"            /* for compare() */
+#include "zygotic.h"            /* for workspaces and mutant parameters */
 
 #include "ioTools.h"
 
@@ -47,6 +50,23 @@ static NArrPtr resComp2;
 
 static int resC;                /* do we compute the residuals? */
 static int nbScore;             /* number of times we ran score */
+static int nbAborted;           /* how many of those went over sco.bound */
+static long long score_usec;    /* wallclock microseconds spent in those */
+
+/* one genotype of a threaded Score(): every thread gets its own copy of   *
+ * the Input with its own mutant parameters, derivative workspace and      *
+ * solver context; the copies are kept between calls so that nothing is    *
+ * allocated per score                                                     */
+typedef struct ScoreJob {
+    int genindex;               /* which genotype */
+    Input inp;                  /* private copy of the Input */
+    ScoreEval eval;             /* what EvalState() made of it */
+    double penalty;             /* penalty of the parameters */
+    int rejected;               /* 1 if it went over inp.sco.bound */
+} ScoreJob;
+
+static ScoreJob *jobs = NULL;   /* one job per genotype */
+static int njobs = 0;
 
 //the different possible type of objective functions YF
 static const int LSE = 0;
@@ -499,39 +519,127 @@ InitStepsize( double step, double acc, FILE * slog, char *infile ) {
 
 /*** REAL SCORING CODE HERE ************************************************/
 
-/** Score: as the name says, score runs the simulation, gets a solution 
- *          and then compares it to the data using the Eval least squares  
- *          function                                                       
- *   NOTE:  both InitZygote and InitScoring have to be called first!       
+/** ScoreGenotype: runs the model for a single genotype and scores it as 
+ *                  it goes; this is the start routine of the threads in   
+ *                  Score()                                                
  */
-void
-Score( Input * inp, ScoreOutput * out, int jacobian ) {
-    //name of the output dir
-    //extern char *outname;
-    ScoreEval eval;
-    int i, j, ii;
-    double totalscore = 0;
-    // file pointer
-    //FILE *fp;
-    // name of debug full filename (with path)
-    char *debugfile = NULL;
-    // stores the Solution from Blastoderm
-    NArrPtr answer;
+static void *
+ScoreGenotype( void *arg ) {
+    ScoreJob *job = ( ScoreJob * ) arg;
+
+    StartEvalStream( &( job->eval ), job->genindex, job->penalty, &( job->inp ) );
+    Blastoderm( job->genindex, job->inp.sco.facts.facttype[job->genindex].genotype, &( job->inp ), job->inp.ste.slogptr );
+    job->rejected = EndEvalStream( job->genindex, &( job->inp ) );
+    return NULL;
+}
 
-    // summed squared differences
+/** ScoreThreaded: runs Blastoderm and Eval for all genotypes, nthreads at 
+ *                  a time, and sums up chisq and residuals in genotype    
+ *                  order, so that the result is the same to the last bit  
+ *                  as the serial loop in Score(); eval gets the ScoreEval 
+ *                  of the last genotype (residuals already freed); re-    
+ *                  turns FORBIDDEN_MOVE if a genotype went over the bound 
+ *                  on its own (with penalty)                              
+ */
+static double
+ScoreThreaded( Input * inp, ScoreOutput * out, ScoreEval * eval, double penalty ) {
+    int i, j, first, last;
     double chisq = 0;
+    pthread_t *threads;
+    EqParms lparm;
+    Workspace wsp;
+    ModelContext ctx;
+    void ( *p_nucmajor ) ( double *, double, double *, int, SolverInput *, Input * );
+
+    /* allocate the private Inputs the first time round */
+    if( njobs != inp->zyg.nalleles ) {
+        for( i = 0; i < njobs; i++ ) {
+            FreeMutant( jobs[i].inp.lparm );
+            FreeWorkspace( &( jobs[i].inp.wsp ) );
+            FreeModelContext( &( jobs[i].inp.ctx ) );
+        }
+        njobs = inp->zyg.nalleles;
+        jobs = ( ScoreJob * ) realloc( jobs, njobs * sizeof( ScoreJob ) );
+        for( i = 0; i < njobs; i++ ) {
+            jobs[i].inp.lparm = CopyParm( inp->zyg.parm, &( inp->zyg.defs ) );
+            jobs[i].inp.wsp = InitWorkspace( &( inp->zyg.defs ) );
+            jobs[i].inp.ctx = InitModelContext(  );
+        }
+    }
+    threads = ( pthread_t * ) calloc( njobs, sizeof( pthread_t ) );
+
+    /* the rest of the Input is shared read-only (parameters may have changed *
+     * since the last call, so we copy it every time)                         */
+    for( i = 0; i < njobs; i++ ) {
+        lparm = jobs[i].inp.lparm;
+        wsp = jobs[i].inp.wsp;
+        ctx = jobs[i].inp.ctx;
+        jobs[i].inp = *inp;
+        jobs[i].inp.lparm = lparm;
+        jobs[i].inp.wsp = wsp;
+        jobs[i].inp.ctx = ctx;
+        jobs[i].genindex = i;
+        jobs[i].penalty = penalty;
+    }
 
-    // variable for penalty
-    double penalty = 0;
+    /* Theta() sets up its tables on the first call; do that before we start */
+    Theta( 0.0, &( inp->zyg ) );
+
+    /* install the gene-major derivative here rather than in each thread */
+    p_nucmajor = p_deriv;
+    if( slayout == GeneMajor )
+        p_deriv = DvdtGeneMajor;
+
+    for( first = 0; first < njobs; first += nthreads ) {
+        last = ( first + nthreads < njobs ) ? first + nthreads : njobs;
+        for( i = first; i < last; i++ )
+            if( pthread_create( &( threads[i] ), NULL, ScoreGenotype, &( jobs[i] ) ) )
+                error( "ScoreThreaded: could not start thread for genotype %d", i );
+        for( i = first; i < last; i++ )
+            pthread_join( threads[i], NULL );
+    }
 
-    /* debugging mode: need debugging file name */
-    if( debug ) {
-        debugfile = ( char * ) calloc( MAX_RECORD, sizeof( char ) );
+    p_deriv = p_nucmajor;
+    free( threads );
+
+    /* if one of them went over the bound, so did the sum */
+    for( i = 0; i < njobs; i++ )
+        if( jobs[i].rejected ) {
+            for( j = 0; j < njobs; j++ )
+                free( jobs[j].eval.residuals );
+            eval->residuals_size = 0;
+            return FORBIDDEN_MOVE;
+        }
+
+    /* sum up in the same order as the serial loop in Score() */
+    for( i = 0; i < njobs; i++ ) {
+        *eval = jobs[i].eval;
+        chisq += eval->chisq;
+        if( i == 0 ) {
+            out->residuals = ( double * ) realloc( out->residuals, eval->residuals_size * sizeof( double ) );
+            for( j = 0; j < eval->residuals_size; j++ ) {
+                out->residuals[j] = 0;
+            }
+        }
+        for( j = 0; j < eval->residuals_size; j++ ) {
+            out->residuals[j] += eval->residuals[j];
+        }
+        free( eval->residuals );
     }
 
-    /*if( !tt_init_flag ) {          // tt_init_flag is a flag static to score.c        //REMOVE? - InitTTs is done in getFacts() function
-       InitTTs();                       // initializes tabulated times (tt)
-       } */
+    return chisq;
+}
+
+/** CheckParameters: the part of Score() before the model runs: flips the 
+ *                    signs of R and lambda, checks the search space and   
+ *                    works out the penalty; returns 1 (with a score or    
+ *                    penalty of FORBIDDEN_MOVE in out) if the move is for-
+ *                    bidden                                                
+ */
+static int
+CheckParameters( Input * inp, ScoreOutput * out, double *penalty ) {
+    int i, ii;
+    int outside;                /* 1 if a parameter is out of its limits */
 
     /* The following will be called after parms are tweaked, hence it must    *
      * check signs. If it appears cleaner, sign checking could be done by the *
@@ -543,67 +651,17 @@ Score( Input * inp, ScoreOutput * out, int jacobian ) {
         if( inp->zyg.parm.lambda[ii] < 0 )
             inp->zyg.parm.lambda[ii] = -inp->zyg.parm.lambda[ii];
     }
-    /* The following fors and ifs check the searchspace in such a way as to   *
-     * return after as few calculations as possible                           */
-    for( i = 0; i < inp->zyg.defs.ngenes; i++ ) {
-        if( inp->zyg.parm.R[i] > inp->sco.searchspace->Rlim[i]->upper ) {
-            //printf("OUT_OF_BOUND_R: %.10lf > %.10lf | %d\n", inp->zyg.parm.R[i], inp->sco.searchspace->Rlim[i]->upper, i);
-            out->score = FORBIDDEN_MOVE;
-            return;
-        }
-        if( inp->zyg.parm.R[i] < inp->sco.searchspace->Rlim[i]->lower ) {
-            //printf("OUT_OF_BOUND_R: %.10lf < %.10lf | %d\n", inp->zyg.parm.R[i], inp->sco.searchspace->Rlim[i]->lower, i);
-            out->score = FORBIDDEN_MOVE;
-            return;
-        }
-        if( inp->zyg.parm.lambda[i] > inp->sco.searchspace->lambdalim[i]->upper ) {
-            //printf("OUT_OF_BOUND_lambda: %.10lf > %.10lf | %d\n", inp->zyg.parm.lambda[i], inp->sco.searchspace->lambdalim[i]->upper, i);
-            out->score = FORBIDDEN_MOVE;
-            return;
-        }
-        if( inp->zyg.parm.lambda[i] < inp->sco.searchspace->lambdalim[i]->lower ) {
-            //printf("OUT_OF_BOUND_lambda: %.10lf < %.10lf | %d\n", inp->zyg.parm.lambda[i], inp->sco.searchspace->lambdalim[i]->lower, i);
-            out->score = FORBIDDEN_MOVE;
-            return;
-        }
-        if( inp->zyg.parm.tau[i] > inp->sco.searchspace->taulim[i]->upper ) {
-            //printf("OUT_OF_BOUND_tau>\n");
-            out->score = FORBIDDEN_MOVE;
-            return;
-        }
-        if( inp->zyg.parm.tau[i] < inp->sco.searchspace->taulim[i]->lower ) {
-            //printf("OUT_OF_BOUND_tau<\n");
-            out->score = FORBIDDEN_MOVE;
-            return;
-        }
+    /* Check the searchspace in one pass over the flat parameter block; the  *
+     * limits are laid out the same way (see FlattenLimits in fly_io.c)       */
+    outside = 0;
+    for( i = 0; i < inp->zyg.parm.size; i++ )
+        outside |= ( inp->zyg.parm.array[i] > inp->sco.searchspace->upper[i] ) |
+            ( inp->zyg.parm.array[i] < inp->sco.searchspace->lower[i] );
+    if( outside ) {
+        out->score = FORBIDDEN_MOVE;
+        return 1;
     }
-    //printf("SCR STEP2\n");
-    if( ( inp->zyg.defs.diff_schedule == 'A' ) || ( inp->zyg.defs.diff_schedule == 'C' ) ) {
-        if( inp->zyg.parm.d[0] > inp->sco.searchspace->dlim[0]->upper ) {
-            //printf("OUT_OF_BOUND_d: %.10lf > %.10lf\n", inp->zyg.parm.d[0], inp->sco.searchspace->dlim[0]->upper);
-            out->score = FORBIDDEN_MOVE;
-            return;
-        }
-        if( inp->zyg.parm.d[0] < inp->sco.searchspace->dlim[0]->lower ) {
-            //printf("OUT_OF_BOUND_d: %.10lf < %.10lf\n", inp->zyg.parm.d[0], inp->sco.searchspace->dlim[0]->lower);
-            out->score = FORBIDDEN_MOVE;
-            return;
-        }
-    } else {
-        for( i = 0; i < inp->zyg.defs.ngenes; i++ ) {
-            if( inp->zyg.parm.d[i] > inp->sco.searchspace->dlim[i]->upper ) {
-                //printf("OUT_OF_BOUND_d: %.10lf > %.10lf for i = %d\n", inp->zyg.parm.d[i], inp->sco.searchspace->dlim[i]->upper, i);
-                out->score = FORBIDDEN_MOVE;
-                return;
-            }
-            if( inp->zyg.parm.d[i] < inp->sco.searchspace->dlim[i]->lower ) {
-                //printf("OUT_OF_BOUND_d: %.10lf < %.10lf for i = %d\n", inp->zyg.parm.d[i], inp->sco.searchspace->dlim[i]->lower, i);
-                out->score = FORBIDDEN_MOVE;
-                return;
-            }
-        }
-    }
-    
+
     /* Penalty stuff below:
      * With asym limits, it is easier now to always check for limits. In case
      * we are doing partly limits, partly penalty, we still need to check for
@@ -617,52 +675,6 @@ Score( Input * inp, ScoreOutput * out, int jacobian ) {
     /* If you're using limits on contributors to u, check'em here */
     
     /*if( inp->sco.searchspace->pen_vec == NULL ) {*/
-    for( i = 0; i < inp->zyg.defs.ngenes; i++ ) {
-        for( j = 0; j < inp->zyg.defs.ngenes; j++ ) {
-            if( inp->zyg.parm.T[( i * inp->zyg.defs.ngenes ) + j] > inp->sco.searchspace->Tlim[( i * inp->zyg.defs.ngenes ) + j]->upper ) {
-                //printf("OUT_OF_BOUND_T: %.10lf > %.10lf | %d | %d\n", inp->zyg.parm.T[(i * inp->zyg.defs.ngenes) + j], inp->sco.searchspace->Tlim[(i * inp->zyg.defs.ngenes) + j]->upper, i, j);
-                out->score = FORBIDDEN_MOVE;
-                return;
-            }
-            if( inp->zyg.parm.T[( i * inp->zyg.defs.ngenes ) + j] < inp->sco.searchspace->Tlim[( i * inp->zyg.defs.ngenes ) + j]->lower ) {
-                //printf("OUT_OF_BOUND_T: %.10lf < %.10lf | %d | %d\n", inp->zyg.parm.T[(i * inp->zyg.defs.ngenes) + j], inp->sco.searchspace->Tlim[(i * inp->zyg.defs.ngenes) + j]->lower, i, j);
-                out->score = FORBIDDEN_MOVE;
-                return;
-            }
-        }
-        for( j = 0; j < inp->zyg.defs.egenes; j++ ) {
-            if( inp->zyg.parm.E[( i * inp->zyg.defs.egenes ) + j] > inp->sco.searchspace->Elim[( i * inp->zyg.defs.egenes ) + j]->upper ) {
-                //printf("OUT_OF_BOUND_E: %.10lf > %.10lf | %d | %d\n", inp->zyg.parm.E[(i * inp->zyg.defs.egenes) + j], inp->sco.searchspace->Elim[(i * inp->zyg.defs.egenes) + j]->upper, i, j);
-                out->score = FORBIDDEN_MOVE;
-                return;
-            }
-            if( inp->zyg.parm.E[( i * inp->zyg.defs.egenes ) + j] < inp->sco.searchspace->Elim[( i * inp->zyg.defs.egenes ) + j]->lower ) {
-                //printf("OUT_OF_BOUND_E: %.10lf < %.10lf | %d | %d\n", inp->zyg.parm.E[(i * inp->zyg.defs.egenes) + j], inp->sco.searchspace->Elim[(i * inp->zyg.defs.egenes) + j]->lower, i, j);
-                out->score = FORBIDDEN_MOVE;
-                return;
-            }
-        }
-        if( inp->zyg.parm.m[i] > inp->sco.searchspace->mlim[i]->upper ) {
-            //printf("OUT_OF_BOUND_m: %.10lf > %.10lf for i = %d\n", inp->zyg.parm.m[i], inp->sco.searchspace->mlim[i]->upper, i);
-            out->score = FORBIDDEN_MOVE;
-            return;
-        }
-        if( inp->zyg.parm.m[i] < inp->sco.searchspace->mlim[i]->lower ) {
-            //printf("OUT_OF_BOUND_m: %.10lf < %.10lf for i = %d\n", inp->zyg.parm.m[i], inp->sco.searchspace->mlim[i]->lower, i);
-            out->score = FORBIDDEN_MOVE;
-            return;
-        }
-        if( inp->zyg.parm.h[i] > inp->sco.searchspace->hlim[i]->upper ) {
-            //printf("OUT_OF_BOUND_h: %.10lf > %.10lf for i = %d\n", inp->zyg.parm.h[i], inp->sco.searchspace->hlim[i]->upper, i);
-            out->score = FORBIDDEN_MOVE;
-            return;
-        }
-        if( inp->zyg.parm.h[i] < inp->sco.searchspace->hlim[i]->lower ) {
-            //printf("OUT_OF_BOUND_h: %.10lf < %.10lf for i = %d\n", inp->zyg.parm.h[i], inp->sco.searchspace->hlim[i]->lower, i);
-            out->score = FORBIDDEN_MOVE;
-            return;
-        }
-    }
     out->penalty = 0;
 
     /* if you're going to calculate penalty on u, do it here */
@@ -670,57 +682,163 @@ Score( Input * inp, ScoreOutput * out, int jacobian ) {
 
     /*} else {*/
     if( inp->sco.searchspace->pen_vec != NULL ) {    
-        penalty = GetPenalty( inp, inp->sco.searchspace );
-        if( penalty == FORBIDDEN_MOVE ) {
+        *penalty = GetPenalty( inp, inp->sco.searchspace );
+        if( *penalty == FORBIDDEN_MOVE ) {
             //printf("FORBIDDEN_MOVE_Penalty\n");
             out->penalty = FORBIDDEN_MOVE;
-            return;
+            return 1;
         }
     /*if (penalty > 0) {
        printf( "PENALTY = %lg\n", penalty);
     }*/
-        out->penalty = penalty;
+        out->penalty = *penalty;
     }
-    
-    /* runs the model and sums squared differences for all genotypes */
-    for( i = 0; i < inp->zyg.nalleles; i++ ) {
-        answer = Blastoderm( i, inp->sco.facts.facttype[i].genotype, inp, inp->ste.slogptr );
-        if( debug ) {
-            sprintf( debugfile, "%s.%s.pout", inp->ste.filename, inp->sco.facts.facttype[i].genotype );
-            fp = fopen( debugfile, "w" );
-            if( !fp ) {
-                perror( "printscore" );
-                exit( 1 );
-            }
-            PrintBlastoderm( fp, answer, "debug_output", MAX_PRECISION, &( inp->zyg ) );
-            fclose( fp );
-        }
-        if( gutparms.flag )     //change this to the new Eval() format, if we want to use it
-            GutEval( &eval, &answer, i, inp );
-        else {
-            Eval( &eval, &answer, i, inp );
+    return 0;
+}
+
+/** Score: as the name says, score runs the simulation, gets a solution 
+ *          and then compares it to the data using the Eval least squares  
+ *          function; with inp->sco.bound set, runs that go over it are    
+ *          stopped early and get a score of FORBIDDEN_MOVE                
+ *   NOTE:  both InitZygote and InitScoring have to be called first!       
+ */
+void
+Score( Input * inp, ScoreOutput * out, int jacobian ) {
+    //name of the output dir
+    //extern char *outname;
+    ScoreEval eval;
+    int i, j;
+    int nres = 0;               /* residuals per column of the Jacobian */
+    double **dgdv;              /* d score / d state for the adjoint */
+    double totalscore = 0;
+    // file pointer
+    //FILE *fp;
+    // name of debug full filename (with path)
+    char *debugfile = NULL;
+    // stores the Solution from Blastoderm
+    NArrPtr answer;
+
+    // summed squared differences
+    double chisq = 0;
+
+    // variable for penalty
+    double penalty = 0;
+
+    // wallclock time of this call (for the .times file)
+    struct timeval start, end;
+
+    gettimeofday( &start, NULL );
+
+    /* debugging mode: need debugging file name */
+    if( debug ) {
+        debugfile = ( char * ) calloc( MAX_RECORD, sizeof( char ) );
+    }
+
+    /*if( !tt_init_flag ) {          // tt_init_flag is a flag static to score.c        //REMOVE? - InitTTs is done in getFacts() function
+       InitTTs();                       // initializes tabulated times (tt)
+       } */
+
+    if( CheckParameters( inp, out, &penalty ) )
+        return;
+
+    /* runs the model and sums squared differences for all genotypes; the    *
+     * genotypes are independent, so we can run them in parallel unless we   *
+     * need to write debugging or gut output for each of them (or the Jaco-   *
+     * bian, whose sensitivities live in the context of inp)                  */
+    if( ( jacobian == JACOBIAN ) && ( inp->ctx.sens.np == 0 ) )
+        error( "Score: no parameters to calculate the Jacobian for" );
+    if( ( jacobian == GRADIENT ) && ( inp->ctx.adj.np == 0 ) )
+        error( "Score: no parameters to calculate the gradient for" );
+    /* the gradient sums up over the penalty and the genotypes */
+    if( jacobian == GRADIENT ) {
+        out->gradient = ( double * ) realloc( out->gradient, inp->ctx.adj.np * sizeof( double ) );
+        for( j = 0; j < inp->ctx.adj.np; j++ ) {
+            out->gradient[j] = 0;
         }
-        chisq += eval.chisq;
-        //printf("EVAL %d = %lg\n", i, eval.chisq);
-        if( i == 0 ) {
-            out->residuals = ( double * ) realloc( out->residuals, eval.residuals_size * sizeof( double ) );
+        inp->ctx.adj.grad = out->gradient;
+        if( out->penalty > 0 )
+            GetPenaltyGradient( inp, inp->sco.searchspace, inp->ctx.adj.parm, inp->ctx.adj.np, out->gradient );
+    }
+    if( ( nthreads > 1 ) && ( inp->zyg.nalleles > 1 ) && !debug && !gutparms.flag && !jacobian ) {
+        chisq = ScoreThreaded( inp, out, &eval, penalty );
+    } else {
+        for( i = 0; i < inp->zyg.nalleles; i++ ) {
+            /* unless we need the whole solution, we score it as it comes */
+            if( !debug && !gutparms.flag && !jacobian ) {
+                StartEvalStream( &eval, i, chisq + penalty, inp );
+                Blastoderm( i, inp->sco.facts.facttype[i].genotype, inp, inp->ste.slogptr );
+                /* over the bound: the rest can only make it worse */
+                if( EndEvalStream( i, inp ) ) {
+                    free( eval.residuals );
+                    eval.residuals_size = 0;
+                    chisq = FORBIDDEN_MOVE;
+                    break;
+                }
+            } else
+                answer = Blastoderm( i, inp->sco.facts.facttype[i].genotype, inp, inp->ste.slogptr );
+            if( debug ) {
+                sprintf( debugfile, "%s.%s.pout", inp->ste.filename, inp->sco.facts.facttype[i].genotype );
+                fp = fopen( debugfile, "w" );
+                if( !fp ) {
+                    perror( "printscore" );
+                    exit( 1 );
+                }
+                PrintBlastoderm( fp, answer, "debug_output", MAX_PRECISION, &( inp->zyg ) );
+                fclose( fp );
+            }
+            if( gutparms.flag )     //change this to the new Eval() format, if we want to use it
+                GutEval( &eval, &answer, i, inp );
+            else if( debug || jacobian ) {
+                Eval( &eval, &answer, i, inp );
+            }
+            chisq += eval.chisq;
+            //printf("EVAL %d = %lg\n", i, eval.chisq);
+            if( i == 0 ) {
+                out->residuals = ( double * ) realloc( out->residuals, eval.residuals_size * sizeof( double ) );
+                for( j = 0; j < eval.residuals_size; j++ ) {
+                    out->residuals[j] = 0;
+                }
+            }
             for( j = 0; j < eval.residuals_size; j++ ) {
-                out->residuals[j] = 0;
+                out->residuals[j] += eval.residuals[j];
+            }
+            free( eval.residuals );
+            /* the Jacobian sums up just like the residuals */
+            if( jacobian == JACOBIAN ) {
+                if( i == 0 ) {
+                    nres = eval.residuals_size;
+                    out->jacobian = ( double * ) realloc( out->jacobian, nres * inp->ctx.sens.np * sizeof( double ) );
+                    for( j = 0; j < nres * inp->ctx.sens.np; j++ ) {
+                        out->jacobian[j] = 0;
+                    }
+                }
+                EvalSens( out->jacobian, nres, &answer, i, inp );
+                for( j = 0; j < inp->ctx.sens.size; j++ ) {
+                    free( inp->ctx.sens.s[j] );
+                }
+                free( inp->ctx.sens.s );
+                inp->ctx.sens.s = NULL;
+            }
+            /* and the gradient comes from going back through the solution */
+            if( jacobian == GRADIENT ) {
+                dgdv = EvalAdjoint( &answer, i, inp );
+                BlastodermAdjoint( i, inp->sco.facts.facttype[i].genotype, &answer, dgdv, inp );
+                for( j = 0; j < answer.size; j++ ) {
+                    free( dgdv[j] );
+                }
+                free( dgdv );
             }
         }
-        for( j = 0; j < eval.residuals_size; j++ ) {
-            out->residuals[j] += eval.residuals[j];
-        }
-        free( eval.residuals );
-        for( j = 0; j < answer.size; j++ ) {
-            free( answer.array[j].state.array );
-        }
-        free( answer.array );
     }
     if ( debug ) {
         free( debugfile );
     }
-    nbScore++;
+    inp->ctx.adj.grad = NULL;
+    __sync_fetch_and_add( &nbScore, 1 );        /* MoveXBatch runs Score() in threads */
+    if( chisq == FORBIDDEN_MOVE )
+        __sync_fetch_and_add( &nbAborted, 1 );
+    gettimeofday( &end, NULL );
+    __sync_fetch_and_add( &score_usec, ( end.tv_sec - start.tv_sec ) * 1000000LL + ( end.tv_usec - start.tv_usec ) );
 
     out->score = chisq;
 //    printf("score=%lg\n", out->score);
@@ -738,6 +856,132 @@ Score( Input * inp, ScoreOutput * out, int jacobian ) {
     out->size_resid_arr = eval.residuals_size;
 }
 
+/** ScoreEnsemble: Score() (without derivatives, debugging or gut output) 
+ *                  for all members of an ensemble at once (see Ensemble in 
+ *                  maternal.h), with the result of member k in out[k]; the 
+ *                  members run through BlastodermEnsemble together and are 
+ *                  scored as they go, each against its own bound; members  
+ *                  that are forbidden or go over the bound drop out        
+ */
+void
+ScoreEnsemble( Ensemble * ens, ScoreOutput * out ) {
+    int K = ens->size;          /* number of members */
+    Input **member;             /* all members ... */
+    int *index;                 /* ... the ones still going ... */
+    int *ran;                   /* ... and the ones that ran at all */
+    ScoreEval *eval;            /* the last eval of each member */
+    double *chisq;              /* summed squared differences of each member */
+    double *penalty;            /* and its penalty */
+    int i, ii, j, k, a, n, nran;
+    struct timeval start, end;
+
+    gettimeofday( &start, NULL );
+
+    member = ( Input ** ) malloc( K * sizeof( Input * ) );
+    index = ( int * ) malloc( K * sizeof( int ) );
+    ran = ( int * ) calloc( K, sizeof( int ) );
+    eval = ( ScoreEval * ) calloc( K, sizeof( ScoreEval ) );
+    chisq = ( double * ) calloc( K, sizeof( double ) );
+    penalty = ( double * ) calloc( K, sizeof( double ) );
+    memcpy( member, ens->member, K * sizeof( Input * ) );
+
+    /* forbidden members don't run at all */
+    for( k = 0, n = 0; k < K; k++ ) {
+        if( CheckParameters( member[k], &( out[k] ), &( penalty[k] ) ) )
+            continue;
+        ran[k] = 1;
+        index[n] = k;
+        ens->member[n++] = member[k];
+    }
+    nran = n;
+
+    /* the genotypes one after the other, just like the serial loop in Score */
+    for( i = 0; ( i < member[0]->zyg.nalleles ) && ( n > 0 ); i++ ) {
+        ens->size = n;
+        for( a = 0; a < n; a++ ) {
+            k = index[a];
+            StartEvalStream( &( eval[k] ), i, chisq[k] + penalty[k], member[k] );
+        }
+        BlastodermEnsemble( i, member[0]->sco.facts.facttype[i].genotype, ens, NULL, member[0]->ste.slogptr );
+        for( a = 0, j = 0; a < n; a++ ) {
+            k = index[a];
+            /* over the bound: the rest can only make it worse */
+            if( EndEvalStream( i, member[k] ) ) {
+                free( eval[k].residuals );
+                eval[k].residuals_size = 0;
+                chisq[k] = FORBIDDEN_MOVE;
+                continue;
+            }
+            chisq[k] += eval[k].chisq;
+            if( i == 0 ) {
+                out[k].residuals = ( double * ) realloc( out[k].residuals, eval[k].residuals_size * sizeof( double ) );
+                for( ii = 0; ii < eval[k].residuals_size; ii++ ) {
+                    out[k].residuals[ii] = 0;
+                }
+            }
+            for( ii = 0; ii < eval[k].residuals_size; ii++ ) {
+                out[k].residuals[ii] += eval[k].residuals[ii];
+            }
+            free( eval[k].residuals );
+            index[j] = k;
+            ens->member[j++] = member[k];
+        }
+        n = j;
+    }
+
+    gettimeofday( &end, NULL );
+    __sync_fetch_and_add( &nbScore, nran );
+    __sync_fetch_and_add( &score_usec, ( end.tv_sec - start.tv_sec ) * 1000000LL + ( end.tv_usec - start.tv_usec ) );
+    for( k = 0; k < K; k++ ) {
+        if( !ran[k] )
+            continue;
+        if( chisq[k] == FORBIDDEN_MOVE )
+            __sync_fetch_and_add( &nbAborted, 1 );
+        out[k].score = chisq[k];
+        out[k].size_resid_arr = eval[k].residuals_size;
+    }
+
+    memcpy( ens->member, member, K * sizeof( Input * ) );
+    ens->size = K;
+    free( member );
+    free( index );
+    free( ran );
+    free( eval );
+    free( chisq );
+    free( penalty );
+}
+
+/** PrintScoreStats: writes the number of (complete) Score() calls, their 
+ *                    average wallclock time, the fraction of them that    
+ *                    went over sco.bound and the Band solver statistics   
+ *                    to the .times file                                   
+ */
+void
+PrintScoreStats( FILE * fp ) {
+    long creates, reinits;
+    int n = __sync_fetch_and_add( &nbScore, 0 );
+
+    fprintf( fp, "scores:    %d\n", n );
+    if( n > 0 ) {
+        fprintf( fp, "per score: %.6f\n", 1e-6 * __sync_fetch_and_add( &score_usec, 0 ) / n );
+        fprintf( fp, "aborted:   %.4f\n", ( double ) __sync_fetch_and_add( &nbAborted, 0 ) / n );
+    }
+    GetBandStats( &creates, &reinits );
+    if( creates + reinits > 0 ) {
+        fprintf( fp, "creates:   %ld\n", creates );        /* CVodeCreate calls */
+        fprintf( fp, "reinits:   %ld\n", reinits );        /* CVodeCreate calls saved */
+    }
+}
+
+/** GetScoreStats: returns the number of (complete) Score() calls so far 
+ *                  and how many of them went over sco.bound               
+ */
+void
+GetScoreStats( int *scores, int *aborted ) {
+    *scores = __sync_fetch_and_add( &nbScore, 0 );
+    *aborted = __sync_fetch_and_add( &nbAborted, 0 );
+}
+
 /** Eval: scores the summed squared differences between equation solution 
  *         and data. Because the times for states written to the Solution  
  *         structure are read out of the data file itself, we do not check 
@@ -828,6 +1072,185 @@ Eval( ScoreEval * eval, NArrPtr * Solution, int gindex, Input * inp ) {
     eval->residuals_size = currsize;
 }
 
+/** StartEvalStream: makes Blastoderm score genotype gindex into eval as 
+ *                    it goes (see ScoreStream in maternal.h), instead of  
+ *                    leaving the whole solution for Eval; known is what   
+ *                    the score + penalty are without this genotype; the   
+ *                    residuals are allocated here, all at once            
+ */
+void
+StartEvalStream( ScoreEval * eval, int gindex, double known, Input * inp ) {
+    DataTable *fact_tab = inp->sco.facts.facttype[gindex].ptr.facts;
+    int tindex;
+    size_t nres = 0;            /* number of data points */
+
+    for( tindex = 0; tindex < fact_tab->size; tindex++ )
+        nres += fact_tab->record[tindex].size;
+    eval->chisq = 0;
+    eval->residuals_size = 0;
+    eval->residuals = ( double * ) malloc( nres * sizeof( double ) );
+    inp->ctx.stream.eval = eval;
+    inp->ctx.stream.tindex = 0;
+    inp->ctx.stream.known = known;
+    inp->ctx.stream.rejected = 0;
+}
+
+/** EvalState: scores the data of genotype gindex for time (if any) with 
+ *              the state v, just like Eval does for the whole solution,   
+ *              and returns 1 if there are no more data to score or if     
+ *              the score went over inp->sco.bound                         
+ */
+int
+EvalState( int gindex, double time, double *v, Input * inp ) {
+    ScoreStream *stream = &( inp->ctx.stream );
+    ScoreEval *eval = stream->eval;
+    DataTable *fact_tab = inp->sco.facts.facttype[gindex].ptr.facts;
+    DataTable *weight_tab = NULL;       /* the weights, if we use them */
+    DataPoint point;
+    int vindex;
+    double difference;          /* diff btw data and model (per datapoint) */
+
+    if( inp->sco.method == 0 )
+        weight_tab = inp->sco.weights.weighttype[gindex].ptr.facts;
+
+    /* there may be more than one record for the same time */
+    for( ; ( stream->tindex < fact_tab->size ) && ( fabs( fact_tab->record[stream->tindex].time - time ) < BIG_EPSILON ); stream->tindex++ ) {
+        for( vindex = 0; vindex < fact_tab->record[stream->tindex].size; vindex++ ) {
+            point = fact_tab->record[stream->tindex].array[vindex];
+            difference = point.conc - v[point.index];
+            if( inp->sco.method == 0 ) {
+                if( weight_tab != NULL ) {
+                    difference *= weight_tab->record[stream->tindex].array[vindex].conc;
+                } else {
+                    printf( "WARNING: Error reading weights from input file - using OLS\n" );
+                    inp->sco.method = 1;
+                }
+            }
+            eval->chisq += difference * difference;
+            eval->residuals[eval->residuals_size++] = fabs( difference );
+        }
+    }
+    /* chisq only goes up, so once it's over the bound it stays there */
+    if( ( inp->sco.bound > 0 ) && ( stream->known + eval->chisq > inp->sco.bound ) )
+        stream->rejected = 1;
+    return stream->rejected || ( stream->tindex == fact_tab->size );
+}
+
+/** EndEvalStream: checks that Blastoderm got to all the data of genotype 
+ *                  gindex and stops scoring as it goes; returns 1 if it   
+ *                  stopped early because the score went over the bound    
+ */
+int
+EndEvalStream( int gindex, Input * inp ) {
+    DataTable *fact_tab = inp->sco.facts.facttype[gindex].ptr.facts;
+
+    inp->ctx.stream.eval = NULL;
+    if( inp->ctx.stream.rejected )
+        return 1;
+    if( inp->ctx.stream.tindex < fact_tab->size )
+        error( "EndEvalStream: no solution for the data of genotype %d at time %f", gindex, fact_tab->record[inp->ctx.stream.tindex].time );
+    return 0;
+}
+
+/** EvalSens: adds the derivatives of the residuals that Eval returns for 
+ *             genotype gindex to the parameters in inp->ctx.sens to jac, 
+ *             using the sensitivities that Blastoderm left there; jac    
+ *             has a column of nres residuals for each parameter; the     
+ *             residuals are |w * (data - v)|, so their derivative is     
+ *             -w * dv/dp times the sign of data - v                      
+ */
+void
+EvalSens( double *jac, int nres, NArrPtr * Solution, int gindex, Input * inp ) {
+    const double big_epsilon = BIG_EPSILON;     /* used to recognize new time */
+
+    DataTable fact_tab;         /* stores a copy of the Facts (from GenoTab) */
+    DataTable weight_tab = ( const struct DataTable ){ 0 };
+                                /* stores a copy of the Weights (from GenoTab) */
+    DataPoint point;            /* used to extract an element of DataTable */
+
+    GenoType *weighttype = inp->sco.weights.weighttype;
+    Sensitivity *sens = &( inp->ctx.sens );
+
+    int tindex;                 /* index for facts timepoints */
+    int sindex;                 /* index for Solution timepoints */
+    int vindex;                 /* index for facts datapoint */
+    int r = 0;                  /* index of the residual */
+    int p, size;
+
+    double time;                /* time for each facts timepoint */
+    double w;                   /* weight of a datapoint */
+    double *s;                  /* ds/dp for each timepoint */
+
+    fact_tab = *( inp->sco.facts.facttype[gindex].ptr.facts );
+    if( ( inp->sco.method == 0 ) && ( weighttype[gindex].ptr.facts != NULL ) )
+        weight_tab = *( weighttype[gindex].ptr.facts );
+
+    sindex = 0;
+    for( tindex = 0; tindex < fact_tab.size; tindex++ ) {
+        time = fact_tab.record[tindex].time;
+        while( fabs( time - Solution->array[sindex].time ) >= big_epsilon ) {
+            sindex++;
+        }
+        s = sens->s[sindex];
+        size = Solution->array[sindex].state.size;
+
+        for( vindex = 0; ( vindex < fact_tab.record[tindex].size ) && ( r < nres ); vindex++, r++ ) {
+            point = fact_tab.record[tindex].array[vindex];
+            w = ( inp->sco.method == 0 ) ? weight_tab.record[tindex].array[vindex].conc : 1.;
+            if( point.conc < Solution->array[sindex].state.array[point.index] )
+                w = -w;
+            for( p = 0; p < sens->np; p++ )
+                jac[p * nres + r] -= w * s[p * size + point.index];
+        }
+    }
+}
+
+/** EvalAdjoint: returns d score / d state for genotype gindex at each 
+ *                time of the Solution (NULL where there are no data),   
+ *                for BlastodermAdjoint; the score that Eval sums up is  
+ *                (w * (data - v))^2, so this is -2 w^2 (data - v)       
+ */
+double **
+EvalAdjoint( NArrPtr * Solution, int gindex, Input * inp ) {
+    const double big_epsilon = BIG_EPSILON;     /* used to recognize new time */
+
+    DataTable fact_tab;         /* stores a copy of the Facts (from GenoTab) */
+    DataTable weight_tab = ( const struct DataTable ){ 0 };
+                                /* stores a copy of the Weights (from GenoTab) */
+    DataPoint point;            /* used to extract an element of DataTable */
+
+    GenoType *weighttype = inp->sco.weights.weighttype;
+
+    int tindex;                 /* index for facts timepoints */
+    int sindex;                 /* index for Solution timepoints */
+    int vindex;                 /* index for facts datapoint */
+
+    double time;                /* time for each facts timepoint */
+    double w;                   /* weight of a datapoint */
+    double **dgdv = ( double ** ) calloc( Solution->size, sizeof( double * ) );
+
+    fact_tab = *( inp->sco.facts.facttype[gindex].ptr.facts );
+    if( ( inp->sco.method == 0 ) && ( weighttype[gindex].ptr.facts != NULL ) )
+        weight_tab = *( weighttype[gindex].ptr.facts );
+
+    sindex = 0;
+    for( tindex = 0; tindex < fact_tab.size; tindex++ ) {
+        time = fact_tab.record[tindex].time;
+        while( fabs( time - Solution->array[sindex].time ) >= big_epsilon ) {
+            sindex++;
+        }
+        if( dgdv[sindex] == NULL )
+            dgdv[sindex] = ( double * ) calloc( Solution->array[sindex].state.size, sizeof( double ) );
+
+        for( vindex = 0; vindex < fact_tab.record[tindex].size; vindex++ ) {
+            point = fact_tab.record[tindex].array[vindex];
+            w = ( weight_tab.record != NULL ) ? weight_tab.record[tindex].array[vindex].conc : 1.;
+            dgdv[sindex][point.index] -= 2. * w * w * ( point.conc - Solution->array[sindex].state.array[point.index] );
+        }
+    }
+    return dgdv;
+}
+
 /*** SCOREGUT FUNCTIONS ****************************************************/
 
 /** SetGuts: sets the gut info in score.c for printing out guts */
@@ -1025,6 +1448,7 @@ CalculateCompoundPenalty( double *param, Range **lim, int nrows, int ncols, doub
 }
 
 /** GetPenalty: calculates penalty from static limits, vmax and mmax 
+*                for the unmutated parameters in inp->zyg.parm           
 *      CAUTION: InitPenalty must be called first!                         
 */
 double
@@ -1040,7 +1464,7 @@ GetPenalty( Input * inp, SearchSpace * limits ) {
     static int donethis = 0;
     int i;
     
-    parm = &( inp->lparm );
+    parm = &( inp->zyg.parm );
     if( limits->pen_vec == NULL ) 
         return -1;
     
@@ -1089,11 +1513,66 @@ GetPenalty( Input * inp, SearchSpace * limits ) {
         penalty = exp( Lambda * penalty ) - 2.718281828459045;
     }
 
-    donethis = 1;
+    if( debug )                 /* only debug runs look at it (and they don't thread) */
+        donethis = 1;
 
     return ( penalty < 0 ) ? 0 : penalty;
 }
 
+/** GetPenaltyGradient: adds the derivative of the penalty that GetPenalty
+ *                      returns to the np parameters in sp to grad; only 
+ *                      call it if that penalty is > 0 (it's clipped at 0) 
+ */
+void
+GetPenaltyGradient( Input * inp, SearchSpace * limits, SensParm * sp, int np, double *grad ) {
+    double Lambda = limits->pen_vec[0];
+    double mmax = limits->pen_vec[1];
+    double *vmax = limits->pen_vec + 2;
+    EqParms *parm = &( inp->zyg.parm );
+    int ngenes = inp->zyg.defs.ngenes;
+    int egenes = inp->zyg.defs.egenes;
+    Range *lim;
+    double S, f, param, max;
+    int p, k, j;
+
+    S = CalculateCompoundPenalty( parm->T, limits->Tlim, ngenes, ngenes, vmax );
+    S += CalculateCompoundPenalty( parm->E, limits->Elim, ngenes, egenes, vmax + ngenes );
+    S += CalculateSinglePenalty( parm->m, limits->mlim, ngenes, mmax );
+    S += CalculateSinglePenalty( parm->h, limits->hlim, ngenes, 1 );
+    f = Lambda * exp( Lambda * S );     /* dP/dS */
+
+    for( p = 0; p < np; p++ ) {
+        k = sp[p].k;
+        j = sp[p].j;
+        switch ( sp[p].type ) {
+        case ParmT:
+            lim = limits->Tlim[k * ngenes + j];
+            param = parm->T[k * ngenes + j];
+            max = vmax[j];
+            break;
+        case ParmE:
+            lim = limits->Elim[k * egenes + j];
+            param = parm->E[k * egenes + j];
+            max = vmax[ngenes + j];
+            break;
+        case Parmm:
+            lim = limits->mlim[k];
+            param = parm->m[k];
+            max = mmax;
+            break;
+        case Parmh:
+            lim = limits->hlim[k];
+            param = parm->h[k];
+            max = 1;
+            break;
+        default:
+            continue;           /* R, d, lambda and tau aren't penalized */
+        }
+        if( fabs( lim->lower + DBL_MAX ) < EPSILON || fabs( lim->upper - DBL_MAX ) < EPSILON )
+            grad[p] += f * 2. * param * max * max;
+    }
+}
+
 //------------------------------------------------------------------------------
 // End of experimental feature
 //------------------------------------------------------------------------------
@@ -1136,7 +1615,7 @@ GetPenalty_OLD( Input * inp, SearchSpace * limits ) {
     }
 
     /* calculate penalty */
-    parm = &( inp->lparm );
+    parm = &( inp->zyg.parm );
     //printf("Argument00 = %lf\n", parm->T[0]);
     for( i = 0; i < inp->zyg.defs.ngenes; i++ ) {
         for( j = 0; j < inp->zyg.defs.ngenes; j++ ) {
@@ -57,6 +57,9 @@ typedef struct GutInfo {
     int ndigits; 
 } GutInfo;
 
+/* Number of genotypes Score() runs at once (set by -j); 0 or 1 is serial */
+int nthreads;
+
 
 /* FUNCTION PROTOTYPES *****************************************************/
 
@@ -125,13 +128,40 @@ double checkBound( TheProblem defs, SearchSpace limits );
 
 /** Score: as the name says, score runs the simulation, gets a solution 
  *          and then compares it to the data using the Eval least squares  
- *          function                                                       
+ *          function; if jacobian is JACOBIAN, it also returns the deri-   
+ *          vatives of the residuals to the parameters in inp->ctx.sens in 
+ *          out->jacobian (see EvalSens), if it is GRADIENT, the derivative
+ *          of score + penalty to the parameters in inp->ctx.adj in        
+ *          out->gradient (see EvalAdjoint); if inp->sco.bound is set, it  
+ *          stops the run as soon as score + penalty are over it and re-   
+ *          turns a score of FORBIDDEN_MOVE (not with debug, gut output,   
+ *          the Jacobian or the gradient, which need the whole run)        
  *   NOTE:  both InitZygote and InitScoring have to be called first!       
  */
 void Score( Input * inp, ScoreOutput * out, int jacobian );
 
+/** ScoreEnsemble: Score() without derivatives, debugging or gut output 
+ *                  for all members of an ensemble at once (see Ensemble in 
+ *                  maternal.h), with the result of member k in out[k]; the 
+ *                  members are propagated together by BlastodermEnsemble  
+ *                  and scored as they go, each against its own bound       
+ */
+void ScoreEnsemble( Ensemble * ens, ScoreOutput * out );
+
 double ScoreNoCheck( void );
 
+/** PrintScoreStats: writes the number of (complete) Score() calls, their 
+ *                    average wallclock time, the fraction of them that    
+ *                    went over sco.bound and the Band solver statistics   
+ *                    to the .times file                                   
+ */
+void PrintScoreStats( FILE * fp );
+
+/** GetScoreStats: returns the number of (complete) Score() calls so far 
+ *                  and how many of them went over sco.bound               
+ */
+void GetScoreStats( int *scores, int *aborted );
+
 /** Eval: scores the summed squared differences between equation solution 
  *         and data. Because the times for states written to the Solution  
  *         structure are read out of the data file itself, we do not check 
@@ -141,6 +171,39 @@ double ScoreNoCheck( void );
  */
 void Eval( ScoreEval * eval, NArrPtr * Solution, int gindex, Input * inp );
 
+/** StartEvalStream: makes Blastoderm score genotype gindex into eval as 
+ *                    it goes (see ScoreStream in maternal.h), instead of  
+ *                    leaving the whole solution for Eval; known is what   
+ *                    the score + penalty are without this genotype        
+ */
+void StartEvalStream( ScoreEval * eval, int gindex, double known, Input * inp );
+
+/** EvalState: scores the data of genotype gindex for time (if any) with 
+ *              the state v, just like Eval does for the whole solution,   
+ *              and returns 1 if there are no more data to score or if     
+ *              the score went over inp->sco.bound                         
+ */
+int EvalState( int gindex, double time, double *v, Input * inp );
+
+/** EndEvalStream: checks that Blastoderm got to all the data of genotype 
+ *                  gindex and stops scoring as it goes; returns 1 if it   
+ *                  stopped early because the score went over the bound    
+ */
+int EndEvalStream( int gindex, Input * inp );
+
+/** EvalSens: adds the derivatives of the residuals that Eval returns for 
+ *             genotype gindex to the parameters in inp->ctx.sens to jac, 
+ *             using the sensitivities that Blastoderm left there; jac    
+ *             has a column of nres residuals for each parameter          
+ */
+void EvalSens( double *jac, int nres, NArrPtr * Solution, int gindex, Input * inp );
+
+/** EvalAdjoint: returns d score / d state for genotype gindex at each 
+ *                time of the Solution (NULL where there are no data),   
+ *                for BlastodermAdjoint                                  
+ */
+double **EvalAdjoint( NArrPtr * Solution, int gindex, Input * inp );
+
 /*** Scoregut functions */
 
 /** SetGuts: sets the gut info in score.c for printing out guts */
@@ -167,10 +230,17 @@ DArrPtr GetTTimes( char *genotype );
 SearchSpace *GetLimits( Input * inp );
 
     /** GetPenalty: calculates penalty from static limits, vmax and mmax 
+ *                for the unmutated parameters in inp->zyg.parm           
  *      CAUTION: InitPenalty must be called first!                         
  */
 double GetPenalty( Input * inp, SearchSpace * limits );
 
+/** GetPenaltyGradient: adds the derivative of the penalty that GetPenalty
+ *                      returns to the np parameters in sp to grad; only 
+ *                      call it if that penalty is > 0 (it's clipped at 0) 
+ */
+void GetPenaltyGradient( Input * inp, SearchSpace * limits, SensParm * sp, int np, double *grad );
+
 double GetCurPenalty( void );
 
 /* A function for converting penalty to explicit limits */
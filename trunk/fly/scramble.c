@@ -46,6 +46,7 @@
 #include <error.h>
 #include <maternal.h>           /* for defs */
 #include <score.h>              /* for limits */
+#include <solvers.h>            /* for FreeModelContext */
 #include <zygotic.h>            /* for EqParms */
 #include <../util/random.h>
 
@@ -295,6 +296,8 @@ main( int argc, char **argv ) {
 
     /* clean up */
     FreeZygote(  );
+    FreeWorkspace( &( inp.wsp ) );
+    FreeModelContext( &( inp.ctx ) );
 
     free( section );
 
@@ -338,6 +341,8 @@ main( int argc, char **argv ) {
     free( inp.sco.searchspace->dlim );
     free( inp.sco.searchspace->lambdalim );
     free( inp.sco.searchspace->taulim );
+    free( inp.sco.searchspace->lower );
+    free( inp.sco.searchspace->upper );
 
     free( inp.sco.searchspace );
 
@@ -347,14 +352,7 @@ main( int argc, char **argv ) {
     free( inp.zyg.full_nnucs );
     free( inp.zyg.full_lin_start );
     free( inp.zyg.lin_start );
-    free( inp.zyg.parm.E );
-    free( inp.zyg.parm.R );
-    free( inp.zyg.parm.T );
-    free( inp.zyg.parm.d );
-    free( inp.zyg.parm.h );
-    free( inp.zyg.parm.lambda );
-    free( inp.zyg.parm.m );
-    free( inp.zyg.parm.tau );
+    FreeMutant( inp.zyg.parm );
 
     for( i = 0; i < inp.zyg.nalleles; i++ ) {
         free( inp.zyg.bias.bt[i].genotype );
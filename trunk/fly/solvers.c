@@ -37,8 +37,8 @@
  *  - tout      time at end                                      
  *  - stephint  suggested stepsize for fixed stepsize solvers;    
  *              see extensive comment below; the embedded Rk     
- *              solvers (Rkck, Rkf) take stephint as their ini-  
- *              tial stepsize                                    
+ *              solvers (Rkck, Rkf, Imex) take stephint as their 
+ *              initial stepsize                                 
  *  - accuracy  accuracy for adaptive stepsize solvers; accuracy 
  *              is always relative, i.e. 0.1 means 10% of the    
  *              actual v we've evaluated                         
@@ -116,53 +116,72 @@
 
 //#include "fly_opt.h"
 
-/*** STATIC VARIABLES AND MACROS *******************************************/
+/*** STATIC FUNCTIONS ******************************************************/
 
-double *d;                      /* D's used for Neville extrapolation in BuSt() */
-double *hpoints;                /* stepsizes h (=H/n) which we try in BuSt() */
-double maxdel, mindel;
-int numdel;                     /* delay parameters used by DCERk32, y_delayed */
-int gridstart;                  /* for the heuristic */
-double *delay;                  /* static array set in SoDe, used by DCERk32 */
-int gridpos;                    /* where you are in the grid */
-double *tdone;                  /* the grid */
-double **derivv1;               /* intermediate derivatives for the Cash-Karp formula */
-double **derivv2;
-double **derivv3;
-double **derivv4;
-double **vdonne;
+/* three helpers used in various solvers below; all solver state lives in  *
+ * the ModelContext of the Input (see maternal.h), so that the solvers are *
+ * reentrant and several models can be integrated at the same time         */
 
-/* three macros used in various solvers below */
-
-double dqrarg;
-
-#define DSQR(a) ((dqrarg=(a)) == 0.0 ? 0.0 : dqrarg*dqrarg)
-
-static double dmaxarg1, dmaxarg2;
-#define DMAX(a,b) (dmaxarg1 = (a), dmaxarg2 = (b), (dmaxarg1) > \
-(dmaxarg2) ?  (dmaxarg1) : (dmaxarg2))
-
-static double dminarg1, dminarg2;
-#define DMIN(a,b) (dminarg1 = (a), dminarg2 = (b), (dminarg1) < \
-(dminarg2) ?  (dminarg1) : (dminarg2))
-
-static Input *inp;
+static inline double
+DSQR( double a ) {
+    return ( a == 0.0 ) ? 0.0 : a * a;
+}
 
-static SolverInput *si;
+static inline double
+DMAX( double a, double b ) {
+    return ( a > b ) ? a : b;
+}
 
-/*** Krylov solver variables added by Anton Crombach, October 2010 *********/
+static inline double
+DMIN( double a, double b ) {
+    return ( a < b ) ? a : b;
+}
 
-/* extra data needed to be shared among different functions */
-//static ExtraData edata = NULL;
+/* Band solver statistics for the .times file; Band() may run in several  *
+ * threads, so these only get touched by atomic adds                       */
+static long band_creates = 0;   /* number of CVodeCreate calls */
+static long band_reinits = 0;   /* number of CVodeReInit calls (creates saved) */
 
-/* memory for the solver to use */
-static void *cvode_mem = NULL;
-/* memory that holds the current state of the system */
-static N_Vector vars = NULL;
-/* number of equations (is also length of `vars') */
-static int neq = -1;
+/*** MODEL CONTEXT *********************************************************/
 
+/** InitModelContext: returns an empty solver context, to be stored in the 
+ *                     Input next to its Workspace; the solvers allocate   
+ *                     what they need in there as they go                  
+ */
+ModelContext
+InitModelContext( void ) {
+    ModelContext ctx;
+
+    memset( &ctx, 0, sizeof( ModelContext ) );
+    ctx.bust.old_accuracy = ctx.bade.old_accuracy = -1.0;
+    ctx.bust.nold = ctx.bade.nold = -1;
+    ctx.bust.first = ctx.bade.first = 1;
+    ctx.gridpos = -1;
+    ctx.neq = -1;
+
+    return ctx;
+}
 
+/** FreeModelContext: frees whatever the solvers left in the context */
+void
+FreeModelContext( ModelContext * ctx ) {
+    ExtrapTables *xt[2] = { &( ctx->bust ), &( ctx->bade ) };
+    int i, k;
+
+    for( i = 0; i < 2; i++ ) {
+        if( xt[i]->alf ) {
+            for( k = 0; xt[i]->alf[k]; k++ )
+                free( xt[i]->alf[k] );
+            free( xt[i]->alf );
+        }
+        free( xt[i]->a );
+    }
+    FreeBandSolver( ctx );
+    FreeBlockPrecond( &( ctx->kry ) );
+    FreeAdjointSolver( ctx );
+    FreeSolutionArena( &( ctx->arena ) );
+    *ctx = InitModelContext(  );
+}
 
 /*** SOLVERS ***************************************************************/
 
@@ -974,6 +993,268 @@ Rkck( double *vin, double *vout, double tin, double tout, double stephint, doubl
     //exit(1);
 }
 
+/** Rk4Ensemble: Rk4 for all members of an ensemble at once (see Ensemble 
+ *                in maternal.h); vin and vout hold the interleaved states 
+ *                of the ens->size members, n is the size of the state of  
+ *                one member; all members take the same steps as they would
+ *                in Rk4 on their own and get the same derivatives from    
+ *                DvdtEnsemble, so they get the same bits, whatever the    
+ *                other members of the ensemble are                        
+ */
+void
+Rk4Ensemble( double *vin, double *vout, double tin, double tout, double stephint, double accuracy, int n, FILE * slog, SolverInput * si,
+             Ensemble * ens ) {
+    int i;                      /* local loop counter */
+    int nk = n * ens->size;     /* length of the interleaved states */
+
+    double *v[2];               /* intermediate v's, used to toggle v arrays */
+    int toggle = 0;             /* used to toggle between v[0] and v[1] */
+
+    double *vtemp;              /* guessed intermediate v's */
+    double *vnow;               /* ptr to v at current time */
+    double *vnext;              /* ptr to v at current time + stepsize */
+
+    double *deriv1;             /* the derivatives at the beginning of a step */
+    double *deriv2;             /* the derivatives at test-midpoint 1 */
+    double *deriv3;             /* the derivatives at test-midpoint 2 */
+    double *deriv4;             /* the derivatives at test-endpoint */
+
+    double t;                   /* current time */
+    double m;                   /* used to calculate number of steps */
+    double stepsize;            /* real stepsize */
+    double hh;                  /* half the stepsize */
+    double h6;                  /* one sixth of the stepsize (for Rk4 formula) */
+    int step;                   /* loop counter for steps */
+    int nsteps;                 /* number of steps we have to take */
+
+    if( tin == tout )
+        return;
+
+    vtemp = ( double * ) calloc( nk, sizeof( double ) );
+    v[0] = ( double * ) calloc( nk, sizeof( double ) );
+    v[1] = ( double * ) calloc( nk, sizeof( double ) );
+    deriv1 = ( double * ) calloc( nk, sizeof( double ) );
+    deriv2 = ( double * ) calloc( nk, sizeof( double ) );
+    deriv3 = ( double * ) calloc( nk, sizeof( double ) );
+    deriv4 = ( double * ) calloc( nk, sizeof( double ) );
+
+    /* the same steps as in Rk4 */
+    m = floor( ( tout - tin ) / stephint + 0.5 );
+    if( m < 1. )
+        m = 1.;
+    stepsize = ( tout - tin ) / m;
+    nsteps = ( int ) m;
+    t = tin;
+
+    if( t == t + stepsize )
+        error( "Rk4Ensemble: stephint of %g too small!", stephint );
+
+    vnow = vin;
+    vnext = ( nsteps == 1 ) ? vout : v[0];
+    hh = stepsize * 0.5;
+    h6 = stepsize / 6.0;
+
+    for( step = 0; step < nsteps; step++ ) {
+        DvdtEnsemble( vnow, t, deriv1, n, si, ens );
+        for( i = 0; i < nk; i++ )
+            vtemp[i] = vnow[i] + hh * deriv1[i];
+        DvdtEnsemble( vtemp, t + hh, deriv2, n, si, ens );
+        for( i = 0; i < nk; i++ )
+            vtemp[i] = vnow[i] + hh * deriv2[i];
+        DvdtEnsemble( vtemp, t + hh, deriv3, n, si, ens );
+        for( i = 0; i < nk; i++ )
+            vtemp[i] = vnow[i] + stepsize * deriv3[i];
+        DvdtEnsemble( vtemp, t + stepsize, deriv4, n, si, ens );
+
+        for( i = 0; i < nk; i++ )
+            vnext[i] = vnow[i]
+                + h6 * ( deriv1[i] + 2.0 * deriv2[i] + 2.0 * deriv3[i] + deriv4[i] );
+
+        t += stepsize;
+
+        /* toggle between v[0] and v[1]; the final step goes to vout */
+        vnow = vnext;
+        if( step == nsteps - 2 )
+            vnext = vout;
+        else {
+            toggle = !toggle;
+            vnext = v[toggle];
+        }
+    }
+
+    if( debug )
+        WriteSolvLog( "Rk4Ensemble", tin, tout, stepsize, nsteps, 4 * nsteps, slog );
+
+    free( v[0] );
+    free( v[1] );
+    free( vtemp );
+    free( deriv1 );
+    free( deriv2 );
+    free( deriv3 );
+    free( deriv4 );
+}
+
+/** RkckEnsemble: Rkck for all members of an ensemble at once (see Rk4- 
+ *                 Ensemble); the members share the adaptive step, which   
+ *                 has to be small enough for each of them: the relative   
+ *                 error of every member has to be below accuracy, so the  
+ *                 step is that of the member that needs the smallest one  
+ *                 (a single member gets the same bits as from Rkck)       
+ */
+void
+RkckEnsemble( double *vin, double *vout, double tin, double tout, double stephint, double accuracy, int n, FILE * slog, SolverInput * si,
+              Ensemble * ens ) {
+    int i;                      /* local loop counter */
+    int nk = n * ens->size;     /* length of the interleaved states */
+
+    double *v[2];               /* used for storing intermediate steps */
+    int toggle = 0;             /* used to toggle between v[0] and v[1] */
+
+    double *vtemp;              /* guessed intermediate v's */
+    double *vnow;               /* ptr to v at current time */
+    double *vnext;              /* ptr to v at current time + stepsize */
+
+    double *verror;             /* error estimate */
+    double verror_max;          /* the maximum error of all members */
+
+    double *deriv1;             /* intermediate derivatives for the Cash-Karp formula */
+    double *deriv2;
+    double *deriv3;
+    double *deriv4;
+    double *deriv5;
+    double *deriv6;
+
+    double t;                   /* the current time */
+    double h = stephint;        /* initial stepsize */
+    double hnext;               /* used to calculate next stepsize */
+    double SAFETY = 0.9;        /* safety margin for decreasing stepsize */
+
+    /* Cash-Karp parameters, as in Rkck */
+    static double a2 = 0.2, a3 = 0.3, a4 = 0.6, a5 = 1.0, a6 = 0.875;
+
+    static double
+        b21 = 0.2,
+        b31 = 3.0 / 40.0,
+        b32 = 9.0 / 40.0,
+        b41 = 0.3,
+        b42 = -0.9,
+        b43 = 1.2,
+        b51 = -11.0 / 54.0,
+        b52 = 2.5,
+        b53 = -70.0 / 27.0, b54 = 35.0 / 27.0, b61 = 1631.0 / 55296.0, b62 = 175.0 / 512.0, b63 = 575.0 / 13824, b64 = 44275.0 / 110592.0, b65 = 253.0 / 4096.0;
+
+    static double c1 = 37.0 / 378.0, c3 = 250.0 / 621.0, c4 = 125.0 / 594.0, c6 = 512.0 / 1771.0;
+
+    double dc1 = c1 - 2825.0 / 27648.0, dc3 = c3 - 18575.0 / 48384.0, dc4 = c4 - 13525.0 / 55296.0, dc5 = -277.0 / 14336.0, dc6 = c6 - 0.25;
+
+    if( tin == tout )
+        return;
+
+    vtemp = ( double * ) calloc( nk, sizeof( double ) );
+    verror = ( double * ) calloc( nk, sizeof( double ) );
+    v[0] = ( double * ) calloc( nk, sizeof( double ) );
+    v[1] = ( double * ) calloc( nk, sizeof( double ) );
+    deriv1 = ( double * ) calloc( nk, sizeof( double ) );
+    deriv2 = ( double * ) calloc( nk, sizeof( double ) );
+    deriv3 = ( double * ) calloc( nk, sizeof( double ) );
+    deriv4 = ( double * ) calloc( nk, sizeof( double ) );
+    deriv5 = ( double * ) calloc( nk, sizeof( double ) );
+    deriv6 = ( double * ) calloc( nk, sizeof( double ) );
+
+    t = tin;
+    vnow = vin;
+    vnext = v[0];
+
+    if( tin + h >= tout )
+        h = tout - tin;
+    while( t < tout ) {
+
+        /* take one step for all members and repeat it with a smaller one *
+         * until the error of each of them is small enough                */
+        while( 1 ) {
+            DvdtEnsemble( vnow, t, deriv1, n, si, ens );
+            for( i = 0; i < nk; i++ )
+                vtemp[i] = vnow[i] + h * ( b21 * deriv1[i] );
+            DvdtEnsemble( vtemp, t + a2 * h, deriv2, n, si, ens );
+
+            for( i = 0; i < nk; i++ )
+                vtemp[i] = vnow[i] + h * ( b31 * deriv1[i] + b32 * deriv2[i] );
+            DvdtEnsemble( vtemp, t + a3 * h, deriv3, n, si, ens );
+
+            for( i = 0; i < nk; i++ )
+                vtemp[i] = vnow[i] + h * ( b41 * deriv1[i] + b42 * deriv2[i] + b43 * deriv3[i] );
+            DvdtEnsemble( vtemp, t + a4 * h, deriv4, n, si, ens );
+
+            for( i = 0; i < nk; i++ )
+                vtemp[i] = vnow[i] + h * ( b51 * deriv1[i] + b52 * deriv2[i] + b53 * deriv3[i]
+                                           + b54 * deriv4[i] );
+            DvdtEnsemble( vtemp, t + a5 * h, deriv5, n, si, ens );
+
+            for( i = 0; i < nk; i++ )
+                vtemp[i] = vnow[i] + h * ( b61 * deriv1[i] + b62 * deriv2[i] + b63 * deriv3[i]
+                                           + b64 * deriv4[i] + b65 * deriv5[i] );
+            DvdtEnsemble( vtemp, t + a6 * h, deriv6, n, si, ens );
+
+            for( i = 0; i < nk; i++ )
+                vnext[i] = vnow[i]
+                    + h * ( c1 * deriv1[i] + c3 * deriv3[i] + c4 * deriv4[i]
+                            + c6 * deriv6[i] );
+
+            for( i = 0; i < nk; i++ )
+                verror[i] = h * ( dc1 * deriv1[i] + dc3 * deriv3[i]
+                                  + dc4 * deriv4[i] + dc5 * deriv5[i]
+                                  + dc6 * deriv6[i] );
+
+            /* the error is relative to each element, so the largest one over *
+             * all members is that of the member that needs the smallest step */
+            verror_max = 0.;
+            for( i = 0; i < nk; i++ ) {
+                if( vnext[i] != 0. )
+                    verror_max = DMAX( fabs( verror[i] / vnext[i] ), verror_max );
+                else
+                    verror_max = DMAX( verror[i] / DBL_EPSILON, verror_max );
+            }
+            verror_max /= accuracy;
+
+            if( verror_max <= 1.0 )
+                break;
+
+            hnext = SAFETY * h * pow( verror_max, -0.25 );
+            h = ( hnext > 0.1 * h ) ? hnext : 0.1 * h;
+            if( h < DBL_EPSILON )
+                error( "RkckEnsemble: stepsize underflow" );
+        }
+
+        t += h;
+
+        if( t >= tout )
+            break;
+
+        h = h * pow( verror_max, -0.20 );
+
+        if( t + h >= tout )
+            h = tout - t;
+
+        vnow = v[toggle];
+        toggle++;
+        toggle %= 2;
+        vnext = v[toggle];
+    }
+
+    memcpy( vout, vnext, sizeof( *vnext ) * nk );
+
+    free( v[0] );
+    free( v[1] );
+    free( vtemp );
+    free( verror );
+    free( deriv1 );
+    free( deriv2 );
+    free( deriv3 );
+    free( deriv4 );
+    free( deriv5 );
+    free( deriv6 );
+}
+
 /** Rkf: propagates vin (of size n) from tin to tout by the Runge-Kutta 
  *        Fehlberg method, which is a the original adaptive-stepsize Rk    
  *        method (Cash-Karp is an improved version of this); it uses a     
@@ -1191,58 +1472,344 @@ Rkf( double *vin, double *vout, double tin, double tout, double stephint, double
 
 }
 
-/**    Milne: propagates vin (of size n) from tin to tout by Milne-Simpson 
- *            which is a predictor-corrector method; the result is retur-  
- *            ned by vout                                                  
- ***************************************************************************
+/*** IMEX RUNGE-KUTTA *******************************************************
  *                                                                         
- * This solver was implemented by Konstantin Koslov, Dec 2001/Jan 2002     
+ * Diffusion between neighbouring nuclei is what makes the equations stiff 
+ * as the nuclei multiply, while production and decay are not; Imex below  
+ * therefore takes diffusion implicitly and the rest explicitly. For each  
+ * gene, the implicit stages solve (I - h * gamma * D[k] * L) z = r, where 
+ * L is the tridiagonal diffusion operator of the nuclei, by the Thomas    
+ * algorithm. Both implicit stages have the same gamma, so the elimina-    
+ * tion factors of a step are computed once. The helpers below work on all 
+ * genes at once and take the strides of nuclei (sa) and genes (sk) in the 
+ * state, so that they do both layouts (see StateLayout in zygotic.h).     
  *                                                                         
+ ***************************************************************************/
+
+/** ImexDiffusion: writes the diffusion term of v, the same as in the de-  
+ *                  rivative functions, to vdot                            
+ */
+static void
+ImexDiffusion( double *v, double *vdot, double *D, int m, int ngenes, int sa, int sk ) {
+    int ap, k, i;
+
+    if( m == 1 ) {
+        for( k = 0; k < ngenes; k++ )
+            vdot[k * sk] = 0.;
+        return;
+    }
+    for( k = 0; k < ngenes; k++ ) {
+        i = k * sk;
+        vdot[i] = D[k] * ( v[i + sa] - v[i] );
+    }
+    for( ap = 1; ap < m - 1; ap++ )
+        for( k = 0; k < ngenes; k++ ) {
+            i = ap * sa + k * sk;
+            vdot[i] = D[k] * ( ( v[i - sa] - v[i] ) + ( v[i + sa] - v[i] ) );
+        }
+    for( k = 0; k < ngenes; k++ ) {
+        i = ( m - 1 ) * sa + k * sk;
+        vdot[i] = D[k] * ( v[i - sa] - v[i] );
+    }
+}
+
+/** ImexFactor: Thomas elimination for I - alpha[k] * L; w gets the inver- 
+ *               se pivot of each element                                  
+ */
+static void
+ImexFactor( double *w, double *alpha, int m, int ngenes, int sa, int sk ) {
+    int ap, k, i;
+    double nb;                  /* number of neighbours of a nucleus */
+
+    for( k = 0; k < ngenes; k++ )
+        w[k * sk] = 1. / ( 1. + ( ( m > 1 ) ? alpha[k] : 0. ) );
+    for( ap = 1; ap < m; ap++ ) {
+        nb = ( ap == m - 1 ) ? 1. : 2.;
+        for( k = 0; k < ngenes; k++ ) {
+            i = ap * sa + k * sk;
+            w[i] = 1. / ( 1. + nb * alpha[k] - alpha[k] * alpha[k] * w[i - sa] );
+        }
+    }
+}
+
+/** ImexSolve: solves (I - alpha[k] * L) x = r in place (x holds r on en-  
+ *              try), with w from ImexFactor                               
+ */
+static void
+ImexSolve( double *x, double *w, double *alpha, int m, int ngenes, int sa, int sk ) {
+    int ap, k, i;
+
+    for( k = 0; k < ngenes; k++ )
+        x[k * sk] *= w[k * sk];
+    for( ap = 1; ap < m; ap++ )
+        for( k = 0; k < ngenes; k++ ) {
+            i = ap * sa + k * sk;
+            x[i] = ( x[i] + alpha[k] * x[i - sa] ) * w[i];
+        }
+    for( ap = m - 2; ap >= 0; ap-- )
+        for( k = 0; k < ngenes; k++ ) {
+            i = ap * sa + k * sk;
+            x[i] += alpha[k] * w[i] * x[i + sa];
+        }
+}
+
+/** Imex: propagates vin (of size n) from tin to tout by an adaptive-step- 
+ *         size implicit-explicit (IMEX) Runge-Kutta method: diffusion is  
+ *         implicit, production and decay explicit; its result is retur-   
+ *         ned by vout                                                     
  ***************************************************************************
  *                                                                         
- * THIS SOLVER SEEMS TO BE BUGGY FOR SOME REASON, DO NOT USE IT!!!!!       
+ * We use the ARK2 pair of Giraldo, Kelly & Constantinescu (2013), SIAM J. 
+ * Sci. Comput. 35(5), B1162-B1194: three stages, second-order with an em- 
+ * bedded first-order formula for the error. Both parts share the weights, 
+ * so a step only needs the full derivative p_deriv at each stage; the ex- 
+ * plicit part of a stage is p_deriv minus its diffusion term, which keeps 
+ * Imex independent of the derivative function. The diffusion coefficients 
+ * are those SetCycle leaves in the workspace, which stay the same for the 
+ * whole call, since the number of nuclei does. The error is measured and  
+ * the stepsize controlled as in Rkck.                                     
  *                                                                         
  */
 void
-Milne( double *vin, double *vout, double tin, double tout, double stephint, double accuracy, int n, FILE * slog, SolverInput * si, Input * inp ) {
-    int i;                      /* local loop counter */
+Imex( double *vin, double *vout, double tin, double tout, double stephint, double accuracy, int n, FILE * slog, SolverInput * si, Input * inp ) {
 
-    double **v;                 /* array to store intermediate results */
+    int i, k;                   /* local loop counters */
+    double **v;                 /* used for storing intermediate steps */
     int toggle = 0;             /* used to toggle between v[0] and v[1] */
 
-    double *vtemp;              /* guessed intermediate v's */
+    double *vtemp;              /* stage right-hand sides and solutions */
 
-    double *vnow;               /* current protein concs */
-    double *vnext;              /* next protein concs */
+    double *vnow;               /* ptr to v at current time */
+    double *vnext;              /* ptr to v at current time + stepsize */
 
-    double *deriv1;             /* the derivatives at the beginning of a step */
-    double *deriv2;             /* derivatives at test-midpoint 1 */
-    double *deriv3;             /* derivatives at test-midpoint 2 */
-    double *deriv4;             /* derivatives at test-endpoint */
+    double verror;              /* error estimate of one element */
+    double verror_max;          /* the maximum relative error */
 
-    double **history_dv;        /* history of the derivatives */
-    double **history_v;         /* history of the v: v_{i-3} v_{i-1} */
-    double *dblank;             /* pointer for history_dv rotation */
+    double *deriv1;             /* full derivatives at the stages */
+    double *deriv2;
+    double *deriv3;
+    double *diff1;              /* their diffusion terms (stages 1 and 2) */
+    double *diff2;
 
-    double deltat;              /* tout - tin */
-    double t;                   /* current time */
-    double th;                  /* time at end of interval */
-    double thh;                 /* time for interval midpoints */
+    const int ngenes = inp->zyg.defs.ngenes;
+    const int m = n / ngenes;   /* number of nuclei */
+    int sa, sk;                 /* strides of nuclei and genes in v */
+    double *D = inp->wsp.D;     /* diffusion coefficients (set by p_deriv) */
+    double *alpha;              /* h * gamma * D */
+    double *w;                  /* Thomas factors for the current h */
 
-    double m;                   /* used to calculate number of steps */
-    double stepsize;            /* real stepsize */
-    double hh;                  /* half the stepsize */
-    double h6;                  /* one sixth of the stepsize (for Rk4 formula) */
-    int step;                   /* loop counter for steps */
-    int nsteps;                 /* number of steps we have to take */
+    double t;                   /* the current time */
 
-    double hp;                  /* multiplier for the predictor derivs */
-    double hc;                  /* multiplier for the corrector derivs */
+    double h = stephint;        /* initial stepsize */
+    double hnext;               /* used to calculate next stepsize */
+    double SAFETY = 0.9;        /* safety margin for changing stepsize */
+    double GROW = 5.0;          /* grow the stepsize by at most this factor */
+
+    int nsteps = 0;             /* number of accepted steps (for the log) */
+    int nd = 0;                 /* number of derivative evaluations */
+
+    /* ARK2 parameters: gamma is the diagonal of the implicit stages, c2 the *
+     * time of the second stage, ae3x the explicit coefficients of the third *
+     * stage and del the weight of stages 1 and 2 (that of stage 3 is gamma) *
+     * as well as the implicit coefficients of stage 3; the error estimate   *
+     * is h * dc * (deriv1 + deriv2 - 2 * deriv3)                            */
+    const double gamma = 1. - 1. / sqrt( 2. );
+    const double c2 = 2. * gamma;
+    const double ae32 = ( 3. + 2. * sqrt( 2. ) ) / 6.;
+    const double ae31 = 1. - ae32;
+    const double del = 1. / ( 2. * sqrt( 2. ) );
+    const double dc = ( 3. * sqrt( 2. ) - 4. ) / 8.;
 
-    double mistake;             /* error estimator */
-    double corr;                /* temp variable for the corrector */
-    double ee;                  /* temp variable for the error estimator */
-    double cc29;                /* 1/29: used for calculating ee */
+    /* the do-nothing case; too small steps dealt with under usual */
+
+    if( tin == tout )
+        return;
+
+    /* the usual case: steps big enough */
+
+    if( slayout == GeneMajor ) {
+        sa = 1;
+        sk = m;
+    } else {
+        sa = ngenes;
+        sk = 1;
+    }
+
+    v = ( double ** ) calloc( 2, sizeof( double * ) );
+
+    vtemp = ( double * ) calloc( n, sizeof( double ) );
+    v[0] = ( double * ) calloc( n, sizeof( double ) );
+    v[1] = ( double * ) calloc( n, sizeof( double ) );
+    deriv1 = ( double * ) calloc( n, sizeof( double ) );
+    deriv2 = ( double * ) calloc( n, sizeof( double ) );
+    deriv3 = ( double * ) calloc( n, sizeof( double ) );
+    diff1 = ( double * ) calloc( n, sizeof( double ) );
+    diff2 = ( double * ) calloc( n, sizeof( double ) );
+    w = ( double * ) calloc( n, sizeof( double ) );
+    alpha = ( double * ) calloc( ngenes, sizeof( double ) );
+
+    t = tin;
+    vnow = vin;
+    vnext = v[0];
+
+    /* initial stepsize cannot be bigger than total time */
+
+    if( tin + h >= tout )
+        h = tout - tin;
+    while( t < tout ) {
+
+        /* the first stage is the same for each try of the step */
+        p_deriv( vnow, t, deriv1, n, si, inp );
+        ImexDiffusion( vnow, diff1, D, m, ngenes, sa, sk );
+        nd++;
+
+        /* Take one step and evaluate the error. Repeat until the resulting error  *
+         * is less than the desired accuracy                                       */
+        while( 1 ) {
+
+            for( k = 0; k < ngenes; k++ )
+                alpha[k] = h * gamma * D[k];
+            ImexFactor( w, alpha, m, ngenes, sa, sk );
+
+            /* second stage: explicit part of stage 1, then solve for diffusion */
+            for( i = 0; i < n; i++ )
+                vtemp[i] = vnow[i] + h * ( c2 * ( deriv1[i] - diff1[i] ) + gamma * diff1[i] );
+            ImexSolve( vtemp, w, alpha, m, ngenes, sa, sk );
+            p_deriv( vtemp, t + c2 * h, deriv2, n, si, inp );
+            ImexDiffusion( vtemp, diff2, D, m, ngenes, sa, sk );
+
+            /* third stage */
+            for( i = 0; i < n; i++ )
+                vtemp[i] = vnow[i] + h * ( ae31 * ( deriv1[i] - diff1[i] ) + ae32 * ( deriv2[i] - diff2[i] )
+                                           + del * ( diff1[i] + diff2[i] ) );
+            ImexSolve( vtemp, w, alpha, m, ngenes, sa, sk );
+            p_deriv( vtemp, t + h, deriv3, n, si, inp );
+            nd += 2;
+
+            /* both parts have the same weights, so they add up to p_deriv */
+            for( i = 0; i < n; i++ )
+                vnext[i] = vnow[i] + h * ( del * ( deriv1[i] + deriv2[i] ) + gamma * deriv3[i] );
+
+            /* find the maximum error of the embedded formula */
+
+            verror_max = 0.;
+            for( i = 0; i < n; i++ ) {
+                verror = h * dc * ( deriv1[i] + deriv2[i] - 2. * deriv3[i] );
+                if( vnext[i] != 0. )
+                    verror_max = DMAX( fabs( verror / vnext[i] ), verror_max );
+                else
+                    verror_max = DMAX( fabs( verror ) / DBL_EPSILON, verror_max );
+            }
+            verror_max /= accuracy;
+
+            /* the error is of second order in h; see Rkck for the rest */
+
+            if( verror_max <= 1.0 )
+                break;
+
+            hnext = SAFETY * h * pow( verror_max, -0.5 );
+            /* decrease stepsize by no more than a factor of 10; check for underflows */
+            h = ( hnext > 0.1 * h ) ? hnext : 0.1 * h;
+            if( h < DBL_EPSILON )
+                error( "Imex: stepsize underflow" );
+        }
+        /* advance the current time by last stepsize */
+
+        t += h;
+        nsteps++;
+
+        if( t >= tout )
+            break;              /* that was the last iteration */
+
+        /* increase stepsize according to error for next iteration */
+
+        hnext = SAFETY * h * pow( verror_max, -0.5 );
+        h = ( hnext < GROW * h ) ? hnext : GROW * h;
+
+        /* make sure t does not overstep tout */
+
+        if( t + h >= tout )
+            h = tout - t;
+
+        /* toggle vnow and vnext between v[0] and v[1] */
+
+        vnow = v[toggle];
+        toggle++;
+        toggle %= 2;
+        vnext = v[toggle];
+    }
+    /* copy the last result to vout after the final iteration */
+
+    memcpy( vout, vnext, sizeof( *vnext ) * n );
+
+    if( debug )
+        WriteSolvLog( "Imex", tin, tout, h, nsteps, nd, slog );
+
+    free( v[0] );
+    free( v[1] );
+    free( v );
+    free( vtemp );
+    free( deriv1 );
+    free( deriv2 );
+    free( deriv3 );
+    free( diff1 );
+    free( diff2 );
+    free( w );
+    free( alpha );
+}
+
+/**    Milne: propagates vin (of size n) from tin to tout by Milne-Simpson 
+ *            which is a predictor-corrector method; the result is retur-  
+ *            ned by vout                                                  
+ ***************************************************************************
+ *                                                                         
+ * This solver was implemented by Konstantin Koslov, Dec 2001/Jan 2002     
+ *                                                                         
+ ***************************************************************************
+ *                                                                         
+ * THIS SOLVER SEEMS TO BE BUGGY FOR SOME REASON, DO NOT USE IT!!!!!       
+ *                                                                         
+ */
+void
+Milne( double *vin, double *vout, double tin, double tout, double stephint, double accuracy, int n, FILE * slog, SolverInput * si, Input * inp ) {
+    int i;                      /* local loop counter */
+
+    double **v;                 /* array to store intermediate results */
+    int toggle = 0;             /* used to toggle between v[0] and v[1] */
+
+    double *vtemp;              /* guessed intermediate v's */
+
+    double *vnow;               /* current protein concs */
+    double *vnext;              /* next protein concs */
+
+    double *deriv1;             /* the derivatives at the beginning of a step */
+    double *deriv2;             /* derivatives at test-midpoint 1 */
+    double *deriv3;             /* derivatives at test-midpoint 2 */
+    double *deriv4;             /* derivatives at test-endpoint */
+
+    double **history_dv;        /* history of the derivatives */
+    double **history_v;         /* history of the v: v_{i-3} v_{i-1} */
+    double *dblank;             /* pointer for history_dv rotation */
+
+    double deltat;              /* tout - tin */
+    double t;                   /* current time */
+    double th;                  /* time at end of interval */
+    double thh;                 /* time for interval midpoints */
+
+    double m;                   /* used to calculate number of steps */
+    double stepsize;            /* real stepsize */
+    double hh;                  /* half the stepsize */
+    double h6;                  /* one sixth of the stepsize (for Rk4 formula) */
+    int step;                   /* loop counter for steps */
+    int nsteps;                 /* number of steps we have to take */
+
+    double hp;                  /* multiplier for the predictor derivs */
+    double hc;                  /* multiplier for the corrector derivs */
+
+    double mistake;             /* error estimator */
+    double corr;                /* temp variable for the corrector */
+    double ee;                  /* temp variable for the error estimator */
+    double cc29;                /* 1/29: used for calculating ee */
 
     int nd = 0;                 /* number of deriv evaluations */
 
@@ -1953,7 +2520,7 @@ bsstep( double *v, double *deriv, int n, double *t, double htry, double accuracy
 
     void mmid( double *vin, double *vout, double *deriv, double tin, double htot, int nstep, int n, SolverInput * si, Input * inp );
 
-    void pzextr( int iest, double hest, double *yest, double *yz, double *dy, int nv, const int KMAXX );
+    void pzextr( int iest, double hest, double *yest, double *yz, double *dy, int nv, const int KMAXX, double *d, double *hpoints );
 
     /*** constants *************************************************************/
 
@@ -1988,20 +2555,8 @@ bsstep( double *v, double *deriv, int n, double *t, double htry, double accuracy
     double wrkmin;
     double fact;
 
-    static double old_accuracy = -1.0;  /* used to save old accuracy */
-    static double tnew;         /* used to save old start time */
-
-    /* the following two arrays are used for Deuflhard's error estimation; a   *
-     * contains the work coefficients and alf (alpha) the correction factors   */
-
-    static double *a = NULL;
-    static double **alf = NULL;
-
     double accuracy1;           /* error (< accuracy) used to calculate alphas */
 
-    static int kmax;            /* used for finding kopt */
-    static int kopt;            /* optimal row number for convergence */
-
     /* sequence of separate attempts to cross interval htot with increasing    *
      * values of nsteps as suggested by Deuflhard (Num Rec, p. 726)            */
 
@@ -2009,14 +2564,14 @@ bsstep( double *v, double *deriv, int n, double *t, double htry, double accuracy
 
     /* miscellaneous flags */
 
-    static int first = 1;       /* is this the first try for a given step? */
     int reduct;                 /* flag indicating if we have reduced stepsize yet */
     int exitflag = 0;           /* exitflag: when set, we exit (!) */
 
-    /* static global arrays */
+    /* arrays for pzextr and the tables we keep between steps */
 
-    extern double *d;           /* D's used for extrapolation in pzextr */
-    extern double *hpoints;     /* stepsizes h (=H/n) which we have tried */
+    double *d;                  /* D's used for extrapolation in pzextr */
+    double *hpoints;            /* stepsizes h (=H/n) which we have tried */
+    ExtrapTables *xt = &( inp->ctx.bust );     /* see ModelContext in maternal.h */
 
     /* allocate arrays */
 
@@ -2044,39 +2599,39 @@ bsstep( double *v, double *deriv, int n, double *t, double htry, double accuracy
 
     /* new accuracy? -> initialize (here, this only applies at start) */
 
-    if( accuracy != old_accuracy ) {
+    if( accuracy != xt->old_accuracy ) {
 
-        *hnext = tnew = -1.0e29;        /* init these to impossible value */
+        *hnext = xt->tnew = -1.0e29;        /* init these to impossible value */
 
         /* allocate memory if necessary */
 
-        if( !a ) {
-            a = ( double * ) calloc( IMAXX + 1, sizeof( double ) );
-            alf = ( double ** ) calloc( KMAXX + 1, sizeof( double * ) );
+        if( !xt->a ) {
+            xt->a = ( double * ) calloc( IMAXX + 1, sizeof( double ) );
+            xt->alf = ( double ** ) calloc( KMAXX + 2, sizeof( double * ) );      /* NULL-terminated */
             for( i = 0; i < KMAXX + 1; i++ )
-                alf[i] = ( double * ) calloc( KMAXX + 1, sizeof( double ) );
+                xt->alf[i] = ( double * ) calloc( KMAXX + 1, sizeof( double ) );
         }
 
         /* initialize the work coefficients */
 
-        a[1] = nseq[1] + 1;
+        xt->a[1] = nseq[1] + 1;
         for( k = 1; k <= KMAXX; k++ )
-            a[k + 1] = a[k] + nseq[k + 1];
+            xt->a[k + 1] = xt->a[k] + nseq[k + 1];
 
         /* initialize the correction factors (alpha) */
 
         accuracy1 = SAFE1 * accuracy;   /* accuracy1 used to calculate alphas */
         for( i = 2; i <= KMAXX; i++ )
             for( k = 1; k < i; k++ )
-                alf[k][i] = pow( accuracy1, ( ( a[k + 1] - a[i + 1] ) / ( ( a[i + 1] - a[1] + 1.0 ) * ( 2 * k + 1 ) ) ) );
-        old_accuracy = accuracy;
+                xt->alf[k][i] = pow( accuracy1, ( ( xt->a[k + 1] - xt->a[i + 1] ) / ( ( xt->a[i + 1] - xt->a[1] + 1.0 ) * ( 2 * k + 1 ) ) ) );
+        xt->old_accuracy = accuracy;
 
         /* determine optimal row number for convergence */
 
-        for( kopt = 2; kopt < KMAXX; kopt++ )
-            if( a[kopt + 1] > a[kopt] * alf[kopt - 1][kopt] )
+        for( xt->kopt = 2; xt->kopt < KMAXX; xt->kopt++ )
+            if( xt->a[xt->kopt + 1] > xt->a[xt->kopt] * xt->alf[xt->kopt - 1][xt->kopt] )
                 break;
-        kmax = kopt;
+        xt->kmax = xt->kopt;
 
     }
 
@@ -2087,9 +2642,9 @@ bsstep( double *v, double *deriv, int n, double *t, double htry, double accuracy
 
     /* new integration or stepsize? -> re-establish the order window */
 
-    if( *t != tnew || h != ( *hnext ) ) {
-        first = 1;
-        kopt = kmax;
+    if( *t != xt->tnew || h != ( *hnext ) ) {
+        xt->first = 1;
+        xt->kopt = xt->kmax;
     }
 
     reduct = 0;                 /* we have not reduced stepsize yet */
@@ -2098,10 +2653,10 @@ bsstep( double *v, double *deriv, int n, double *t, double htry, double accuracy
 
         /* try increasing numbers of steps over the interval h */
 
-        for( k = 1; k <= kmax; k++ ) {
+        for( k = 1; k <= xt->kmax; k++ ) {
 
-            tnew = ( *t ) + h;
-            if( tnew == ( *t ) )
+            xt->tnew = ( *t ) + h;
+            if( xt->tnew == ( *t ) )
                 error( "BuSt: stepsize underflow in bsstep\n" );
 
             /* propagate the equations from t to t+h with nseq[k] steps using vsav and *
@@ -2114,7 +2669,7 @@ bsstep( double *v, double *deriv, int n, double *t, double htry, double accuracy
              * hest is squared since the error series is even                          */
 
             hest = DSQR( h / nseq[k] );
-            pzextr( k - 1, hest, vseq, v, verror, n, KMAXX );
+            pzextr( k - 1, hest, vseq, v, verror, n, KMAXX, d, hpoints );
 
             if( k > 1 ) {
 
@@ -2140,24 +2695,24 @@ bsstep( double *v, double *deriv, int n, double *t, double htry, double accuracy
 
             /* are we in the order window? -> converged */
 
-            if( k > 1 && ( k >= kopt - 1 || first ) ) {
+            if( k > 1 && ( k >= xt->kopt - 1 || xt->first ) ) {
 
                 if( verror_max < 1.0 ) {        /* exit if accuracy good enough */
                     exitflag = 1;
                     break;
                 }
 
-                if( k == kmax || k == kopt + 1 ) {      /* stepsize reduction possible? */
+                if( k == xt->kmax || k == xt->kopt + 1 ) {      /* stepsize reduction possible? */
                     red = SAFE2 / err[km - 1];
                     break;
-                } else if( k == kopt && alf[kopt - 1][kopt] < err[km - 1] ) {
+                } else if( k == xt->kopt && xt->alf[xt->kopt - 1][xt->kopt] < err[km - 1] ) {
                     red = 1.0 / err[km - 1];
                     break;
-                } else if( kopt == kmax && alf[km][kmax - 1] < err[km - 1] ) {
-                    red = alf[km][kmax - 1] * SAFE2 / err[km - 1];
+                } else if( xt->kopt == xt->kmax && xt->alf[km][xt->kmax - 1] < err[km - 1] ) {
+                    red = xt->alf[km][xt->kmax - 1] * SAFE2 / err[km - 1];
                     break;
-                } else if( alf[km][kopt] < err[km - 1] ) {
-                    red = alf[km][kopt - 1] / err[km - 1];
+                } else if( xt->alf[km][xt->kopt] < err[km - 1] ) {
+                    red = xt->alf[km][xt->kopt - 1] / err[km - 1];
                     break;
                 }
             }
@@ -2177,9 +2732,9 @@ bsstep( double *v, double *deriv, int n, double *t, double htry, double accuracy
 
     /* we've taken a successful step */
 
-    *t = tnew;
+    *t = xt->tnew;
     *hdid = h;
-    first = 0;
+    xt->first = 0;
     wrkmin = 1.0e35;
 
     /* compute optimal row for convergence and corresponding stepsize */
@@ -2187,13 +2742,13 @@ bsstep( double *v, double *deriv, int n, double *t, double htry, double accuracy
     for( i = 1; i <= km; i++ ) {
 
         fact = DMAX( err[i - 1], SCALMX );
-        work = fact * a[i + 1];
+        work = fact * xt->a[i + 1];
 
         if( work < wrkmin ) {
 
             scale = fact;
             wrkmin = work;
-            kopt = i + 1;
+            xt->kopt = i + 1;
 
         }
     }
@@ -2202,13 +2757,13 @@ bsstep( double *v, double *deriv, int n, double *t, double htry, double accuracy
 
     /* check for possible order increase, but not if stepsize was just reduced */
 
-    if( kopt >= k && kopt != kmax && !reduct ) {
+    if( xt->kopt >= k && xt->kopt != xt->kmax && !reduct ) {
 
-        fact = DMAX( scale / alf[kopt - 1][kopt], SCALMX );
+        fact = DMAX( scale / xt->alf[xt->kopt - 1][xt->kopt], SCALMX );
 
-        if( a[kopt + 1] * fact <= wrkmin ) {
+        if( xt->a[xt->kopt + 1] * fact <= wrkmin ) {
             *hnext = h / fact;
-            kopt++;
+            xt->kopt++;
         }
     }
 
@@ -2231,6 +2786,8 @@ bsstep( double *v, double *deriv, int n, double *t, double htry, double accuracy
  *           - vout: extrapolated v's that will be returned                
  *           - dv:   array of error estimates to be returned               
  *           - n:    size of verst, vout and dv arrays                     
+ *           - d:    the D's of the tableau (n * KMAXX), kept by the caller
+ *           - hpoints: stepsizes h (=H/n) which we have tried so far      
  *           Neville's algorithm uses a recursive approach to determine a  
  *           suitable Lagrange polynomial for extrapolation by traversing  
  *           a tableau of differences between Lagrange polynomials of in-  
@@ -2238,7 +2795,7 @@ bsstep( double *v, double *deriv, int n, double *t, double htry, double accuracy
  *           (see Numerical Recipes in C, Chapter 3.1 for details)         
  */
 void
-pzextr( int iest, double hest, double *vest, double *vout, double *dv, int n, const int KMAXX ) {
+pzextr( int iest, double hest, double *vest, double *vout, double *dv, int n, const int KMAXX, double *d, double *hpoints ) {
     int i, j;                   /* loop counters */
 
     double q;                   /* temp vars for calculating C's and D's */
@@ -2246,9 +2803,6 @@ pzextr( int iest, double hest, double *vest, double *vout, double *dv, int n, co
     double delta;
     double *c;                  /* C's used for extrapolation */
 
-    extern double *d;           /* D's used for extrapolation */
-    extern double *hpoints;     /* stepsizes h (=H/n) which we have tried */
-
     if( !( c = ( double * ) calloc( n, sizeof( double ) ) ) )
         error( "pzextr: error allocating c.\n" );
 
@@ -2460,7 +3014,7 @@ stifbs( double *v, double *deriv, int n, double *t, double htry, double accuracy
     void simpr( double *vin, double *vout, double *deriv, double *dfdt,
                 double **jac, double tin, double htot, int nstep, int n, SolverInput * si, Input * inp );
 
-    void pzextr( int iest, double hest, double *yest, double *yz, double *dy, int nv, const int KMAXX );
+    void pzextr( int iest, double hest, double *yest, double *yz, double *dy, int nv, const int KMAXX, double *d, double *hpoints );
 
     /*** constants *************************************************************/
 
@@ -2498,21 +3052,8 @@ stifbs( double *v, double *deriv, int n, double *t, double htry, double accuracy
     double wrkmin;
     double fact;
 
-    static double old_accuracy = -1.0;  /* used to save old accuracy */
-    static double tnew;         /* used to save old start time */
-    static int nold = -1;       /* for saving old value of n */
-
-    /* the following two arrays are used for Deuflhard's error estimation; a   *
-     * contains the work coefficients and alf (alpha) the correction factors   */
-
-    static double *a = NULL;
-    static double **alf = NULL;
-
     double accuracy1;           /* error (< accuracy) used to calculate alphas */
 
-    static int kmax;            /* used for finding kopt */
-    static int kopt;            /* optimal row number for convergence */
-
     /* sequence of separate attempts to cross interval htot with increasing    *
      * values of nsteps as suggested by Deuflhard (Num Rec, p. 726)            */
 
@@ -2520,14 +3061,14 @@ stifbs( double *v, double *deriv, int n, double *t, double htry, double accuracy
 
     /* miscellaneous flags */
 
-    static int first = 1;       /* is this the first try for a given step? */
     int reduct;                 /* flag indicating if we have reduced stepsize yet */
     int exitflag = 0;           /* exitflag: when set, we exit (!) */
 
-    /* static global arrays */
+    /* arrays for pzextr and the tables we keep between steps */
 
-    extern double *d;           /* D's used for extrapolation in pzextr */
-    extern double *hpoints;     /* stepsizes h (=H/n) which we have tried */
+    double *d;                  /* D's used for extrapolation in pzextr */
+    double *hpoints;            /* stepsizes h (=H/n) which we have tried */
+    ExtrapTables *xt = &( inp->ctx.bade );     /* see ModelContext in maternal.h */
 
     /* allocate arrays */
 
@@ -2565,46 +3106,46 @@ stifbs( double *v, double *deriv, int n, double *t, double htry, double accuracy
 
     /* allocate memory if necessary */
 
-    if( !a ) {
-        a = ( double * ) calloc( IMAXX + 1, sizeof( double ) );
-        alf = ( double ** ) calloc( KMAXX + 1, sizeof( double * ) );
+    if( !xt->a ) {
+        xt->a = ( double * ) calloc( IMAXX + 1, sizeof( double ) );
+        xt->alf = ( double ** ) calloc( KMAXX + 2, sizeof( double * ) );      /* NULL-terminated */
         for( i = 0; i < KMAXX + 1; i++ )
-            alf[i] = ( double * ) calloc( KMAXX + 1, sizeof( double ) );
+            xt->alf[i] = ( double * ) calloc( KMAXX + 1, sizeof( double ) );
     }
 
     /* new accuracy? -> initialize (here, this only applies at start) */
 
-    if( ( accuracy != old_accuracy ) || ( n != nold ) ) {
+    if( ( accuracy != xt->old_accuracy ) || ( n != xt->nold ) ) {
 
-        *hnext = tnew = -1.0e29;        /* init these to impossible value */
+        *hnext = xt->tnew = -1.0e29;        /* init these to impossible value */
 
         /* initialize the work coefficients */
 
-        a[1] = nseq[1] + 1;
+        xt->a[1] = nseq[1] + 1;
         for( k = 1; k <= KMAXX; k++ )
-            a[k + 1] = a[k] + nseq[k + 1];
+            xt->a[k + 1] = xt->a[k] + nseq[k + 1];
 
         /* initialize the correction factors (alpha) */
 
         accuracy1 = SAFE1 * accuracy;   /* accuracy1 used to calculate alphas */
         for( i = 2; i <= KMAXX; i++ )
             for( k = 1; k < i; k++ )
-                alf[k][i] = pow( accuracy1, ( ( a[k + 1] - a[i + 1] ) / ( ( a[i + 1] - a[1] + 1.0 ) * ( 2 * k + 1 ) ) ) );
-        old_accuracy = accuracy;
-        nold = n;
+                xt->alf[k][i] = pow( accuracy1, ( ( xt->a[k + 1] - xt->a[i + 1] ) / ( ( xt->a[i + 1] - xt->a[1] + 1.0 ) * ( 2 * k + 1 ) ) ) );
+        xt->old_accuracy = accuracy;
+        xt->nold = n;
 
         /* add cost of Jacobian evaluations to work coefficients */
 
-        a[1] += n;
+        xt->a[1] += n;
         for( k = 1; k <= KMAXX; k++ )
-            a[k + 1] = a[k] + nseq[k + 1];
+            xt->a[k + 1] = xt->a[k] + nseq[k + 1];
 
         /* determine optimal row number for convergence */
 
-        for( kopt = 2; kopt < KMAXX; kopt++ )
-            if( a[kopt + 1] > a[kopt] * alf[kopt - 1][kopt] )
+        for( xt->kopt = 2; xt->kopt < KMAXX; xt->kopt++ )
+            if( xt->a[xt->kopt + 1] > xt->a[xt->kopt] * xt->alf[xt->kopt - 1][xt->kopt] )
                 break;
-        kmax = kopt;
+        xt->kmax = xt->kopt;
 
     }
 
@@ -2619,9 +3160,9 @@ stifbs( double *v, double *deriv, int n, double *t, double htry, double accuracy
 
     /* new integration or stepsize? -> re-establish the order window */
 
-    if( *t != tnew || h != ( *hnext ) ) {
-        first = 1;
-        kopt = kmax;
+    if( *t != xt->tnew || h != ( *hnext ) ) {
+        xt->first = 1;
+        xt->kopt = xt->kmax;
     }
 
     reduct = 0;                 /* we have not reduced stepsize yet */
@@ -2630,10 +3171,10 @@ stifbs( double *v, double *deriv, int n, double *t, double htry, double accuracy
 
         /* try increasing numbers of steps over the interval h */
 
-        for( k = 1; k <= kmax; k++ ) {
+        for( k = 1; k <= xt->kmax; k++ ) {
 
-            tnew = ( *t ) + h;
-            if( tnew == ( *t ) )
+            xt->tnew = ( *t ) + h;
+            if( xt->tnew == ( *t ) )
                 error( "BaDe: stepsize underflow in stifbs.\n" );
 
             /* propagate the equations from t to t+h with nseq[k] steps using vsav and *
@@ -2647,7 +3188,7 @@ stifbs( double *v, double *deriv, int n, double *t, double htry, double accuracy
              * hest is squared since the error series is even                          */
 
             hest = DSQR( h / nseq[k] );
-            pzextr( k - 1, hest, vseq, v, verror, n, KMAXX );
+            pzextr( k - 1, hest, vseq, v, verror, n, KMAXX, d, hpoints );
 
             if( k > 1 ) {
 
@@ -2673,24 +3214,24 @@ stifbs( double *v, double *deriv, int n, double *t, double htry, double accuracy
 
             /* are we in the order window? -> converged */
 
-            if( k > 1 && ( k >= kopt - 1 || first ) ) {
+            if( k > 1 && ( k >= xt->kopt - 1 || xt->first ) ) {
 
                 if( verror_max < 1.0 ) {        /* exit if accuracy good enough */
                     exitflag = 1;
                     break;
                 }
 
-                if( k == kmax || k == kopt + 1 ) {      /* stepsize reduction possible? */
+                if( k == xt->kmax || k == xt->kopt + 1 ) {      /* stepsize reduction possible? */
                     red = SAFE2 / err[km - 1];
                     break;
-                } else if( k == kopt && alf[kopt - 1][kopt] < err[km - 1] ) {
+                } else if( k == xt->kopt && xt->alf[xt->kopt - 1][xt->kopt] < err[km - 1] ) {
                     red = 1.0 / err[km - 1];
                     break;
-                } else if( kopt == kmax && alf[km][kmax - 1] < err[km - 1] ) {
-                    red = alf[km][kmax - 1] * SAFE2 / err[km - 1];
+                } else if( xt->kopt == xt->kmax && xt->alf[km][xt->kmax - 1] < err[km - 1] ) {
+                    red = xt->alf[km][xt->kmax - 1] * SAFE2 / err[km - 1];
                     break;
-                } else if( alf[km][kopt] < err[km - 1] ) {
-                    red = alf[km][kopt - 1] / err[km - 1];
+                } else if( xt->alf[km][xt->kopt] < err[km - 1] ) {
+                    red = xt->alf[km][xt->kopt - 1] / err[km - 1];
                     break;
                 }
             }
@@ -2710,9 +3251,9 @@ stifbs( double *v, double *deriv, int n, double *t, double htry, double accuracy
 
     /* we've taken a successful step */
 
-    *t = tnew;
+    *t = xt->tnew;
     *hdid = h;
-    first = 0;
+    xt->first = 0;
     wrkmin = 1.0e35;
 
     /* compute optimal row for convergence and corresponding stepsize */
@@ -2720,13 +3261,13 @@ stifbs( double *v, double *deriv, int n, double *t, double htry, double accuracy
     for( i = 1; i <= km; i++ ) {
 
         fact = DMAX( err[i - 1], SCALMX );
-        work = fact * a[i + 1];
+        work = fact * xt->a[i + 1];
 
         if( work < wrkmin ) {
 
             scale = fact;
             wrkmin = work;
-            kopt = i + 1;
+            xt->kopt = i + 1;
 
         }
     }
@@ -2735,13 +3276,13 @@ stifbs( double *v, double *deriv, int n, double *t, double htry, double accuracy
 
     /* check for possible order increase, but not if stepsize was just reduced */
 
-    if( kopt >= k && kopt != kmax && !reduct ) {
+    if( xt->kopt >= k && xt->kopt != xt->kmax && !reduct ) {
 
-        fact = DMAX( scale / alf[kopt - 1][kopt], SCALMX );
+        fact = DMAX( scale / xt->alf[xt->kopt - 1][xt->kopt], SCALMX );
 
-        if( a[kopt + 1] * fact <= wrkmin ) {
+        if( xt->a[xt->kopt + 1] * fact <= wrkmin ) {
             *hnext = h / fact;
-            kopt++;
+            xt->kopt++;
         }
     }
 
@@ -3069,6 +3610,7 @@ SoDe( double *vin, double *vout, double tin, double tout, double stephint, doubl
     int num_discons, fact_discons_size;
 
     double **vees, *tees;
+    ModelContext *ctx = &( inp->ctx );  /* delays go here for DCERk32 */
     //printf("running delay solver\n");
     /*lp = GetMutParameters(); */
     lp = &( inp->lparm );
@@ -3076,19 +3618,19 @@ SoDe( double *vin, double *vout, double tin, double tout, double stephint, doubl
 
     //printf("%d %f %f %f\n",fact_discons_size,fact_discons[0],fact_discons[1], fact_discons[2]);
 
-    maxdel = 0.;
-    mindel = 1000.;
+    ctx->maxdel = 0.;
+    ctx->mindel = 1000.;
 
     for( j = 0; j < inp->zyg.defs.ngenes; j++ ) {
 
-        if( lp->tau[j] > maxdel )
-            maxdel = lp->tau[j];
-        if( lp->tau[j] < mindel )
-            mindel = lp->tau[j];
+        if( lp->tau[j] > ctx->maxdel )
+            ctx->maxdel = lp->tau[j];
+        if( lp->tau[j] < ctx->mindel )
+            ctx->mindel = lp->tau[j];
 
     }
-    numdel = inp->zyg.defs.ngenes;
-    delay = lp->tau;
+    ctx->numdel = inp->zyg.defs.ngenes;
+    ctx->delay = lp->tau;
 
     //printf("maxdel:%f, mindel:%f and numdel:%d\n",maxdel,mindel,numdel);
 
@@ -3250,6 +3792,7 @@ y_delayed( double ***vd, int n, double *rktimes, double *tau,
     double *vtemp, *vnext, *vprev, *dummy;
     double *drv1, *drv2, *drv3, *drv4;
     double verror_max;
+    ModelContext *ctx = &( inp->ctx );  /* for the delays */
 
     //  static double a1 = 0.0, a2 = 0.5, a3 = 0.75, a4 = 1.0;
 
@@ -3277,11 +3820,11 @@ y_delayed( double ***vd, int n, double *rktimes, double *tau,
 
         t = rktimes[vc];
 
-        for( dc = 0; dc < numdel; dc++ )
+        for( dc = 0; dc < ctx->numdel; dc++ )
             if( tau[dc] == 0. )
                 vd[vc][dc] = memcpy( vd[vc][dc], vdone[gridsize - 1], sizeof( double ) * n );
             else if( t - tau[dc] <= grid[0] )
-                History( t - tau[dc], t, vd[vc][dc], n, inp->his[si->genindex], inp->zyg.defs.ngenes, &( inp->zyg ) );
+                History( t - tau[dc], t, vd[vc][dc], n, inp->his[si->genindex], inp->zyg.defs.ngenes, &( inp->zyg ), &( inp->ctx.hiscursor ) );
             else if( t - tau[dc] <= grid[gridsize - 1] ) {
 
                 j = 0;
@@ -3326,7 +3869,7 @@ y_delayed( double ***vd, int n, double *rktimes, double *tau,
     }
 
     /* Now lets do the promised iteration, if required ofcourse! */
-    if( rktimes[3] - mindel > grid[gridsize - 1] ) {
+    if( rktimes[3] - ctx->mindel > grid[gridsize - 1] ) {
         d_deriv( vdone[gridsize - 1], vd[0], rktimes[0], drv1, n, si, inp );
 
         it = 0;
@@ -3352,7 +3895,7 @@ y_delayed( double ***vd, int n, double *rktimes, double *tau,
 
                 t = rktimes[vc];
 
-                for( dc = 0; dc < numdel; dc++ )
+                for( dc = 0; dc < ctx->numdel; dc++ )
                     if( t - tau[dc] > grid[gridsize - 1] ) {
                         CE( t - tau[dc], vd[vc][dc], grid[gridsize - 1], vdone[gridsize - 1], ech, drv1, drv2, drv3, drv4, n );
 
@@ -3437,6 +3980,7 @@ DCERk32( double **vatt, int n, double *tarray, int tpoints, double *darray, int
     const double SAFETY = 0.9;  /* safety margin for decrsg stepsize */
     const double ERRCON = 5.832e-3;     /* to prevent huge jumps, see
                                            num recipes pg. 719 */
+    ModelContext *ctx = &( inp->ctx );  /* delays and grid of past states */
 
 
 
@@ -3475,8 +4019,8 @@ DCERk32( double **vatt, int n, double *tarray, int tpoints, double *darray, int
     v[1] = ( double * ) calloc( n, sizeof( double ) );
 
     for( vc = 0; vc < 4; vc++ ) {
-        v_delayed[vc] = ( double ** ) calloc( numdel, sizeof( double * ) );
-        for( dc = 0; dc < numdel; dc++ )
+        v_delayed[vc] = ( double ** ) calloc( ctx->numdel, sizeof( double * ) );
+        for( dc = 0; dc < ctx->numdel; dc++ )
             v_delayed[vc][dc] = ( double * ) calloc( n, sizeof( double ) );
     }
 
@@ -3485,43 +4029,43 @@ DCERk32( double **vatt, int n, double *tarray, int tpoints, double *darray, int
     vnext = v[0];
 
     /* allocate more grid and derivs */
-    gridpos++;
-    if( !( tdone = ( double * ) realloc( tdone, ( gridpos + 1 ) * sizeof( double ) ) ) ) {
+    ctx->gridpos++;
+    if( !( ctx->tdone = ( double * ) realloc( ctx->tdone, ( ctx->gridpos + 1 ) * sizeof( double ) ) ) ) {
         printf( "Could not allocate memory for tdone\n" );
         exit( 1 );
     }
 
-    if( !( vdonne = ( double ** ) realloc( vdonne, ( gridpos + 1 ) * sizeof( double * ) ) ) ) {
+    if( !( ctx->vdonne = ( double ** ) realloc( ctx->vdonne, ( ctx->gridpos + 1 ) * sizeof( double * ) ) ) ) {
         printf( "Could not allocate memory for vdonne\n" );
         exit( 1 );
     }
 
-    if( !( derivv1 = ( double ** ) realloc( derivv1, ( gridpos + 1 ) * sizeof( double * ) ) ) ) {
+    if( !( ctx->derivv1 = ( double ** ) realloc( ctx->derivv1, ( ctx->gridpos + 1 ) * sizeof( double * ) ) ) ) {
         printf( "Could not allocate memory for derivv1\n" );
         exit( 1 );
     }
 
-    if( !( derivv2 = ( double ** ) realloc( derivv2, ( gridpos + 1 ) * sizeof( double * ) ) ) ) {
+    if( !( ctx->derivv2 = ( double ** ) realloc( ctx->derivv2, ( ctx->gridpos + 1 ) * sizeof( double * ) ) ) ) {
         printf( "Could not allocate memory for derivv2\n" );
         exit( 1 );
     }
 
-    if( !( derivv3 = ( double ** ) realloc( derivv3, ( gridpos + 1 ) * sizeof( double * ) ) ) ) {
+    if( !( ctx->derivv3 = ( double ** ) realloc( ctx->derivv3, ( ctx->gridpos + 1 ) * sizeof( double * ) ) ) ) {
         printf( "Could not allocate memory for derivv3 \n" );
         exit( 1 );
     }
 
-    if( !( derivv4 = ( double ** ) realloc( derivv4, ( gridpos + 1 ) * sizeof( double * ) ) ) ) {
+    if( !( ctx->derivv4 = ( double ** ) realloc( ctx->derivv4, ( ctx->gridpos + 1 ) * sizeof( double * ) ) ) ) {
         printf( "Could not allocate memory for derivv4\n" );
         exit( 1 );
     }
-    derivv1[gridpos] = ( double * ) calloc( n, sizeof( double ) );
-    derivv2[gridpos] = ( double * ) calloc( n, sizeof( double ) );
-    derivv3[gridpos] = ( double * ) calloc( n, sizeof( double ) );
-    derivv4[gridpos] = ( double * ) calloc( n, sizeof( double ) );
-    vdonne[gridpos] = ( double * ) calloc( n, sizeof( double ) );
-    tdone[gridpos] = t;
-    memcpy( vdonne[gridpos], vnow, sizeof( *vnow ) * n );
+    ctx->derivv1[ctx->gridpos] = ( double * ) calloc( n, sizeof( double ) );
+    ctx->derivv2[ctx->gridpos] = ( double * ) calloc( n, sizeof( double ) );
+    ctx->derivv3[ctx->gridpos] = ( double * ) calloc( n, sizeof( double ) );
+    ctx->derivv4[ctx->gridpos] = ( double * ) calloc( n, sizeof( double ) );
+    ctx->vdonne[ctx->gridpos] = ( double * ) calloc( n, sizeof( double ) );
+    ctx->tdone[ctx->gridpos] = t;
+    memcpy( ctx->vdonne[ctx->gridpos], vnow, sizeof( *vnow ) * n );
 
 
     /* initial stepsize cannot be bigger than total time */
@@ -3543,7 +4087,7 @@ DCERk32( double **vatt, int n, double *tarray, int tpoints, double *darray, int
             DISCON = 1;
         }
 
-    if( ( h > mindel ) && ( h <= 2. * mindel ) ) {
+    if( ( h > ctx->mindel ) && ( h <= 2. * ctx->mindel ) ) {
 
         if( DISCON ) {
 
@@ -3562,7 +4106,7 @@ DCERk32( double **vatt, int n, double *tarray, int tpoints, double *darray, int
     /* we need to calculate derivv1 only the first time, since if the
        previous step was a success, we can use the last derivv4, and if it is
        was a failure, we don't have to recalculate it */
-    while( y_delayed( v_delayed, n, tms, delay, tdone, vdonne, derivv1, derivv2, derivv3, derivv4, gridpos + 1, accuracy, si, inp ) ) {
+    while( y_delayed( v_delayed, n, tms, ctx->delay, ctx->tdone, ctx->vdonne, ctx->derivv1, ctx->derivv2, ctx->derivv3, ctx->derivv4, ctx->gridpos + 1, accuracy, si, inp ) ) {
         printf( "Rejected Iteration for [%f,%f]!\n", t, t + h );
         h = 0.5 * h;
         tms[0] = t;
@@ -3579,7 +4123,7 @@ DCERk32( double **vatt, int n, double *tarray, int tpoints, double *darray, int
         }
     }
 
-    d_deriv( vnow, v_delayed[0], t, derivv1[gridpos], n, si, inp );
+    d_deriv( vnow, v_delayed[0], t, ctx->derivv1[ctx->gridpos], n, si, inp );
 
     while( t < tarray[tpoints - 1] ) {
 
@@ -3593,35 +4137,35 @@ DCERk32( double **vatt, int n, double *tarray, int tpoints, double *darray, int
             tms[2] = t + a3 * h;
             tms[3] = t + h;
 
-            if( !y_delayed( v_delayed, n, tms, delay, tdone, vdonne, derivv1, derivv2, derivv3, derivv4, gridpos + 1, accuracy, si, inp ) ) {
+            if( !y_delayed( v_delayed, n, tms, ctx->delay, ctx->tdone, ctx->vdonne, ctx->derivv1, ctx->derivv2, ctx->derivv3, ctx->derivv4, ctx->gridpos + 1, accuracy, si, inp ) ) {
 
                 /* do the Runge-Kutta thing here: calulate intermediate 
                    derivatives */
                 for( i = 0; i < n; i++ )
-                    vtemp[i] = vnow[i] + h * ( b21 * derivv1[gridpos][i] );
+                    vtemp[i] = vnow[i] + h * ( b21 * ctx->derivv1[ctx->gridpos][i] );
 
-                d_deriv( vtemp, v_delayed[1], t + a2 * h, derivv2[gridpos], n, si, inp );
+                d_deriv( vtemp, v_delayed[1], t + a2 * h, ctx->derivv2[ctx->gridpos], n, si, inp );
 
                 for( i = 0; i < n; i++ )
-                    vtemp[i] = vnow[i] + h * ( b32 * derivv2[gridpos][i] );
+                    vtemp[i] = vnow[i] + h * ( b32 * ctx->derivv2[ctx->gridpos][i] );
 
-                d_deriv( vtemp, v_delayed[2], t + a3 * h, derivv3[gridpos], n, si, inp );
+                d_deriv( vtemp, v_delayed[2], t + a3 * h, ctx->derivv3[ctx->gridpos], n, si, inp );
 
                 /* ... then feed them to the Rk32 formula */
 
                 for( i = 0; i < n; i++ )
-                    vnext[i] = vnow[i] + h * ( c1 * derivv1[gridpos][i] + c2 * derivv2[gridpos][i] + c3 * derivv3[gridpos][i] );
+                    vnext[i] = vnow[i] + h * ( c1 * ctx->derivv1[ctx->gridpos][i] + c2 * ctx->derivv2[ctx->gridpos][i] + c3 * ctx->derivv3[ctx->gridpos][i] );
 
                 /* Now calculate k4 for the embedded 4-stage formula, if this step is
                    succesful, it will get used as derivv1 (k1) in the next step */
                 //              for (i=0; i<10; i++) {
                 //                  printf("%d gridpos=%d; derivv1=%lg; derivv2=%lg; derivv3=%lg; h=%lg\n", i, gridpos, derivv1[gridpos][i], derivv2[gridpos][i], derivv3[gridpos][i], h);
                 //              }
-                d_deriv( vnext, v_delayed[3], t + h, derivv4[gridpos], n, si, inp );
+                d_deriv( vnext, v_delayed[3], t + h, ctx->derivv4[ctx->gridpos], n, si, inp );
                 /* calculate the error estimate using the embedded formula */
 
                 for( i = 0; i < n; i++ ) {
-                    verror[i] = h * ( dc1 * derivv1[gridpos][i] + dc2 * derivv2[gridpos][i] + dc3 * derivv3[gridpos][i] + dc4 * derivv4[gridpos][i] );
+                    verror[i] = h * ( dc1 * ctx->derivv1[ctx->gridpos][i] + dc2 * ctx->derivv2[ctx->gridpos][i] + dc3 * ctx->derivv3[ctx->gridpos][i] + dc4 * ctx->derivv4[ctx->gridpos][i] );
                 }
                 //printf("verror=%lg, h=%lg, dc1=%lg, deriv1=%lg, dc2=%lg, deriv2=%lg, dc3=%lg, deriv3=%lg, dc4=%lg, deriv4=%lg\n", verror[0], h, dc1, derivv1[gridpos][0], dc2, derivv2[gridpos][0], dc3, derivv3[gridpos][0], dc4, derivv4[gridpos][0]);
                 /* find the maximum error */
@@ -3672,7 +4216,7 @@ DCERk32( double **vatt, int n, double *tarray, int tpoints, double *darray, int
 
                 h = ( hnext > 0.1 * h ) ? hnext : 0.1 * h;
 
-                if( ( h > mindel ) && ( h <= 2. * mindel ) ) {
+                if( ( h > ctx->mindel ) && ( h <= 2. * ctx->mindel ) ) {
 
                     if( DISCON ) {
 
@@ -3694,7 +4238,7 @@ DCERk32( double **vatt, int n, double *tarray, int tpoints, double *darray, int
                 /*              printf("Rejected Iteration for [%f,%f]!\n",t,t+h); */
                 h = 0.5 * h;
 
-                if( ( h > mindel ) && ( h <= 2. * mindel ) )
+                if( ( h > ctx->mindel ) && ( h <= 2. * ctx->mindel ) )
                     h = .5 * h;
 
                 if( DISCON ) {
@@ -3723,7 +4267,7 @@ DCERk32( double **vatt, int n, double *tarray, int tpoints, double *darray, int
            exchange the pointers */
         while( ( tarray[tpos] < t + h ) && ( tpos < tpoints ) ) {
 
-            CE( tarray[tpos], vatt[tpos], t, vnow, h, derivv1[gridpos], derivv2[gridpos], derivv3[gridpos], derivv4[gridpos], n );
+            CE( tarray[tpos], vatt[tpos], t, vnow, h, ctx->derivv1[ctx->gridpos], ctx->derivv2[ctx->gridpos], ctx->derivv3[ctx->gridpos], ctx->derivv4[ctx->gridpos], n );
             /*          printf("Vatt: %d %f %f %f %f %f\n",
                tpos,tarray[tpos],vatt[tpos][0],vnow[0],t,t+h); */
 
@@ -3783,7 +4327,7 @@ DCERk32( double **vatt, int n, double *tarray, int tpoints, double *darray, int
             }
 
 
-        if( ( h > mindel ) && ( h <= 2. * mindel ) ) {
+        if( ( h > ctx->mindel ) && ( h <= 2. * ctx->mindel ) ) {
 
             if( DISCON ) {
 
@@ -3798,56 +4342,56 @@ DCERk32( double **vatt, int n, double *tarray, int tpoints, double *darray, int
 
         /* allocate more grid and derivs */
 
-        gridpos++;
-        if( !( tdone = ( double * ) realloc( tdone, ( gridpos + 1 ) * sizeof( double ) ) ) ) {
+        ctx->gridpos++;
+        if( !( ctx->tdone = ( double * ) realloc( ctx->tdone, ( ctx->gridpos + 1 ) * sizeof( double ) ) ) ) {
             printf( "Could not allocate memory for tdone\n" );
             exit( 1 );
         }
 
-        if( !( vdonne = ( double ** ) realloc( vdonne, ( gridpos + 1 ) * sizeof( double * ) ) ) ) {
+        if( !( ctx->vdonne = ( double ** ) realloc( ctx->vdonne, ( ctx->gridpos + 1 ) * sizeof( double * ) ) ) ) {
             printf( "Could not allocate memory for vdonne\n" );
             exit( 1 );
         }
 
-        if( !( derivv1 = ( double ** ) realloc( derivv1, ( gridpos + 1 ) * sizeof( double * ) ) ) ) {
+        if( !( ctx->derivv1 = ( double ** ) realloc( ctx->derivv1, ( ctx->gridpos + 1 ) * sizeof( double * ) ) ) ) {
             printf( "Could not allocate memory for derivv1\n" );
             exit( 1 );
         }
 
-        if( !( derivv2 = ( double ** ) realloc( derivv2, ( gridpos + 1 ) * sizeof( double * ) ) ) ) {
+        if( !( ctx->derivv2 = ( double ** ) realloc( ctx->derivv2, ( ctx->gridpos + 1 ) * sizeof( double * ) ) ) ) {
             printf( "Could not allocate memory for derivv2\n" );
             exit( 1 );
         }
 
-        if( !( derivv3 = ( double ** ) realloc( derivv3, ( gridpos + 1 ) * sizeof( double * ) ) ) ) {
+        if( !( ctx->derivv3 = ( double ** ) realloc( ctx->derivv3, ( ctx->gridpos + 1 ) * sizeof( double * ) ) ) ) {
             printf( "Could not allocate memory for derivv3 \n" );
             exit( 1 );
         }
 
-        if( !( derivv4 = ( double ** ) realloc( derivv4, ( gridpos + 1 ) * sizeof( double * ) ) ) ) {
+        if( !( ctx->derivv4 = ( double ** ) realloc( ctx->derivv4, ( ctx->gridpos + 1 ) * sizeof( double * ) ) ) ) {
             printf( "Could not allocate memory for derivv4\n" );
             exit( 1 );
         }
-        derivv1[gridpos] = ( double * ) calloc( n, sizeof( double ) );
-        derivv2[gridpos] = ( double * ) calloc( n, sizeof( double ) );
-        derivv3[gridpos] = ( double * ) calloc( n, sizeof( double ) );
-        derivv4[gridpos] = ( double * ) calloc( n, sizeof( double ) );
-        vdonne[gridpos] = ( double * ) calloc( n, sizeof( double ) );
-        tdone[gridpos] = t;
-
-        if( t - maxdel > tdone[0] ) {
-            while( t - maxdel >= tdone[gridstart] )
-                gridstart++;
-
-            gridstart--;
+        ctx->derivv1[ctx->gridpos] = ( double * ) calloc( n, sizeof( double ) );
+        ctx->derivv2[ctx->gridpos] = ( double * ) calloc( n, sizeof( double ) );
+        ctx->derivv3[ctx->gridpos] = ( double * ) calloc( n, sizeof( double ) );
+        ctx->derivv4[ctx->gridpos] = ( double * ) calloc( n, sizeof( double ) );
+        ctx->vdonne[ctx->gridpos] = ( double * ) calloc( n, sizeof( double ) );
+        ctx->tdone[ctx->gridpos] = t;
+
+        if( t - ctx->maxdel > ctx->tdone[0] ) {
+            while( t - ctx->maxdel >= ctx->tdone[ctx->gridstart] )
+                ctx->gridstart++;
+
+            ctx->gridstart--;
         }
 
-        memcpy( vdonne[gridpos], vnow, sizeof( *vnow ) * n );
+        memcpy( ctx->vdonne[ctx->gridpos], vnow, sizeof( *vnow ) * n );
 
 
         /* put present derivv4 into future derivv1 */
 
-        memcpy( derivv1[gridpos], derivv4[gridpos - 1], sizeof( **derivv4 ) * n );
+        memcpy( ctx->derivv1[ctx->gridpos], ctx->derivv4[ctx->gridpos - 1], sizeof( **ctx->derivv4 ) * n );
     }
 
     /*       for (j=0; j<=gridpos;j++)
@@ -3874,15 +4418,15 @@ DCERk32( double **vatt, int n, double *tarray, int tpoints, double *darray, int
     free( v[1] );
 
     for( vc = 0; vc < 4; vc++ ) {
-        for( dc = 0; dc < numdel; dc++ )
+        for( dc = 0; dc < ctx->numdel; dc++ )
             free( v_delayed[vc][dc] );
         free( v_delayed[vc] );
     }
 
     /* Put zeroes in derivv1[gridpos], all the rest are zero anyways */
 
-    free( derivv1[gridpos] );
-    derivv1[gridpos] = ( double * ) calloc( n, sizeof( double ) );
+    free( ctx->derivv1[ctx->gridpos] );
+    ctx->derivv1[ctx->gridpos] = ( double * ) calloc( n, sizeof( double ) );
 
 
     free( v );
@@ -3892,84 +4436,86 @@ DCERk32( double **vatt, int n, double *tarray, int tpoints, double *darray, int
 }
 
 void
-FreeDelaySolver( void ) {
+FreeDelaySolver( ModelContext * ctx ) {
 
     int j;
 
-    for( j = 0; j <= gridpos; j++ ) {
-        free( derivv1[j] );
-        free( derivv2[j] );
-        free( derivv3[j] );
-        free( derivv4[j] );
-        free( vdonne[j] );
+    for( j = 0; j <= ctx->gridpos; j++ ) {
+        free( ctx->derivv1[j] );
+        free( ctx->derivv2[j] );
+        free( ctx->derivv3[j] );
+        free( ctx->derivv4[j] );
+        free( ctx->vdonne[j] );
     }
 
-    free( derivv1 );
-    free( derivv2 );
-    free( derivv3 );
-    free( derivv4 );
-    free( vdonne );
-    free( tdone );
+    free( ctx->derivv1 );
+    free( ctx->derivv2 );
+    free( ctx->derivv3 );
+    free( ctx->derivv4 );
+    free( ctx->vdonne );
+    free( ctx->tdone );
 
 }
 
 void
-InitDelaySolver( void ) {
+InitDelaySolver( ModelContext * ctx ) {
 
-    gridpos = -1;
-    gridstart = 0;
-    tdone = NULL;
-    vdonne = NULL;
-    derivv1 = NULL;
-    derivv2 = NULL;
-    derivv3 = NULL;
-    derivv4 = NULL;
+    ctx->gridpos = -1;
+    ctx->gridstart = 0;
+    ctx->tdone = NULL;
+    ctx->vdonne = NULL;
+    ctx->derivv1 = NULL;
+    ctx->derivv2 = NULL;
+    ctx->derivv3 = NULL;
+    ctx->derivv4 = NULL;
 
 }
 
 void
-DivideHistory( double t1, double t2, Zygote * zyg ) {
+DivideHistory( double t1, double t2, Input * inp ) {
     double *blug;
     int i, size;
+    ModelContext *ctx = &( inp->ctx );
+    Zygote *zyg = &( inp->zyg );
 
     if( ( size =
           GetNNucs( &( zyg->defs ), zyg->nnucs, t2, &( zyg->times ) ) * zyg->defs.ngenes ) > GetNNucs( &( zyg->defs ), zyg->nnucs, t1,
                                                                                                        &( zyg->times ) ) * zyg->defs.ngenes )
-        for( i = 0; i <= gridpos; i++ ) {
+        for( i = 0; i <= ctx->gridpos; i++ ) {
             blug = ( double * ) calloc( size, sizeof( double ) );
-            Go_Forward( blug, vdonne[i], GetStartLinIndex( t2, &( zyg->defs ), &( zyg->times ) ), GetStartLinIndex( t1, &( zyg->defs ), &( zyg->times ) ), zyg,
+            Go_Forward( blug, ctx->vdonne[i], GetStartLinIndex( t2, &( zyg->defs ), &( zyg->times ) ), GetStartLinIndex( t1, &( zyg->defs ), &( zyg->times ) ), zyg,
                         zyg->defs.ngenes );
 
-            free( vdonne[i] );
-            vdonne[i] = blug;
+            free( ctx->vdonne[i] );
+            ctx->vdonne[i] = blug;
 
             blug = ( double * ) calloc( size, sizeof( double ) );
-            Go_Forward( blug, derivv1[i], GetStartLinIndex( t2, &( zyg->defs ), &( zyg->times ) ), GetStartLinIndex( t1, &( zyg->defs ), &( zyg->times ) ), zyg,
+            Go_Forward( blug, ctx->derivv1[i], GetStartLinIndex( t2, &( zyg->defs ), &( zyg->times ) ), GetStartLinIndex( t1, &( zyg->defs ), &( zyg->times ) ), zyg,
                         zyg->defs.ngenes );
 
-            free( derivv1[i] );
-            derivv1[i] = blug;
+            free( ctx->derivv1[i] );
+            ctx->derivv1[i] = blug;
 
             blug = ( double * ) calloc( size, sizeof( double ) );
-            Go_Forward( blug, derivv2[i], GetStartLinIndex( t2, &( zyg->defs ), &( zyg->times ) ), GetStartLinIndex( t1, &( zyg->defs ), &( zyg->times ) ), zyg,
+            Go_Forward( blug, ctx->derivv2[i], GetStartLinIndex( t2, &( zyg->defs ), &( zyg->times ) ), GetStartLinIndex( t1, &( zyg->defs ), &( zyg->times ) ), zyg,
                         zyg->defs.ngenes );
 
-            free( derivv2[i] );
-            derivv2[i] = blug;
+            free( ctx->derivv2[i] );
+            ctx->derivv2[i] = blug;
 
             blug = ( double * ) calloc( size, sizeof( double ) );
-            Go_Forward( blug, derivv3[i], GetStartLinIndex( t2, &( zyg->defs ), &( zyg->times ) ), GetStartLinIndex( t1, &( zyg->defs ), &( zyg->times ) ), zyg,
+            Go_Forward( blug, ctx->derivv3[i], GetStartLinIndex( t2, &( zyg->defs ), &( zyg->times ) ), GetStartLinIndex( t1, &( zyg->defs ), &( zyg->times ) ), zyg,
                         zyg->defs.ngenes );
 
-            free( derivv3[i] );
-            derivv3[i] = blug;
+            free( ctx->derivv3[i] );
+            ctx->derivv3[i] = blug;
 
             blug = ( double * ) calloc( size, sizeof( double ) );
-            Go_Forward( blug, derivv4[i], GetStartLinIndex( t2, &( zyg->defs ), &( zyg->times ) ), GetStartLinIndex( t1, &( zyg->defs ), &( zyg->times ) ), zyg,
+            Go_Forward( blug, ctx->derivv4[i], GetStartLinIndex( t2, &( zyg->defs ), &( zyg->times ) ), GetStartLinIndex( t1, &( zyg->defs ), &( zyg->times ) ), zyg,
                         zyg->defs.ngenes );
 
-            free( derivv4[i] );
-            derivv4[i] = blug;
+            free( ctx->derivv4[i] );
+            ctx->derivv4[i] = blug;
 
         }
 
@@ -4269,15 +4815,15 @@ void FreeExtraData(ExtraData edata) {   //needed by the old Krylov solver
 */
 
 int
-InitKrylovVariables( double *vin, int n ) {
+InitKrylovVariables( ModelContext * ctx, double *vin, int n ) {
 
     int i;
 
-    vars = N_VNew_Serial( n );
-    if( CheckFlag( ( void * ) vars, "N_VNew_Serial", 0 ) )
+    ctx->vars = N_VNew_Serial( n );
+    if( CheckFlag( ( void * ) ctx->vars, "N_VNew_Serial", 0 ) )
         return 1;
     for( i = 0; i < n; ++i ) {
-        NV_Ith_S( vars, i ) = vin[i];
+        NV_Ith_S( ctx->vars, i ) = vin[i];
     }
     return 0;
 }
@@ -4306,39 +4852,18 @@ CheckFlag( void *flagvalue, char *funcname, int opt ) {
     return 0;
 }
 
-/**  Direct Band: propagates vin (of size n) from tin to tout by BDF (Backward  
- *           Differential Formulas and use of a Newton-Krylov method with  
- *           preconditioning to avoid the costly computation of the        
- *           jacobian.                                                     
- ***************************************************************************
- *                                                                         
- * This solver was written by Anton Crombach, October 2010                 
- *                                                                          
- * I realised I cannot evaluate only part of the derivative (f.i. only the
- * production/decay part)... so let's see what happens if I evaluate the full
- * derivative for preconditioning. That actually works better.
- * 
- * This is actually the Direct Band solver. */
-void
-Band( double *vin, double *vout, double tin, double tout, double stephint, double accuracy, int n, FILE * slog, SolverInput * sinput, Input * input ) {
-    int flag, i, j;
-    realtype t, tstop;
+/** GetStopTime: the CVODE solvers look ahead and then get confused by the 
+ *                change in number of equations, so we need to set a stop  
+ *                time beyond which they are not allowed to look; that is  
+ *                the next division (or the mitosis before it) or else     
+ *                gastrulation                                             
+ */
+static realtype
+GetStopTime( double tout, Input * inp ) {
+    int i, j;
     double *divtimes, *divdurations;
-    inp = input;
-    si = sinput;
-
-    /* If nothing to do, return */
-    if( fabs( tin - tout ) < 1e-6 )
-        return;
-    if( cvode_mem != 0 ) {
-        FreeBandSolver(  );
-    }
-    InitKrylovVariables( vin, n );
-    InitBandSolver( tin, stephint, accuracy, accuracy );
+    realtype tstop;
 
-    /* Band solver looks ahead and then gets confused by the change
-       in number of equations, so we need to set a stop time beyond which it
-       is not allowed to look */
     i = inp->zyg.defs.ndivs - 1;
     j = -1;
 
@@ -4361,42 +4886,266 @@ Band( double *vin, double *vout, double tin, double tout, double stephint, doubl
         // otherwise don't look beyond gastrulation
         tstop = inp->zyg.times.gast_time;
     }
-    CVodeSetStopTime( cvode_mem, tstop );
+    return tstop;
+}
+
+/* the linear solvers the CVODE memory of a ModelContext can have */
+enum {
+    NoLinSolver,                /* none yet */
+    BandLinSolver,              /* CVBand with difference quotients */
+    BandJacLinSolver,           /* CVBand with JacobnBand (-J) */
+    KrylovLinSolver             /* CVSpgmr with the block preconditioner */
+};
+
+/** CanReuseSolver: the CVODE memory in ctx can be reinitialized (rather 
+ *                   than created again) if it is for n equations, has the 
+ *                   linear solver lsolver and, if we want sensitivities,  
+ *                   has none yet or the same number                       
+ */
+static int
+CanReuseSolver( ModelContext * ctx, int n, int lsolver ) {
+    if( ( ctx->cvode_mem == NULL ) || ( NV_LENGTH_S( ctx->vars ) != n ) || ( ctx->cvode_lsolver != lsolver ) )
+        return 0;
+    return ( ctx->sens.np == 0 ) || ( ctx->sens.nyS == 0 ) || ( ctx->sens.nyS == ctx->sens.np );
+}
+
+/** InitSensitivities: (re)starts the forward sensitivities of the CVODE   
+ *                      memory in inp->ctx from ctx->sens.sin after the solver  
+ *                      has been (re)initialized, or switches them off if  
+ *                      we don't want any this time; the sensitivities get 
+ *                      the tolerances of the state and are part of the    
+ *                      error test                                         
+ */
+static int
+InitSensitivities( Input * inp ) {
+    ModelContext *ctx = &( inp->ctx );
+    Sensitivity *sens = &( ctx->sens );
+    int n = NV_LENGTH_S( ctx->vars );
+    int flag, p, i;
+
+    if( sens->np == 0 ) {
+        if( sens->nyS > 0 ) {
+            flag = CVodeSensToggleOff( ctx->cvode_mem );
+            if( CheckFlag( &flag, "CVodeSensToggleOff", 1 ) )
+                return 1;
+        }
+        return 0;
+    }
+
+    if( sens->nyS == 0 ) {
+        sens->yS = N_VCloneVectorArray_Serial( sens->np, ctx->vars );
+        if( CheckFlag( ( void * ) sens->yS, "N_VCloneVectorArray_Serial", 0 ) )
+            return 1;
+        sens->sp = ( double ** ) calloc( sens->np, sizeof( double * ) );
+        sens->sdot = ( double ** ) calloc( sens->np, sizeof( double * ) );
+        sens->dD = ( double * ) calloc( 2 * inp->zyg.defs.ngenes, sizeof( double ) );
+    }
+    for( p = 0; p < sens->np; p++ )
+        for( i = 0; i < n; i++ )
+            NV_Ith_S( sens->yS[p], i ) = sens->sin[p * n + i];
+
+    if( sens->nyS == 0 ) {
+        flag = CVodeSensInit( ctx->cvode_mem, sens->np, CV_STAGGERED, my_fs_band, sens->yS );
+        if( CheckFlag( &flag, "CVodeSensInit", 1 ) )
+            return 1;
+        sens->nyS = sens->np;
+    } else {
+        flag = CVodeSensReInit( ctx->cvode_mem, CV_STAGGERED, sens->yS );
+        if( CheckFlag( &flag, "CVodeSensReInit", 1 ) )
+            return 1;
+    }
+    flag = CVodeSensEEtolerances( ctx->cvode_mem );
+    if( CheckFlag( &flag, "CVodeSensEEtolerances", 1 ) )
+        return 1;
+    flag = CVodeSetSensErrCon( ctx->cvode_mem, TRUE );
+    if( CheckFlag( &flag, "CVodeSetSensErrCon", 1 ) )
+        return 1;
+    return 0;
+}
+
+/** GetSensitivities: copies the sensitivities at the end of a step into 
+ *                     ctx->sens.sout (if we want any)                     
+ */
+static void
+GetSensitivities( ModelContext * ctx ) {
+    Sensitivity *sens = &( ctx->sens );
+    int n = NV_LENGTH_S( ctx->vars );
+    int flag, p, i;
+    realtype t;
+
+    if( sens->np == 0 )
+        return;
+    flag = CVodeGetSens( ctx->cvode_mem, &t, sens->yS );
+    if( CheckFlag( &flag, "CVodeGetSens", 1 ) )
+        return;
+    for( p = 0; p < sens->np; p++ )
+        for( i = 0; i < n; i++ )
+            sens->sout[p * n + i] = NV_Ith_S( sens->yS[p], i );
+}
+
+/**  Direct Band: propagates vin (of size n) from tin to tout by BDF (Backward  
+ *           Differential Formulas and use of a Newton-Krylov method with  
+ *           preconditioning to avoid the costly computation of the        
+ *           jacobian.                                                     
+ ***************************************************************************
+ *                                                                         
+ * This solver was written by Anton Crombach, October 2010                 
+ *                                                                          
+ * I realised I cannot evaluate only part of the derivative (f.i. only the
+ * production/decay part)... so let's see what happens if I evaluate the full
+ * derivative for preconditioning. That actually works better.
+ * 
+ * This is actually the Direct Band solver. */
+void
+Band( double *vin, double *vout, double tin, double tout, double stephint, double accuracy, int n, FILE * slog, SolverInput * si, Input * inp ) {
+    int flag, i;
+    realtype t;
+    ModelContext *ctx = &( inp->ctx );  /* holds the CVODE memory */
+
+    ctx->si = si;               /* for my_f_band */
+
+    /* If nothing to do, return */
+    if( fabs( tin - tout ) < 1e-6 )
+        return;
+
+    /* the solver (and its band matrix) can be kept for as long as the     *
+     * number of equations stays the same, i.e. until the next division;   *
+     * CVodeReInit can't change the size, so then we start from scratch    */
+    if( CanReuseSolver( ctx, n, bandjac ? BandJacLinSolver : BandLinSolver ) ) {
+        for( i = 0; i < n; ++i ) {
+            NV_Ith_S( ctx->vars, i ) = vin[i];
+        }
+        if( ReInitBandSolver( inp, tin, stephint, accuracy, accuracy ) )
+            return;
+    } else {
+        FreeBandSolver( ctx );
+        InitKrylovVariables( ctx, vin, n );
+        InitBandSolver( inp, tin, stephint, accuracy, accuracy );
+    }
+    if( InitSensitivities( inp ) )
+        return;
+
+    /* Band solver looks ahead and then gets confused by the change
+       in number of equations, so we need to set a stop time beyond which it
+       is not allowed to look */
+    CVodeSetStopTime( ctx->cvode_mem, GetStopTime( tout, inp ) );
     /* old code, works if networks would always be well-behaved */
-    flag = CVode( cvode_mem, tout, vars, &t, CV_NORMAL );
+    flag = CVode( ctx->cvode_mem, tout, ctx->vars, &t, CV_NORMAL );
     if( CheckFlag( &flag, "CVode", 1 ) )
         return;
     /* copy vars into vout */
     for( i = 0; i < n; ++i ) {
-        vout[i] = NV_Ith_S( vars, i );
+        vout[i] = NV_Ith_S( ctx->vars, i );
     }
+    GetSensitivities( ctx );
 }
 
-/** wrapper function - to call the derivative */
+/** wrapper function - to call the derivative; CVODE hands us the Input 
+ *  we registered with CVodeSetUserData in InitBandSolver               
+ */
 int
 my_f_band( realtype t, N_Vector y, N_Vector ydot, void *extra_data ) {  
     
     int n = NV_LENGTH_S( y );
-    p_deriv( NV_DATA_S( y ), t, NV_DATA_S( ydot ), n, si, inp );
+    Input *inp = ( Input * ) extra_data;
+    p_deriv( NV_DATA_S( y ), t, NV_DATA_S( ydot ), n, inp->ctx.si, inp );
+    return 0;
+}
+
+/** wrapper function - to call DvdpOrig for the sensitivities of all     
+ *  parameters at once (CVODES hands us the Input, just like my_f_band)  
+ */
+int
+my_fs_band( int Ns, realtype t, N_Vector y, N_Vector ydot, N_Vector * yS, N_Vector * ySdot, void *extra_data, N_Vector tmp1,
+            N_Vector tmp2 ) {
+    Input *inp = ( Input * ) extra_data;
+    Sensitivity *sens = &( inp->ctx.sens );
+    int p;
+
+    for( p = 0; p < Ns; p++ ) {
+        sens->sp[p] = NV_DATA_S( yS[p] );
+        sens->sdot[p] = NV_DATA_S( ySdot[p] );
+    }
+    DvdpOrig( t, NV_DATA_S( y ), NV_LENGTH_S( y ), Ns, sens->sp, sens->sdot, sens->parm, sens->live, sens->dD, inp->ctx.si, inp );
+    return 0;
+}
+
+/** CheckBandJac: debugging aid for my_jac_band; compares the analytic   
+ *                 Jacobian in J with finite differences of the derivative 
+ *                 and prints the largest difference (relative to the      
+ *                 largest element of the column); y is used as scratch    
+ *                 and restored, ydot is scratch too                       
+ */
+static void
+CheckBandJac( realtype t, N_Vector y, N_Vector fy, DlsMat J, N_Vector ydot, Input * inp ) {
+    int n = NV_LENGTH_S( y );
+    int i, j, imax = 0, jmax = 0;
+    double *v = NV_DATA_S( y );
+    double *f = NV_DATA_S( fy );
+    double *fd = NV_DATA_S( ydot );
+    double yj, dy, an, colmax, err, maxerr = 0.;
+
+    for( j = 0; j < n; j++ ) {
+        yj = v[j];
+        dy = sqrt( DBL_EPSILON ) * DMAX( fabs( yj ), 1. );
+        v[j] = yj + dy;
+        p_deriv( v, t, fd, n, inp->ctx.si, inp );
+        v[j] = yj;
+        colmax = 0.;
+        for( i = 0; i < n; i++ ) {
+            fd[i] = ( fd[i] - f[i] ) / dy;
+            colmax = DMAX( colmax, fabs( fd[i] ) );
+        }
+        for( i = 0; i < n; i++ ) {
+            an = ( abs( i - j ) <= J->mu ) ? BAND_ELEM( J, i, j ) : 0.;
+            err = fabs( an - fd[i] ) / DMAX( colmax, 1. );
+            if( err > maxerr ) {
+                maxerr = err;
+                imax = i;
+                jmax = j;
+            }
+        }
+    }
+    printf( "my_jac_band: t = %g, n = %d, max. difference to finite differences %g at (%d,%d)\n", t, n, maxerr, imax, jmax );
+}
+
+/** wrapper function - to call JacobnBand; CVODE zeroes J before it     
+ *  calls us, and gives us the Input we registered in InitBandSolver   
+ */
+int
+my_jac_band( long int N, long int mupper, long int mlower, realtype t, N_Vector y, N_Vector fy, DlsMat J, void *extra_data,
+             N_Vector tmp1, N_Vector tmp2, N_Vector tmp3 ) {
+    Input *inp = ( Input * ) extra_data;
+
+    JacobnBand( t, NV_DATA_S( y ), N, J->cols, J->s_mu, inp->ctx.si, inp );
+    if( debug )
+        CheckBandJac( t, y, fy, J, tmp1, inp );
     return 0;
 }
 
 int
-InitBandSolver( realtype tzero, double stephint, double rel_tol, double abs_tol ) {
+InitBandSolver( Input * inp, realtype tzero, double stephint, double rel_tol, double abs_tol ) {
     int flag;
-    neq = inp->zyg.defs.ngenes * GetNNucs( &( inp->zyg.defs ), inp->zyg.nnucs, tzero, &( inp->zyg.times ) );
-    cvode_mem = CVodeCreate( CV_BDF, CV_NEWTON );
-    if( CheckFlag( ( void * ) cvode_mem, "CVodeCreate", 0 ) ) {
+    ModelContext *ctx = &( inp->ctx );
+    ctx->neq = inp->zyg.defs.ngenes * GetNNucs( &( inp->zyg.defs ), inp->zyg.nnucs, tzero, &( inp->zyg.times ) );
+    ctx->cvode_mem = CVodeCreate( CV_BDF, CV_NEWTON );
+    if( CheckFlag( ( void * ) ctx->cvode_mem, "CVodeCreate", 0 ) ) {
         printf( "Error creating ODE solver\n" );
         return 1;
     }
+    __sync_fetch_and_add( &band_creates, 1 );
 
 
+    /* my_f_band needs the Input to call the derivative */
+    flag = CVodeSetUserData( ctx->cvode_mem, inp );
+    if( CheckFlag( &flag, "CVodeSetUserData", 1 ) )
+        return 1;
+
     /* Call CVodeInit to initialize the integrator memory and specify the
      * user's right hand side function, the inital time tzero, and
      * the initial dependent variable vector vars_
      */
-    flag = CVodeInit( cvode_mem, my_f_band, tzero, vars );
+    flag = CVodeInit( ctx->cvode_mem, my_f_band, tzero, ctx->vars );
     if( CheckFlag( &flag, "CVodeInit", 1 ) ) {
         printf( "Error setting up ODE solver\n" );
         return 1;
@@ -4405,37 +5154,578 @@ InitBandSolver( realtype tzero, double stephint, double rel_tol, double abs_tol
     /* Call CVodeSStolerances to specify the scalar relative tolerance
      * and scalar absolute tolerance
      */
-    flag = CVodeSStolerances( cvode_mem, rel_tol, abs_tol );
+    flag = CVodeSStolerances( ctx->cvode_mem, rel_tol, abs_tol );
     if( CheckFlag( &flag, "CVodeSStolerances", 1 ) ) {
         printf( "Error setting up tolerances\n" );
         return 1;
     }
 
-    flag = CVBand( cvode_mem, neq, inp->zyg.defs.ngenes + 1, inp->zyg.defs.ngenes + 1 );
+    flag = CVBand( ctx->cvode_mem, ctx->neq, inp->zyg.defs.ngenes + 1, inp->zyg.defs.ngenes + 1 );
     if( CheckFlag( &flag, "CVBand", 1 ) ) {
         printf( "Error setting band linear solver\n" );
         return 1;
     }
 
+    /* use the analytic Jacobian rather than finite differences */
+    if( bandjac ) {
+        flag = CVDlsSetBandJacFn( ctx->cvode_mem, my_jac_band );
+        if( CheckFlag( &flag, "CVDlsSetBandJacFn", 1 ) )
+            return 1;
+    }
+    ctx->cvode_lsolver = bandjac ? BandJacLinSolver : BandLinSolver;
+
     /* Set step size hint, pass 0.0 to use internal estimate */
     //stephint = 0.0;
-    CVodeSetInitStep( cvode_mem, stephint );
+    CVodeSetInitStep( ctx->cvode_mem, stephint );
 
     //printf( "Band Solver successfully (re)initialized\n" );
     return 0;
 }
 
+/** ReInitBandSolver: restarts the Band (or Krylov) solver in inp->ctx at 
+ *                     tzero from the values in ctx->vars, keeping its      
+ *                     memory and its linear solver; the size must not have 
+ *                     changed                                              
+ */
+int
+ReInitBandSolver( Input * inp, realtype tzero, double stephint, double rel_tol, double abs_tol ) {
+    int flag;
+    ModelContext *ctx = &( inp->ctx );
+
+    flag = CVodeReInit( ctx->cvode_mem, tzero, ctx->vars );
+    if( CheckFlag( &flag, "CVodeReInit", 1 ) ) {
+        printf( "Error reinitializing ODE solver\n" );
+        return 1;
+    }
+    __sync_fetch_and_add( &band_reinits, 1 );
+
+    /* the Input may have been copied since the solver was created */
+    flag = CVodeSetUserData( ctx->cvode_mem, inp );
+    if( CheckFlag( &flag, "CVodeSetUserData", 1 ) )
+        return 1;
+    flag = CVodeSStolerances( ctx->cvode_mem, rel_tol, abs_tol );
+    if( CheckFlag( &flag, "CVodeSStolerances", 1 ) ) {
+        printf( "Error setting up tolerances\n" );
+        return 1;
+    }
+    CVodeSetInitStep( ctx->cvode_mem, stephint );
+
+    return 0;
+}
+
+/** GetBandStats: returns how often the Band solver was created from      
+ *                 scratch and how often it was reinitialized instead      
+ */
+void
+GetBandStats( long *creates, long *reinits ) {
+    *creates = __sync_fetch_and_add( &band_creates, 0 );
+    *reinits = __sync_fetch_and_add( &band_reinits, 0 );
+}
+
 void
-FreeBandSolver( void ) {        //before initializing again
+FreeBandSolver( ModelContext * ctx ) {        //before initializing again
 
-    if( cvode_mem != NULL ) {
-        CVodeFree( &cvode_mem );
-        cvode_mem = NULL;
+    if( ctx->cvode_mem != NULL ) {
+        CVodeFree( &( ctx->cvode_mem ) );
+        ctx->cvode_mem = NULL;
     }
-    if( vars != NULL ) {
-        N_VDestroy_Serial( vars );
-        vars = NULL;
+    ctx->cvode_lsolver = NoLinSolver;
+    if( ctx->sens.nyS > 0 ) {
+        N_VDestroyVectorArray_Serial( ctx->sens.yS, ctx->sens.nyS );
+        free( ctx->sens.sp );
+        free( ctx->sens.sdot );
+        free( ctx->sens.dD );
+        ctx->sens.yS = NULL;
+        ctx->sens.sp = ctx->sens.sdot = NULL;
+        ctx->sens.dD = NULL;
+        ctx->sens.nyS = 0;
+    }
+    if( ctx->vars != NULL ) {
+        N_VDestroy_Serial( ctx->vars );
+        ctx->vars = NULL;
+    }
+}
+
+/**  Krylov: propagates vin (of size n) from tin to tout by BDF (Backward  
+ *           Differential Formulas), like Band, but solves the linear      
+ *           systems of the Newton iteration with preconditioned GMRES     
+ *           (CVSpgmr) instead of a band LU; the preconditioner is the     
+ *           block-tridiagonal I - gamma * J with the analytic Jacobian   
+ *           J of JacobnBand, i.e. the full gene-coupling block of each   
+ *           nucleus plus diffusion to the neighbours with the D's of the 
+ *           current cycle, factored by block Gaussian elimination        
+ *           (see PrecondKrylov below); solver memory is kept and         
+ *           reinitialized just like in Band                              
+ */
+void
+Krylov( double *vin, double *vout, double tin, double tout, double stephint, double accuracy, int n, FILE * slog, SolverInput * si, Input * inp ) {
+    int flag, i;
+    realtype t;
+    ModelContext *ctx = &( inp->ctx );  /* holds the CVODE memory */
+
+    ctx->si = si;               /* for my_f_band and the preconditioner */
+
+    /* If nothing to do, return */
+    if( fabs( tin - tout ) < 1e-6 )
+        return;
+
+    if( CanReuseSolver( ctx, n, KrylovLinSolver ) ) {
+        for( i = 0; i < n; ++i ) {
+            NV_Ith_S( ctx->vars, i ) = vin[i];
+        }
+        if( ReInitBandSolver( inp, tin, stephint, accuracy, accuracy ) )
+            return;
+    } else {
+        FreeBandSolver( ctx );
+        InitKrylovVariables( ctx, vin, n );
+        InitKrylovSolver( inp, tin, stephint, accuracy, accuracy );
+    }
+    if( InitSensitivities( inp ) )
+        return;
+
+    CVodeSetStopTime( ctx->cvode_mem, GetStopTime( tout, inp ) );
+    flag = CVode( ctx->cvode_mem, tout, ctx->vars, &t, CV_NORMAL );
+    if( CheckFlag( &flag, "CVode", 1 ) )
+        return;
+    /* copy vars into vout */
+    for( i = 0; i < n; ++i ) {
+        vout[i] = NV_Ith_S( ctx->vars, i );
+    }
+    GetSensitivities( ctx );
+}
+
+int
+InitKrylovSolver( Input * inp, realtype tzero, double stephint, double rel_tol, double abs_tol ) {
+    int flag;
+    ModelContext *ctx = &( inp->ctx );
+    ctx->neq = NV_LENGTH_S( ctx->vars );
+    ctx->cvode_mem = CVodeCreate( CV_BDF, CV_NEWTON );
+    if( CheckFlag( ( void * ) ctx->cvode_mem, "CVodeCreate", 0 ) ) {
+        printf( "Error creating ODE solver\n" );
+        return 1;
+    }
+    __sync_fetch_and_add( &band_creates, 1 );
+
+    /* my_f_band and the preconditioner need the Input */
+    flag = CVodeSetUserData( ctx->cvode_mem, inp );
+    if( CheckFlag( &flag, "CVodeSetUserData", 1 ) )
+        return 1;
+
+    flag = CVodeInit( ctx->cvode_mem, my_f_band, tzero, ctx->vars );
+    if( CheckFlag( &flag, "CVodeInit", 1 ) ) {
+        printf( "Error setting up ODE solver\n" );
+        return 1;
+    }
+
+    flag = CVodeSStolerances( ctx->cvode_mem, rel_tol, abs_tol );
+    if( CheckFlag( &flag, "CVodeSStolerances", 1 ) ) {
+        printf( "Error setting up tolerances\n" );
+        return 1;
+    }
+
+    /* GMRES with left preconditioning and the default Krylov dimension */
+    flag = CVSpgmr( ctx->cvode_mem, PREC_LEFT, 0 );
+    if( CheckFlag( &flag, "CVSpgmr", 1 ) ) {
+        printf( "Error setting up linear solver CVSPGMR\n" );
+        return 1;
+    }
+    flag = CVSpilsSetPreconditioner( ctx->cvode_mem, PrecondKrylov, PSolveKrylov );
+    if( CheckFlag( &flag, "CVSpilsSetPreconditioner", 1 ) ) {
+        printf( "Error setting preconditioner\n" );
+        return 1;
+    }
+    ctx->cvode_lsolver = KrylovLinSolver;
+
+    CVodeSetInitStep( ctx->cvode_mem, stephint );
+    return 0;
+}
+
+/** BlockLU: LU decomposition with partial pivoting of the n x n matrix a 
+ *            (row by row), in place; returns 1 if a is singular          
+ */
+static int
+BlockLU( double *a, int n, int *piv ) {
+    int i, j, k, p;
+    double big, tmp;
+
+    for( k = 0; k < n; k++ ) {
+        p = k;
+        big = fabs( a[k * n + k] );
+        for( i = k + 1; i < n; i++ )
+            if( fabs( a[i * n + k] ) > big ) {
+                big = fabs( a[i * n + k] );
+                p = i;
+            }
+        if( big == 0. )
+            return 1;
+        piv[k] = p;
+        if( p != k )
+            for( j = 0; j < n; j++ ) {
+                tmp = a[k * n + j];
+                a[k * n + j] = a[p * n + j];
+                a[p * n + j] = tmp;
+            }
+        for( i = k + 1; i < n; i++ ) {
+            a[i * n + k] /= a[k * n + k];
+            for( j = k + 1; j < n; j++ )
+                a[i * n + j] -= a[i * n + k] * a[k * n + j];
+        }
+    }
+    return 0;
+}
+
+/** BlockLUSolve: solves a x = b with the factors from BlockLU; x is      
+ *                 returned in b                                           
+ */
+static void
+BlockLUSolve( const double *a, int n, const int *piv, double *b ) {
+    int i, j;
+    double tmp;
+
+    for( i = 0; i < n; i++ ) {
+        if( piv[i] != i ) {
+            tmp = b[i];
+            b[i] = b[piv[i]];
+            b[piv[i]] = tmp;
+        }
+        for( j = 0; j < i; j++ )
+            b[i] -= a[i * n + j] * b[j];
+    }
+    for( i = n - 1; i >= 0; i-- ) {
+        for( j = i + 1; j < n; j++ )
+            b[i] -= a[i * n + j] * b[j];
+        b[i] /= a[i * n + i];
+    }
+}
+
+/** PrecondKrylov: sets up the preconditioner P = I - gamma * J for the   
+ *                  Krylov solver; J is block tridiagonal: a full ngenes x 
+ *                  ngenes block per nucleus on the diagonal and diagonal  
+ *                  blocks D for diffusion next to it; block Gaussian      
+ *                  elimination turns the diagonal blocks into             
+ *                  S_0 = P_00, S_i = P_ii - (gamma D) S_i-1^-1 (gamma D), 
+ *                  which we keep LU-factored; if CVODE says the Jacobian  
+ *                  is still ok (jok), we only redo the elimination for   
+ *                  the new gamma                                          
+ */
+int
+PrecondKrylov( realtype t, N_Vector y, N_Vector fy, booleantype jok, booleantype * jcurPtr, realtype gamma, void *extra_data,
+               N_Vector tmp1, N_Vector tmp2, N_Vector tmp3 ) {
+    Input *inp = ( Input * ) extra_data;
+    BlockPrecond *pc = &( inp->ctx.kry );
+    int ng = inp->zyg.defs.ngenes;
+    int n = NV_LENGTH_S( y );
+    int m = n / ng;
+    int ld = 2 * ng + 1;        /* length of a band column */
+    int ap, base, j, k, kk;
+    double *S, *Sprev, *w;
+
+    /* (re)allocate for the number of equations of this cycle */
+    if( pc->n != n ) {
+        FreeBlockPrecond( pc );
+        pc->jac = ( double * ) calloc( n * ld, sizeof( double ) );
+        pc->cols = ( double ** ) calloc( n, sizeof( double * ) );
+        for( j = 0; j < n; j++ )
+            pc->cols[j] = pc->jac + j * ld;
+        pc->blocks = ( double * ) calloc( n * ng, sizeof( double ) );
+        pc->pivot = ( int * ) calloc( n, sizeof( int ) );
+        pc->coupl = ( double * ) calloc( ng, sizeof( double ) );
+        pc->work = ( double * ) calloc( ng, sizeof( double ) );
+        pc->n = n;
+        jok = 0;
+    }
+
+    if( jok ) {
+        *jcurPtr = 0;
+    } else {
+        memset( pc->jac, 0, n * ld * sizeof( double ) );
+        JacobnBand( t, NV_DATA_S( y ), n, pc->cols, ng, inp->ctx.si, inp );
+        *jcurPtr = 1;
+    }
+
+    /* JacobnBand has set up the D's of this cycle in the workspace */
+    for( k = 0; k < ng; k++ )
+        pc->coupl[k] = ( m > 1 ) ? -gamma * inp->wsp.D[k] : 0.;
+
+    w = pc->work;
+    for( ap = 0, base = 0; ap < m; ap++, base += ng ) {
+        S = pc->blocks + base * ng;
+        for( k = 0; k < ng; k++ )
+            for( kk = 0; kk < ng; kk++ )
+                S[k * ng + kk] = -gamma * pc->cols[base + kk][k - kk + ng] + ( k == kk );
+        if( ap > 0 ) {
+            /* S -= (gamma D) Sprev^-1 (gamma D), one column at a time */
+            Sprev = S - ng * ng;
+            for( kk = 0; kk < ng; kk++ ) {
+                for( k = 0; k < ng; k++ )
+                    w[k] = ( k == kk ) ? pc->coupl[kk] : 0.;
+                BlockLUSolve( Sprev, ng, pc->pivot + base - ng, w );
+                for( k = 0; k < ng; k++ )
+                    S[k * ng + kk] -= pc->coupl[k] * w[k];
+            }
+        }
+        if( BlockLU( S, ng, pc->pivot + base ) )
+            return 1;           /* recoverable: CVODE will try a smaller step */
+    }
+    return 0;
+}
+
+/** PSolveKrylov: solves P z = r with the block LU from PrecondKrylov    
+ *                 (forward elimination, then back substitution)          
+ */
+int
+PSolveKrylov( realtype t, N_Vector y, N_Vector fy, N_Vector r, N_Vector z, realtype gamma, realtype delta, int lr, void *extra_data,
+              N_Vector tmp ) {
+    Input *inp = ( Input * ) extra_data;
+    BlockPrecond *pc = &( inp->ctx.kry );
+    int ng = inp->zyg.defs.ngenes;
+    int n = NV_LENGTH_S( r );
+    int base, k;
+    double *zd = NV_DATA_S( z );
+    double *w = pc->work;
+
+    N_VScale( 1.0, r, z );
+    for( base = 0; base < n; base += ng ) {
+        if( base > 0 )
+            for( k = 0; k < ng; k++ )
+                zd[base + k] -= pc->coupl[k] * zd[base - ng + k];
+        BlockLUSolve( pc->blocks + base * ng, ng, pc->pivot + base, zd + base );
+    }
+    for( base = n - 2 * ng; base >= 0; base -= ng ) {
+        for( k = 0; k < ng; k++ )
+            w[k] = pc->coupl[k] * zd[base + ng + k];
+        BlockLUSolve( pc->blocks + base * ng, ng, pc->pivot + base, w );
+        for( k = 0; k < ng; k++ )
+            zd[base + k] -= w[k];
+    }
+    return 0;
+}
+
+/** FreeBlockPrecond: frees the preconditioner of the Krylov solver */
+void
+FreeBlockPrecond( BlockPrecond * pc ) {
+    free( pc->jac );
+    free( pc->cols );
+    free( pc->blocks );
+    free( pc->pivot );
+    free( pc->coupl );
+    free( pc->work );
+    memset( pc, 0, sizeof( BlockPrecond ) );
+}
+
+/*** ADJOINT ***************************************************************/
+
+/* number of steps between two checkpoints of the forward solution */
+#define ADJ_STEPS 100
+
+/** wrapper function - to call DvdlOrig for the backward problem of 
+ *  BandAdjoint (CVODES hands us the Input, just like my_f_band)   
+ */
+int
+my_fB_band( realtype t, N_Vector y, N_Vector yB, N_Vector yBdot, void *extra_data ) {
+    Input *inp = ( Input * ) extra_data;
+
+    DvdlOrig( t, NV_DATA_S( y ), NV_DATA_S( yB ), NV_DATA_S( yBdot ), NV_LENGTH_S( y ), inp->ctx.si, inp );
+    return 0;
+}
+
+/** wrapper function - to call DvdpAdjoint for the quadratures of the 
+ *  gradient in BandAdjoint                                          
+ */
+int
+my_fQB_band( realtype t, N_Vector y, N_Vector yB, N_Vector qBdot, void *extra_data ) {
+    Input *inp = ( Input * ) extra_data;
+    Adjoint *adj = &( inp->ctx.adj );
+
+    DvdpAdjoint( t, NV_DATA_S( y ), NV_DATA_S( yB ), NV_DATA_S( qBdot ), NV_LENGTH_S( y ), adj->np, adj->parm, adj->live,
+                 adj->dD, inp->ctx.si, inp );
+    return 0;
+}
+
+/** InitAdjointSolver: creates the CVODES memory of BandAdjoint for n 
+ *                      equations, starting at tzero from adj->y; the   
+ *                      backward problem can only be set up once the    
+ *                      forward one has been run (see BandAdjoint)      
+ */
+static int
+InitAdjointSolver( Input * inp, int n, realtype tzero, double accuracy ) {
+    Adjoint *adj = &( inp->ctx.adj );
+    int flag;
+
+    adj->cvode_mem = CVodeCreate( CV_BDF, CV_NEWTON );
+    if( CheckFlag( ( void * ) adj->cvode_mem, "CVodeCreate", 0 ) )
+        return 1;
+    flag = CVodeSetUserData( adj->cvode_mem, inp );
+    if( CheckFlag( &flag, "CVodeSetUserData", 1 ) )
+        return 1;
+    flag = CVodeInit( adj->cvode_mem, my_f_band, tzero, adj->y );
+    if( CheckFlag( &flag, "CVodeInit", 1 ) )
+        return 1;
+    flag = CVodeSStolerances( adj->cvode_mem, accuracy, accuracy );
+    if( CheckFlag( &flag, "CVodeSStolerances", 1 ) )
+        return 1;
+    flag = CVBand( adj->cvode_mem, n, inp->zyg.defs.ngenes + 1, inp->zyg.defs.ngenes + 1 );
+    if( CheckFlag( &flag, "CVBand", 1 ) )
+        return 1;
+    if( bandjac ) {
+        flag = CVDlsSetBandJacFn( adj->cvode_mem, my_jac_band );
+        if( CheckFlag( &flag, "CVDlsSetBandJacFn", 1 ) )
+            return 1;
+    }
+    flag = CVodeAdjInit( adj->cvode_mem, ADJ_STEPS, CV_HERMITE );
+    if( CheckFlag( &flag, "CVodeAdjInit", 1 ) )
+        return 1;
+    adj->which = -1;            /* no backward problem yet */
+    return 0;
+}
+
+/** InitBackward: (re)starts the backward problem of BandAdjoint at tzero 
+ *                 from adj->yB, with the quadratures in adj->qB         
+ */
+static int
+InitBackward( Input * inp, int n, realtype tzero, double accuracy ) {
+    Adjoint *adj = &( inp->ctx.adj );
+    int flag;
+
+    if( adj->which < 0 ) {
+        flag = CVodeCreateB( adj->cvode_mem, CV_BDF, CV_NEWTON, &( adj->which ) );
+        if( CheckFlag( &flag, "CVodeCreateB", 1 ) )
+            return 1;
+        flag = CVodeInitB( adj->cvode_mem, adj->which, my_fB_band, tzero, adj->yB );
+        if( CheckFlag( &flag, "CVodeInitB", 1 ) )
+            return 1;
+        flag = CVBandB( adj->cvode_mem, adj->which, n, inp->zyg.defs.ngenes + 1, inp->zyg.defs.ngenes + 1 );
+        if( CheckFlag( &flag, "CVBandB", 1 ) )
+            return 1;
+        flag = CVodeQuadInitB( adj->cvode_mem, adj->which, my_fQB_band, adj->qB );
+        if( CheckFlag( &flag, "CVodeQuadInitB", 1 ) )
+            return 1;
+    } else {
+        flag = CVodeReInitB( adj->cvode_mem, adj->which, tzero, adj->yB );
+        if( CheckFlag( &flag, "CVodeReInitB", 1 ) )
+            return 1;
+        flag = CVodeQuadReInitB( adj->cvode_mem, adj->which, adj->qB );
+        if( CheckFlag( &flag, "CVodeQuadReInitB", 1 ) )
+            return 1;
+    }
+    /* the Input may have been copied since the solver was created */
+    flag = CVodeSetUserDataB( adj->cvode_mem, adj->which, inp );
+    if( CheckFlag( &flag, "CVodeSetUserDataB", 1 ) )
+        return 1;
+    flag = CVodeSStolerancesB( adj->cvode_mem, adj->which, accuracy, accuracy );
+    if( CheckFlag( &flag, "CVodeSStolerancesB", 1 ) )
+        return 1;
+    flag = CVodeQuadSStolerancesB( adj->cvode_mem, adj->which, accuracy, accuracy );
+    if( CheckFlag( &flag, "CVodeQuadSStolerancesB", 1 ) )
+        return 1;
+    flag = CVodeSetQuadErrConB( adj->cvode_mem, adj->which, TRUE );
+    if( CheckFlag( &flag, "CVodeSetQuadErrConB", 1 ) )
+        return 1;
+    return 0;
+}
+
+/** BandAdjoint: propagates lin = d score / d state at tout back to lout  
+ *                at tin, for the state that goes from vin at tin to tout 
+ *                (of size n), and adds d score / d parm of the way to    
+ *                inp->ctx.adj.grad; CVODES solves the state forward      
+ *                again, keeping checkpoints every ADJ_STEPS steps, and   
+ *                then ldot = -J^T l and the quadratures backward, using  
+ *                the states it interpolates between the checkpoints; the 
+ *                solver memory is kept and reinitialized like in Band    
+ */
+void
+BandAdjoint( double *vin, double *lin, double *lout, double tin, double tout, double accuracy, int n, SolverInput * si,
+             Input * inp ) {
+    ModelContext *ctx = &( inp->ctx );
+    Adjoint *adj = &( ctx->adj );
+    int flag, i, p, ncheck;
+    realtype t;
+
+    ctx->si = si;               /* for the right hand sides */
+
+    if( fabs( tin - tout ) < 1e-6 ) {
+        for( i = 0; i < n; i++ )
+            lout[i] = lin[i];
+        return;
+    }
+
+    /* the memory can be kept for as long as the sizes stay the same */
+    if( ( adj->cvode_mem != NULL ) && ( ( NV_LENGTH_S( adj->y ) != n ) || ( NV_LENGTH_S( adj->qB ) != adj->np ) ) )
+        FreeAdjointSolver( ctx );
+    if( adj->cvode_mem == NULL ) {
+        adj->y = N_VNew_Serial( n );
+        adj->yB = N_VNew_Serial( n );
+        adj->qB = N_VNew_Serial( adj->np );
+        adj->dD = ( double * ) calloc( 2 * inp->zyg.defs.ngenes, sizeof( double ) );
+        for( i = 0; i < n; i++ )
+            NV_Ith_S( adj->y, i ) = vin[i];
+        if( InitAdjointSolver( inp, n, tin, accuracy ) )
+            return;
+    } else {
+        for( i = 0; i < n; i++ )
+            NV_Ith_S( adj->y, i ) = vin[i];
+        flag = CVodeReInit( adj->cvode_mem, tin, adj->y );
+        if( CheckFlag( &flag, "CVodeReInit", 1 ) )
+            return;
+        flag = CVodeSetUserData( adj->cvode_mem, inp );
+        if( CheckFlag( &flag, "CVodeSetUserData", 1 ) )
+            return;
+        flag = CVodeSStolerances( adj->cvode_mem, accuracy, accuracy );
+        if( CheckFlag( &flag, "CVodeSStolerances", 1 ) )
+            return;
+        flag = CVodeAdjReInit( adj->cvode_mem );
+        if( CheckFlag( &flag, "CVodeAdjReInit", 1 ) )
+            return;
+    }
+
+    /* forward, as in Band, but with checkpoints */
+    CVodeSetStopTime( adj->cvode_mem, GetStopTime( tout, inp ) );
+    flag = CVodeF( adj->cvode_mem, tout, adj->y, &t, CV_NORMAL, &ncheck );
+    if( CheckFlag( &flag, "CVodeF", 1 ) )
+        return;
+
+    /* and backward, with the quadratures starting from zero */
+    for( i = 0; i < n; i++ )
+        NV_Ith_S( adj->yB, i ) = lin[i];
+    for( p = 0; p < adj->np; p++ )
+        NV_Ith_S( adj->qB, p ) = 0.;
+    if( InitBackward( inp, n, tout, accuracy ) )
+        return;
+    flag = CVodeB( adj->cvode_mem, tin, CV_NORMAL );
+    if( CheckFlag( &flag, "CVodeB", 1 ) )
+        return;
+    flag = CVodeGetB( adj->cvode_mem, adj->which, &t, adj->yB );
+    if( CheckFlag( &flag, "CVodeGetB", 1 ) )
+        return;
+    flag = CVodeGetQuadB( adj->cvode_mem, adj->which, &t, adj->qB );
+    if( CheckFlag( &flag, "CVodeGetQuadB", 1 ) )
+        return;
+
+    for( i = 0; i < n; i++ )
+        lout[i] = NV_Ith_S( adj->yB, i );
+    for( p = 0; p < adj->np; p++ )
+        adj->grad[p] += NV_Ith_S( adj->qB, p );
+}
+
+/** FreeAdjointSolver: frees the CVODES memory of BandAdjoint (with its 
+ *                      checkpoints and backward problem)               
+ */
+void
+FreeAdjointSolver( ModelContext * ctx ) {
+    Adjoint *adj = &( ctx->adj );
+
+    if( adj->cvode_mem != NULL ) {
+        CVodeFree( &( adj->cvode_mem ) );
+        adj->cvode_mem = NULL;
+    }
+    if( adj->y != NULL ) {
+        N_VDestroy_Serial( adj->y );
+        N_VDestroy_Serial( adj->yB );
+        N_VDestroy_Serial( adj->qB );
+        adj->y = adj->yB = adj->qB = NULL;
     }
+    free( adj->dD );
+    adj->dD = NULL;
 }
 
 /*
@@ -4532,7 +5822,7 @@ void vec_zero( realtype u[], int n ) {
 
 /** get some info and write it out */
 void
-writeInfo(  ) {
+writeInfo( void *cvode_mem ) {
     long int lenrw, leniw;
     long int lenrwLS, leniwLS;
     long int nst, nfe, nsetups, nni, ncfn, netf;
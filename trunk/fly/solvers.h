@@ -17,11 +17,13 @@
 #define SOLVERS_INCLUDED
 
 /*
- * added by Anton Crombach, October 2010
+ * added by Anton Crombach, October 2010; CVODES (CVODE with sensitivity
+ * analysis) for the forward sensitivities of the Band and Krylov solvers
+ * and for the adjoint gradient
  */
-#include <cvode/cvode.h>
-#include <cvode/cvode_band.h>
-#include <cvode/cvode_spgmr.h>
+#include <cvodes/cvodes.h>
+#include <cvodes/cvodes_band.h>
+#include <cvodes/cvodes_spgmr.h>
 #include <nvector/nvector_serial.h>
 #include <sundials/sundials_dense.h>
 #include <sundials/sundials_types.h>
@@ -35,6 +37,10 @@ void ( *p_deriv_lite ) ( double *, double, double *, int, SolverInput *, Input *
 void ( *d_deriv ) ( double *, double **, double, double *, int, SolverInput *, Input * );
 void ( *p_jacobn ) ( double, double *, double *, double **, int, SolverInput *, Input * );
 
+/* Band solver Jacobian: 0 lets CVBand use finite differences (default),  *
+ * 1 uses the analytic JacobnBand (set by -J)                             */
+int bandjac;
+
 
 
 
@@ -92,6 +98,25 @@ void Rk4( double *vin, double *vout, double tin, double tout, double stephint, d
 void Rkck( double *vin, double *vout, double tin, double tout, double stephint, double accuracy, int n, FILE * slog, SolverInput * si, Input * inp );
 
 
+/** Rk4Ensemble: Rk4 for all members of an ensemble at once; vin and vout 
+ *                hold their interleaved states (see Ensemble in maternal.h)
+ *                and n is the size of the state of one member; each member
+ *                gets the same bits as from Rk4 on its own, whatever the  
+ *                other members are                                        
+ */
+void Rk4Ensemble( double *vin, double *vout, double tin, double tout, double stephint, double accuracy, int n, FILE * slog, SolverInput * si,
+                  Ensemble * ens );
+
+
+/** RkckEnsemble: Rkck for all members of an ensemble at once (see Rk4- 
+ *                 Ensemble); they share one adaptive step, which is small 
+ *                 enough for the accuracy of each of them, so the result  
+ *                 of a member depends on the others in the ensemble       
+ */
+void RkckEnsemble( double *vin, double *vout, double tin, double tout, double stephint, double accuracy, int n, FILE * slog, SolverInput * si,
+                   Ensemble * ens );
+
+
 /** Rkf: propagates vin (of size n) from tin to tout by the Runge-Kutta 
  *        Fehlberg method, which is a the original adaptive-stepsize Rk    
  *        method (Cash-Karp is an improved version of this); it uses a     
@@ -105,6 +130,16 @@ void Rkck( double *vin, double *vout, double tin, double tout, double stephint,
 void Rkf( double *vin, double *vout, double tin, double tout, double stephint, double accuracy, int n, FILE * slog, SolverInput * si, Input * inp );
 
 
+/** Imex: propagates vin (of size n) from tin to tout by an implicit-ex-  
+ *         plicit Runge-Kutta method with adaptive stepsize (the ARK2 pair 
+ *         of Giraldo, Kelly & Constantinescu); diffusion is taken impli-  
+ *         citly, by a tridiagonal solve for each gene, so that it doesn't 
+ *         limit the stepsize as the nuclei get more; production and decay 
+ *         are explicit; its result is returned by vout                    
+ */
+void Imex( double *vin, double *vout, double tin, double tout, double stephint, double accuracy, int n, FILE * slog, SolverInput * si, Input * inp );
+
+
 
 /**    Milne: propagates vin (of size n) from tin to tout by Milne-Simpson 
  *            which is a predictor-corrector method; the result is retur-  
@@ -177,16 +212,78 @@ void BaDe( double *vin, double *vout, double tin, double tout, double stephint,
  * This is actually the Direct Band solver. */
 void Band( double *vin, double *vout, double tin, double tout, double stephint, double accuracy, int n, FILE * slog, SolverInput * si, Input * inp );
 
-int InitKrylovVariables( double *vin, int n );
+int InitKrylovVariables( ModelContext * ctx, double *vin, int n );
+
+int InitBandSolver( Input * inp, realtype tzero, double stephint, double rel_tol, double abs_tol );
+
+/** ReInitBandSolver: restarts the Band (or Krylov) solver in inp->ctx at 
+ *                     tzero from the values in ctx->vars, keeping its      
+ *                     memory and its linear solver; the size must not have 
+ *                     changed                                              
+ */
+int ReInitBandSolver( Input * inp, realtype tzero, double stephint, double rel_tol, double abs_tol );
+
+/** GetBandStats: returns how often the Band solver was created from      
+ *                 scratch and how often it was reinitialized instead      
+ */
+void GetBandStats( long *creates, long *reinits );
 
-int InitBandSolver( realtype tzero, double stephint, double rel_tol, double abs_tol );
-void FreeBandSolver( void );
+void FreeBandSolver( ModelContext * ctx );
 
 int CheckFlag( void *flagvalue, char *funcname, int opt );
 
 /** wrapper function - to call the derivative */
 int my_f_band( realtype t, N_Vector y, N_Vector ydot, void *extra_data );
 
+/** wrapper function - to call DvdpOrig for the forward sensitivities */
+int my_fs_band( int Ns, realtype t, N_Vector y, N_Vector ydot, N_Vector * yS, N_Vector * ySdot, void *extra_data, N_Vector tmp1,
+                N_Vector tmp2 );
+
+/**  Krylov: propagates vin (of size n) from tin to tout by BDF (Backward  
+ *           Differential Formulas), like Band, but solves the linear      
+ *           systems of the Newton iteration with preconditioned GMRES     
+ *           (CVSpgmr) instead of a band LU; the preconditioner is the     
+ *           block-tridiagonal I - gamma * J with the analytic Jacobian   
+ *           of JacobnBand and the D's of the current cycle               
+ */
+void Krylov( double *vin, double *vout, double tin, double tout, double stephint, double accuracy, int n, FILE * slog, SolverInput * si, Input * inp );
+
+int InitKrylovSolver( Input * inp, realtype tzero, double stephint, double rel_tol, double abs_tol );
+
+/** PrecondKrylov: sets up (and factors) the block-tridiagonal            
+ *                  preconditioner P = I - gamma * J for Krylov            
+ */
+int PrecondKrylov( realtype t, N_Vector y, N_Vector fy, booleantype jok, booleantype * jcurPtr, realtype gamma, void *extra_data,
+                   N_Vector tmp1, N_Vector tmp2, N_Vector tmp3 );
+
+/** PSolveKrylov: solves P z = r with the factors from PrecondKrylov */
+int PSolveKrylov( realtype t, N_Vector y, N_Vector fy, N_Vector r, N_Vector z, realtype gamma, realtype delta, int lr, void *extra_data,
+                  N_Vector tmp );
+
+/** FreeBlockPrecond: frees the preconditioner of the Krylov solver */
+void FreeBlockPrecond( BlockPrecond * pc );
+
+/** BandAdjoint: propagates lin = d score / d state at tout back to lout 
+ *                at tin, for the state that goes from vin at tin to tout 
+ *                (of size n), and adds d score / d parm of the way to    
+ *                inp->ctx.adj.grad; uses CVODES with the band solver and 
+ *                checkpoints of the forward solution (whatever solver    
+ *                Blastoderm used)                                        
+ */
+void BandAdjoint( double *vin, double *lin, double *lout, double tin, double tout, double accuracy, int n, SolverInput * si,
+                  Input * inp );
+
+/** FreeAdjointSolver: frees the CVODES memory of BandAdjoint */
+void FreeAdjointSolver( ModelContext * ctx );
+
+/** wrapper functions - to call DvdlOrig and DvdpAdjoint for BandAdjoint */
+int my_fB_band( realtype t, N_Vector y, N_Vector yB, N_Vector yBdot, void *extra_data );
+int my_fQB_band( realtype t, N_Vector y, N_Vector yB, N_Vector qBdot, void *extra_data );
+
+/** wrapper function - to call JacobnBand (if bandjac is set) */
+int my_jac_band( long int N, long int mupper, long int mlower, realtype t, N_Vector y, N_Vector fy, DlsMat J, void *extra_data,
+                 N_Vector tmp1, N_Vector tmp2, N_Vector tmp3 );
+
 /** WriteSolvLog: write to solver log file */
 void WriteSolvLog( char *solver, double tin, double tout, double h, int n, int nderivs, FILE * slog );
 
@@ -206,8 +303,17 @@ void DCERk32( double **vatt, int n, double *tarray, int tpoints, double *darray,
 
 void CE( double t, double *vans, double tbegin, double *v_at_tbegin, double ech, double *d1, double *d2, double *d3, double *d4, int n );
 
-void DivideHistory( double t1, double t2, Zygote * zyg );
-void FreeDelaySolver( void );
-void InitDelaySolver( void );
+void DivideHistory( double t1, double t2, Input * inp );
+void FreeDelaySolver( ModelContext * ctx );
+void InitDelaySolver( ModelContext * ctx );
+
+/** InitModelContext: returns an empty solver context, to be stored in the 
+ *                     Input next to its Workspace; the solvers allocate   
+ *                     what they need in there as they go                  
+ */
+ModelContext InitModelContext( void );
+
+/** FreeModelContext: frees whatever the solvers left in the context */
+void FreeModelContext( ModelContext * ctx );
 
 #endif
@@ -34,14 +34,15 @@
 
 /*** Constants *************************************************************/
 
-const char *OPTS = ":a:Df:g:Ghi:j:op:r:s:t:vx:z:";      /* cmd line opt string */
+const char *OPTS = ":a:Df:g:Ghi:j:k:K:op:r:s:t:vx:z:";      /* cmd line opt string */
 
 /*** Help, usage and version messages **************************************/
 
 static const char usage[] =
     "Usage: unfold [-a <accuracy>] [-D] [-f <float_prec>] [-g <g(u)>] [-G]\n"
-    "              [-h] [-i <stepsize>] [-j <timefile>] [-o] [-p <pstep>]\n"
-    "              [-s <solver>] [-t <time>] [-v] [-x <sect_title>]\n" 
+    "              [-h] [-i <stepsize>] [-j <timefile>] [-k <threads>]\n"
+    "              [-K <nuclei>] [-o] [-p <pstep>] [-s <solver>] [-t <time>] [-v]\n"
+    "              [-x <sect_title>]\n" 
     "              [-z <gast_time>]\n" 
     "              <datafile> [<genotype>]\n";
 
@@ -59,6 +60,8 @@ static const char help[] =
     "  -h                  prints this help message\n"
     "  -i <stepsize>       sets ODE solver stepsize (in minutes)\n"
     "  -j <timefile>       reads output fimes from <timefile>\n"
+    "  -k <threads>        share each derivative out over <threads> threads\n"
+    "  -K <nuclei>         with at least <nuclei> nuclei each (default 256)\n"
     "  -o                  use oldstyle cell division times (3 div only)\n"
     "  -p <pstep>          prints output every <pstep> minutes\n"
     "  -s <solver>         choose ODE solver\n"
@@ -235,6 +238,16 @@ main( int argc, char **argv ) {
             timefile = ( char * ) calloc( MAX_RECORD, sizeof( char ) );
             timefile = strcpy( timefile, optarg );
             break;
+        case 'k':              /* -k sets the threads per derivative (big embryos) */
+            rhsthreads = atoi( optarg );
+            if( rhsthreads < 1 )
+                error( "unfold: need at least one thread (hint: check your -k)" );
+            break;
+        case 'K':              /* -K sets the smallest block of nuclei per thread */
+            rhsblock = atoi( optarg );
+            if( rhsblock < 1 )
+                error( "unfold: need at least one nucleus per block (hint: check your -K)" );
+            break;
         case 'o':              /* -o sets old division style (ndivs = 3 only! ) */
             olddivstyle = 1;
             break;
@@ -273,14 +286,18 @@ main( int argc, char **argv ) {
                 ps = Rkck;
             else if( !( strcmp( optarg, "rf" ) ) )
                 ps = Rkf;
+            else if( !( strcmp( optarg, "imex" ) ) )
+                ps = Imex;
             else if( !( strcmp( optarg, "sd" ) ) )
                 ps = SoDe;
             else if( !( strcmp( optarg, "kr" ) ) )
                 ps = Band;
             else if( !( strcmp( optarg, "bnd" ) ) )
                 ps = Band; 
+            else if( !( strcmp( optarg, "K" ) ) )
+                ps = Krylov;
             else
-                error( "unfold: invalid solver (%s), use: a,bd,bs,e,h,kr,mi,me,r{2,4,ck,f}", optarg );
+                error( "unfold: invalid solver (%s), use: a,bd,bs,e,h,kr,K,mi,me,r{2,4,ck,f},imex", optarg );
             break;
         case 't':
             if( timefile )
@@ -479,12 +496,10 @@ main( int argc, char **argv ) {
     }
     free( inp.sco.facts.tt[genindex].ptr.times.array );
     inp.sco.facts.tt[genindex].ptr.times = tt;
+    InitSchedules( &inp );      /* now that we know the tabulated times */
     /* Run the model... */
 
     for( i = 0; i < 1; ++i ) {
-        if( i > 0 ) {
-            FreeSolution( &answer );
-        }
         answer = Blastoderm( genindex, genotype, &inp, slog );
     }
     /* if debugging: print out the innards of the model to unfold.out */
@@ -564,9 +579,11 @@ main( int argc, char **argv ) {
     printf( "# Unfold ran for %.13f seconds\n", tvsub( end, begin ) );
 
     FreeHistory( inp.zyg.nalleles, inp.his );
-    FreeSolution( &answer );
     FreeExternalInputs( inp.zyg.nalleles, inp.ext );
+    FreeSchedules( &inp );
     FreeZygote(  );
+    FreeWorkspace( &( inp.wsp ) );
+    FreeModelContext( &( inp.ctx ) );
     free( extinp_polation );
     free( polation );
     for( i = 0; i < inp.zyg.nalleles; i++ ) {
@@ -589,14 +606,7 @@ main( int argc, char **argv ) {
     free( inp.zyg.nnucs );
     free( inp.zyg.full_nnucs );
     free( inp.zyg.full_lin_start );
-    free( inp.zyg.parm.E );
-    free( inp.zyg.parm.R );
-    free( inp.zyg.parm.T );
-    free( inp.zyg.parm.d );
-    free( inp.zyg.parm.h );
-    free( inp.zyg.parm.lambda );
-    free( inp.zyg.parm.m );
-    free( inp.zyg.parm.tau );
+    FreeMutant( inp.zyg.parm );
     for( i = 0; i < inp.zyg.nalleles; i++ ) {
         free( inp.zyg.bias.bt[i].genotype );
         free( inp.zyg.bias.bt[i].ptr.times.array );
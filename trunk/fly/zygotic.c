@@ -29,6 +29,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <pthread.h>            /* for the nucleus block threads */
 #include "error.h"              /* for error handling */
 #include "maternal.h"           /* need this for BArrPtr (for the Bicoid structure) */
 #include "solvers.h"            /* for p_deriv */
@@ -36,6 +37,7 @@
 #include "zygotic.h"            /* obviously */
 #include "fly_io.h"             /* i/o of parameters and data */
 #include "ioTools.h"
+#include "vecLib.h"             /* SIMD sqrt, exp, tanh and diffusion */
 
 
 //test
@@ -56,12 +58,14 @@ extern void vexp_();
 const int INTERPHASE = 0;
 const int MITOSIS = 1;
 
-/* diffusion coefficients */
-static double *D;
+/* below this many nuclei per thread, splitting a derivative doesn't pay */
+const int RHS_BLOCK = 256;
 
-/* following arrays are used by DvdtOrig */
-double *vinput;                 /* vinput, bot2 and bot are used for */
-double *bot2, *bot;             /* storing intermediate stuff for vector */
+/* regulatory input kernel, chosen by InitRegInput according to circuit size */
+static void ( *p_reginput ) ( double *, int, EqParms *, TheProblem *, double * ) = RegInputGeneric;
+
+/* stops the threads of a workspace (see NUCLEUS BLOCKS below) */
+static void StopNucTeam( NucTeam * team );
 
 /*** INITIALIZATION FUNCTIONS **********************************************/
 
@@ -83,6 +87,7 @@ InitZygote( FILE * fp, void ( *pd ) ( double *, double, double *, int, SolverInp
      ***************************************************************************/
 
     Zygote zyg;
+    VecLevel level;             /* vector functions in use (vecLib.h) */
     /* install the dvdt function: makes pd global (solvers need to access it) */
 
     p_deriv = pd;
@@ -97,7 +102,6 @@ InitZygote( FILE * fp, void ( *pd ) ( double *, double, double *, int, SolverInp
 
     /* read equation parameters and the problem */
     zyg.defs = ReadTheProblem( fp );
-    D = ( double * ) calloc( zyg.defs.ngenes, sizeof( double ) );       /* contains info about diffusion sched. */
 
     /* install bicoid and bias and nnucs in maternal.c */
     zyg.bcdtype = InitBicoid( fp, &zyg );
@@ -109,32 +113,195 @@ InitZygote( FILE * fp, void ( *pd ) ( double *, double, double *, int, SolverInp
     // read initial state
     zyg.parm = ReadParameters( fp, zyg.defs, section_title );
 
+    /* allocate scratch arrays for the derivative functions and set up an *
+     * empty context for the solvers                                       */
+    inp->wsp = InitWorkspace( &( zyg.defs ) );
+    inp->ctx = InitModelContext(  );
+
+    /* pick the regulatory input kernel for this circuit size */
+    InitRegInput( &( zyg.defs ) );
+
+    /* install the fastest vector functions this CPU can do */
+    level = InitVecLib( VecAVX2 );
+    if( debug )
+        printf( "InitZygote: using %s vector functions (max. error %g eps)\n", VecLevelName( level ), VecSelfCheck(  ) );
+
     return zyg;
 }
 
+/** InitWorkspace: allocates the scratch arrays used by the derivative and 
+ *                  Jacobian functions; everything is sized for the maxi-  
+ *                  mum number of nuclei (defs->nnucs), so that no further 
+ *                  allocation is needed during a run (except for the      
+ *                  baselines of RegBase, which are added on first use)    
+ */
+Workspace
+InitWorkspace( TheProblem * defs ) {
+    Workspace wsp;
+    int i;
+
+    wsp.size = defs->ngenes * defs->nnucs;
+    wsp.ext_size = defs->egenes * defs->nnucs;
+
+    wsp.vinput = ( double * ) calloc( wsp.size, sizeof( double ) );
+    wsp.bot2 = ( double * ) calloc( wsp.size, sizeof( double ) );
+    wsp.bot = ( double * ) calloc( wsp.size, sizeof( double ) );
+    wsp.l_rule = ( int * ) calloc( defs->ngenes, sizeof( int ) );
+    wsp.v_ext = ( double * ) calloc( wsp.ext_size, sizeof( double ) );
+    wsp.v_extd = ( double ** ) calloc( defs->ngenes, sizeof( double * ) );
+    wsp.soa_in = ( double * ) calloc( wsp.size, sizeof( double ) );
+    wsp.soa_out = ( double * ) calloc( wsp.size, sizeof( double ) );
+    wsp.D = ( double * ) calloc( defs->ngenes, sizeof( double ) );      /* contains info about diffusion sched. */
+    if( !wsp.vinput || !wsp.bot2 || !wsp.bot || !wsp.l_rule || !wsp.v_ext || !wsp.v_extd
+        || !wsp.soa_in || !wsp.soa_out || !wsp.D )
+        error( "InitWorkspace: could not allocate derivative workspace" );
+
+    /* the delayed external inputs live in one block, one row per gene */
+    wsp.v_extd[0] = ( double * ) calloc( defs->ngenes * wsp.ext_size, sizeof( double ) );
+    if( !wsp.v_extd[0] )
+        error( "InitWorkspace: could not allocate delayed external inputs" );
+    for( i = 1; i < defs->ngenes; i++ )
+        wsp.v_extd[i] = wsp.v_extd[0] + i * wsp.ext_size;
+
+    wsp.num_nucs = 0;           /* D and bcd get filled in by SetCycle */
+    wsp.bcd.size = 0;
+    wsp.bcd.array = NULL;
+    wsp.regbase = NULL;         /* grown by RegBase as needed */
+    wsp.regvalid = NULL;
+    wsp.nregbase = 0;
+    wsp.team = NULL;            /* started by ForNucBlocks as needed */
+
+    wsp.bytes = 5 * wsp.size * sizeof( double )
+        + defs->ngenes * ( sizeof( int ) + sizeof( double ) )
+        + ( defs->ngenes + 1 ) * wsp.ext_size * sizeof( double )
+        + defs->ngenes * sizeof( double * );
+
+    return wsp;
+}
+
+/** InitEnsemble: allocates the interleaved scratch arrays of an ensemble 
+ *                 of up to capacity members (see Ensemble in maternal.h); 
+ *                 the members themselves are up to the caller             
+ */
+Ensemble
+InitEnsemble( int capacity, TheProblem * defs ) {
+    Ensemble ens;
+
+    ens.size = 0;
+    ens.capacity = capacity;
+    ens.length = capacity * defs->ngenes * defs->nnucs;
+
+    ens.member = ( Input ** ) calloc( capacity, sizeof( Input * ) );
+    ens.T = ( double * ) calloc( capacity * defs->ngenes * defs->ngenes, sizeof( double ) );
+    ens.R = ( double * ) calloc( capacity * defs->ngenes, sizeof( double ) );
+    ens.lambda = ( double * ) calloc( capacity * defs->ngenes, sizeof( double ) );
+    ens.D = ( double * ) calloc( capacity * defs->ngenes, sizeof( double ) );
+    ens.u = ( double * ) calloc( ens.length, sizeof( double ) );
+    ens.bot2 = ( double * ) calloc( ens.length, sizeof( double ) );
+    ens.bot = ( double * ) calloc( ens.length, sizeof( double ) );
+    ens.vin = ( double * ) calloc( ens.length, sizeof( double ) );
+    ens.vout = ( double * ) calloc( ens.length, sizeof( double ) );
+    if( !ens.member || !ens.T || !ens.R || !ens.lambda || !ens.D || !ens.u || !ens.bot2 || !ens.bot || !ens.vin || !ens.vout )
+        error( "InitEnsemble: could not allocate ensemble of %d members", capacity );
+
+    return ens;
+}
+
 /*** CLEANUP FUNCTIONS *****************************************************/
 
-/** FreeZygote: frees memory for D */
+/** FreeZygote: nothing left to free here; D now lives in the Workspace */
 void
 FreeZygote( void ) {
-    free( D );
+}
+
+/** FreeWorkspace: frees the scratch arrays of the derivative functions */
+void
+FreeWorkspace( Workspace * wsp ) {
+    int i;
+
+    free( wsp->vinput );
+    free( wsp->bot2 );
+    free( wsp->bot );
+    free( wsp->l_rule );
+    free( wsp->v_ext );
+    free( wsp->v_extd[0] );
+    free( wsp->v_extd );
+    free( wsp->soa_in );
+    free( wsp->soa_out );
+    free( wsp->D );
+    for( i = 0; i < wsp->nregbase; i++ )
+        free( wsp->regbase[i] );
+    free( wsp->regbase );
+    free( wsp->regvalid );
+    wsp->nregbase = 0;
+    StopNucTeam( wsp->team );
+    wsp->team = NULL;
+    wsp->num_nucs = 0;
+    wsp->bytes = 0;
+}
+
+/** FreeEnsemble: frees the scratch arrays of an ensemble (not its members) */
+void
+FreeEnsemble( Ensemble * ens ) {
+    free( ens->member );
+    free( ens->T );
+    free( ens->R );
+    free( ens->lambda );
+    free( ens->D );
+    free( ens->u );
+    free( ens->bot2 );
+    free( ens->bot );
+    free( ens->vin );
+    free( ens->vout );
+    ens->size = ens->capacity = ens->length = 0;
+}
+
+/** ResetRegBase: marks all baselines of RegBase as out of date; call it 
+ *                 whenever the parameters or the genotype change         
+ */
+void
+ResetRegBase( Workspace * wsp ) {
+    int i;
+
+    for( i = 0; i < wsp->nregbase; i++ )
+        wsp->regvalid[i] = 0;
+}
+
+/** WorkspaceBytes: returns the number of bytes held by the derivative  
+ *                   workspace; it only grows the first time RegBase needs 
+ *                   a baseline, so this is also its peak size             
+ */
+size_t
+WorkspaceBytes( Workspace * wsp ) {
+    return wsp->bytes;
 }
 
 /** FreeMutant: frees mutated parameter struct */
 void
 FreeMutant( EqParms lparm ) {
-    free( lparm.R );
-    free( lparm.T );
-    free( lparm.E );
-    free( lparm.m );
-    free( lparm.h );
-    free( lparm.d );
-    free( lparm.lambda );
-    free( lparm.tau );
+    free( lparm.array );
 }
 
 /*** DERIVATIVE FUNCTIONS **************************************************/
 
+/** SetCycle: updates the diffusion coefficients and the bicoid gradient in 
+ *             the workspace whenever the number of nuclei changes (time-  
+ *             varying quantities only vary by ccycle); Blastoderm resets  
+ *             wsp.num_nucs at the start of each run                       
+ */
+static void
+SetCycle( double t, int m, int allele, Input * inp, char *caller ) {
+    if( m == inp->wsp.num_nucs )
+        return;
+
+    /* get diff coefficients, according to diff schedule */
+    GetD( t, inp->lparm.d, inp->wsp.D, &( inp->zyg ) );
+    inp->wsp.num_nucs = m;      /* store # of nucs for next step */
+    inp->wsp.bcd = GetBicoid( t, allele, inp->zyg.bcdtype, &( inp->zyg ) );      /* get bicoid gradient */
+    if( inp->wsp.bcd.size != m )
+        error( "%s: %d nuclei don't match Bicoid!", caller, m );
+}
+
 /*** Derivative functions: *************************************************
  *                                                                         *
  *   These functions calculate derivatives for the solver function based   *
@@ -148,9 +315,10 @@ FreeMutant( EqParms lparm ) {
  *   There are two rules for the derivative function, one for INTERPHASE   *
  *   and one for MITOSIS. The difference between the two is that only de-  *
  *   cay and diffusion happen during mitosis and the regulation term is    *
- *   only included during INTERPHASE. The rule gets set in Blastoderm      *
- *   (using SetRule) to ensure that the derivative function is in the      *
- *   right rule.                                                           *
+ *   only included during INTERPHASE. The rule comes in si->rule, which    *
+ *   Blastoderm sets for each interval from the Schedule (the rule never   *
+ *   changes within one), so the derivative functions never look it up.   *
+ *   Only DvdtDelay still needs Theta(), for the delayed times.            *
  *                                                                         *
  *   JR: We get rid of 3 of 4 divisions in the inner loop by nesting. We   *
  *   get rid of an if by adding one iteration of the loop before and one   *
@@ -158,65 +326,505 @@ FreeMutant( EqParms lparm ) {
  *                                                                         *
  ***************************************************************************/
 
+/*** REGULATORY INPUT KERNELS *********************************************
+ *                                                                         *
+ *   u = h + m * bcd + E . v_ext + T . v for every gene in all m nuclei    *
+ *   is the hottest loop of the model. Only T . v depends on the state:    *
+ *   RegBase() puts the rest into u (from a table per cleavage cycle and   *
+ *   interval of the external inputs, which are linear in t), and the      *
+ *   kernels below then add T . v to it. Besides the generic version there *
+ *   are kernels for the most common circuit sizes (ngenes) with the dot   *
+ *   products written out in full. The terms are summed in exactly the    *
+ *   same order as in the generic loop, so all kernels give bit-identical  *
+ *   results. The kernel is chosen by InitRegInput() (called from Init-    *
+ *   Zygote).                                                              *
+ *                                                                         *
+ ***************************************************************************/
+
+/* NOTE: no parentheses around these on purpose, so that the sum is        *
+ * evaluated left to right, just like the += in the generic loop           */
+#define DOT4( a, x )    a[0] * x[0] + a[1] * x[1] + a[2] * x[2] + a[3] * x[3]
+#define DOT6( a, x )    DOT4( a, x ) + a[4] * x[4] + a[5] * x[5]
+#define DOT8( a, x )    DOT6( a, x ) + a[6] * x[6] + a[7] * x[7]
+
+/** RegBaseSlot: h + m * bcd + E . v_ext, the part of the regulatory    
+ *                input that does not depend on the state, is linear in t 
+ *                within an interval of the external inputs; so we work   
+ *                out its value at the start of the interval and its slope
+ *                once per cycle and interval and keep them in the work-  
+ *                space until ResetRegBase (Blastoderm does that for each 
+ *                run); returns the values for the m nuclei at time t,    
+ *                followed by the slopes, and t - t0 in t_diff; SetCycle  
+ *                must have been called for t first                       
+ */
+static double *
+RegBaseSlot( double t, int m, int allele, Input * inp, double *t_diff ) {
+    const int ngenes = inp->zyg.defs.ngenes;
+    const int egenes = inp->zyg.defs.egenes;
+    const int n = m * ngenes;
+    InterpObject *io = &( inp->ext[allele] );
+    Workspace *wsp = &( inp->wsp );
+    EqParms *lparm = &( inp->lparm );
+    int i, j, e, k, c, ap, slot, nslots;
+    double u1, s1;
+    double *base, *slope, *f, *fs, *E;
+
+    k = InterpInterval( io, t, &( inp->ctx.extcursor ), t_diff );
+    c = GetStartLinIndex( t, &( inp->zyg.defs ), &( inp->zyg.times ) );
+    if( io->csize[c] != m * egenes )
+        error( "RegBase: %d nuclei don't match the external inputs", m );
+
+    /* one slot per interval and cycle, so each slot has a fixed size */
+    slot = k * io->ncycles + c;
+    nslots = io->slope.size * io->ncycles;
+    if( nslots > wsp->nregbase ) {
+        wsp->regbase = ( double ** ) realloc( wsp->regbase, nslots * sizeof( double * ) );
+        wsp->regvalid = ( int * ) realloc( wsp->regvalid, nslots * sizeof( int ) );
+        for( i = wsp->nregbase; i < nslots; i++ ) {
+            wsp->regbase[i] = NULL;
+            wsp->regvalid[i] = 0;
+        }
+        wsp->bytes += ( nslots - wsp->nregbase ) * ( sizeof( double * ) + sizeof( int ) );
+        wsp->nregbase = nslots;
+    }
+
+    if( !wsp->regvalid[slot] ) {
+        if( !wsp->regbase[slot] ) {
+            wsp->regbase[slot] = ( double * ) malloc( 2 * n * sizeof( double ) );
+            wsp->bytes += 2 * n * sizeof( double );
+        }
+        base = wsp->regbase[slot];
+        slope = base + n;
+        f = io->cfunc[c] + k * io->csize[c];
+        fs = io->cslope[c] + k * io->csize[c];
+        for( ap = 0, i = 0; ap < m; ap++, f += egenes, fs += egenes ) {
+            for( j = 0, E = lparm->E; j < ngenes; j++, i++, E += egenes ) {
+                u1 = lparm->h[j];
+                u1 += lparm->m[j] * wsp->bcd.array[ap]; /* ap is nuclear index */
+                s1 = 0.;
+                for( e = 0; e < egenes; e++ ) {
+                    u1 += E[e] * f[e];
+                    s1 += E[e] * fs[e];
+                }
+                base[i] = u1;
+                slope[i] = s1;
+            }
+        }
+        wsp->regvalid[slot] = 1;
+    }
+    return wsp->regbase[slot];
+}
+
+/** RegBase: writes h + m * bcd + E . v_ext for the m nuclei at time t 
+ *            into u (see RegBaseSlot)                                  
+ */
+static void
+RegBase( double t, int m, int allele, Input * inp, double *u ) {
+    const int n = m * inp->zyg.defs.ngenes;
+    int i;
+    double t_diff;
+    double *base, *slope;
+
+    base = RegBaseSlot( t, m, allele, inp, &t_diff );
+    slope = base + n;
+    for( i = 0; i < n; i++ )
+        u[i] = base[i] + slope[i] * t_diff;
+}
+
+/** RegInputGeneric: adds T . v to u for any ngenes */
+void
+RegInputGeneric( double *v, int m, EqParms * lparm, TheProblem * defs, double *u ) {
+    int ap, k, j;               /* nucleus, gene and loop counter */
+    int base;                   /* first gene in nucleus */
+    double u1;
+
+    for( ap = 0, base = 0; ap < m; ap++, base += defs->ngenes ) {
+        for( k = 0; k < defs->ngenes; k++ ) {
+            u1 = u[base + k];
+            for( j = 0; j < defs->ngenes; j++ )
+                u1 += lparm->T[( k * defs->ngenes ) + j] * v[base + j];
+            u[base + k] = u1;
+        }
+    }
+}
+
+/** RegInput4: adds T . v to u for 4 genes */
+void
+RegInput4( double *v, int m, EqParms * lparm, TheProblem * defs, double *u ) {
+    int ap, k;
+    double *vv, *T;
+
+    for( ap = 0, vv = v; ap < m; ap++, vv += 4, u += 4 ) {
+        for( k = 0, T = lparm->T; k < 4; k++, T += 4 )
+            u[k] = u[k] + DOT4( T, vv );
+    }
+}
+
+/** RegInput6: adds T . v to u for 6 genes */
+void
+RegInput6( double *v, int m, EqParms * lparm, TheProblem * defs, double *u ) {
+    int ap, k;
+    double *vv, *T;
+
+    for( ap = 0, vv = v; ap < m; ap++, vv += 6, u += 6 ) {
+        for( k = 0, T = lparm->T; k < 6; k++, T += 6 )
+            u[k] = u[k] + DOT6( T, vv );
+    }
+}
+
+/** RegInput8: adds T . v to u for 8 genes */
+void
+RegInput8( double *v, int m, EqParms * lparm, TheProblem * defs, double *u ) {
+    int ap, k;
+    double *vv, *T;
+
+    for( ap = 0, vv = v; ap < m; ap++, vv += 8, u += 8 ) {
+        for( k = 0, T = lparm->T; k < 8; k++, T += 8 )
+            u[k] = u[k] + DOT8( T, vv );
+    }
+}
+
+/** InitRegInput: picks the regulatory input kernel for the circuit size */
+void
+InitRegInput( TheProblem * defs ) {
+    if( defs->ngenes == 4 )
+        p_reginput = RegInput4;
+    else if( defs->ngenes == 6 )
+        p_reginput = RegInput6;
+    else if( defs->ngenes == 8 )
+        p_reginput = RegInput8;
+    else
+        p_reginput = RegInputGeneric;
+}
+
+/*** NUCLEUS BLOCKS ********************************************************
+ *                                                                         *
+ *   For big embryos a single evaluation of the derivative (or of the      *
+ *   banded Jacobian) is worth sharing out over a few threads. Everything  *
+ *   in there is local to a nucleus, except for diffusion, which also      *
+ *   needs the neighbouring nuclei on either side (the halo). Since v is   *
+ *   only read while we evaluate, each block simply reads its halo from    *
+ *   v across the border and writes its own part of vdot (or u, g(u) and   *
+ *   the Jacobian columns), so there is nothing to exchange or lock.       *
+ *                                                                         *
+ *   ForNucBlocks() cuts the m nuclei into at most rhsthreads contiguous   *
+ *   blocks of at least rhsblock nuclei each; the calling thread does the  *
+ *   first block and a team of threads, which each Workspace starts the    *
+ *   first time it needs it, does the others. Problems too small for two   *
+ *   blocks stay on the serial path. All blocks give the same bits as the  *
+ *   serial code, since the vector functions don't care where an argument  *
+ *   is in the array (see vecLib.h).                                       *
+ *                                                                         *
+ ***************************************************************************/
+
+/* a job for the team: func(first, last, arg) for each block of nuclei */
+typedef void ( *BlockFunc ) ( int first, int last, void *arg );
+
+struct NucTeam {
+    int size;                   /* number of threads (without the caller) */
+    pthread_t *threads;
+    pthread_mutex_t lock;       /* protects everything below */
+    pthread_cond_t go;          /* a new job is there ... */
+    pthread_cond_t done;        /* ... and all its blocks are finished */
+    int round;                  /* number of the current job */
+    int pending;                /* blocks of the team still running */
+    int quit;                   /* StopNucTeam wants the threads back */
+    BlockFunc func;             /* the job ... */
+    void *arg;
+    int nblocks;                /* ... its number of blocks ... */
+    int *first;                 /* ... and their first nuclei (nblocks + 1) */
+};
+
+/* each thread of the team does block id + 1 of every job */
+typedef struct NucMember {
+    NucTeam *team;
+    int id;
+} NucMember;
+
+/** NucTeamThread: waits for jobs and does its block of each of them */
+static void *
+NucTeamThread( void *arg ) {
+    NucMember *me = ( NucMember * ) arg;
+    NucTeam *team = me->team;
+    int b = me->id + 1;
+    int round = 0;
+
+    pthread_mutex_lock( &( team->lock ) );
+    for( ;; ) {
+        while( ( team->round == round ) && !team->quit )
+            pthread_cond_wait( &( team->go ), &( team->lock ) );
+        if( team->quit )
+            break;
+        round = team->round;
+        if( b < team->nblocks ) {
+            pthread_mutex_unlock( &( team->lock ) );
+            ( *team->func ) ( team->first[b], team->first[b + 1], team->arg );
+            pthread_mutex_lock( &( team->lock ) );
+            if( --team->pending == 0 )
+                pthread_cond_signal( &( team->done ) );
+        }
+    }
+    pthread_mutex_unlock( &( team->lock ) );
+    free( me );
+    return NULL;
+}
+
+/** StartNucTeam: starts size threads that wait for nucleus blocks */
+static NucTeam *
+StartNucTeam( int size ) {
+    NucTeam *team;
+    NucMember *me;
+    int i;
+
+    team = ( NucTeam * ) calloc( 1, sizeof( NucTeam ) );
+    team->threads = ( pthread_t * ) calloc( size, sizeof( pthread_t ) );
+    team->first = ( int * ) calloc( size + 2, sizeof( int ) );
+    if( !team->threads || !team->first )
+        error( "StartNucTeam: could not allocate team of %d threads", size );
+    pthread_mutex_init( &( team->lock ), NULL );
+    pthread_cond_init( &( team->go ), NULL );
+    pthread_cond_init( &( team->done ), NULL );
+    team->size = size;
+    for( i = 0; i < size; i++ ) {
+        me = ( NucMember * ) malloc( sizeof( NucMember ) );
+        me->team = team;
+        me->id = i;
+        if( pthread_create( &( team->threads[i] ), NULL, NucTeamThread, me ) )
+            error( "StartNucTeam: could not start thread %d", i );
+    }
+    return team;
+}
+
+/** StopNucTeam: sends the threads of a team home and frees it */
+static void
+StopNucTeam( NucTeam * team ) {
+    int i;
+
+    if( team == NULL )
+        return;
+    pthread_mutex_lock( &( team->lock ) );
+    team->quit = 1;
+    pthread_cond_broadcast( &( team->go ) );
+    pthread_mutex_unlock( &( team->lock ) );
+    for( i = 0; i < team->size; i++ )
+        pthread_join( team->threads[i], NULL );
+    pthread_mutex_destroy( &( team->lock ) );
+    pthread_cond_destroy( &( team->go ) );
+    pthread_cond_destroy( &( team->done ) );
+    free( team->threads );
+    free( team->first );
+    free( team );
+}
+
+/** NucBlocks: the number of blocks ForNucBlocks cuts m nuclei into */
+static int
+NucBlocks( int m ) {
+    int minblock = ( rhsblock > 0 ) ? rhsblock : RHS_BLOCK;
+    int nblocks;
+
+    if( rhsthreads < 2 )
+        return 1;
+    nblocks = m / minblock;
+    if( nblocks > rhsthreads )
+        nblocks = rhsthreads;
+    return ( nblocks > 1 ) ? nblocks : 1;
+}
+
+/** ForNucBlocks: calls func(first, last, arg) for contiguous blocks of 
+ *                 the m nuclei [first, last), in parallel if there are 
+ *                 enough of them (see NucBlocks), and returns when all 
+ *                 blocks are done                                      
+ */
+static void
+ForNucBlocks( Workspace * wsp, int m, BlockFunc func, void *arg ) {
+    NucTeam *team;
+    int b, nblocks = NucBlocks( m );
+
+    if( nblocks == 1 ) {
+        ( *func ) ( 0, m, arg );
+        return;
+    }
+    if( ( wsp->team != NULL ) && ( wsp->team->size + 1 < nblocks ) ) {       /* rhsthreads went up */
+        wsp->bytes -= sizeof( NucTeam ) + wsp->team->size * ( sizeof( pthread_t ) + sizeof( NucMember ) ) + ( wsp->team->size + 2 ) * sizeof( int );
+        StopNucTeam( wsp->team );
+        wsp->team = NULL;
+    }
+    if( wsp->team == NULL ) {
+        wsp->team = StartNucTeam( rhsthreads - 1 );
+        wsp->bytes += sizeof( NucTeam ) + ( rhsthreads - 1 ) * ( sizeof( pthread_t ) + sizeof( NucMember ) )
+            + ( rhsthreads + 1 ) * sizeof( int );
+    }
+    team = wsp->team;
+    if( nblocks > team->size + 1 )
+        nblocks = team->size + 1;
+
+    pthread_mutex_lock( &( team->lock ) );
+    team->func = func;
+    team->arg = arg;
+    team->nblocks = nblocks;
+    for( b = 0; b <= nblocks; b++ )
+        team->first[b] = ( int ) ( ( ( long ) b * m ) / nblocks );
+    team->pending = nblocks - 1;
+    team->round++;
+    pthread_cond_broadcast( &( team->go ) );
+    pthread_mutex_unlock( &( team->lock ) );
+
+    ( *func ) ( team->first[0], team->first[1], arg );
+
+    pthread_mutex_lock( &( team->lock ) );
+    while( team->pending > 0 )
+        pthread_cond_wait( &( team->done ), &( team->lock ) );
+    pthread_mutex_unlock( &( team->lock ) );
+}
+
+/* what the blocks of DvdtOrig, Dvdt_sqrt and JacobnBand need to know */
+typedef struct NucJob {
+    double *v;                  /* the state (all m nuclei) ... */
+    double *vdot;               /* ... and its derivative */
+    double **col;               /* JacobnBand: the band matrix */
+    int offset;
+    int m;                      /* number of nuclei */
+    int lrule;                  /* 0 during mitosis: no regulation */
+    double *base;               /* h + m * bcd + E . v_ext at the start */
+    double *slope;              /* of the interval, its slope and t - t0 */
+    double t_diff;              /* (see RegBaseSlot) */
+    Input *inp;
+} NucJob;
+
+/** RegInputBlock: u = h + m * bcd + E . v_ext + T . v for the nuclei in 
+ *                  [first, last), as RegBase and the RegInput kernel do 
+ */
+static void
+RegInputBlock( int first, int last, NucJob * job, double *u ) {
+    const int ngenes = job->inp->zyg.defs.ngenes;
+    int i;
+
+    for( i = first * ngenes; i < last * ngenes; i++ )
+        u[i] = job->base[i] + job->slope[i] * job->t_diff;
+    ( *p_reginput ) ( job->v + first * ngenes, last - first, &( job->inp->lparm ), &( job->inp->zyg.defs ), u + first * ngenes );
+}
+
+/** DvdtOrigBlock: DvdtOrig for the nuclei in [first, last) (see NUCLEUS 
+ *                  BLOCKS); the terms are summed in the same order as in 
+ *                  DvdtOrig below                                        
+ */
+static void
+DvdtOrigBlock( int first, int last, void *arg ) {
+    NucJob *job = ( NucJob * ) arg;
+    Input *inp = job->inp;
+    const int ngenes = inp->zyg.defs.ngenes;
+    const int lo = first * ngenes;      /* our part of the state */
+    const int nb = ( last - first ) * ngenes;
+    int ap, i, k;
+    double vdot1, g1;
+    double *v = job->v;
+    double *vdot = job->vdot;
+    double *D = inp->wsp.D;
+    double *u = inp->wsp.vinput;
+    double *bot2 = inp->wsp.bot2;
+    double *bot = inp->wsp.bot;
+
+    RegInputBlock( first, last, job, u );
+
+    if( gofu == Sqrt ) {
+        for( i = lo; i < lo + nb; i++ )
+            bot2[i] = 1 + u[i] * u[i];
+        VecSqrt( bot2 + lo, bot + lo, nb );
+    } else if( gofu == Tanh ) {
+        VecTanh( u + lo, bot + lo, nb );
+    } else if( gofu == Exp ) {
+        for( i = lo; i < lo + nb; i++ )
+            u[i] = -2.0 * u[i];
+        VecExp( u + lo, bot + lo, nb );
+    } else if( ( gofu != Hvs ) && ( gofu != Kolja ) )
+        error( "DvdtOrig: unknown g(u)" );
+
+    for( ap = first, i = lo; ap < last; ap++ ) {
+        for( k = 0; k < ngenes; k++, i++ ) {
+            vdot1 = -inp->lparm.lambda[k] * v[i];
+            if( gofu == Sqrt ) {
+                g1 = 1 + u[i] / bot[i];
+                vdot1 += job->lrule * inp->lparm.R[k] * 0.5 * g1;
+            } else if( gofu == Tanh ) {
+                g1 = bot[i] + 1;
+                vdot1 += job->lrule * inp->lparm.R[k] * 0.5 * g1;
+            } else {
+                if( gofu == Exp )
+                    g1 = 1 / ( 1 + bot[i] );
+                else if( gofu == Hvs )
+                    g1 = ( u[i] >= 0. ) ? 1. : 0.;
+                else
+                    g1 = u[i];
+                vdot1 += job->lrule * inp->lparm.R[k] * g1;
+            }
+            /* diffusion: the halo is v of nuclei first - 1 and last */
+            if( job->m > 1 ) {
+                if( ap == 0 )
+                    vdot1 += D[k] * ( v[i + ngenes] - v[i] );
+                else if( ap == job->m - 1 )
+                    vdot1 += D[k] * ( v[i - ngenes] - v[i] );
+                else
+                    vdot1 += D[k] * ( ( v[i - ngenes] - v[i] ) + ( v[i + ngenes] - v[i] ) );
+            }
+            vdot[i] = vdot1;
+        }
+    }
+}
+
 /** DvdtOrig: the original derivative function; implements the equations 
  *             as published in Reinitz & Sharp (1995), Mech Dev 49, 133-58 
  *             plus different g(u) functions as used by Yousong Wang in    
- *             spring 2002.                                                
+ *             spring 2002; big embryos are done in blocks of nuclei by    
+ *             rhsthreads threads (see NUCLEUS BLOCKS above)               
  */
 void
 DvdtOrig( double *v, double t, double *vdot, int n, SolverInput * si, Input * inp ) {
 
-    double vinput1 = 0;
     int m;                      /* number of nuclei */
-    int ap;                     /* nuclear index on AP axis [0,1,...,m-1] */
-    int i, j;                   /* local loop counters */
+    int i;                      /* local loop counter */
     int k;                      /* index of gene k in a specific nucleus */
-    int base, base1;            /* index of first gene in a specific nucleus */
-    int *l_rule;                /* for autonomous implementation */
+    int base;                   /* index of first gene in a specific nucleus */
+    int *l_rule = inp->wsp.l_rule;      /* for autonomous implementation */
 #ifdef ALPHA_DU
     int incx = 1;               /* increment step size for vsqrt input array */
     int incy = 1;               /* increment step size for vsqrt output array */
 #endif
 
-    static int num_nucs = 0;    /* store the number of nucs for next step */
-    static int bcd_index = 0;   /* the *next* array in bicoid struct for bcd */
-    static DArrPtr bcd;         /* pointer to appropriate bicoid struct */
-    double *v_ext;              /* array to hold the external input
-                                   concentrations at time t */
+    double *D = inp->wsp.D;     /* diffusion coefficients for this cycle */
+    double *vinput = inp->wsp.vinput;   /* vinput, bot2 and bot are used for */
+    double *bot2 = inp->wsp.bot2;       /* storing intermediate stuff for vector */
+    double *bot = inp->wsp.bot; /* functions (see Workspace in maternal.h) */
     int allele = si->genindex;
 
-    vinput = ( double * ) calloc( inp->zyg.defs.ngenes * inp->zyg.defs.nnucs, sizeof( double ) );
-    bot2 = ( double * ) calloc( inp->zyg.defs.ngenes * inp->zyg.defs.nnucs, sizeof( double ) );
-    bot = ( double * ) calloc( inp->zyg.defs.ngenes * inp->zyg.defs.nnucs, sizeof( double ) );
-
 
     /* get D parameters and bicoid gradient according to cleavage cycle */
     /* n is the total number of genes */
     m = n / inp->zyg.defs.ngenes;       /* m is the number of nuclei */
     /* inp->zyg.defs.ngenes is the number of
      * genes per nucleus */
-    if( m != num_nucs ) {       /* time-varying quantities only vary by ccycle */
-
-        GetD( t, inp->lparm.d, D, &( inp->zyg ) );
-        /* get diff coefficients, according to diff schedule */
-        if( num_nucs > m )      /* started a new iteration in score */
-            bcd_index = 0;      /* -> start all over again! */
-        num_nucs = m;           /* store # of nucs for next step */
-        bcd = GetBicoid( t, allele, inp->zyg.bcdtype, &( inp->zyg ) );  /* get bicoid gradient */
-        if( bcd.size != num_nucs )
-            error( "DvdtOrig: %d nuclei don't match Bicoid!", num_nucs );
-        bcd_index++;            /* store index for next bicoid gradient */
+    SetCycle( t, m, allele, inp, "DvdtOrig" );
+
+    /* big embryos: the same equations, in blocks of nuclei */
+    if( NucBlocks( m ) > 1 ) {
+        NucJob job;
+
+        job.v = v;
+        job.vdot = vdot;
+        job.m = m;
+        job.lrule = !( si->rule );
+        job.base = RegBaseSlot( t, m, allele, inp, &( job.t_diff ) );
+        job.slope = job.base + n;
+        job.inp = inp;
+        ForNucBlocks( &( inp->wsp ), m, DvdtOrigBlock, &job );
+        return;
     }
-    l_rule = ( int * ) calloc( inp->zyg.defs.ngenes, sizeof( int ) );
+
     for( i = 0; i < inp->zyg.defs.ngenes; i++ )
-        l_rule[i] = !( Theta( t, &( inp->zyg ) ) );     // Theta(u) = false while interphase
+        l_rule[i] = !( si->rule );      // si->rule is INTERPHASE (0) while interphase
     /* l_rule is zero during mitosis, in order
      * to put to zero the regulation part of the
      * equation. Remember, no regulation during
      * mitosis */
-    // Here we retrieve the external input concentrations into v_ext
-    v_ext = ( double * ) calloc( m * inp->zyg.defs.egenes, sizeof( double ) );
-    ExternalInputs( t, t, v_ext, m * inp->zyg.defs.egenes, inp->ext[allele], inp->zyg.defs.egenes, &( inp->zyg ) );     //here we assume that all the genotypes use the same external inps, so we take the first one -- ask Yogi 2
     /* This is how it works (by JR): 
 
        ap      nucleus position on ap axis
@@ -226,7 +834,8 @@ DvdtOrig( double *v, double t, double *vdot, int n, SolverInput * si, Input * in
        Protein synthesis terms are calculated according to g(u)
 
        First we do loop for vinput contributions; vinput contains
-       the u that goes into g(u)
+       the u that goes into g(u) (RegBase puts h + m * bcd + E . v_ext
+       into it, and the RegInput kernel adds T . v)
 
        Then we do a separate loop or vector func for sqrt or exp
 
@@ -241,6 +850,8 @@ DvdtOrig( double *v, double t, double *vdot, int n, SolverInput * si, Input * in
        These loops look a little funky 'cause we don't want any 
        divides'                                                       */
 
+    RegBase( t, m, allele, inp, vinput );
+    ( *p_reginput ) ( v, m, &( inp->lparm ), &( inp->zyg.defs ), vinput );
 
     /***************************************************************************
      *                                                                         *
@@ -252,21 +863,8 @@ DvdtOrig( double *v, double t, double *vdot, int n, SolverInput * si, Input * in
 
         gettimeofday( &start, NULL );   //start the timer
 
-        for( base = 0, base1 = 0, ap = 0; base < n; base += inp->zyg.defs.ngenes, base1 += inp->zyg.defs.egenes, ap++ ) {
-            for( i = base; i < base + inp->zyg.defs.ngenes; i++ ) {
-
-                k = i - base;
-                //printf("HK=%lg\n", inp->lparm.h[k]);
-                vinput1 = inp->lparm.h[k];
-                vinput1 += inp->lparm.m[k] * bcd.array[ap];     /* ap is nuclear index */
-                for( j = 0; j < inp->zyg.defs.egenes; j++ )
-                    vinput1 += inp->lparm.E[( k * inp->zyg.defs.egenes ) + j] * v_ext[base1 + j];
-                for( j = 0; j < inp->zyg.defs.ngenes; j++ )
-                    vinput1 += inp->lparm.T[( k * inp->zyg.defs.ngenes ) + j] * v[base + j];
-                bot2[i] = 1 + vinput1 * vinput1;
-                vinput[i] = vinput1;
-            }
-        }
+        for( i = 0; i < n; i++ )
+            bot2[i] = 1 + vinput[i] * vinput[i];
 
         gettimeofday( &end, NULL );     //start the timer
         //printf("beforehalfG %ld\n", ((end.tv_sec * 1000000 + end.tv_usec) - (start.tv_sec * 1000000 + start.tv_usec)));
@@ -274,8 +872,7 @@ DvdtOrig( double *v, double t, double *vdot, int n, SolverInput * si, Input * in
 #ifdef ALPHA_DU
         vsqrt_( bot2, &incx, bot, &incy, &n );  /* superfast DEC vector function */
 #else
-        for( i = 0; i < n; i++ )        /* slow traditional style sqrt */
-            bot[i] = sqrt( bot2[i] );
+        VecSqrt( bot2, bot, n );        /* SIMD vector function (vecLib.c) */
 #endif
         gettimeofday( &end, NULL );     //start the timer
         //printf("halfG %ld\n", ((end.tv_sec * 1000000 + end.tv_usec) - (start.tv_sec * 1000000 + start.tv_usec)));
@@ -336,23 +933,9 @@ DvdtOrig( double *v, double t, double *vdot, int n, SolverInput * si, Input * in
          ***************************************************************************/
 
     } else if( gofu == Tanh ) {
-        for( base = 0, base1 = 0, ap = 0; base < n; base += inp->zyg.defs.ngenes, base1 += inp->zyg.defs.egenes, ap++ ) {
-            for( i = base; i < base + inp->zyg.defs.ngenes; i++ ) {
-
-                k = i - base;
-
-                vinput1 = inp->lparm.h[k];
-                vinput1 += inp->lparm.m[k] * bcd.array[ap];     /* ap is nuclear index */
 
-                for( j = 0; j < inp->zyg.defs.egenes; j++ )
-                    vinput1 += inp->lparm.E[( k * inp->zyg.defs.egenes ) + j] * v_ext[base1 + j];
-
-                for( j = 0; j < inp->zyg.defs.ngenes; j++ )
-                    vinput1 += inp->lparm.T[( k * inp->zyg.defs.ngenes ) + j] * v[base + j];
-
-                vinput[i] = vinput1;
-            }
-        }
+        /* calculate tanh(u); store it in bot[] */
+        VecTanh( vinput, bot, n );      /* SIMD vector function (vecLib.c) */
 
         /* next loop does the rest of the equation (R, Ds and lambdas) */
         /* store result in vdot[] */
@@ -366,7 +949,7 @@ DvdtOrig( double *v, double t, double *vdot, int n, SolverInput * si, Input * in
 
                     k = i - base;
                     vdot1 = -inp->lparm.lambda[k] * v[i];
-                    g1 = tanh( vinput[i] ) + 1;
+                    g1 = bot[i] + 1;
                     vdot1 += l_rule[k] * inp->lparm.R[k] * 0.5 * g1;
                     vdot[i] = vdot1;
                 }
@@ -379,7 +962,7 @@ DvdtOrig( double *v, double t, double *vdot, int n, SolverInput * si, Input * in
             for( i = 0; i < inp->zyg.defs.ngenes; i++ ) {       /* first anterior-most nucleus */
                 k = i;
                 vdot1 = -inp->lparm.lambda[k] * v[i];
-                g1 = tanh( vinput[i] ) + 1;
+                g1 = bot[i] + 1;
                 vdot1 += l_rule[k] * inp->lparm.R[k] * 0.5 * g1;
                 vdot1 += D[i] * ( v[i + inp->zyg.defs.ngenes] - v[i] );
                 vdot[i] = vdot1;
@@ -389,7 +972,7 @@ DvdtOrig( double *v, double t, double *vdot, int n, SolverInput * si, Input * in
                 for( i = base; i < base + inp->zyg.defs.ngenes; i++ ) {
                     k = i - base;
                     vdot1 = -inp->lparm.lambda[k] * v[i];
-                    g1 = tanh( vinput[i] ) + 1;
+                    g1 = bot[i] + 1;
                     vdot1 += l_rule[k] * inp->lparm.R[k] * 0.5 * g1;
                     vdot1 += D[k] * ( ( v[i - inp->zyg.defs.ngenes] - v[i] ) + ( v[i + inp->zyg.defs.ngenes] - v[i] ) );
                     vdot[i] = vdot1;
@@ -399,7 +982,7 @@ DvdtOrig( double *v, double t, double *vdot, int n, SolverInput * si, Input * in
             for( i = base; i < base + inp->zyg.defs.ngenes; i++ ) {
                 k = i - base;
                 vdot1 = -inp->lparm.lambda[k] * v[i];
-                g1 = tanh( vinput[i] ) + 1;
+                g1 = bot[i] + 1;
                 vdot1 += l_rule[k] * inp->lparm.R[k] * 0.5 * g1;
                 vdot1 += D[k] * ( v[i - inp->zyg.defs.ngenes] - v[i] );
                 vdot[i] = vdot1;
@@ -412,30 +995,14 @@ DvdtOrig( double *v, double t, double *vdot, int n, SolverInput * si, Input * in
          ***************************************************************************/
 
     } else if( gofu == Exp ) {
-        for( base = 0, base1 = 0, ap = 0; base < n; base += inp->zyg.defs.ngenes, base1 += inp->zyg.defs.egenes, ap++ ) {
-            for( i = base; i < base + inp->zyg.defs.ngenes; i++ ) {
-
-                k = i - base;
-
-                vinput1 = inp->lparm.h[k];
-                vinput1 += inp->lparm.m[k] * bcd.array[ap];     /* ap is nuclear index */
-
-                for( j = 0; j < inp->zyg.defs.egenes; j++ )
-                    vinput1 += inp->lparm.E[( k * inp->zyg.defs.egenes ) + j] * v_ext[base1 + j];
-
-                for( j = 0; j < inp->zyg.defs.ngenes; j++ )
-                    vinput1 += inp->lparm.T[( k * inp->zyg.defs.ngenes ) + j] * v[base + j];
-
-                vinput[i] = -2.0 * vinput1;
-            }
-        }
+        for( i = 0; i < n; i++ )
+            vinput[i] = -2.0 * vinput[i];
 
         /* now calculate exp(-u); store it in bot[] */
 #ifdef ALPHA_DU
         vexp_( vinput, &incx, bot, &incy, &n ); /* superfast DEC vector function */
 #else
-        for( i = 0; i < n; i++ )        /* slow traditional style exp */
-            bot[i] = exp( vinput[i] );
+        VecExp( vinput, bot, n );       /* SIMD vector function (vecLib.c) */
 #endif
 
         /* next loop does the rest of the equation (R, Ds and lambdas) */
@@ -499,22 +1066,6 @@ DvdtOrig( double *v, double t, double *vdot, int n, SolverInput * si, Input * in
          ***************************************************************************/
 
     } else if( gofu == Hvs ) {
-        for( base = 0, base1 = 0, ap = 0; base < n; base += inp->zyg.defs.ngenes, base1 += inp->zyg.defs.egenes, ap++ ) {
-            for( i = base; i < base + inp->zyg.defs.ngenes; i++ ) {
-
-                k = i - base;
-
-                vinput1 = inp->lparm.h[k];
-                vinput1 += inp->lparm.m[k] * bcd.array[ap];     /* ap is nuclear index */
-
-                for( j = 0; j < inp->zyg.defs.egenes; j++ )
-                    vinput1 += inp->lparm.E[( k * inp->zyg.defs.egenes ) + j] * v_ext[base1 + j];
-
-                for( j = 0; j < inp->zyg.defs.ngenes; j++ )
-                    vinput1 += inp->lparm.T[( k * inp->zyg.defs.ngenes ) + j] * v[base + j];
-                vinput[i] = vinput1;
-            }
-        }
 
         /* next loop does the rest of the equation (R, Ds and lambdas) */
         /* store result in vdot[] */
@@ -581,23 +1132,6 @@ DvdtOrig( double *v, double t, double *vdot, int n, SolverInput * si, Input * in
         }
 
     } else if( gofu == Kolja ) {
-        for( base = 0, base1 = 0, ap = 0; base < n; base += inp->zyg.defs.ngenes, base1 += inp->zyg.defs.egenes, ap++ ) {
-            for( i = base; i < base + inp->zyg.defs.ngenes; i++ ) {
-
-                k = i - base;
-
-                vinput1 = inp->lparm.h[k];
-                vinput1 += inp->lparm.m[k] * bcd.array[ap];     /* ap is nuclear index */
-
-                for( j = 0; j < inp->zyg.defs.egenes; j++ )
-                    vinput1 += inp->lparm.E[( k * inp->zyg.defs.egenes ) + j] * v_ext[base1 + j];
-
-                for( j = 0; j < inp->zyg.defs.ngenes; j++ )
-                    vinput1 += inp->lparm.T[( k * inp->zyg.defs.ngenes ) + j] * v[base + j];
-
-                vinput[i] = vinput1;    //u
-            }
-        }
 
         if( n == inp->zyg.defs.ngenes ) {       /* first part: one nuc, no diffusion */
 
@@ -655,14 +1189,189 @@ DvdtOrig( double *v, double t, double *vdot, int n, SolverInput * si, Input * in
         error( "DvdtOrig: unknown g(u)" );
 
     /* during mitosis only diffusion and decay happen */
-    free( l_rule );
-    free( v_ext );
-    free( vinput );
-    free( bot2 );
-    free( bot );
     return;
 }
 
+/** DvdtEnsemble: DvdtOrig for all members of an ensemble at once; v and 
+ *                 vdot are interleaved (element i of member k at i * K + k 
+ *                 for K = ens->size members) and n is the size of the     
+ *                 state of one member; each member gets the same bits as  
+ *                 from DvdtOrig on its own, whatever the other members    
+ *                 are, since the sums go in the same order and VecExp and 
+ *                 VecTanh don't care where in the array an argument is    
+ *                 (see vecLib.h); only the vector loops run over members  
+ */
+void
+DvdtEnsemble( double *v, double t, double *vdot, int n, SolverInput * si, Ensemble * ens ) {
+    const int K = ens->size;
+    const int ngenes = ens->member[0]->zyg.defs.ngenes;
+    const int m = n / ngenes;   /* number of nuclei */
+    const int nk = n * K;       /* length of v and vdot */
+    const int lrule = !( si->rule );    /* 0 during mitosis: no regulation */
+    int i, j, k, e;
+    double t_diff;
+    double half;                /* the 1/2 in front of g(u), if any */
+    double *base, *slope;       /* baseline of u of a member (RegBaseSlot) */
+    double *u = ens->u;
+    double *bot2 = ens->bot2;
+    double *bot = ens->bot;
+    Input *inp;
+
+    /* a single member is laid out just like a state of its own */
+    if( K == 1 ) {
+        DvdtOrig( v, t, vdot, n, si, ens->member[0] );
+        return;
+    }
+
+    half = ( ( gofu == Sqrt ) || ( gofu == Tanh ) ) ? 0.5 : 1.;
+
+    /* the parameters and the state-independent part of u of each member; *
+     * R goes in with the rule and the 1/2, in the same order as DvdtOrig */
+    for( k = 0; k < K; k++ ) {
+        inp = ens->member[k];
+        SetCycle( t, m, si->genindex, inp, "DvdtEnsemble" );
+        for( i = 0; i < ngenes; i++ ) {
+            ens->R[i * K + k] = lrule * inp->lparm.R[i] * half;
+            ens->lambda[i * K + k] = inp->lparm.lambda[i];
+            ens->D[i * K + k] = inp->wsp.D[i];
+            for( j = 0; j < ngenes; j++ )
+                ens->T[( i * ngenes + j ) * K + k] = inp->lparm.T[i * ngenes + j];
+        }
+        base = RegBaseSlot( t, m, si->genindex, inp, &t_diff );
+        slope = base + n;
+        for( e = 0; e < n; e++ )
+            u[e * K + k] = base[e] + slope[e] * t_diff;
+    }
+
+    /* u += T . v, in the order of the RegInput kernels */
+    VecEnsembleDot( ens->T, v, u, ngenes, m, K );
+
+    /* g(u) goes into bot */
+    if( gofu == Sqrt ) {
+        for( e = 0; e < nk; e++ )
+            bot2[e] = 1 + u[e] * u[e];
+        VecSqrt( bot2, bot, nk );
+        for( e = 0; e < nk; e++ )
+            bot[e] = 1 + u[e] / bot[e];
+    } else if( gofu == Tanh ) {
+        VecTanh( u, bot, nk );
+        for( e = 0; e < nk; e++ )
+            bot[e] = bot[e] + 1;
+    } else if( gofu == Exp ) {
+        for( e = 0; e < nk; e++ )
+            u[e] = -2.0 * u[e];
+        VecExp( u, bot, nk );
+        for( e = 0; e < nk; e++ )
+            bot[e] = 1 / ( 1 + bot[e] );
+    } else if( gofu == Hvs ) {
+        for( e = 0; e < nk; e++ )
+            bot[e] = ( u[e] >= 0. ) ? 1. : 0.;
+    } else if( gofu == Kolja ) {
+        for( e = 0; e < nk; e++ )
+            bot[e] = u[e];
+    } else
+        error( "DvdtEnsemble: unknown g(u)" );
+
+    /* decay, production and diffusion (none for a single nucleus) */
+    VecEnsembleRate( v, bot, ens->lambda, ens->R, ens->D, vdot, ngenes, m, K );
+}
+
+/** DvdtGeneMajor: same equations as DvdtOrig, but v and vdot are stored
+ *                  gene-major (v[k*m + ap], see StateLayout in zygotic.h)
+ *                  so that all loops run over contiguous rows of nuclei;
+ *                  the sums are done in the same order as in DvdtOrig,
+ *                  which gives the same bits in the other layout
+ */
+void
+DvdtGeneMajor( double *v, double t, double *vdot, int n, SolverInput * si, Input * inp ) {
+
+    const int ngenes = inp->zyg.defs.ngenes;
+    int m;                      /* number of nuclei */
+    int ap;                     /* nuclear index on AP axis [0,1,...,m-1] */
+    int i, j;                   /* local loop counters */
+    int k;                      /* index of gene k */
+    int lrule;                  /* 0 during mitosis: no regulation */
+    double rate;                /* l_rule * R (* 0.5) for gene k */
+    double *u, *g, *vk, *vdk;   /* rows of gene k */
+    double *base, *slope;       /* baseline of u and its slope in time */
+    double t_diff;              /* time since the start of the interval */
+    double *Tk, u1;             /* row k of T and one element of u */
+
+    double *D = inp->wsp.D;     /* diffusion coefficients for this cycle */
+    double *vinput = inp->wsp.vinput;   /* u, gene-major */
+    double *bot2 = inp->wsp.bot2;       /* intermediate stuff for g(u) */
+    double *bot = inp->wsp.bot; /* g(u) itself, gene-major */
+    int allele = si->genindex;
+
+    m = n / ngenes;
+    SetCycle( t, m, allele, inp, "DvdtGeneMajor" );
+    lrule = !( si->rule );
+
+    /* u = h + m * bcd + E . v_ext, read straight into gene-major order
+       from the nucleus-major baseline of RegBaseSlot (the same sums as
+       RegBase), then + T . v, one gene (row) at a time */
+    base = RegBaseSlot( t, m, allele, inp, &t_diff );
+    slope = base + n;
+    for( k = 0; k < ngenes; k++ ) {
+        u = vinput + k * m;
+        Tk = inp->lparm.T + k * ngenes;
+        for( ap = 0; ap < m; ap++ ) {
+            u1 = base[ap * ngenes + k] + slope[ap * ngenes + k] * t_diff;
+            for( j = 0; j < ngenes; j++ )
+                u1 += Tk[j] * v[j * m + ap];
+            u[ap] = u1;
+        }
+    }
+
+    /* g(u) into bot[]; the factor 1/2 of Sqrt and Tanh goes into rate */
+    g = bot;
+    if( gofu == Sqrt ) {
+        for( i = 0; i < n; i++ )
+            bot2[i] = 1 + vinput[i] * vinput[i];
+        VecSqrt( bot2, bot, n );
+        for( i = 0; i < n; i++ )
+            g[i] = 1 + vinput[i] / bot[i];
+    } else if( gofu == Tanh ) {
+        VecTanh( vinput, bot, n );
+        for( i = 0; i < n; i++ )
+            g[i] = bot[i] + 1;
+    } else if( gofu == Exp ) {
+        for( i = 0; i < n; i++ )
+            vinput[i] = -2.0 * vinput[i];
+        VecExp( vinput, bot, n );
+        for( i = 0; i < n; i++ )
+            g[i] = 1 / ( 1 + bot[i] );
+    } else if( gofu == Hvs ) {
+        for( i = 0; i < n; i++ )
+            g[i] = ( vinput[i] >= 0. ) ? 1. : 0.;
+    } else if( gofu == Kolja ) {
+        for( i = 0; i < n; i++ )
+            g[i] = vinput[i];
+    } else
+        error( "DvdtGeneMajor: unknown g(u)" );
+
+    /* production and decay, then diffusion with special cases at both ends */
+    for( k = 0; k < ngenes; k++ ) {
+        vk = v + k * m;
+        vdk = vdot + k * m;
+        g = bot + k * m;
+        rate = lrule * inp->lparm.R[k];
+        if( ( gofu == Sqrt ) || ( gofu == Tanh ) )
+            rate *= 0.5;
+
+        for( ap = 0; ap < m; ap++ ) {
+            vdk[ap] = -inp->lparm.lambda[k] * vk[ap];
+            vdk[ap] += rate * g[ap];
+        }
+        if( m > 1 ) {
+            vdk[0] += D[k] * ( vk[1] - vk[0] );
+            for( ap = 1; ap < m - 1; ap++ )
+                vdk[ap] += D[k] * ( ( vk[ap - 1] - vk[ap] ) + ( vk[ap + 1] - vk[ap] ) );
+            vdk[m - 1] += D[k] * ( vk[m - 2] - vk[m - 1] );
+        }
+    }
+}
+
 
 
 /*** JACOBIAN FUNCTION(S) **************************************************/
@@ -714,33 +1423,20 @@ JacobnOrig( double t, double *v, double *dfdt, double **jac, int n, SolverInput
     int incy = 1;               /* increment step size for vsqrt output array */
 #endif
 
-    static int num_nucs = 0;    /* store the number of nucs for next step */
-    static int bcd_index = 0;   /* the *next* array in bicoid struct for bcd */
-    DArrPtr bcd = ( const struct DArrPtr ){ 0 }; 
-                                /* pointer to appropriate bicoid struct */
+    DArrPtr bcd;                /* bicoid gradient for this cycle */
+    double *D = inp->wsp.D;     /* diffusion coefficients for this cycle */
+    double *bot2 = inp->wsp.bot2;       /* scratch arrays for g'(u), see */
+    double *bot = inp->wsp.bot; /* Workspace in maternal.h */
 
     int allele = si->genindex;
 
-    vinput = ( double * ) calloc( inp->zyg.defs.ngenes * inp->zyg.defs.nnucs, sizeof( double ) );
-    bot2 = ( double * ) calloc( inp->zyg.defs.ngenes * inp->zyg.defs.nnucs, sizeof( double ) );
-    bot = ( double * ) calloc( inp->zyg.defs.ngenes * inp->zyg.defs.nnucs, sizeof( double ) );
-
     /* get D parameters and bicoid gradient according to cleavage cycle */
 
     m = n / inp->zyg.defs.ngenes;       /* m is the number of nuclei */
-    if( m != num_nucs ) {       /* time-varying quantities only vary by ccycle */
-        GetD( t, inp->lparm.d, D, &( inp->zyg ) );
-        /* get diff coefficients, according to diff schedule */
-        if( num_nucs > m )      /* started a new iteration in score */
-            bcd_index = 0;      /* -> start all over again! */
-        num_nucs = m;           /* store # of nucs for next step */
-        bcd = GetBicoid( t, allele, inp->zyg.bcdtype, &( inp->zyg ) );  /* get bicoid gradient */
-        if( bcd.size != num_nucs )
-            error( "JacobnOrig: %d nuclei don't match Bicoid!", num_nucs );
-        bcd_index++;            /* store index for next bicoid gradient */
-    }
+    SetCycle( t, m, allele, inp, "JacobnOrig" );
+    bcd = inp->wsp.bcd;
 
-    rule = GetRule( t, &( inp->zyg ) );
+    rule = si->rule;
 
     /*** INTERPHASE rule *******************************************************/
 
@@ -785,8 +1481,7 @@ JacobnOrig( double t, double *v, double *dfdt, double **jac, int n, SolverInput
 #ifdef ALPHA_DU
             vsqrt_( bot2, &incx, bot, &incy, &n );      /* superfast DEC vector function */
 #else
-            for( i = 0; i < n; i++ )    /* slow traditional style sqrt */
-                bot[i] = sqrt( bot2[i] );
+            VecSqrt( bot2, bot, n );    /* SIMD vector function (vecLib.c) */
 #endif
 
             /* resume loop after vector sqrt above; we finish calculating g'(u) and    *
@@ -867,8 +1562,7 @@ JacobnOrig( double t, double *v, double *dfdt, double **jac, int n, SolverInput
 #ifdef ALPHA_DU
             vexp_( bot, &incx, bot2, &incy, &n );       /* superfast DEC vector function */
 #else
-            for( i = 0; i < n; i++ )    /* slow traditional style exp */
-                bot2[i] = exp( bot[i] );
+            VecExp( bot, bot2, n );     /* SIMD vector function (vecLib.c) */
 #endif
 
             /* resume loop after vector exp above; we finish calculating g'(u) and     *
@@ -961,12 +1655,421 @@ JacobnOrig( double t, double *v, double *dfdt, double **jac, int n, SolverInput
 
     } else
         error( "JacobnOrig: Bad rule %i sent to JacobnOrig", rule );
-    free( vinput );
-    free( bot2 );
-    free( bot );
     return;
 }
 
+/**  JacobnBandBlock: the columns of the banded Jacobian (see JacobnBand) 
+ *                    for the nuclei in [first, last)                      
+ */
+static void
+JacobnBandBlock( int first, int last, void *arg ) {
+    NucJob *job = ( NucJob * ) arg;
+    Input *inp = job->inp;
+    const int ngenes = inp->zyg.defs.ngenes;
+    const int lo = first * ngenes;      /* our part of the state */
+    const int hi = last * ngenes;
+    const int n = job->m * ngenes;
+    int i, j;                   /* row and column of the Jacobian */
+    int k, kk;                  /* gene of row i and of column j */
+    int base;                   /* index of 1st gene in a specific nucleus */
+
+    double *D = inp->wsp.D;     /* diffusion coefficients for this cycle */
+    double *u = inp->wsp.vinput;        /* regulatory input */
+    double *gdot = inp->wsp.bot;        /* R * g'(u) */
+    double *tmp = inp->wsp.bot2;        /* 1 + u^2 or -2u */
+    double *c;                  /* column j, shifted to its diagonal */
+    double diag;
+
+    /* R * g'(u) for every gene in every nucleus; no regulation in mitosis */
+    if( !job->lrule || ( gofu == Hvs ) ) {
+        for( i = lo; i < hi; i++ )
+            gdot[i] = 0.;
+    } else {
+        RegInputBlock( first, last, job, u );
+
+        if( gofu == Sqrt ) {    /* g'(u) = 1/2 * 1 / (1 + u^2)^3/2 */
+            for( i = lo; i < hi; i++ )
+                tmp[i] = 1 + u[i] * u[i];
+            VecSqrt( tmp + lo, gdot + lo, hi - lo );
+            for( base = lo; base < hi; base += ngenes )
+                for( k = 0; k < ngenes; k++ )
+                    gdot[base + k] = inp->lparm.R[k] * 0.5 / ( gdot[base + k] * tmp[base + k] );
+        } else if( gofu == Tanh ) {     /* g'(u) = 1/2 * (1 - tanh(u)^2) */
+            VecTanh( u + lo, gdot + lo, hi - lo );
+            for( base = lo; base < hi; base += ngenes )
+                for( k = 0; k < ngenes; k++ )
+                    gdot[base + k] = inp->lparm.R[k] * 0.5 * ( 1 - gdot[base + k] * gdot[base + k] );
+        } else if( gofu == Exp ) {      /* g'(u) = 2e^(-2u) / (1 + e^(-2u))^2 */
+            for( i = lo; i < hi; i++ )
+                tmp[i] = -2.0 * u[i];
+            VecExp( tmp + lo, gdot + lo, hi - lo );
+            for( base = lo; base < hi; base += ngenes )
+                for( k = 0; k < ngenes; k++ )
+                    gdot[base + k] = inp->lparm.R[k] * 2. * gdot[base + k] / ( ( 1. + gdot[base + k] ) * ( 1. + gdot[base + k] ) );
+        } else if( gofu == Kolja ) {    /* g(u) = u */
+            for( base = lo; base < hi; base += ngenes )
+                for( k = 0; k < ngenes; k++ )
+                    gdot[base + k] = inp->lparm.R[k];
+        } else
+            error( "JacobnBand: unknown g(u)" );
+    }
+
+    /* fill in column by column: the regulatory block of the nucleus, then *
+     * the diffusion to the neighbouring nuclei                            */
+    for( base = lo; base < hi; base += ngenes ) {
+        for( kk = 0; kk < ngenes; kk++ ) {
+            j = base + kk;
+            c = job->col[j] + job->offset;
+
+            for( k = 0; k < ngenes; k++ )
+                c[base + k - j] = inp->lparm.T[( k * ngenes ) + kk] * gdot[base + k];
+
+            diag = -inp->lparm.lambda[kk];
+            if( base > 0 ) {
+                c[-ngenes] = D[kk];
+                diag -= D[kk];
+            }
+            if( base < n - ngenes ) {
+                c[ngenes] = D[kk];
+                diag -= D[kk];
+            }
+            c[0] += diag;
+        }
+    }
+}
+
+/**  JacobnBand: banded Jacobian for the DvdtOrig model, for the CVODE Band 
+ *               solver; same matrix as in the diagram above for JacobnOrig, 
+ *               but with the regulatory input u (including external        
+ *               inputs) and the mitosis rule (si->rule) taken as in DvdtOrig,
+ *               for all g(u)'s (g'(u) of the heaviside is taken as zero);  
+ *               element (i,j) goes to col[j][i - j + offset], so col and   
+ *               offset are the cols and s_mu of a SUNDIALS band matrix;    
+ *               elements outside the nonzero pattern are not touched, and  
+ *               nothing gets allocated (scratch is in inp->wsp); big em-   
+ *               bryos are done in blocks of nuclei (see NUCLEUS BLOCKS)    
+ */
+void
+JacobnBand( double t, double *v, int n, double **col, int offset, SolverInput * si, Input * inp ) {
+    NucJob job;
+
+    job.m = n / inp->zyg.defs.ngenes;
+    SetCycle( t, job.m, si->genindex, inp, "JacobnBand" );
+
+    job.v = v;
+    job.col = col;
+    job.offset = offset;
+    job.lrule = !( si->rule );
+    if( job.lrule && ( gofu != Hvs ) ) {
+        job.base = RegBaseSlot( t, job.m, si->genindex, inp, &( job.t_diff ) );
+        job.slope = job.base + n;
+    }
+    job.inp = inp;
+    ForNucBlocks( &( inp->wsp ), job.m, JacobnBandBlock, &job );
+}
+
+/**  RegSlopes: g(u) and R * g'(u) of the DvdtOrig model at time t for 
+ *              the n = m * ngenes concentrations in v, as in JacobnBand 
+ *              but we need both for the derivatives to the parameters;  
+ *              both are zero in mitosis; SetCycle must have been called 
+ *              and v_ext and u in inp->wsp get overwritten              
+ */
+static void
+RegSlopes( double t, double *v, int m, SolverInput * si, double *g, double *gdot, Input * inp, char *caller ) {
+    int i, k, base;
+    int allele = si->genindex;
+    int n = m * inp->zyg.defs.ngenes;
+    int ngenes = inp->zyg.defs.ngenes;
+    int egenes = inp->zyg.defs.egenes;
+    double *v_ext = inp->wsp.v_ext;     /* external inputs at time t */
+    double *u = inp->wsp.vinput;        /* regulatory input */
+    double a, e;
+
+    if( si->rule == MITOSIS ) {
+        for( i = 0; i < n; i++ )
+            g[i] = gdot[i] = 0.;
+    } else {
+        /* the derivatives to E need v_ext as well */
+        ExternalInputs( t, t, v_ext, m * egenes, inp->ext[allele], egenes, &( inp->zyg ), &( inp->ctx.extcursor ) );
+        RegBase( t, m, allele, inp, u );
+        ( *p_reginput ) ( v, m, &( inp->lparm ), &( inp->zyg.defs ), u );
+
+        if( gofu == Sqrt ) {
+            for( i = 0; i < n; i++ )
+                g[i] = 1 + u[i] * u[i];
+            VecSqrt( g, gdot, n );
+            for( base = 0; base < n; base += ngenes )
+                for( k = 0; k < ngenes; k++ ) {
+                    i = base + k;
+                    a = gdot[i];
+                    gdot[i] = inp->lparm.R[k] * 0.5 / ( a * g[i] );
+                    g[i] = 0.5 * ( 1 + u[i] / a );
+                }
+        } else if( gofu == Tanh ) {
+            VecTanh( u, gdot, n );
+            for( base = 0; base < n; base += ngenes )
+                for( k = 0; k < ngenes; k++ ) {
+                    i = base + k;
+                    a = gdot[i];
+                    g[i] = 0.5 * ( a + 1 );
+                    gdot[i] = inp->lparm.R[k] * 0.5 * ( 1 - a * a );
+                }
+        } else if( gofu == Exp ) {
+            for( i = 0; i < n; i++ )
+                g[i] = -2.0 * u[i];
+            VecExp( g, gdot, n );
+            for( base = 0; base < n; base += ngenes )
+                for( k = 0; k < ngenes; k++ ) {
+                    i = base + k;
+                    e = gdot[i];
+                    g[i] = 1 / ( 1 + e );
+                    gdot[i] = inp->lparm.R[k] * 2. * e / ( ( 1. + e ) * ( 1. + e ) );
+                }
+        } else if( gofu == Hvs ) {
+            for( i = 0; i < n; i++ ) {
+                g[i] = ( u[i] >= 0. ) ? 1. : 0.;
+                gdot[i] = 0.;
+            }
+        } else if( gofu == Kolja ) {
+            for( base = 0; base < n; base += ngenes )
+                for( k = 0; k < ngenes; k++ ) {
+                    g[base + k] = u[base + k];
+                    gdot[base + k] = inp->lparm.R[k];
+                }
+        } else
+            error( "%s: unknown g(u)", caller );
+    }
+}
+
+/**  DvdpOrig: right hand side of the forward sensitivity equations of the
+ *             DvdtOrig model, sdot = J s + df/dp, for all np parameters
+ *             in sp at once; s[p] and sdot[p] are ds/dp and its time
+ *             derivative for parameter sp[p] (both of size n); J is the
+ *             same as in JacobnBand and df/dp is
+ *                R:      g(u)
+ *                T,E,m,h:  R g'(u) times v, v_ext, bcd or 1
+ *                d:      dD/dd times the diffusion term
+ *                lambda: -v
+ *                tau:    0 (no delays in DvdtOrig)
+ *             where the regulation terms are zero in mitosis and for the
+ *             parameters that the mutant fixes (live[p] == 0); dD is
+ *             scratch for 2 * ngenes doubles
+ */
+void
+DvdpOrig( double t, double *v, int n, int np, double **s, double **sdot, SensParm * sp, int *live, double *dD, SolverInput * si,
+          Input * inp ) {
+
+    int m;                      /* number of nuclei */
+    int i, p;                   /* state and parameter index */
+    int k, j;                   /* gene and regulator */
+    int ap, base;               /* nucleus and its first gene */
+    int ngenes = inp->zyg.defs.ngenes;
+    int egenes = inp->zyg.defs.egenes;
+    int allele = si->genindex;
+
+    double *D = inp->wsp.D;     /* diffusion coefficients for this cycle */
+    double *v_ext = inp->wsp.v_ext;     /* external inputs at time t */
+    double *gdot = inp->wsp.bot;        /* R * g'(u) */
+    double *g = inp->wsp.bot2;  /* g(u) */
+    double *bcd;
+    double *sv, *sd;            /* s[p] and sdot[p] */
+    double *unit = dD + ngenes; /* one d set to 1 */
+    double a, reg;
+
+    m = n / ngenes;
+    SetCycle( t, m, allele, inp, "DvdpOrig" );
+    bcd = inp->wsp.bcd.array;
+    RegSlopes( t, v, m, si, g, gdot, inp, "DvdpOrig" );
+
+    for( p = 0; p < np; p++ ) {
+        sv = s[p];
+        sd = sdot[p];
+
+        /* J s: regulation within the nucleus, decay and diffusion */
+        for( ap = 0, base = 0; ap < m; ap++, base += ngenes ) {
+            for( k = 0; k < ngenes; k++ ) {
+                i = base + k;
+                reg = 0.;
+                for( j = 0; j < ngenes; j++ )
+                    reg += inp->lparm.T[( k * ngenes ) + j] * sv[base + j];
+                a = gdot[i] * reg - inp->lparm.lambda[k] * sv[i];
+                if( base > 0 )
+                    a += D[k] * ( sv[i - ngenes] - sv[i] );
+                if( base < n - ngenes )
+                    a += D[k] * ( sv[i + ngenes] - sv[i] );
+                sd[i] = a;
+            }
+        }
+
+        /* df/dp */
+        if( !live[p] )
+            continue;
+        k = sp[p].k;
+        j = sp[p].j;
+        switch ( sp[p].type ) {
+        case ParmR:
+            for( base = 0; base < n; base += ngenes )
+                sd[base + k] += g[base + k];
+            break;
+        case ParmT:
+            for( base = 0; base < n; base += ngenes )
+                sd[base + k] += gdot[base + k] * v[base + j];
+            break;
+        case ParmE:
+            for( ap = 0, base = 0; ap < m; ap++, base += ngenes )
+                sd[base + k] += gdot[base + k] * v_ext[ap * egenes + j];
+            break;
+        case Parmm:
+            for( ap = 0, base = 0; ap < m; ap++, base += ngenes )
+                sd[base + k] += gdot[base + k] * bcd[ap];
+            break;
+        case Parmh:
+            for( base = 0; base < n; base += ngenes )
+                sd[base + k] += gdot[base + k];
+            break;
+        case Parmd:
+            /* D is linear in d, so GetD of a unit vector gives dD/dd */
+            for( i = 0; i < ngenes; i++ )
+                unit[i] = ( i == k ) ? 1. : 0.;
+            GetD( t, unit, dD, &( inp->zyg ) );
+            for( base = 0; base < n; base += ngenes )
+                for( i = 0; i < ngenes; i++ ) {
+                    a = 0.;
+                    if( base > 0 )
+                        a += v[base + i - ngenes] - v[base + i];
+                    if( base < n - ngenes )
+                        a += v[base + i + ngenes] - v[base + i];
+                    sd[base + i] += dD[i] * a;
+                }
+            break;
+        case Parmlambda:
+            for( base = 0; base < n; base += ngenes )
+                sd[base + k] -= v[base + k];
+            break;
+        case Parmtau:
+            break;
+        }
+    }
+}
+
+/**  DvdlOrig: right hand side of the adjoint equations of the DvdtOrig 
+ *             model, ldot = -J^T l, where l is d score / d state (of size 
+ *             n) and J the same as in JacobnBand; the diffusion part of J 
+ *             is symmetric, the regulation within a nucleus is not        
+ */
+void
+DvdlOrig( double t, double *v, double *l, double *ldot, int n, SolverInput * si, Input * inp ) {
+
+    int m;                      /* number of nuclei */
+    int i, k, j;                /* state index, gene and regulator */
+    int base;                   /* index of 1st gene in a nucleus */
+    int ngenes = inp->zyg.defs.ngenes;
+
+    double *D = inp->wsp.D;     /* diffusion coefficients for this cycle */
+    double *gdot = inp->wsp.bot;        /* R * g'(u) */
+    double *g = inp->wsp.bot2;  /* g(u) */
+    double a;
+
+    m = n / ngenes;
+    SetCycle( t, m, si->genindex, inp, "DvdlOrig" );
+    RegSlopes( t, v, m, si, g, gdot, inp, "DvdlOrig" );
+
+    for( base = 0; base < n; base += ngenes ) {
+        for( j = 0; j < ngenes; j++ ) {
+            i = base + j;
+            a = -inp->lparm.lambda[j] * l[i];
+            for( k = 0; k < ngenes; k++ )
+                a += inp->lparm.T[( k * ngenes ) + j] * gdot[base + k] * l[base + k];
+            if( base > 0 )
+                a += D[j] * ( l[i - ngenes] - l[i] );
+            if( base < n - ngenes )
+                a += D[j] * ( l[i + ngenes] - l[i] );
+            ldot[i] = -a;
+        }
+    }
+}
+
+/**  DvdpAdjoint: right hand side of the quadratures of the adjoint 
+ *                gradient, qdot[p] = -l^T df/dp for the np parameters 
+ *                in sp, with df/dp as in DvdpOrig (and zero for the   
+ *                parameters the mutant fixes); integrated backwards   
+ *                in time, q is what the PROPAGATE adds to the gradient;
+ *                dD is scratch for 2 * ngenes doubles                 
+ */
+void
+DvdpAdjoint( double t, double *v, double *l, double *qdot, int n, int np, SensParm * sp, int *live, double *dD,
+             SolverInput * si, Input * inp ) {
+
+    int m;                      /* number of nuclei */
+    int i, p;                   /* state and parameter index */
+    int k, j;                   /* gene and regulator */
+    int ap, base;               /* nucleus and its first gene */
+    int ngenes = inp->zyg.defs.ngenes;
+    int egenes = inp->zyg.defs.egenes;
+
+    double *v_ext = inp->wsp.v_ext;     /* external inputs at time t */
+    double *gdot = inp->wsp.bot;        /* R * g'(u) */
+    double *g = inp->wsp.bot2;  /* g(u) */
+    double *bcd;
+    double *unit = dD + ngenes; /* one d set to 1 */
+    double a, q;
+
+    m = n / ngenes;
+    SetCycle( t, m, si->genindex, inp, "DvdpAdjoint" );
+    bcd = inp->wsp.bcd.array;
+    RegSlopes( t, v, m, si, g, gdot, inp, "DvdpAdjoint" );
+
+    for( p = 0; p < np; p++ ) {
+        q = 0.;
+        k = sp[p].k;
+        j = sp[p].j;
+        if( live[p] ) {
+            switch ( sp[p].type ) {
+            case ParmR:
+                for( base = 0; base < n; base += ngenes )
+                    q += l[base + k] * g[base + k];
+                break;
+            case ParmT:
+                for( base = 0; base < n; base += ngenes )
+                    q += l[base + k] * gdot[base + k] * v[base + j];
+                break;
+            case ParmE:
+                for( ap = 0, base = 0; ap < m; ap++, base += ngenes )
+                    q += l[base + k] * gdot[base + k] * v_ext[ap * egenes + j];
+                break;
+            case Parmm:
+                for( ap = 0, base = 0; ap < m; ap++, base += ngenes )
+                    q += l[base + k] * gdot[base + k] * bcd[ap];
+                break;
+            case Parmh:
+                for( base = 0; base < n; base += ngenes )
+                    q += l[base + k] * gdot[base + k];
+                break;
+            case Parmd:
+                for( i = 0; i < ngenes; i++ )
+                    unit[i] = ( i == k ) ? 1. : 0.;
+                GetD( t, unit, dD, &( inp->zyg ) );
+                for( base = 0; base < n; base += ngenes )
+                    for( i = 0; i < ngenes; i++ ) {
+                        a = 0.;
+                        if( base > 0 )
+                            a += v[base + i - ngenes] - v[base + i];
+                        if( base < n - ngenes )
+                            a += v[base + i + ngenes] - v[base + i];
+                        q += l[base + i] * dD[i] * a;
+                    }
+                break;
+            case Parmlambda:
+                for( base = 0; base < n; base += ngenes )
+                    q -= l[base + k] * v[base + k];
+                break;
+            case Parmtau:
+                break;
+            }
+        }
+        qdot[p] = -q;
+    }
+}
 
 
 /*** GUTS FUNCTIONS ********************************************************/
@@ -982,7 +2085,6 @@ CalcGuts( int gindex, char *gtype, InterpObject * hist_interrp, InterpObject * e
     int i;                      // just for the loops 
     int numguts;                // number of guts columns requested 
     int which;                  // for which gene to calculate guts 
-    int rule;                   // propagation rule 
     unsigned long *gutcomps = NULL;     // bit flags for each word of ID string 
 
     NArrPtr gutsy;              // temporary place for guts, to be returned 
@@ -1032,7 +2134,7 @@ CalcGuts( int gindex, char *gtype, InterpObject * hist_interrp, InterpObject * e
     inp->ext = extinp_interrp;
     si.all_fact_discons = SetFactDiscons( inp->his, inp->ext );
     si.genindex = gindex;
-    inp->lparm = Mutate( gtype, inp->zyg.parm, &( inp->zyg.defs ) );
+    Mutate( gtype, inp->zyg.parm, &( inp->lparm ), &( inp->zyg.defs ) );
 
     // which tells us which gene we calculate guts for
 
@@ -1060,7 +2162,7 @@ CalcGuts( int gindex, char *gtype, InterpObject * hist_interrp, InterpObject * e
 
         // set whether it is MITOSIS or INTERPHASE when calculating guts
 
-        rule = GetRule( gutsy.array[i].time, &( inp->zyg ) );
+        si.rule = GetRule( gutsy.array[i].time, &( inp->zyg ) );
 
         // call the function that calculates the internals of the RHS
 
@@ -1071,7 +2173,6 @@ CalcGuts( int gindex, char *gtype, InterpObject * hist_interrp, InterpObject * e
 
     // clean up
 
-    FreeMutant( inp->lparm );
     /*FreeDelaySolver(); */
     FreeFactDiscons( si.all_fact_discons.fact_discons );
     free( gutcomps );
@@ -1102,10 +2203,8 @@ CalcRhs( double *v, double t, double *guts, int n, int gn, int numguts, int whic
 
     double *deriv;              // array for the derivatives at a specific time
 
-    static int num_nucs = 0;    // store the number of nucs for next step
-    static int bcd_index = 0;   // the *next* array in bicoid struct for bcd
-
-    static DArrPtr bcd;         // pointer to appropriate bicoid struct
+    DArrPtr bcd;                // bicoid gradient for this cycle
+    double *D = inp->wsp.D;     // diffusion coefficients for this cycle
     double *v_ext;              // array to hold the external input concentrations at time t
 
     int allele = si->genindex;
@@ -1117,14 +2216,8 @@ CalcRhs( double *v, double t, double *guts, int n, int gn, int numguts, int whic
 
     m = n / inp->zyg.defs.ngenes;       // m is the current number of nuclei
 
-    if( m != num_nucs ) {
-        GetD( t, inp->lparm.d, D, &( inp->zyg ) );
-        num_nucs = m;
-        bcd = GetBicoid( t, allele, inp->zyg.bcdtype, &( inp->zyg ) );
-        if( bcd.size != num_nucs )
-            error( "CalcRhs: %d nuclei don't match Bicoid!", num_nucs );
-        bcd_index++;
-    }
+    SetCycle( t, m, allele, inp, "CalcRhs" );
+    bcd = inp->wsp.bcd;
     // call the derivative function to get the total derivative
 
     deriv = ( double * ) calloc( n, sizeof( double ) );
@@ -1133,7 +2226,7 @@ CalcRhs( double *v, double t, double *guts, int n, int gn, int numguts, int whic
     // Here we retrieve the external input concentrations into v_ext
 
     v_ext = ( double * ) calloc( m * inp->zyg.defs.egenes, sizeof( double ) );
-    ExternalInputs( t, t, v_ext, m * inp->zyg.defs.egenes, inp->ext[allele], inp->zyg.defs.egenes, &( inp->zyg ) );
+    ExternalInputs( t, t, v_ext, m * inp->zyg.defs.egenes, inp->ext[allele], inp->zyg.defs.egenes, &( inp->zyg ), &( inp->ctx.extcursor ) );
 
     /* all the code below calculates the requested guts (by checking the bits  *
      * set in the gutcomps array); it does so by forward reconstructing all    *
@@ -1404,34 +2497,64 @@ GetGutsComps( char *geneidstring, char *egeneidstring, char **specsin, unsigned
 
 /*** MUTATOR FUNCTIONS *****************************************************/
 
-/** Mutate: calls mutator functions according to genotype string */
-EqParms
-Mutate( char *g_type, EqParms parm, TheProblem * defs ) {
-    int i;
-    int c;
-
-    char *record;
+/** Mutate: copies parm into lparm and mutates it according to geno- 
+ *            type string g_type (see CompileMutant); lparm is only     
+ *            (re)allocated if it is not the size of parm yet           
+ */
+void
+Mutate( char *g_type, EqParms parm, EqParms * lparm, TheProblem * defs ) {
+    int nzero;
+    int *zero;
 
-    EqParms lparm;
+    zero = CompileMutant( g_type, defs, &nzero );
+    ApplyMutant( zero, nzero, parm, lparm, defs );
+    free( zero );
+}
 
-    lparm = CopyParm( parm, defs );     /* make local copy of parameters to be mutated */
+/** CompileMutant: parses genotype string g_type and returns the indices 
+ *                  into EqParms.array (see AllocParm) of the parameters  
+ *                  the mutator functions below set to zero for it; there 
+ *                  are nzero of them                                      
+ */
+int *
+CompileMutant( char *g_type, TheProblem * defs, int *nzero ) {
+    int i, j;
+    int c;
+    int ngenes = defs->ngenes;
+    int *zero;
 
-    record = g_type;
-    c = ( int ) *record;
+    zero = ( int * ) calloc( strlen( g_type ) * ( ngenes + 1 ) + 1, sizeof( int ) );
+    *nzero = 0;
 
-    for( i = 0; c != '\0'; i++, c = ( int ) *( ++record ) ) {
+    for( i = 0; ( c = ( int ) g_type[i] ) != '\0'; i++ ) {
         if( c == 'W' )
             continue;
-        else if( c == 'R' )
-            R_Mutate( i, &lparm );
-        else if( c == 'S' )
-            RT_Mutate( i, defs->ngenes, &lparm );
-        else if( c == 'T' )
-            T_Mutate( i, defs->ngenes, &lparm );
-        else
+        else if( ( c != 'R' ) && ( c != 'S' ) && ( c != 'T' ) )
             error( "Mutate: unrecognized letter in genotype string!" );
+        if( ( c == 'R' ) || ( c == 'S' ) )
+            zero[( *nzero )++] = i;     /* R[i] */
+        if( ( c == 'T' ) || ( c == 'S' ) )
+            for( j = 0; j < ngenes; j++ )
+                zero[( *nzero )++] = ngenes + ( j * ngenes ) + i;       /* T[j][i] */
     }
-    return lparm;
+    return zero;
+}
+
+/** ApplyMutant: copies parm into lparm and sets the nzero parameters of 
+ *                CompileMutant to zero; lparm is only (re)allocated if it 
+ *                is not the size of parm yet                              
+ */
+void
+ApplyMutant( int *zero, int nzero, EqParms parm, EqParms * lparm, TheProblem * defs ) {
+    int i;
+
+    if( lparm->size != parm.size ) {
+        FreeMutant( *lparm );
+        *lparm = AllocParm( defs );
+    }
+    memcpy( lparm->array, parm.array, parm.size * sizeof( double ) );
+    for( i = 0; i < nzero; i++ )
+        lparm->array[zero[i]] = 0;
 }
 
 /** T_Mutate: mutates genes by setting all their T matrix entries 
@@ -1473,44 +2596,62 @@ RT_Mutate( int gene, int ngenes, EqParms * lparm ) {
     /* Don't need to zero param.thresh in (trans acting) mutants */
 }
 
+/** FixedByMutant: returns 1 if the mutator functions above set parameter
+ *                  p to zero for genotype g_type, so that the mutant does
+ *                  not depend on it, and 0 otherwise
+ */
+int
+FixedByMutant( char *g_type, SensParm p ) {
+    int i;
+
+    for( i = 0; g_type[i] != '\0'; i++ ) {
+        if( ( ( g_type[i] == 'R' ) || ( g_type[i] == 'S' ) ) && ( p.type == ParmR ) && ( p.k == i ) )
+            return 1;
+        if( ( ( g_type[i] == 'T' ) || ( g_type[i] == 'S' ) ) && ( p.type == ParmT ) && ( p.j == i ) )
+            return 1;
+    }
+    return 0;
+}
+
+/** AllocParm: returns a parameter struct with all parameters set to 
+ *              zero; they live in one block in the order R, T, E, m, h, 
+ *              d, lambda, tau (d has one entry for diffusion schedules 
+ *              A and C, ngenes otherwise)                               
+ */
+EqParms
+AllocParm( TheProblem * defs ) {
+    int ngenes = defs->ngenes;
+    int nd;                     /* number of diffusion parameters */
+
+    EqParms l_parm;
+
+    if( ( defs->diff_schedule == 'A' ) || ( defs->diff_schedule == 'C' ) )
+        nd = 1;
+    else
+        nd = ngenes;
+
+    l_parm.size = ngenes * ( 5 + ngenes + defs->egenes ) + nd;
+    l_parm.array = ( double * ) calloc( l_parm.size, sizeof( double ) );
+
+    l_parm.R = l_parm.array;
+    l_parm.T = l_parm.R + ngenes;
+    l_parm.E = l_parm.T + ngenes * ngenes;
+    l_parm.m = l_parm.E + ngenes * defs->egenes;
+    l_parm.h = l_parm.m + ngenes;
+    l_parm.d = l_parm.h + ngenes;
+    l_parm.lambda = l_parm.d + nd;
+    l_parm.tau = l_parm.lambda + ngenes;
+
+    return l_parm;
+}
+
 /** CopyParm: copies all the parameters into the lparm struct */
 EqParms
 CopyParm( EqParms orig_parm, TheProblem * defs ) {
-    int i, j;                   /* local loop counters */
-
     EqParms l_parm;             /* copy of parm struct to be returned */
 
-    l_parm.R = ( double * ) calloc( defs->ngenes, sizeof( double ) );
-    l_parm.T = ( double * ) calloc( defs->ngenes * defs->ngenes, sizeof( double ) );
-    l_parm.E = ( double * ) calloc( defs->ngenes * defs->egenes, sizeof( double ) );
-    l_parm.m = ( double * ) calloc( defs->ngenes, sizeof( double ) );
-    l_parm.h = ( double * ) calloc( defs->ngenes, sizeof( double ) );
-    if( ( defs->diff_schedule == 'A' ) || ( defs->diff_schedule == 'C' ) ) {
-        l_parm.d = ( double * ) malloc( sizeof( double ) );
-    } else {
-        l_parm.d = ( double * ) calloc( defs->ngenes, sizeof( double ) );
-    }
-    l_parm.lambda = ( double * ) calloc( defs->ngenes, sizeof( double ) );
-    l_parm.tau = ( double * ) calloc( defs->ngenes, sizeof( double ) );
-
-    for( i = 0; i < defs->ngenes; i++ ) {
-        l_parm.R[i] = orig_parm.R[i];
-        for( j = 0; j < defs->ngenes; j++ )
-            l_parm.T[( i * defs->ngenes ) + j] = orig_parm.T[( i * defs->ngenes ) + j];
-        for( j = 0; j < defs->egenes; j++ )
-            l_parm.E[( i * defs->egenes ) + j] = orig_parm.E[( i * defs->egenes ) + j];
-        l_parm.m[i] = orig_parm.m[i];
-        l_parm.h[i] = orig_parm.h[i];
-        l_parm.lambda[i] = orig_parm.lambda[i];
-        l_parm.tau[i] = orig_parm.tau[i];
-    }
-
-    if( ( defs->diff_schedule == 'A' ) || ( defs->diff_schedule == 'C' ) ) {
-        l_parm.d[0] = orig_parm.d[0];
-    } else {
-        for( i = 0; i < defs->ngenes; i++ )
-            l_parm.d[i] = orig_parm.d[i];
-    }
+    l_parm = AllocParm( defs );
+    memcpy( l_parm.array, orig_parm.array, l_parm.size * sizeof( double ) );
 
     return l_parm;
 }
@@ -1549,38 +2690,25 @@ DvdtDelay( double *v, double **vd, double t, double *vdot, int n, SolverInput *
     int i, j;                   /* local loop counters */
     int k;                      /* index of gene k in a specific nucleus */
     int base, base1;            /* index of first gene in a specific nucleus */
-    int *l_rule;                /* for autonomous implementation */
+    int *l_rule = inp->wsp.l_rule;      /* for autonomous implementation */
 #ifdef ALPHA_DU
     int incx = 1;               /* increment step size for vsqrt input array */
     int incy = 1;               /* increment step size for vsqrt output array */
 #endif
 
-    static int num_nucs = 0;    /* store the number of nucs for next step */
-    static int bcd_index = 0;   /* the *next* array in bicoid struct for bcd */
-    static DArrPtr bcd;         /* pointer to appropriate bicoid struct */
-    double **v_ext;             /* array to hold the external input
-                                   concentrations at time t */
+    DArrPtr bcd;                /* bicoid gradient for this cycle */
+    double *D = inp->wsp.D;     /* diffusion coefficients for this cycle */
+    double **v_ext = inp->wsp.v_extd;   /* array to hold the external input
+                                           concentrations at time t */
+    double *vinput = inp->wsp.vinput;   /* vinput, bot2 and bot are used for */
+    double *bot2 = inp->wsp.bot2;       /* storing intermediate stuff for vector */
+    double *bot = inp->wsp.bot; /* functions (see Workspace in maternal.h) */
     int allele = si->genindex;
 
-    vinput = ( double * ) calloc( inp->zyg.defs.ngenes * inp->zyg.defs.nnucs, sizeof( double ) );
-    bot2 = ( double * ) calloc( inp->zyg.defs.ngenes * inp->zyg.defs.nnucs, sizeof( double ) );
-    bot = ( double * ) calloc( inp->zyg.defs.ngenes * inp->zyg.defs.nnucs, sizeof( double ) );
-
     /* get D parameters and bicoid gradient according to cleavage cycle */
     m = n / inp->zyg.defs.ngenes;       /* m is the number of nuclei */
-    if( m != num_nucs ) {       /* time-varying quantities only vary by ccycle */
-        GetD( t, inp->lparm.d, D, &( inp->zyg ) );
-        /* get diff coefficients, according to diff schedule */
-        if( num_nucs > m )      /* started a new iteration in score */
-            bcd_index = 0;      /* -> start all over again! */
-        num_nucs = m;           /* store # of nucs for next step */
-        bcd = GetBicoid( t, allele, inp->zyg.bcdtype, &( inp->zyg ) );  /* get bicoid gradient */
-        if( bcd.size != num_nucs )
-            error( "DvdtDelay: %d nuclei don't match Bicoid!", num_nucs );
-        bcd_index++;            /* store index for next bicoid gradient */
-    }
-
-    l_rule = ( int * ) calloc( inp->zyg.defs.ngenes, sizeof( int ) );
+    SetCycle( t, m, allele, inp, "DvdtDelay" );
+    bcd = inp->wsp.bcd;
 
     for( i = 0; i < inp->zyg.defs.ngenes; i++ ) {
         l_rule[i] = !Theta( t - inp->lparm.tau[i], &( inp->zyg ) );     /*for autonomous equations */
@@ -1600,11 +2728,9 @@ DvdtDelay( double *v, double **vd, double t, double *vdot, int n, SolverInput *
 
     /* Here we retrieve the external input concentrations into v_ext */
 
-    v_ext = ( double ** ) calloc( inp->zyg.defs.ngenes, sizeof( double * ) );
     for( i = 0; i < inp->zyg.defs.ngenes; i++ ) {
 
-        v_ext[i] = ( double * ) calloc( m * inp->zyg.defs.egenes, sizeof( double ) );
-        ExternalInputs( t - inp->lparm.tau[i], t, v_ext[i], m * inp->zyg.defs.egenes, inp->ext[allele], inp->zyg.defs.egenes, &( inp->zyg ) );
+        ExternalInputs( t - inp->lparm.tau[i], t, v_ext[i], m * inp->zyg.defs.egenes, inp->ext[allele], inp->zyg.defs.egenes, &( inp->zyg ), &( inp->ctx.extcursor ) );
 
     }
     /* This is how it works (by JR): 
@@ -1616,7 +2742,7 @@ DvdtDelay( double *v, double **vd, double t, double *vdot, int n, SolverInput *
        Protein synthesis terms are calculated according to g(u)
 
        First we do loop for vinput contributions; vinput contains
-       the u that goes into g(u)
+       the u that goes into g(u) (done by the RegInput kernel)
 
        Then we do a separate loop or vector func for sqrt or exp
 
@@ -1662,8 +2788,7 @@ DvdtDelay( double *v, double **vd, double t, double *vdot, int n, SolverInput *
 #ifdef ALPHA_DU
         vsqrt_( bot2, &incx, bot, &incy, &n );  /* superfast DEC vector function */
 #else
-        for( i = 0; i < n; i++ )        /* slow traditional style sqrt */
-            bot[i] = sqrt( bot2[i] );
+        VecSqrt( bot2, bot, n );        /* SIMD vector function (vecLib.c) */
 #endif
         /* next loop does the rest of the equation (R, Ds and lambdas) */
         /* store result in vdot[] */
@@ -1743,6 +2868,9 @@ DvdtDelay( double *v, double **vd, double t, double *vdot, int n, SolverInput *
             }
         }
 
+        /* calculate tanh(u); store it in bot[] */
+        VecTanh( vinput, bot, n );      /* SIMD vector function (vecLib.c) */
+
         /* next loop does the rest of the equation (R, Ds and lambdas) */
         /* store result in vdot[] */
 
@@ -1755,7 +2883,7 @@ DvdtDelay( double *v, double **vd, double t, double *vdot, int n, SolverInput *
 
                     k = i - base;
                     vdot1 = -inp->lparm.lambda[k] * v[i];
-                    g1 = tanh( vinput[i] ) + 1;
+                    g1 = bot[i] + 1;
                     vdot1 += l_rule[k] * inp->lparm.R[k] * 0.5 * g1;
                     vdot[i] = vdot1;
                 }
@@ -1768,7 +2896,7 @@ DvdtDelay( double *v, double **vd, double t, double *vdot, int n, SolverInput *
             for( i = 0; i < inp->zyg.defs.ngenes; i++ ) {       /* first anterior-most nucleus */
                 k = i;
                 vdot1 = -inp->lparm.lambda[k] * v[i];
-                g1 = tanh( vinput[i] ) + 1;
+                g1 = bot[i] + 1;
                 vdot1 += l_rule[k] * inp->lparm.R[k] * 0.5 * g1;
                 vdot1 += D[i] * ( v[i + inp->zyg.defs.ngenes] - v[i] );
                 vdot[i] = vdot1;
@@ -1778,7 +2906,7 @@ DvdtDelay( double *v, double **vd, double t, double *vdot, int n, SolverInput *
                 for( i = base; i < base + inp->zyg.defs.ngenes; i++ ) {
                     k = i - base;
                     vdot1 = -inp->lparm.lambda[k] * v[i];
-                    g1 = tanh( vinput[i] ) + 1;
+                    g1 = bot[i] + 1;
                     vdot1 += l_rule[k] * inp->lparm.R[k] * 0.5 * g1;
                     vdot1 += D[k] * ( ( v[i - inp->zyg.defs.ngenes] - v[i] ) + ( v[i + inp->zyg.defs.ngenes] - v[i] ) );
                     vdot[i] = vdot1;
@@ -1788,7 +2916,7 @@ DvdtDelay( double *v, double **vd, double t, double *vdot, int n, SolverInput *
             for( i = base; i < base + inp->zyg.defs.ngenes; i++ ) {
                 k = i - base;
                 vdot1 = -inp->lparm.lambda[k] * v[i];
-                g1 = tanh( vinput[i] ) + 1;
+                g1 = bot[i] + 1;
                 vdot1 += l_rule[k] * inp->lparm.R[k] * 0.5 * g1;
                 vdot1 += D[k] * ( v[i - inp->zyg.defs.ngenes] - v[i] );
                 vdot[i] = vdot1;
@@ -1825,8 +2953,7 @@ DvdtDelay( double *v, double **vd, double t, double *vdot, int n, SolverInput *
 #ifdef ALPHA_DU
         vexp_( vinput, &incx, bot, &incy, &n ); /* superfast DEC vector function */
 #else
-        for( i = 0; i < n; i++ )        /* slow traditional style exp */
-            bot[i] = exp( vinput[i] );
+        VecExp( vinput, bot, n );       /* SIMD vector function (vecLib.c) */
 #endif
 
         /* next loop does the rest of the equation (R, Ds and lambdas) */
@@ -2074,24 +3201,40 @@ DvdtDelay( double *v, double **vd, double t, double *vdot, int n, SolverInput *
         printf( "vdot0=%lg, vdot1=%lg, vdot2=%lg, vdot3=%lg\n", vdot[0], vdot[1], vdot[2], vdot[3] );
     }
 
-    free( l_rule );
-
-    for( i = 0; i < inp->zyg.defs.ngenes; i++ )
-        free( v_ext[i] );
-
-    free( v_ext );
-    free( vinput );
-    free( bot2 );
-    free( bot );
     return;
 }
 
 /////////////////////////////////////////////////////////////////////////////
 
+/* subfunctions of Dvdt_sqrt for the nuclei in [first, last) of m, below */
+static void ProductionBlock( int first, int last, NucJob * job );
+static void DiffusionBlock( double *v, double *vdot, int first, int last, int m, double *D, int GG );
+
+/** SqrtBlock: Dvdt_sqrt for the nuclei in [first, last) (see NUCLEUS 
+ *              BLOCKS); same steps and sums as Dvdt_sqrt below        
+ */
+static void
+SqrtBlock( int first, int last, void *arg ) {
+    NucJob *job = ( NucJob * ) arg;
+    const int GG = job->inp->zyg.defs.ngenes;
+    const int lo = first * GG;
+    int i;
+
+    if( job->lrule )
+        ProductionBlock( first, last, job );
+    else
+        for( i = lo; i < last * GG; ++i )
+            job->vdot[i] = 0.0;
+    Dvdt_degradation( job->v + lo, 0., job->vdot + lo, ( last - first ) * GG, job->inp );
+    if( job->m > 1 )
+        DiffusionBlock( job->v, job->vdot, first, last, job->m, job->inp->wsp.D, GG );
+}
+
 /** Dvdt_sqrt: reimplementation of part of DvdtOrig that should make the 
  *              maintenance easier and gave a small speed up (~12%). The   
  *              function is now subdivided into 3 subfunctions that allow  
- *              easy reuse with the krylov preconditioner.                 
+ *              easy reuse with the krylov preconditioner; big embryos are 
+ *              done in blocks of nuclei (see NUCLEUS BLOCKS)              
  */
 void
 Dvdt_sqrt( double *v, double t, double *vdot, int n, SolverInput * si, Input * inp ) {
@@ -2105,38 +3248,34 @@ Dvdt_sqrt( double *v, double t, double *vdot, int n, SolverInput * si, Input * i
 
     int allele = si->genindex;
 
-    // array to hold the external input concentrations at time t
-    double *v_ext;
-    // store the number of nucs for next step
-    static int num_nucs = 0;
-    // the next array in bicoid struct for Bcd
-    static int bcd_index = 0;
-    // pointer to appropriate bicoid struct
-    static DArrPtr bcd;
-
-    if( num_nucs != MM ) {
-        // get D parameters according to cleavage cycle
-        // NOTE: time-varying quantities only vary by ccycle
-        GetD( t, inp->lparm.d, D, &( inp->zyg ) );
-        if( num_nucs > MM )     /* started a new iteration in score */
-            bcd_index = 0;      /* -> start all over again! */
-        num_nucs = MM;          /* store # of nucs for next step */
-        bcd = GetBicoid( t, allele, inp->zyg.bcdtype, &( inp->zyg ) );  /* get bicoid gradient */
-        if( bcd.size != num_nucs )
-            error( "DvdtDelay: %d nuclei don't match Bicoid!", num_nucs );
-        bcd_index++;            /* store index for next bicoid gradient */
-    }
+    // diffusion coefficients for this cycle
+    double *D = inp->wsp.D;
+
+    // NOTE: time-varying quantities only vary by ccycle
+    SetCycle( t, MM, allele, inp, "Dvdt_sqrt" );
 
-    // here we retrieve the external input concentrations into v_ext
-    v_ext = ( double * ) calloc( MM * inp->zyg.defs.egenes, sizeof( double ) );
-    ExternalInputs( t, t, v_ext, MM * inp->zyg.defs.egenes, inp->ext[allele], inp->zyg.defs.egenes, &( inp->zyg ) );
+    rule = si->rule;
 
-    //printf("TIME = %lg\n", si->time);
-    rule = GetRule( si->time, &( inp->zyg ) );
+    // big embryos: the same three steps, in blocks of nuclei
+    if( NucBlocks( MM ) > 1 ) {
+        NucJob job;
+
+        job.v = v;
+        job.vdot = vdot;
+        job.m = MM;
+        job.lrule = ( rule == INTERPHASE );
+        if( job.lrule ) {
+            job.base = RegBaseSlot( t, MM, allele, inp, &( job.t_diff ) );
+            job.slope = job.base + n;
+        }
+        job.inp = inp;
+        ForNucBlocks( &( inp->wsp ), MM, SqrtBlock, &job );
+        return;
+    }
 
     // in interphase there is gene product synthesis (rna or protein)
     if( rule == INTERPHASE ) {
-        Dvdt_production( v, t, vdot, n, v_ext, bcd, MM, inp );
+        Dvdt_production( v, t, vdot, n, allele, MM, inp );
     } else {
         // set vdot to zero: no production
         for( i = 0; i < n; ++i )
@@ -2144,7 +3283,6 @@ Dvdt_sqrt( double *v, double t, double *vdot, int n, SolverInput * si, Input * i
     }
     Dvdt_degradation( v, t, vdot, n, inp );
     Dvdt_diffusion( v, t, vdot, n, MM, D, inp );
-    free( v_ext );
 }
 
 /*
@@ -2160,7 +3298,7 @@ void Dvdt_sqrt_precond(double *v, double t, double *vdot, int n, int allele, Inp
     rule = GetRule(t, &(inp->zyg));
     // Here we retrieve the external input concentrations into v_ext
     v_ext = (double *) calloc(MM * inp->zyg.defs.egenes, sizeof (double));
-    ExternalInputs(t, t, v_ext, MM * inp->zyg.defs.egenes, inp->ext[allele], inp->zyg.defs.egenes, &(inp->zyg));
+    ExternalInputs(t, t, v_ext, MM * inp->zyg.defs.egenes, inp->ext[allele], inp->zyg.defs.egenes, &(inp->zyg), &(inp->ctx.extcursor));
 
     if (rule == INTERPHASE) {
         Dvdt_production(v, t, vdot, n, v_ext, MM, inp);
@@ -2174,44 +3312,46 @@ void Dvdt_sqrt_precond(double *v, double t, double *vdot, int n, int allele, Inp
 }
 */
 
-/** subfunction for (regulated) production */
-void
-Dvdt_production( double *v, double t, double *vdot, int n, double *v_ext, DArrPtr bcd, int MM, Input * inp ) {
-    // nuclear index on AP axis [0,1,...,m-1]
-    int ap;
+/** ProductionBlock: regulated production for the nuclei in [first, last) */
+static void
+ProductionBlock( int first, int last, NucJob * job ) {
+    Input *inp = job->inp;
+    const int lo = first * inp->zyg.defs.ngenes;
+    const int hi = last * inp->zyg.defs.ngenes;
     // local loop counters
-    int i, j, aux1, aux2;
-    // index of first gene in a specific nucleus
-    int base, base_e;
-    // auxilary var
-    double aux;
+    int i, k;
+    // regulatory input u for all nuclei, 1 + u^2 and sqrt(1 + u^2)
+    double *u = inp->wsp.vinput;
+    double *bot2 = inp->wsp.bot2;
+    double *bot = inp->wsp.bot;
+
+    RegInputBlock( first, last, job, u );
+    for( i = lo; i < hi; ++i )
+        bot2[i] = 1 + u[i] * u[i];
+    VecSqrt( bot2 + lo, bot + lo, hi - lo );
     // forall nuclei do production/regulation
-    for( ap = 0; ap < MM; ++ap ) {
-        // external genes
-        base_e = ap * inp->zyg.defs.egenes;
-        // gap genes
-        base = ap * inp->zyg.defs.ngenes;
-        // per nucleus
-        for( i = 0; i < inp->zyg.defs.ngenes; ++i ) {
-
-            aux = inp->lparm.h[i];
-            aux += inp->lparm.m[i] * bcd.array[ap];
-            aux1 = ( i * inp->zyg.defs.egenes );
-            aux2 = ( i * inp->zyg.defs.ngenes );
-            for( j = 0; j < inp->zyg.defs.egenes; ++j ) {
-                aux += inp->lparm.E[aux1 + j] * v_ext[base_e + j];
-            }
-            for( j = 0; j < inp->zyg.defs.ngenes; ++j ) {
-                aux += inp->lparm.T[aux2 + j] * v[base + j];
-                //if ((ap == 0) && (i == 0))
-                //      printf("T%d=%f v=%f\n", j, inp->lparm.T[ aux2 + j ], v[ base + j ]);
-            }
-            //printf("aux=%lg interm=%lg rez=%lg\n", aux, (sqrt(1 + aux * aux)), (aux / sqrt(1 + aux * aux)));
-            vdot[base + i] = inp->lparm.R[i] * 0.5 * ( 1 + aux / sqrt( 1 + aux * aux ) );
-        }
+    for( i = lo, k = 0; i < hi; ++i, ++k ) {
+        // cycle through gap genes
+        if( k == inp->zyg.defs.ngenes )
+            k = 0;
+        job->vdot[i] = inp->lparm.R[k] * 0.5 * ( 1 + u[i] / bot[i] );
     }
 }
 
+/** subfunction for (regulated) production; SetCycle must have been called */
+void
+Dvdt_production( double *v, double t, double *vdot, int n, int allele, int MM, Input * inp ) {
+    NucJob job;
+
+    job.v = v;
+    job.vdot = vdot;
+    job.m = MM;
+    job.base = RegBaseSlot( t, MM, allele, inp, &( job.t_diff ) );
+    job.slope = job.base + n;
+    job.inp = inp;
+    ProductionBlock( 0, MM, &job );
+}
+
 /** subfunction for the degradation */
 void
 Dvdt_degradation( double *v, double t, double *vdot, int n, Input * inp ) {
@@ -2230,35 +3370,41 @@ Dvdt_degradation( double *v, double t, double *vdot, int n, Input * inp ) {
     }
 }
 
-/** subfunction doing the diffusion */
-void
-Dvdt_diffusion( double *v, double t, double *vdot, int n, int MM, double *D, Input * inp ) {
-    const int GG = inp->zyg.defs.ngenes;
+/** DiffusionBlock: diffusion for the nuclei in [first, last) of m > 1; 
+ *                   reads v of the neighbours first - 1 and last      
+ */
+static void
+DiffusionBlock( double *v, double *vdot, int first, int last, int m, double *D, int GG ) {
     // counters and auxilary vars
-    int i, ap, base, aux1;
-    // and forall nuclei diffusion (one nucleus special case)
-    if( n != GG ) {
+    int i, base, aux1;
+    int a = ( first > 1 ) ? first : 1;  // inner nuclei [a, b)
+    int b = ( last < m - 1 ) ? last : m - 1;
 
-        // anterior most nucleus
+    // anterior most nucleus
+    if( first == 0 )
         for( i = 0; i < GG; ++i ) {
             vdot[i] += D[i] * ( v[i + GG] - v[i] );
         }
 
-        // then middle nuclei
-        for( ap = 1; ap < MM - 1; ++ap ) {
-            // gap genes
-            base = ap * GG;
-            for( i = 0; i < GG; ++i ) {
-                vdot[base + i] += D[i] * ( v[base + i - GG] + v[base + i + GG] - 2 * v[base + i] );
-            }
-        }
+    // then middle nuclei (same sums as the scalar loop, see vecLib.h)
+    if( b > a )
+        VecStencil3( v + ( a - 1 ) * GG, vdot + ( a - 1 ) * GG, D, GG, b - a + 2 );
 
-        // last: posterior-most nucleus
-        base = ( MM - 1 ) * GG;
+    // last: posterior-most nucleus
+    if( last == m ) {
+        base = ( m - 1 ) * GG;
         for( i = 0; i < GG; ++i ) {
             aux1 = base + i;
             vdot[aux1] += D[i] * ( v[aux1 - GG] - v[aux1] );
         }
+    }
+}
 
-    }                           // else we skip diffusion
+/** subfunction doing the diffusion */
+void
+Dvdt_diffusion( double *v, double t, double *vdot, int n, int MM, double *D, Input * inp ) {
+    // and forall nuclei diffusion (one nucleus special case)
+    if( n != inp->zyg.defs.ngenes )
+        DiffusionBlock( v, vdot, 0, MM, MM, D, inp->zyg.defs.ngenes );
+    // else we skip diffusion
 }
@@ -35,6 +35,9 @@
 extern const int INTERPHASE;
 extern const int MITOSIS;
 
+/* default for the smallest block of nuclei per thread (see rhsblock) */
+extern const int RHS_BLOCK;
+
 /*** ENUM ******************************************************************/
 
 /** This is the g(u)-function enum which describes the different types of   
@@ -48,12 +51,36 @@ typedef enum GFunc {
     Kolja,
 } GFunc;
 
+/** The order in which the solvers see the state: NucMajor is the order of 
+ * the data files (v[ap*ngenes + k]); GeneMajor keeps each gene's profile  
+ * contiguous (v[k*nnucs + ap]), which lets the diffusion and decay loops  
+ * run with unit stride; Blastoderm converts at each PROPAGATE step, which 
+ * costs two O(n) copies per solver call, a few percent of its derivative  
+ * evaluations; at -O2, DvdtGeneMajor only beats DvdtOrig for few nuclei   
+ * (16); for 58 or more it is up to 25% slower per call                   
+ */
+typedef enum StateLayout {
+    NucMajor,
+    GeneMajor,
+} StateLayout;
+
 /*** A GLOBAL **************************************************************/
 
 /* The g(u) function we're using - by default gofu takes the 0th element of 
    the enum, in our case Sqrt */
 GFunc gofu;   
 
+/* The state layout used by the solvers - NucMajor by default */
+StateLayout slayout;
+
+/* Threads that share each evaluation of DvdtOrig, Dvdt_sqrt and JacobnBand 
+   by blocks of nuclei (set by -k); 0 or 1 is serial */
+int rhsthreads;
+
+/* Smallest block of nuclei worth a thread of its own (set by -K); 0 means 
+   the default, RHS_BLOCK */
+int rhsblock;
+
 /* Derivative and Jacobian */
 void ( *pd ) ( double *, double, double *, int, SolverInput *, Input * );
 void ( *pj ) ( double, double *, double *, double **, int, SolverInput *, Input * );
@@ -71,14 +98,67 @@ void ( *dd ) ( double *, double **, double, double *, int, SolverInput *, Input
  */
 Zygote InitZygote( FILE * fp, void ( *pd ) (  ), void ( *pj ) (  ), Input * inp, char *section_title );
 
+/** InitWorkspace: allocates the scratch arrays used by the derivative and
+ *                  Jacobian functions, sized for the maximum number of
+ *                  nuclei; called by InitZygote
+ */
+Workspace InitWorkspace( TheProblem * defs );
+
+/** WorkspaceBytes: returns the (peak) number of bytes held by the deriva-
+ *                   tive workspace
+ */
+size_t WorkspaceBytes( Workspace * wsp );
+
+/** InitEnsemble: allocates the interleaved scratch arrays of an ensemble 
+ *                 of up to capacity members; the members themselves (each 
+ *                 an Input with its own parameters, Workspace and Model-  
+ *                 Context) are up to the caller                           
+ */
+Ensemble InitEnsemble( int capacity, TheProblem * defs );
+
 /* Cleanup functions */
 
-/** FreeZygote: frees memory for D */
+/** FreeZygote: nothing left to free here; D now lives in the Workspace */
 void FreeZygote( void );
 
+/** FreeWorkspace: frees the scratch arrays of the derivative functions */
+void FreeWorkspace( Workspace * wsp );
+
+/** FreeEnsemble: frees the scratch arrays of an ensemble (not its members) */
+void FreeEnsemble( Ensemble * ens );
+
 /** FreeMutant: frees mutated parameter struct */
 void FreeMutant( EqParms lparm );
 
+/** ResetRegBase: marks all baselines of RegBase as out of date; call it 
+ *                 whenever the parameters or the genotype change         
+ */
+void ResetRegBase( Workspace * wsp );
+
+
+/* Regulatory input kernels */
+
+/* These add T . v to u (which RegBase has set to h + m * bcd + E . v_ext) *
+ * for all genes in m nuclei; the specialized ones have their dot products *
+ * written out for a fixed ngenes and give the same bits as the generic    *
+ * one                                                                     */
+
+/** RegInputGeneric: adds T . v to u for any ngenes */
+void RegInputGeneric( double *v, int m, EqParms * lparm, TheProblem * defs, double *u );
+
+/** RegInput4: adds T . v to u for 4 genes */
+void RegInput4( double *v, int m, EqParms * lparm, TheProblem * defs, double *u );
+
+/** RegInput6: adds T . v to u for 6 genes */
+void RegInput6( double *v, int m, EqParms * lparm, TheProblem * defs, double *u );
+
+/** RegInput8: adds T . v to u for 8 genes */
+void RegInput8( double *v, int m, EqParms * lparm, TheProblem * defs, double *u );
+
+/** InitRegInput: picks the regulatory input kernel for the circuit size;
+ *                 falls back to RegInputGeneric; called by InitZygote
+ */
+void InitRegInput( TheProblem * defs );
 
 /* Derivative Function(s) */
 
@@ -97,6 +177,18 @@ void DvdtOrig( double *v, double t, double *vdot, int n, SolverInput * si, Input
  */
 void DvdtDelay( double *v, double **vd, double t, double *vdot, int n, SolverInput * si, Input * inp );
 
+/** DvdtGeneMajor: same as DvdtOrig, but for a state (and derivative) in 
+ *                  GeneMajor layout; Blastoderm installs it as p_deriv    
+ *                  while propagating if slayout is GeneMajor              
+ */
+void DvdtGeneMajor( double *v, double t, double *vdot, int n, SolverInput * si, Input * inp );
+
+/** DvdtEnsemble: DvdtOrig for all members of an ensemble at once, with 
+ *                 their states interleaved (see Ensemble in maternal.h);  
+ *                 n is the size of the state of one member               
+ */
+void DvdtEnsemble( double *v, double t, double *vdot, int n, SolverInput * si, Ensemble * ens );
+
 
 /** Dvdt_sqrt: reimplementation of part of DvdtOrig that should make the 
  *              maintenance easier and gave a small speed up (~12%). The   
@@ -108,8 +200,8 @@ void Dvdt_sqrt( double *v, double t, double *vdot, int n, SolverInput * si, Inpu
 /* the preconditioner version lacks diffusion */
 /*void Dvdt_sqrt_precond( double *v, double t, double *vdot, int n, int allele, Input * inp );*/
 
-/** subfunction for (regulated) production */
-void Dvdt_production( double *v, double t, double *vdot, int n, double *v_ext, DArrPtr bcd, int m, Input * inp );
+/** subfunction for (regulated) production; SetCycle must have been called */
+void Dvdt_production( double *v, double t, double *vdot, int n, int allele, int m, Input * inp );
 
 /** subfunction for the degradation */
 void Dvdt_degradation( double *v, double t, double *vdot, int n, Input * inp );
@@ -157,6 +249,37 @@ void Dvdt_diffusion( double *v, double t, double *vdot, int n, int m, double *D,
  */
 void JacobnOrig( double t, double *v, double *dfdt, double **jac, int n, SolverInput * si, Input * inp );
 
+/**  JacobnBand: banded Jacobian for the DvdtOrig model, for the CVODE Band 
+ *               solver; element (i,j) goes to col[j][i - j + offset], so   
+ *               col and offset are the cols and s_mu of a SUNDIALS band    
+ *               matrix; only the nonzero pattern is written to, and       
+ *               nothing gets allocated                                     
+ */
+void JacobnBand( double t, double *v, int n, double **col, int offset, SolverInput * si, Input * inp );
+
+/**  DvdpOrig: right hand side of the forward sensitivity equations of the
+ *             DvdtOrig model, sdot = J s + df/dp, for all np parameters
+ *             in sp at once (see Sensitivity in maternal.h); parameters
+ *             with live[p] == 0 get no df/dp; dD is scratch for 2 * ngenes
+ *             doubles
+ */
+void DvdpOrig( double t, double *v, int n, int np, double **s, double **sdot, SensParm * sp, int *live, double *dD, SolverInput * si,
+               Input * inp );
+
+/**  DvdlOrig: right hand side of the adjoint equations of the DvdtOrig 
+ *             model, ldot = -J^T l, for l = d score / d state (see Adjoint 
+ *             in maternal.h)                                              
+ */
+void DvdlOrig( double t, double *v, double *l, double *ldot, int n, SolverInput * si, Input * inp );
+
+/**  DvdpAdjoint: right hand side of the quadratures of the adjoint 
+ *                gradient, qdot[p] = -l^T df/dp for the np parameters 
+ *                in sp, with df/dp as in DvdpOrig; dD is scratch for 2 
+ *                * ngenes doubles                                      
+ */
+void DvdpAdjoint( double t, double *v, double *l, double *qdot, int n, int np, SensParm * sp, int *live, double *dD,
+                  SolverInput * si, Input * inp );
+
 
 /*** GUTS FUNCTIONS ********************************************************/
 
@@ -198,8 +321,24 @@ char *GetGutsComps( char *geneidstring, char *egeneidstring, char **specsin, uns
 
 /* Mutator functions */
 
-/** Mutate: calls mutator functions according to genotype string */
-EqParms Mutate( char *g_type, EqParms parm, TheProblem * defs );
+/** Mutate: copies parm into lparm and mutates it according to geno- 
+ *            type string g_type (see CompileMutant); lparm is only     
+ *            (re)allocated if it is not the size of parm yet           
+ */
+void Mutate( char *g_type, EqParms parm, EqParms * lparm, TheProblem * defs );
+
+/** CompileMutant: parses genotype string g_type and returns the indices 
+ *                  into EqParms.array (see AllocParm) of the parameters  
+ *                  the mutator functions below set to zero for it; there 
+ *                  are nzero of them                                      
+ */
+int *CompileMutant( char *g_type, TheProblem * defs, int *nzero );
+
+/** ApplyMutant: copies parm into lparm and sets the nzero parameters of 
+ *                CompileMutant to zero; lparm is only (re)allocated if it 
+ *                is not the size of parm yet                              
+ */
+void ApplyMutant( int *zero, int nzero, EqParms parm, EqParms * lparm, TheProblem * defs );
 
 /** T_Mutate: mutates genes by setting all their T matrix entries 
  *             to zero. Used to simulate mutants that express a   
@@ -222,6 +361,18 @@ void R_Mutate( int gene, EqParms * lparm );
  */
 void RT_Mutate( int gene, int ngenes, EqParms * lparm );
 
+/** FixedByMutant: returns 1 if the mutator functions set parameter p to 
+ *                  zero for genotype g_type, and 0 otherwise              
+ */
+int FixedByMutant( char *g_type, SensParm p );
+
+/** AllocParm: returns a parameter struct with all parameters set to 
+ *              zero; they live in one block in the order R, T, E, m, h, 
+ *              d, lambda, tau (d has one entry for diffusion schedules 
+ *              A and C, ngenes otherwise)                               
+ */
+EqParms AllocParm( TheProblem * defs );
+
 /** CopyParm: copies all the parameters into the lparm struct */
 EqParms CopyParm( EqParms orig_parm, TheProblem * defs );
 
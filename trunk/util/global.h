@@ -65,9 +65,15 @@ typedef struct ScoreOutput {
     double score;
     double penalty;
     double *residuals;
-    double *jacobian;
+    double *jacobian;           /* d residuals / d parameters: one column */
+                                /* of size_resid_arr for each parameter */
+    double *gradient;           /* d (score + penalty) / d parameters */
 } ScoreOutput;
 
+/* what Score() and MoveX() calculate besides the score and residuals */
+#define JACOBIAN 1              /* the jacobian, by forward sensitivities */
+#define GRADIENT 2              /* the gradient, by adjoints */
+
 typedef struct Files {
     char *inputfile;            /* name of the input file */
     char *outputfile;           /* name of the output file */
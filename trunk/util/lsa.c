@@ -453,6 +453,7 @@ Initialize( int argc, char **argv ) {
     out.penalty = 0;
     out.size_resid_arr = 0;
     out.jacobian = NULL;
+    out.gradient = NULL;
     out.residuals = NULL;
 
     /* allocate memory for static file names */
@@ -664,7 +665,7 @@ InitialLoop( void ) {
     /* randomize initial state; throw out results; DO NOT PARALLELIZE! */
     for( i = 0; i < state->tune.initial_moves; i++ ) {
         /* make a move: will either return the energy change or FORBIDDEN_MOVE */
-        energy_change = GenerateMove( &files, &distp, &out );
+        energy_change = GenerateMove( &files, &distp, &out, 0. );
         if( ( i % 20000 == 0 ) && ( i > 0 ) ) {
             printf( "#%d Initial Loop Move = %d\n", proc_id, i );
         }
@@ -703,7 +704,7 @@ InitialLoop( void ) {
     /* loop to collect initial statistics; this one is parallelized */
     for( i = 0; i < proc_init; i++ ) {
         /* make a move: will either return the energy change or FORBIDDEN_MOVE */
-        energy_change = GenerateMove( &files, &distp, &out );
+        energy_change = GenerateMove( &files, &distp, &out, 0. );
         /* Metropolis stuff here; we usually want FORBIDDEN_MOVE to be very large  *
          * that's why we want to prevent overflows here (hence the 'if')           */
         if( energy_change != FORBIDDEN_MOVE )
@@ -1060,6 +1061,8 @@ Loop( void ) {
     int i;                      /* local loop counter */
     double energy_change;       /* local Delta E */
     double d;                   /* difference between energy and estimated mean */
+    double metropolis = 1.;     /* random number for the Metropolis criterion */
+    double bound;               /* highest energy we can accept (0: any) */
 
 
     /* quenchit mode: set temperature to (approximately) zero immediately */
@@ -1088,8 +1091,20 @@ Loop( void ) {
         /* do proc_tau moves here */
         for( i = 0; i < proc_tau; i++ ) {
 
+            /* draw the random number for the Metropolis criterion before we move:  *
+             * then we know the highest energy we could still accept, and the model *
+             * run can be stopped as soon as it goes over that (the move gets re-   *
+             * jected as FORBIDDEN_MOVE then); in quenchit mode, that's the current *
+             * energy; if the random number is below exp(MIN_DELTA), any move goes  */
+            if( quenchit )
+                bound = energy;
+            else {
+                metropolis = RandomReal(  );
+                bound = ( log( metropolis ) < MIN_DELTA ) ? 0. : energy - log( metropolis ) / S;
+            }
+
             /* make a move: will either return the energy change or FORBIDDEN_MOVE */
-            energy_change = GenerateMove( &files, &distp, &out );
+            energy_change = GenerateMove( &files, &distp, &out, bound );
             /* Metropolis stuff here; we usually want FORBIDDEN_MOVE to be very large  *
              * that's why we want to prevent overflows here (hence the 'if'); we also  *
              * need to avoid overflows with quenchit (where S is (almost) infinite!)   */
@@ -1107,7 +1122,7 @@ Loop( void ) {
 
             if( energy_change == FORBIDDEN_MOVE ) {
                 RejectMove(  );
-            } else if( ( energy_change <= 0.0 ) || ( ( !quenchit ) && ( exp( exp_arg ) > RandomReal(  ) ) ) ) {
+            } else if( ( energy_change <= 0.0 ) || ( ( !quenchit ) && ( exp( exp_arg ) > metropolis ) ) ) {
                 energy += energy_change;
                 AcceptMove(  );
                 success++;
@@ -2330,7 +2345,7 @@ FixTLoop( void ) {
 
         /* randomize initial state; throw out results; DO NOT PARALLELIZE! */
 
-        energy_change = GenerateMove( &files, &distp, &out );
+        energy_change = GenerateMove( &files, &distp, &out, 0. );
 
         /* Metropolis stuff here; we usually want FORBIDDEN_MOVE to be very large  *
          * that's why we want to prevent overflows here (hence the 'if')           */
@@ -2362,7 +2377,7 @@ FixTLoop( void ) {
 
         /* make a move: will either return the energy change or FORBIDDEN_MOVE */
 
-        energy_change = GenerateMove( &files, &distp, &out );
+        energy_change = GenerateMove( &files, &distp, &out, 0. );
 
         /* Metropolis stuff here; we usually want FORBIDDEN_MOVE to be very large  *
          * that's why we want to prevent overflows here (hence the 'if')           */
@@ -3038,24 +3053,24 @@ WriteLog( void ) {
 /** PrintLog: actually prints the log to wherever it needs to be printed */
 void
 PrintLog( FILE * outptr, int local_flag ) {
-    const char *format = "  %9d %14.6f  %10.6e %16.6f %16.6f %16.6f %16.6f %5.2f %8.5f\n";
+    const char *format = "  %9d %14.6f  %10.6e %16.6f %16.6f %16.6f %16.6f %5.2f %8.5f %7.4f\n";
 
     if( count_tau % ( print_freq * captions ) == 0 ) {
         fprintf( outptr, "\n iterations              T          dS/S            meanE" );
         fprintf( outptr, "              sdE         (e)meanE           (e)sdE" );
-        fprintf( outptr, "   acc    alpha\n\n" );
+        fprintf( outptr, "   acc    alpha aborted\n\n" );
     }
     /* print data */
 #ifdef MPI
     if( local_flag ) {
         fprintf( outptr, format,
                  ( state->tune.initial_moves + proc_init + count_tau * proc_tau ),
-                 1.0 / S, dS / S, l_mean, sqrt( l_vari ), l_estimate_mean_u, l_estimate_sd, l_acc_ratio, l_alpha );
+                 1.0 / S, dS / S, l_mean, sqrt( l_vari ), l_estimate_mean_u, l_estimate_sd, l_acc_ratio, l_alpha, AbortedFraction(  ) );
     } else {
 #endif
         fprintf( outptr, format,
                  ( state->tune.initial_moves + proc_init + count_tau * proc_tau ),
-                 1.0 / S, dS / S, mean, sqrt( vari ), estimate_mean, estimate_sd, acc_ratio, alpha );
+                 1.0 / S, dS / S, mean, sqrt( vari ), estimate_mean, estimate_sd, acc_ratio, alpha, AbortedFraction(  ) );
 #ifdef MPI
     }
 #endif
@@ -423,15 +423,24 @@ void FinalMove( void );
  */
 void WriteTimes( double *times );
 
+/** AbortedFraction: the fraction of the model runs so far that were 
+ *                    stopped early because the move they were for could  
+ *                    not have been accepted anymore (see Loop in lsa.c);  
+ *                    it goes into the log                                 
+ */
+double AbortedFraction( void );
+
 
 
 /* move generation functions that are used in lsa.c (live in move(s).c) */
 
 /** GenerateMove: evaluates the old energy, changes a parameter, then eval- 
  *               uates the new energy; returns the difference between old  
- *               and new energy to the caller                              
+ *               and new energy to the caller, or FORBIDDEN_MOVE if the    
+ *               new energy went over bound (unless bound is 0), in which  
+ *               case the model run is stopped early (see SetScoreBound)   
  */
-//double GenerateMove( Files * files, DistParms * distp, ScoreOutput * out );
+//double GenerateMove( Files * files, DistParms * distp, ScoreOutput * out, double bound );
 
 /** AcceptMove: sets new energy as the old energy for the next step and 
  *               keeps track of the number of successful moves          
@@ -0,0 +1,799 @@
+/**
+ * @file vecLib.c
+ *
+ * @brief Implementation of the vector math functions (see vecLib.h).
+ *
+ * Every function has a scalar version, which is always there and is what
+ * we compare against, plus SSE2 (2 doubles) and AVX2 (4 doubles) versions
+ * for x86 machines. The SIMD versions are compiled with per-function
+ * target attributes, so the rest of the code does not need -mavx2, and
+ * InitVecLib() installs them only if the CPU we run on supports them.
+ *
+ * exp() is done the classic way (Cody & Waite): x = k ln2 + r with
+ * |r| <= ln2/2, exp(r) by a degree-13 Taylor polynomial and 2^k put
+ * straight into the exponent bits. Arguments for which the result would
+ * not be a normal number (and NaNs) are passed on to the libm exp().
+ *
+ * The result for an element only depends on its argument: the libm fall-
+ * back is done lane by lane, and the last n % width elements go through
+ * the same SIMD code, padded to a whole register.
+ */
+
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "vecLib.h"
+
+#if defined( HAVE_SSE2 ) && ( defined( __x86_64__ ) || defined( __i386__ ) ) && defined( __GNUC__ )
+#define VEC_X86
+#include <immintrin.h>
+#define TARGET_SSE2 __attribute__ ( ( target( "sse2" ) ) )
+#define TARGET_AVX2 __attribute__ ( ( target( "avx2" ) ) )
+#endif
+
+
+/*** CONSTANTS *************************************************************/
+
+static const double LOG2E = 1.44269504088896340736;     /* 1/ln(2) */
+static const double LN2_HI = 6.93145751953125E-1;       /* ln(2) split in two */
+static const double LN2_LO = 1.42860682030941723212E-6; /* (Cody & Waite) */
+static const double EXP_MIN = -708.0;   /* fast exp() only in this range, */
+static const double EXP_MAX = 709.0;    /* where 2^k is a normal number */
+static const double TANH_MAX = 20.0;    /* tanh(x) == 1.0 for x > TANH_MAX */
+
+/* 1/k! for the exp() polynomial, highest order first */
+static const double EXP_COEFF[14] = {
+    1.0 / 6227020800.0, 1.0 / 479001600.0, 1.0 / 39916800.0, 1.0 / 3628800.0,
+    1.0 / 362880.0, 1.0 / 40320.0, 1.0 / 5040.0, 1.0 / 720.0, 1.0 / 120.0,
+    1.0 / 24.0, 1.0 / 6.0, 1.0 / 2.0, 1.0, 1.0
+};
+
+
+/*** FUNCTION POINTERS *****************************************************/
+
+/* these point to the versions installed by InitVecLib; scalar by default */
+static void VecSqrtScalar( const double *x, double *y, int n );
+static void VecExpScalar( const double *x, double *y, int n );
+static void VecTanhScalar( const double *x, double *y, int n );
+static void VecStencil3Scalar( const double *y, double *ydot, const double *D, int ng, int m );
+static void VecEnsembleDotScalar( const double *T, const double *y, double *u, int ng, int m, int K );
+static void VecEnsembleRateScalar( const double *y, const double *g, const double *lambda, const double *rate, const double *D,
+                                   double *ydot, int ng, int m, int K );
+
+static void ( *p_sqrt ) ( const double *, double *, int ) = VecSqrtScalar;
+static void ( *p_exp ) ( const double *, double *, int ) = VecExpScalar;
+static void ( *p_tanh ) ( const double *, double *, int ) = VecTanhScalar;
+static void ( *p_stencil3 ) ( const double *, double *, const double *, int, int ) = VecStencil3Scalar;
+static void ( *p_ensdot ) ( const double *, const double *, double *, int, int, int ) = VecEnsembleDotScalar;
+static void ( *p_ensrate ) ( const double *, const double *, const double *, const double *, const double *, double *, int, int,
+                             int ) = VecEnsembleRateScalar;
+
+
+/*** SCALAR VERSIONS *******************************************************/
+
+static void
+VecSqrtScalar( const double *x, double *y, int n ) {
+    int i;
+
+    for( i = 0; i < n; i++ )
+        y[i] = sqrt( x[i] );
+}
+
+static void
+VecExpScalar( const double *x, double *y, int n ) {
+    int i;
+
+    for( i = 0; i < n; i++ )
+        y[i] = exp( x[i] );
+}
+
+static void
+VecTanhScalar( const double *x, double *y, int n ) {
+    int i;
+
+    for( i = 0; i < n; i++ )
+        y[i] = tanh( x[i] );
+}
+
+static void
+VecStencil3Scalar( const double *y, double *ydot, const double *D, int ng, int m ) {
+    int ap, i, base;
+
+    for( ap = 1; ap < m - 1; ++ap ) {
+        base = ap * ng;
+        for( i = 0; i < ng; ++i )
+            ydot[base + i] += D[i] * ( y[base + i - ng] + y[base + i + ng] - 2 * y[base + i] );
+    }
+}
+
+/* one gene of one nucleus of VecEnsembleDot, for members k0 to K-1; T and *
+ * y point to the row of that gene and to the nucleus, u to the element   */
+static inline void
+EnsembleDotTail( const double *T, const double *y, double *u, int ng, int K, int k0 ) {
+    int j, k;
+    double s;
+
+    for( k = k0; k < K; k++ ) {
+        s = u[k];
+        for( j = 0; j < ng; j++ )
+            s += T[j * K + k] * y[j * K + k];
+        u[k] = s;
+    }
+}
+
+/* elements c to n-1 of one nucleus of VecEnsembleRate, which holds all  *
+ * genes of all members in the same order as lambda, rate and D; left    *
+ * and right say whether there is a neighbouring nucleus on that side,   *
+ * which is nx doubles away                                              */
+static inline void
+EnsembleRateTail( const double *y, const double *g, const double *lambda, const double *rate, const double *D, double *ydot,
+                  int n, int c, int nx, int left, int right ) {
+    double s;
+
+    for( ; c < n; c++ ) {
+        s = -lambda[c] * y[c] + rate[c] * g[c];
+        if( left && right )
+            s += D[c] * ( ( y[c - nx] - y[c] ) + ( y[c + nx] - y[c] ) );
+        else if( right )
+            s += D[c] * ( y[c + nx] - y[c] );
+        else if( left )
+            s += D[c] * ( y[c - nx] - y[c] );
+        ydot[c] = s;
+    }
+}
+
+static void
+VecEnsembleDotScalar( const double *T, const double *y, double *u, int ng, int m, int K ) {
+    int ap, i;
+
+    for( ap = 0; ap < m; ap++, y += ng * K )
+        for( i = 0; i < ng; i++, u += K )
+            EnsembleDotTail( T + i * ng * K, y, u, ng, K, 0 );
+}
+
+static void
+VecEnsembleRateScalar( const double *y, const double *g, const double *lambda, const double *rate, const double *D, double *ydot,
+                       int ng, int m, int K ) {
+    const int nx = ng * K;      /* one nucleus: all genes of all members */
+    int ap;
+
+    for( ap = 0; ap < m; ap++, y += nx, g += nx, ydot += nx )
+        EnsembleRateTail( y, g, lambda, rate, D, ydot, nx, 0, nx, ap > 0, ap < m - 1 );
+}
+
+
+#ifdef VEC_X86
+
+/*** SSE2 VERSIONS *********************************************************/
+
+/* exp() for 2 arguments in [EXP_MIN, EXP_MAX] */
+static inline TARGET_SSE2 __m128d
+ExpCoreSSE2( __m128d x ) {
+    const __m128d magic = _mm_set1_pd( 6755399441055744.0 );    /* 1.5 * 2^52 rounds to int */
+    __m128d k, r, p;
+    __m128i e;
+    int i;
+
+    k = _mm_sub_pd( _mm_add_pd( _mm_mul_pd( x, _mm_set1_pd( LOG2E ) ), magic ), magic );
+    r = _mm_sub_pd( _mm_sub_pd( x, _mm_mul_pd( k, _mm_set1_pd( LN2_HI ) ) ), _mm_mul_pd( k, _mm_set1_pd( LN2_LO ) ) );
+
+    p = _mm_set1_pd( EXP_COEFF[0] );
+    for( i = 1; i < 14; i++ )
+        p = _mm_add_pd( _mm_mul_pd( p, r ), _mm_set1_pd( EXP_COEFF[i] ) );
+
+    /* 2^k: biased exponent into bits 52-62 of each double */
+    e = _mm_add_epi32( _mm_cvtpd_epi32( k ), _mm_set1_epi32( 1023 ) );
+    e = _mm_slli_epi64( _mm_unpacklo_epi32( e, _mm_setzero_si128(  ) ), 52 );
+
+    return _mm_mul_pd( p, _mm_castsi128_pd( e ) );
+}
+
+
+/* exp(x) - 1 for 2 arguments in [EXP_MIN, EXP_MAX], without the cancel- *
+ * lation near 0: 2^k (exp(r) - 1) + (2^k - 1), where 2^k - 1 is exact  */
+static inline TARGET_SSE2 __m128d
+ExpM1CoreSSE2( __m128d x ) {
+    const __m128d magic = _mm_set1_pd( 6755399441055744.0 );    /* 1.5 * 2^52 rounds to int */
+    __m128d k, r, p, t;
+    __m128i e;
+    int i;
+
+    k = _mm_sub_pd( _mm_add_pd( _mm_mul_pd( x, _mm_set1_pd( LOG2E ) ), magic ), magic );
+    r = _mm_sub_pd( _mm_sub_pd( x, _mm_mul_pd( k, _mm_set1_pd( LN2_HI ) ) ), _mm_mul_pd( k, _mm_set1_pd( LN2_LO ) ) );
+
+    /* the exp() polynomial without its constant term */
+    p = _mm_set1_pd( EXP_COEFF[0] );
+    for( i = 1; i < 13; i++ )
+        p = _mm_add_pd( _mm_mul_pd( p, r ), _mm_set1_pd( EXP_COEFF[i] ) );
+    p = _mm_mul_pd( p, r );
+
+    e = _mm_add_epi32( _mm_cvtpd_epi32( k ), _mm_set1_epi32( 1023 ) );
+    e = _mm_slli_epi64( _mm_unpacklo_epi32( e, _mm_setzero_si128(  ) ), 52 );
+    t = _mm_castsi128_pd( e );
+
+    return _mm_add_pd( _mm_mul_pd( p, t ), _mm_sub_pd( t, _mm_set1_pd( 1.0 ) ) );
+}
+
+static TARGET_SSE2 void
+VecSqrtSSE2( const double *x, double *y, int n ) {
+    int i;
+
+    for( i = 0; i + 2 <= n; i += 2 )
+        _mm_storeu_pd( y + i, _mm_sqrt_pd( _mm_loadu_pd( x + i ) ) );
+    VecSqrtScalar( x + i, y + i, n - i );
+}
+
+/* exp() for 2 arguments: ExpCoreSSE2 where they are in range, libm for *
+ * the lanes that are not                                                */
+static inline TARGET_SSE2 __m128d
+ExpLanesSSE2( __m128d x ) {
+    __m128d ok = _mm_and_pd( _mm_cmpge_pd( x, _mm_set1_pd( EXP_MIN ) ), _mm_cmple_pd( x, _mm_set1_pd( EXP_MAX ) ) );
+    __m128d y;
+    double xs[2], ys[2];
+    int lanes, j;
+
+    /* clamped, so that the exponent bits of the other lanes stay sane */
+    y = ExpCoreSSE2( _mm_min_pd( _mm_max_pd( x, _mm_set1_pd( EXP_MIN ) ), _mm_set1_pd( EXP_MAX ) ) );
+    if( ( lanes = _mm_movemask_pd( ok ) ) == 0x3 )
+        return y;
+    _mm_storeu_pd( xs, x );
+    _mm_storeu_pd( ys, y );
+    for( j = 0; j < 2; j++ )
+        if( !( lanes & ( 1 << j ) ) )
+            ys[j] = exp( xs[j] );
+    return _mm_loadu_pd( ys );
+}
+
+/* tanh(x) = -sign(x) * e / (2 + e) with e = exp(-2|x|) - 1, which keeps *
+ * the relative error small for x near 0; libm for lanes holding NaNs    */
+static inline TARGET_SSE2 __m128d
+TanhLanesSSE2( __m128d x ) {
+    const __m128d sign = _mm_set1_pd( -0.0 );
+    __m128d a, e, y;
+    double xs[2], ys[2];
+    int lanes, j;
+
+    a = _mm_min_pd( _mm_andnot_pd( sign, x ), _mm_set1_pd( TANH_MAX ) );
+    e = ExpM1CoreSSE2( _mm_mul_pd( a, _mm_set1_pd( -2.0 ) ) );
+    a = _mm_andnot_pd( sign, _mm_div_pd( e, _mm_add_pd( _mm_set1_pd( 2.0 ), e ) ) );
+    y = _mm_or_pd( a, _mm_and_pd( sign, x ) );
+    if( ( lanes = _mm_movemask_pd( _mm_cmpunord_pd( x, x ) ) ) == 0 )
+        return y;
+    _mm_storeu_pd( xs, x );
+    _mm_storeu_pd( ys, y );
+    for( j = 0; j < 2; j++ )
+        if( lanes & ( 1 << j ) )
+            ys[j] = tanh( xs[j] );
+    return _mm_loadu_pd( ys );
+}
+
+static TARGET_SSE2 void
+VecExpSSE2( const double *x, double *y, int n ) {
+    int i;
+    double pad[2] = { 0, 0 };
+
+    for( i = 0; i + 2 <= n; i += 2 )
+        _mm_storeu_pd( y + i, ExpLanesSSE2( _mm_loadu_pd( x + i ) ) );
+    if( i < n ) {
+        pad[0] = x[i];
+        _mm_storeu_pd( pad, ExpLanesSSE2( _mm_loadu_pd( pad ) ) );
+        y[i] = pad[0];
+    }
+}
+
+static TARGET_SSE2 void
+VecTanhSSE2( const double *x, double *y, int n ) {
+    int i;
+    double pad[2] = { 0, 0 };
+
+    for( i = 0; i + 2 <= n; i += 2 )
+        _mm_storeu_pd( y + i, TanhLanesSSE2( _mm_loadu_pd( x + i ) ) );
+    if( i < n ) {
+        pad[0] = x[i];
+        _mm_storeu_pd( pad, TanhLanesSSE2( _mm_loadu_pd( pad ) ) );
+        y[i] = pad[0];
+    }
+}
+
+static TARGET_SSE2 void
+VecStencil3SSE2( const double *y, double *ydot, const double *D, int ng, int m ) {
+    const __m128d two = _mm_set1_pd( 2.0 );
+    int ap, i, base;
+    __m128d s;
+
+    for( ap = 1; ap < m - 1; ++ap ) {
+        base = ap * ng;
+        for( i = 0; i + 2 <= ng; i += 2 ) {
+            s = _mm_add_pd( _mm_loadu_pd( y + base + i - ng ), _mm_loadu_pd( y + base + i + ng ) );
+            s = _mm_sub_pd( s, _mm_mul_pd( two, _mm_loadu_pd( y + base + i ) ) );
+            s = _mm_add_pd( _mm_loadu_pd( ydot + base + i ), _mm_mul_pd( _mm_loadu_pd( D + i ), s ) );
+            _mm_storeu_pd( ydot + base + i, s );
+        }
+        for( ; i < ng; ++i )
+            ydot[base + i] += D[i] * ( y[base + i - ng] + y[base + i + ng] - 2 * y[base + i] );
+    }
+}
+
+/* one gene of one nucleus of VecEnsembleDot (see EnsembleDotTail), two *
+ * members at a time from k on; returns the first member left over       */
+static inline TARGET_SSE2 int
+EnsembleDotPairs( const double *T, const double *y, double *u, int ng, int K, int k ) {
+    int j;
+    __m128d s;
+
+    for( ; k + 2 <= K; k += 2 ) {
+        s = _mm_loadu_pd( u + k );
+        for( j = 0; j < ng; j++ )
+            s = _mm_add_pd( s, _mm_mul_pd( _mm_loadu_pd( T + j * K + k ), _mm_loadu_pd( y + j * K + k ) ) );
+        _mm_storeu_pd( u + k, s );
+    }
+    return k;
+}
+
+/* the same for VecEnsembleRate (see EnsembleRateTail) */
+static inline TARGET_SSE2 int
+EnsembleRatePairs( const double *y, const double *g, const double *lambda, const double *rate, const double *D, double *ydot,
+                   int n, int c, int nx, int left, int right ) {
+    const __m128d sign = _mm_set1_pd( -0.0 );
+    __m128d yc, s, d;
+
+    for( ; c + 2 <= n; c += 2 ) {
+        yc = _mm_loadu_pd( y + c );
+        s = _mm_mul_pd( _mm_xor_pd( _mm_loadu_pd( lambda + c ), sign ), yc );
+        s = _mm_add_pd( s, _mm_mul_pd( _mm_loadu_pd( rate + c ), _mm_loadu_pd( g + c ) ) );
+        if( left || right ) {
+            if( left && right )
+                d = _mm_add_pd( _mm_sub_pd( _mm_loadu_pd( y + c - nx ), yc ), _mm_sub_pd( _mm_loadu_pd( y + c + nx ), yc ) );
+            else if( right )
+                d = _mm_sub_pd( _mm_loadu_pd( y + c + nx ), yc );
+            else
+                d = _mm_sub_pd( _mm_loadu_pd( y + c - nx ), yc );
+            s = _mm_add_pd( s, _mm_mul_pd( _mm_loadu_pd( D + c ), d ) );
+        }
+        _mm_storeu_pd( ydot + c, s );
+    }
+    return c;
+}
+
+static TARGET_SSE2 void
+VecEnsembleDotSSE2( const double *T, const double *y, double *u, int ng, int m, int K ) {
+    int ap, i, k;
+
+    for( ap = 0; ap < m; ap++, y += ng * K )
+        for( i = 0; i < ng; i++, u += K ) {
+            k = EnsembleDotPairs( T + i * ng * K, y, u, ng, K, 0 );
+            if( k < K )
+                EnsembleDotTail( T + i * ng * K, y, u, ng, K, k );
+        }
+}
+
+static TARGET_SSE2 void
+VecEnsembleRateSSE2( const double *y, const double *g, const double *lambda, const double *rate, const double *D, double *ydot,
+                     int ng, int m, int K ) {
+    const int nx = ng * K;
+    int ap, c;
+
+    for( ap = 0; ap < m; ap++, y += nx, g += nx, ydot += nx ) {
+        c = EnsembleRatePairs( y, g, lambda, rate, D, ydot, nx, 0, nx, ap > 0, ap < m - 1 );
+        if( c < nx )
+            EnsembleRateTail( y, g, lambda, rate, D, ydot, nx, c, nx, ap > 0, ap < m - 1 );
+    }
+}
+
+
+/*** AVX2 VERSIONS *********************************************************/
+
+/* exp() for 4 arguments in [EXP_MIN, EXP_MAX] */
+static inline TARGET_AVX2 __m256d
+ExpCoreAVX2( __m256d x ) {
+    __m256d k, r, p;
+    __m256i e;
+    int i;
+
+    k = _mm256_round_pd( _mm256_mul_pd( x, _mm256_set1_pd( LOG2E ) ), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC );
+    r = _mm256_sub_pd( _mm256_sub_pd( x, _mm256_mul_pd( k, _mm256_set1_pd( LN2_HI ) ) ), _mm256_mul_pd( k, _mm256_set1_pd( LN2_LO ) ) );
+
+    p = _mm256_set1_pd( EXP_COEFF[0] );
+    for( i = 1; i < 14; i++ )
+        p = _mm256_add_pd( _mm256_mul_pd( p, r ), _mm256_set1_pd( EXP_COEFF[i] ) );
+
+    /* 2^k: biased exponent into bits 52-62 of each double */
+    e = _mm256_cvtepi32_epi64( _mm_add_epi32( _mm256_cvtpd_epi32( k ), _mm_set1_epi32( 1023 ) ) );
+    e = _mm256_slli_epi64( e, 52 );
+
+    return _mm256_mul_pd( p, _mm256_castsi256_pd( e ) );
+}
+
+
+/* exp(x) - 1 for 4 arguments in [EXP_MIN, EXP_MAX] (see ExpM1CoreSSE2) */
+static inline TARGET_AVX2 __m256d
+ExpM1CoreAVX2( __m256d x ) {
+    __m256d k, r, p, t;
+    __m256i e;
+    int i;
+
+    k = _mm256_round_pd( _mm256_mul_pd( x, _mm256_set1_pd( LOG2E ) ), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC );
+    r = _mm256_sub_pd( _mm256_sub_pd( x, _mm256_mul_pd( k, _mm256_set1_pd( LN2_HI ) ) ), _mm256_mul_pd( k, _mm256_set1_pd( LN2_LO ) ) );
+
+    p = _mm256_set1_pd( EXP_COEFF[0] );
+    for( i = 1; i < 13; i++ )
+        p = _mm256_add_pd( _mm256_mul_pd( p, r ), _mm256_set1_pd( EXP_COEFF[i] ) );
+    p = _mm256_mul_pd( p, r );
+
+    e = _mm256_cvtepi32_epi64( _mm_add_epi32( _mm256_cvtpd_epi32( k ), _mm_set1_epi32( 1023 ) ) );
+    t = _mm256_castsi256_pd( _mm256_slli_epi64( e, 52 ) );
+
+    return _mm256_add_pd( _mm256_mul_pd( p, t ), _mm256_sub_pd( t, _mm256_set1_pd( 1.0 ) ) );
+}
+
+static TARGET_AVX2 void
+VecSqrtAVX2( const double *x, double *y, int n ) {
+    int i;
+
+    for( i = 0; i + 4 <= n; i += 4 )
+        _mm256_storeu_pd( y + i, _mm256_sqrt_pd( _mm256_loadu_pd( x + i ) ) );
+    VecSqrtScalar( x + i, y + i, n - i );
+}
+
+/* exp() for 4 arguments, lane by lane as in ExpLanesSSE2 */
+static inline TARGET_AVX2 __m256d
+ExpLanesAVX2( __m256d x ) {
+    __m256d ok = _mm256_and_pd( _mm256_cmp_pd( x, _mm256_set1_pd( EXP_MIN ), _CMP_GE_OQ ),
+                                _mm256_cmp_pd( x, _mm256_set1_pd( EXP_MAX ), _CMP_LE_OQ ) );
+    __m256d y;
+    double xs[4], ys[4];
+    int lanes, j;
+
+    y = ExpCoreAVX2( _mm256_min_pd( _mm256_max_pd( x, _mm256_set1_pd( EXP_MIN ) ), _mm256_set1_pd( EXP_MAX ) ) );
+    if( ( lanes = _mm256_movemask_pd( ok ) ) == 0xf )
+        return y;
+    _mm256_storeu_pd( xs, x );
+    _mm256_storeu_pd( ys, y );
+    for( j = 0; j < 4; j++ )
+        if( !( lanes & ( 1 << j ) ) )
+            ys[j] = exp( xs[j] );
+    return _mm256_loadu_pd( ys );
+}
+
+/* tanh() for 4 arguments as in TanhLanesSSE2 */
+static inline TARGET_AVX2 __m256d
+TanhLanesAVX2( __m256d x ) {
+    const __m256d sign = _mm256_set1_pd( -0.0 );
+    __m256d a, e, y;
+    double xs[4], ys[4];
+    int lanes, j;
+
+    a = _mm256_min_pd( _mm256_andnot_pd( sign, x ), _mm256_set1_pd( TANH_MAX ) );
+    e = ExpM1CoreAVX2( _mm256_mul_pd( a, _mm256_set1_pd( -2.0 ) ) );
+    a = _mm256_andnot_pd( sign, _mm256_div_pd( e, _mm256_add_pd( _mm256_set1_pd( 2.0 ), e ) ) );
+    y = _mm256_or_pd( a, _mm256_and_pd( sign, x ) );
+    if( ( lanes = _mm256_movemask_pd( _mm256_cmp_pd( x, x, _CMP_UNORD_Q ) ) ) == 0 )
+        return y;
+    _mm256_storeu_pd( xs, x );
+    _mm256_storeu_pd( ys, y );
+    for( j = 0; j < 4; j++ )
+        if( lanes & ( 1 << j ) )
+            ys[j] = tanh( xs[j] );
+    return _mm256_loadu_pd( ys );
+}
+
+static TARGET_AVX2 void
+VecExpAVX2( const double *x, double *y, int n ) {
+    int i;
+    double pad[4] = { 0, 0, 0, 0 };
+
+    for( i = 0; i + 4 <= n; i += 4 )
+        _mm256_storeu_pd( y + i, ExpLanesAVX2( _mm256_loadu_pd( x + i ) ) );
+    if( i < n ) {
+        memcpy( pad, x + i, ( n - i ) * sizeof( double ) );
+        _mm256_storeu_pd( pad, ExpLanesAVX2( _mm256_loadu_pd( pad ) ) );
+        memcpy( y + i, pad, ( n - i ) * sizeof( double ) );
+    }
+}
+
+static TARGET_AVX2 void
+VecTanhAVX2( const double *x, double *y, int n ) {
+    int i;
+    double pad[4] = { 0, 0, 0, 0 };
+
+    for( i = 0; i + 4 <= n; i += 4 )
+        _mm256_storeu_pd( y + i, TanhLanesAVX2( _mm256_loadu_pd( x + i ) ) );
+    if( i < n ) {
+        memcpy( pad, x + i, ( n - i ) * sizeof( double ) );
+        _mm256_storeu_pd( pad, TanhLanesAVX2( _mm256_loadu_pd( pad ) ) );
+        memcpy( y + i, pad, ( n - i ) * sizeof( double ) );
+    }
+}
+
+static TARGET_AVX2 void
+VecStencil3AVX2( const double *y, double *ydot, const double *D, int ng, int m ) {
+    const __m256d two = _mm256_set1_pd( 2.0 );
+    int ap, i, base;
+    __m256d s;
+
+    for( ap = 1; ap < m - 1; ++ap ) {
+        base = ap * ng;
+        for( i = 0; i + 4 <= ng; i += 4 ) {
+            s = _mm256_add_pd( _mm256_loadu_pd( y + base + i - ng ), _mm256_loadu_pd( y + base + i + ng ) );
+            s = _mm256_sub_pd( s, _mm256_mul_pd( two, _mm256_loadu_pd( y + base + i ) ) );
+            s = _mm256_add_pd( _mm256_loadu_pd( ydot + base + i ), _mm256_mul_pd( _mm256_loadu_pd( D + i ), s ) );
+            _mm256_storeu_pd( ydot + base + i, s );
+        }
+        for( ; i < ng; ++i )
+            ydot[base + i] += D[i] * ( y[base + i - ng] + y[base + i + ng] - 2 * y[base + i] );
+    }
+}
+/* VecEnsembleDot and VecEnsembleRate take 4 members at a time, and the *
+ * last 2 or 3 of them with the SSE2 versions                            */
+static TARGET_AVX2 void
+VecEnsembleDotAVX2( const double *T, const double *y, double *u, int ng, int m, int K ) {
+    int ap, i, j, k;
+    const double *Ti;
+    __m256d s;
+
+    for( ap = 0; ap < m; ap++, y += ng * K )
+        for( i = 0, Ti = T; i < ng; i++, u += K, Ti += ng * K ) {
+            for( k = 0; k + 4 <= K; k += 4 ) {
+                s = _mm256_loadu_pd( u + k );
+                for( j = 0; j < ng; j++ )
+                    s = _mm256_add_pd( s, _mm256_mul_pd( _mm256_loadu_pd( Ti + j * K + k ), _mm256_loadu_pd( y + j * K + k ) ) );
+                _mm256_storeu_pd( u + k, s );
+            }
+            k = EnsembleDotPairs( Ti, y, u, ng, K, k );
+            if( k < K )
+                EnsembleDotTail( Ti, y, u, ng, K, k );
+        }
+}
+
+static TARGET_AVX2 void
+VecEnsembleRateAVX2( const double *y, const double *g, const double *lambda, const double *rate, const double *D, double *ydot,
+                     int ng, int m, int K ) {
+    const __m256d sign = _mm256_set1_pd( -0.0 );
+    const int nx = ng * K;
+    int ap, c, left, right;
+    __m256d yc, s, d;
+
+    for( ap = 0; ap < m; ap++, y += nx, g += nx, ydot += nx ) {
+        left = ap > 0;
+        right = ap < m - 1;
+        for( c = 0; c + 4 <= nx; c += 4 ) {
+            yc = _mm256_loadu_pd( y + c );
+            s = _mm256_mul_pd( _mm256_xor_pd( _mm256_loadu_pd( lambda + c ), sign ), yc );
+            s = _mm256_add_pd( s, _mm256_mul_pd( _mm256_loadu_pd( rate + c ), _mm256_loadu_pd( g + c ) ) );
+            if( left || right ) {
+                if( left && right )
+                    d = _mm256_add_pd( _mm256_sub_pd( _mm256_loadu_pd( y + c - nx ), yc ), _mm256_sub_pd( _mm256_loadu_pd( y + c + nx ), yc ) );
+                else if( right )
+                    d = _mm256_sub_pd( _mm256_loadu_pd( y + c + nx ), yc );
+                else
+                    d = _mm256_sub_pd( _mm256_loadu_pd( y + c - nx ), yc );
+                s = _mm256_add_pd( s, _mm256_mul_pd( _mm256_loadu_pd( D + c ), d ) );
+            }
+            _mm256_storeu_pd( ydot + c, s );
+        }
+        c = EnsembleRatePairs( y, g, lambda, rate, D, ydot, nx, c, nx, left, right );
+        if( c < nx )
+            EnsembleRateTail( y, g, lambda, rate, D, ydot, nx, c, nx, left, right );
+    }
+}
+
+#endif                          /* VEC_X86 */
+
+
+/*** INITIALIZATION ********************************************************/
+
+/** InitVecLib: detects the CPU features and installs the fastest vector
+ *               functions up to max_level; returns the level in use
+ */
+VecLevel
+InitVecLib( VecLevel max_level ) {
+    VecLevel level = VecScalar;
+
+#ifdef VEC_X86
+    __builtin_cpu_init(  );
+    if( ( max_level >= VecAVX2 ) && __builtin_cpu_supports( "avx2" ) )
+        level = VecAVX2;
+    else if( ( max_level >= VecSSE2 ) && __builtin_cpu_supports( "sse2" ) )
+        level = VecSSE2;
+#endif
+
+    p_sqrt = VecSqrtScalar;
+    p_exp = VecExpScalar;
+    p_tanh = VecTanhScalar;
+    p_stencil3 = VecStencil3Scalar;
+    p_ensdot = VecEnsembleDotScalar;
+    p_ensrate = VecEnsembleRateScalar;
+
+#ifdef VEC_X86
+    if( level == VecAVX2 ) {
+        p_sqrt = VecSqrtAVX2;
+        p_exp = VecExpAVX2;
+        p_tanh = VecTanhAVX2;
+        p_stencil3 = VecStencil3AVX2;
+        p_ensdot = VecEnsembleDotAVX2;
+        p_ensrate = VecEnsembleRateAVX2;
+    } else if( level == VecSSE2 ) {
+        p_sqrt = VecSqrtSSE2;
+        p_exp = VecExpSSE2;
+        p_tanh = VecTanhSSE2;
+        p_stencil3 = VecStencil3SSE2;
+        p_ensdot = VecEnsembleDotSSE2;
+        p_ensrate = VecEnsembleRateSSE2;
+    }
+#endif
+
+    return level;
+}
+
+/** VecLevelName: returns a printable name for a vector level */
+const char *
+VecLevelName( VecLevel level ) {
+    switch ( level ) {
+    case VecAVX2:
+        return "avx2";
+    case VecSSE2:
+        return "sse2";
+    default:
+        return "scalar";
+    }
+}
+
+
+/*** THE VECTOR FUNCTIONS **************************************************/
+
+void
+VecSqrt( const double *x, double *y, int n ) {
+    ( *p_sqrt ) ( x, y, n );
+}
+
+void
+VecExp( const double *x, double *y, int n ) {
+    ( *p_exp ) ( x, y, n );
+}
+
+void
+VecTanh( const double *x, double *y, int n ) {
+    ( *p_tanh ) ( x, y, n );
+}
+
+void
+VecStencil3( const double *y, double *ydot, const double *D, int ng, int m ) {
+    ( *p_stencil3 ) ( y, ydot, D, ng, m );
+}
+
+void
+VecEnsembleDot( const double *T, const double *y, double *u, int ng, int m, int K ) {
+    ( *p_ensdot ) ( T, y, u, ng, m, K );
+}
+
+void
+VecEnsembleRate( const double *y, const double *g, const double *lambda, const double *rate, const double *D, double *ydot,
+                 int ng, int m, int K ) {
+    ( *p_ensrate ) ( y, g, lambda, rate, D, ydot, ng, m, K );
+}
+
+
+/*** SELF CHECK ************************************************************/
+
+/* 1 if f gives the bits in ref (f of all n elements of x in one call) for *
+ * every piece x[off] to x[off+len-1] of up to 9 elements as well, so that *
+ * both the tails and each position in a register get used                */
+static int
+SameEverywhere( void ( *f ) ( const double *, double *, int ), const double *x, const double *ref, int n ) {
+    double y[9];
+    int off, len;
+
+    for( off = 0; off < n; off++ )
+        for( len = 1; ( len <= 9 ) && ( off + len <= n ); len++ ) {
+            f( x + off, y, len );
+            if( memcmp( y, ref + off, len * sizeof( double ) ) )
+                return 0;
+        }
+    return 1;
+}
+
+/** VecSelfCheck: runs the installed functions against the scalar ones on
+ *                 a grid of arguments (including the edges of the fast
+ *                 exp range) and returns the largest error in units of
+ *                 DBL_EPSILON: relative for sqrt, exp and tanh, absolute
+ *                 for the stencil and the ensemble functions; if exp or
+ *                 tanh give other bits for an argument depending on where
+ *                 it is in the array (or next to which arguments out of
+ *                 the fast range), the error is HUGE_VAL
+ */
+double
+VecSelfCheck( void ) {
+    enum { NPTS = 4003, NNUC = 11, NG = 6, NK = 7, NMIX = 37 };
+    static double x[NPTS], y[NPTS], ref[NPTS];
+    double xm[NMIX], ym[NMIX];
+    static double v[NNUC * NG], vd[NNUC * NG], vdref[NNUC * NG];
+    static double ev[NNUC * NG * NK], eg[NNUC * NG * NK], eu[NNUC * NG * NK], euref[NNUC * NG * NK];
+    static double evd[NNUC * NG * NK], evdref[NNUC * NG * NK], eT[NG * NG * NK], epar[NG * NK], eD[NG * NK];
+    const double D[NG] = { 0.237, 0.3, 0.115, 0.3, 0.2, 0.01 };
+    double err, maxerr = 0;
+    int i;
+
+    /* sqrt and exp: x from -800 to 800, bunched up around zero */
+    for( i = 0; i < NPTS; i++ ) {
+        x[i] = ( i - NPTS / 2 ) * 0.01;
+        if( i % 3 == 0 )
+            x[i] *= 40.0;
+    }
+
+    for( i = 0; i < NPTS; i++ )
+        x[i] = fabs( x[i] );
+    VecSqrt( x, y, NPTS );
+    VecSqrtScalar( x, ref, NPTS );
+    for( i = 0; i < NPTS; i++ )
+        if( ref[i] > 0 && ( err = fabs( y[i] - ref[i] ) / ( ref[i] * DBL_EPSILON ) ) > maxerr )
+            maxerr = err;
+
+    for( i = 0; i < NPTS; i++ )
+        x[i] = ( i % 2 ) ? x[i] : -x[i];
+    VecExp( x, y, NPTS );
+    VecExpScalar( x, ref, NPTS );
+    for( i = 0; i < NPTS; i++ )
+        if( ref[i] > DBL_MIN && !isinf( ref[i] ) && ( err = fabs( y[i] - ref[i] ) / ( ref[i] * DBL_EPSILON ) ) > maxerr )
+            maxerr = err;
+
+    /* tanh: the same, spread down to tiny arguments */
+    for( i = 0; i < NPTS; i++ )
+        x[i] = ldexp( x[i], -( i % 64 ) );
+    VecTanh( x, y, NPTS );
+    VecTanhScalar( x, ref, NPTS );
+    for( i = 0; i < NPTS; i++ )
+        if( ref[i] != 0 && ( err = fabs( y[i] - ref[i] ) / fabs( ref[i] * DBL_EPSILON ) ) > maxerr )
+            maxerr = err;
+
+    /* exp and tanh at every position, with arguments out of the fast range *
+     * (and NaNs) mixed in                                                  */
+    for( i = 0; i < NMIX; i++ ) {
+        xm[i] = 5.0 * sin( 1.3 * i );
+        if( i % 5 == 2 )
+            xm[i] = ( i % 4 == 0 ) ? NAN : ( ( i % 4 == 1 ) ? -800.0 : 750.0 );
+    }
+    VecExp( xm, ym, NMIX );
+    if( !SameEverywhere( VecExp, xm, ym, NMIX ) )
+        maxerr = HUGE_VAL;
+    VecTanh( xm, ym, NMIX );
+    if( !SameEverywhere( VecTanh, xm, ym, NMIX ) )
+        maxerr = HUGE_VAL;
+
+    /* stencil: compare the complete derivative array */
+    for( i = 0; i < NNUC * NG; i++ ) {
+        v[i] = sin( 0.37 * i ) * 100.0;
+        vd[i] = vdref[i] = cos( 0.11 * i );
+    }
+    VecStencil3( v, vd, D, NG, NNUC );
+    VecStencil3Scalar( v, vdref, D, NG, NNUC );
+    for( i = 0; i < NNUC * NG; i++ )
+        if( ( err = fabs( vd[i] - vdref[i] ) / DBL_EPSILON ) > maxerr )
+            maxerr = err;
+
+    /* ensemble: an odd number of members, so the tails get used as well */
+    for( i = 0; i < NNUC * NG * NK; i++ ) {
+        ev[i] = sin( 0.37 * i ) * 100.0;
+        eg[i] = cos( 0.23 * i );
+        eu[i] = euref[i] = cos( 0.11 * i );
+    }
+    for( i = 0; i < NG * NG * NK; i++ )
+        eT[i] = sin( 0.71 * i );
+    for( i = 0; i < NG * NK; i++ ) {
+        epar[i] = 0.1 + 0.01 * i;
+        eD[i] = D[i % NG];
+    }
+    VecEnsembleDot( eT, ev, eu, NG, NNUC, NK );
+    VecEnsembleDotScalar( eT, ev, euref, NG, NNUC, NK );
+    VecEnsembleRate( ev, eg, epar, eT, eD, evd, NG, NNUC, NK );
+    VecEnsembleRateScalar( ev, eg, epar, eT, eD, evdref, NG, NNUC, NK );
+    for( i = 0; i < NNUC * NG * NK; i++ ) {
+        if( ( err = fabs( eu[i] - euref[i] ) / DBL_EPSILON ) > maxerr )
+            maxerr = err;
+        if( ( err = fabs( evd[i] - evdref[i] ) / DBL_EPSILON ) > maxerr )
+            maxerr = err;
+    }
+
+    return maxerr;
+}
@@ -0,0 +1,81 @@
+/**
+ * @file vecLib.h
+ *
+ * @brief Vector math functions for the inner loop of the model.
+ *
+ * These replace the DEC vsqrt_/vexp_ functions we used to have on the
+ * alphas. Each function works on a whole array of doubles and comes in a
+ * scalar, an SSE2 and an AVX2 flavour; InitVecLib() checks what the CPU
+ * can do at runtime and installs the fastest one. SSE2 and AVX2 are only
+ * compiled in on x86 with HAVE_SSE2 defined (see Makefile).
+ *
+ * VecSqrt, VecStencil3 and the ensemble functions give the same bits as
+ * their scalar versions.
+ * VecExp and VecTanh use their own polynomial and are accurate to a few
+ * ulp (relative), which is plenty for g(u). Like all the others, they give
+ * the same bits for an argument wherever it is in the array, whatever the
+ * length of the array and whatever is next to it.
+ */
+
+#ifndef VECLIB_INCLUDED
+#define VECLIB_INCLUDED
+
+/** the instruction sets we know about */
+typedef enum VecLevel {
+    VecScalar,
+    VecSSE2,
+    VecAVX2
+} VecLevel;
+
+/** InitVecLib: detects the CPU features and installs the fastest vector
+ *               functions; pass VecAVX2 to get the best available, or a
+ *               lower level to restrict it (VecScalar turns SIMD off);
+ *               returns the level actually used
+ */
+VecLevel InitVecLib( VecLevel max_level );
+
+/** VecLevelName: returns a printable name for a vector level */
+const char *VecLevelName( VecLevel level );
+
+/** VecSqrt: y[i] = sqrt(x[i]) for i < n */
+void VecSqrt( const double *x, double *y, int n );
+
+/** VecExp: y[i] = exp(x[i]) for i < n */
+void VecExp( const double *x, double *y, int n );
+
+/** VecTanh: y[i] = tanh(x[i]) for i < n (relative error of a few ulp) */
+void VecTanh( const double *x, double *y, int n );
+
+/** VecStencil3: adds the 3-point diffusion stencil for all inner nuclei,
+ *                i.e. ydot[i] += D[k] * (y[i-ng] + y[i+ng] - 2 y[i]) for
+ *                the genes k of nuclei 1 to m-2 (ng genes per nucleus)
+ */
+void VecStencil3( const double *y, double *ydot, const double *D, int ng, int m );
+
+/** VecEnsembleDot: u += T . y in each of m nuclei of ng genes for the K
+ *                   members of an ensemble, whose states are interleaved
+ *                   (element i of member k at i * K + k, and T the same
+ *                   way); the sum over the genes goes left to right, so
+ *                   each member gets the same bits as from a plain loop
+ */
+void VecEnsembleDot( const double *T, const double *y, double *u, int ng, int m, int K );
+
+/** VecEnsembleRate: ydot = -lambda y + rate g plus diffusion between the
+ *                    nuclei (none at the outer side of the first and the
+ *                    last one) for an ensemble laid out as in VecEnsemble-
+ *                    Dot; lambda, rate and D have one entry per gene and
+ *                    member (gene i of member k at i * K + k); the terms
+ *                    are summed in the order they are written here
+ */
+void VecEnsembleRate( const double *y, const double *g, const double *lambda, const double *rate, const double *D, double *ydot,
+                      int ng, int m, int K );
+
+/** VecSelfCheck: compares the installed vector functions with the scalar
+ *                 ones on a range of arguments; returns the largest error
+ *                 found in units of DBL_EPSILON, or HUGE_VAL if VecExp or
+ *                 VecTanh depend on the position of an argument (run by
+ *                 veccheck in the util build, and under debug)
+ */
+double VecSelfCheck( void );
+
+#endif
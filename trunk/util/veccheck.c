@@ -0,0 +1,37 @@
+/**
+ * @file veccheck.c
+ *
+ * @brief Checks the vector functions on every level the CPU supports.
+ *
+ * Runs VecSelfCheck() for the scalar, SSE2 and AVX2 versions (as far as
+ * this machine has them) and fails if any of them is off by more than
+ * VEC_CHECK_MAX ulp, or gives an argument different bits depending on
+ * where it is in the array. 'make' in util runs it after building
+ * vecLib.o.
+ */
+
+#include <stdio.h>
+
+#include "vecLib.h"
+
+#define VEC_CHECK_MAX 4.0       /* most error allowed, in DBL_EPSILON */
+
+int
+main( void ) {
+    VecLevel want, got;
+    double err;
+    int failed = 0;
+
+    for( want = VecScalar; want <= VecAVX2; want++ ) {
+        got = InitVecLib( want );
+        if( got != want )
+            continue;           /* not on this machine (or not compiled in) */
+        err = VecSelfCheck(  );
+        printf( "veccheck: %-6s largest error %g ulp\n", VecLevelName( got ), err );
+        if( !( err <= VEC_CHECK_MAX ) )
+            failed = 1;
+    }
+    if( failed )
+        fprintf( stderr, "veccheck: vector functions are off\n" );
+    return failed;
+}